@@ -21,11 +21,21 @@
 
 typedef struct model_runner_args {
   QueueHandle_t input_queue;
+  rtos_intertile_pool_t *input_pool;
   rtos_intertile_address_t *intertile_addr;
 } model_runner_args_t;
 
 #define TENSOR_ARENA_SIZE 58000
 
+#define INPUT_TENSOR_SIZE (32 * 32 * 3)
+#define OUTPUT_TENSOR_SIZE 10
+
+/*
+ * One input tensor may be queued for the runner while
+ * the next one is being received.
+ */
+#define INPUT_TENSOR_POOL_BLOCKS 2
+
 static int argmax(const int8_t *A, const int N) {
   int m = 0;
 
@@ -49,7 +59,7 @@ static void cifar10_task_app(void *args) {
   uint8_t *data = NULL;
   FRESULT result;
   unsigned int bytes_read = 0;
-  uint8_t *output_tensor;
+  int8_t output_tensor[OUTPUT_TENSOR_SIZE];
   int output_tensor_len;
   char classification[12] = {0};
 
@@ -73,10 +83,10 @@ static void cifar10_task_app(void *args) {
       vPortFree(data);
 
       output_tensor_len =
-          rtos_intertile_rx(adr->intertile_ctx, adr->port,
-                            (void **)&output_tensor, portMAX_DELAY);
+          rtos_intertile_rx_buf(adr->intertile_ctx, adr->port, output_tensor,
+                                sizeof(output_tensor), portMAX_DELAY);
 
-      switch (argmax((int8_t *)output_tensor, 10)) {
+      switch (argmax(output_tensor, OUTPUT_TENSOR_SIZE)) {
       case 0:
         rtos_snprintf(classification, 9, "Airplane");
         break;
@@ -112,7 +122,6 @@ static void cifar10_task_app(void *args) {
       }
       rtos_printf("Classification of file %s is %s\n", test_input_files[i],
                   classification);
-      vPortFree(output_tensor);
     }
     rtos_printf("All files complete.  Repeating in 5 seconds...\n");
     vTaskDelay(pdMS_TO_TICKS(5000));
@@ -127,8 +136,9 @@ static void cifar10_runner_rx(void *args) {
   int input_tensor_len;
 
   while (1) {
-    input_tensor_len = rtos_intertile_rx(adr->intertile_ctx, adr->port,
-                                         (void **)&input_tensor, portMAX_DELAY);
+    input_tensor_len =
+        rtos_intertile_rx_pool(adr->intertile_ctx, adr->port, targs->input_pool,
+                               (void **)&input_tensor, portMAX_DELAY);
     xQueueSend(q, &input_tensor, portMAX_DELAY);
   }
 }
@@ -175,6 +185,7 @@ static void cifar10_task_runner(void *args) {
 
   input_buffer = model_runner_input_buffer_get(model_runner_ctx);
   input_size = model_runner_input_size_get(model_runner_ctx);
+  configASSERT(input_size <= INPUT_TENSOR_SIZE);
   output_buffer = model_runner_output_buffer_get(model_runner_ctx);
   output_size = model_runner_output_size_get(model_runner_ctx);
 
@@ -183,7 +194,7 @@ static void cifar10_task_runner(void *args) {
     xQueueReceive(q, &input_tensor, portMAX_DELAY);
 
     memcpy(input_buffer, input_tensor, input_size);
-    vPortFree(input_tensor);
+    rtos_intertile_pool_free(targs->input_pool, input_tensor);
 
     rtos_printf("Running inference...\n");
     model_runner_invoke(model_runner_ctx);
@@ -203,13 +214,20 @@ void cifar10_app_task_create(rtos_intertile_address_t *intertile_addr,
 
 void cifar10_model_runner_task_create(rtos_intertile_address_t *intertile_addr,
                                       unsigned priority) {
+  static uint32_t input_pool_buf[INPUT_TENSOR_POOL_BLOCKS * INPUT_TENSOR_SIZE /
+                                 sizeof(uint32_t)];
+  static rtos_intertile_pool_t input_pool;
   model_runner_args_t *args = pvPortMalloc(sizeof(model_runner_args_t));
   QueueHandle_t input_queue = xQueueCreate(1, sizeof(int32_t *));
 
   configASSERT(args);
   configASSERT(input_queue);
 
+  rtos_intertile_pool_init(&input_pool, input_pool_buf, INPUT_TENSOR_SIZE,
+                           INPUT_TENSOR_POOL_BLOCKS);
+
   args->input_queue = input_queue;
+  args->input_pool = &input_pool;
   args->intertile_addr = intertile_addr;
 
   xTaskCreate((TaskFunction_t)cifar10_task_runner, "cifar10", 500, args,
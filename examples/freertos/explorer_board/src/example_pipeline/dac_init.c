@@ -10,14 +10,24 @@
 /* Header for the DAC chip registers and i2c address */
 #include "example_pipeline/DAC3204.h"
 
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/*
+ * A write of a value to a register in the AIC3204 DAC chip.
+ */
+#define DAC_REG_WRITE(reg, val) {rtos_i2c_master_reg_op_write, AIC3204_I2C_DEVICE_ADDR, (reg), (val)}
+
 /*
- * Writes a value to a register in the AIC3204 DAC chip.
+ * Performs a sequence of register writes to the AIC3204 DAC chip. They
+ * are performed as a single batch so that, when the I2C bus is owned by
+ * the other tile, the sequence needs only one intertile round trip.
  */
-static inline int i2c_dac_reg_write(rtos_i2c_master_t *i2c_ctx, uint8_t reg, uint8_t val)
+static int i2c_dac_reg_batch(rtos_i2c_master_t *i2c_ctx, rtos_i2c_master_reg_op_t ops[], size_t count)
 {
 	i2c_regop_res_t ret;
+	size_t num_ops_done;
 
-	ret = rtos_i2c_master_reg_write(i2c_ctx, AIC3204_I2C_DEVICE_ADDR, reg, val);
+	ret = rtos_i2c_master_reg_batch(i2c_ctx, ops, count, &num_ops_done);
 
 	if (ret == I2C_REGOP_SUCCESS) {
 		return 0;
@@ -26,6 +36,92 @@ static inline int i2c_dac_reg_write(rtos_i2c_master_t *i2c_ctx, uint8_t reg, uin
 	}
 }
 
+static rtos_i2c_master_reg_op_t dac_config_seq[] = {
+	// Set register page to 0
+	DAC_REG_WRITE(AIC3204_PAGE_CTRL, 0x00),
+
+	// Initiate SW reset (PLL is powered off as part of reset)
+	DAC_REG_WRITE(AIC3204_SW_RST, 0x01),
+
+	// Program clock settings
+
+	// Default is CODEC_CLKIN is from MCLK pin. Don't need to change this.
+	// Power up NDAC and set to 1
+	DAC_REG_WRITE(AIC3204_NDAC, 0x81),
+	// Power up MDAC and set to 4
+	DAC_REG_WRITE(AIC3204_MDAC, 0x84),
+	// Program DOSR = 128
+	DAC_REG_WRITE(AIC3204_DOSR, 0x80),
+	// Set Audio Interface Config: I2S, 24 bits, slave mode, DOUT always driving.
+	DAC_REG_WRITE(AIC3204_CODEC_IF, 0x20),
+	// Program the DAC processing block to be used - PRB_P1
+	DAC_REG_WRITE(AIC3204_DAC_SIG_PROC, 0x01),
+	// Select Page 1
+	DAC_REG_WRITE(AIC3204_PAGE_CTRL, 0x01),
+	// Enable the internal AVDD_LDO:
+	DAC_REG_WRITE(AIC3204_LDO_CTRL, 0x09),
+
+	//
+	// Program Analog Blocks
+	// ---------------------
+	//
+	// Disable Internal Crude AVdd in presence of external AVdd supply or before powering up internal AVdd LDO
+	DAC_REG_WRITE(AIC3204_PWR_CFG, 0x08),
+	// Enable Master Analog Power Control
+	DAC_REG_WRITE(AIC3204_LDO_CTRL, 0x01),
+	// Set Common Mode voltages: Full Chip CM to 0.9V and Output Common Mode for Headphone to 1.65V and HP powered from LDOin @ 3.3V.
+	DAC_REG_WRITE(AIC3204_CM_CTRL, 0x33),
+	// Set PowerTune Modes
+	// Set the Left & Right DAC PowerTune mode to PTM_P3/4. Use Class-AB driver.
+	DAC_REG_WRITE(AIC3204_PLAY_CFG1, 0x00),
+	DAC_REG_WRITE(AIC3204_PLAY_CFG2, 0x00),
+	// Set MicPGA startup delay to 3.1ms
+	DAC_REG_WRITE(AIC3204_AN_IN_CHRG, 0x31),
+	// Set the REF charging time to 40ms
+	DAC_REG_WRITE(AIC3204_REF_STARTUP, 0x01),
+	// HP soft stepping settings for optimal pop performance at power up
+	// Rpop used is 6k with N = 6 and soft step = 20usec. This should work with 47uF coupling
+	// capacitor. Can try N=5,6 or 7 time constants as well. Trade-off delay vs “pop” sound.
+	DAC_REG_WRITE(AIC3204_HP_START, 0x25),
+	// Route Left DAC to HPL
+	DAC_REG_WRITE(AIC3204_HPL_ROUTE, 0x08),
+	// Route Right DAC to HPR
+	DAC_REG_WRITE(AIC3204_HPR_ROUTE, 0x08),
+	// We are using Line input with low gain for PGA so can use 40k input R but lets stick to 20k for now.
+	// Route IN2_L to LEFT_P with 20K input impedance
+	DAC_REG_WRITE(AIC3204_LPGA_P_ROUTE, 0x20),
+	// Route IN2_R to LEFT_M with 20K input impedance
+	DAC_REG_WRITE(AIC3204_LPGA_N_ROUTE, 0x20),
+	// Route IN1_R to RIGHT_P with 20K input impedance
+	DAC_REG_WRITE(AIC3204_RPGA_P_ROUTE, 0x80),
+	// Route IN1_L to RIGHT_M with 20K input impedance
+	DAC_REG_WRITE(AIC3204_RPGA_N_ROUTE, 0x20),
+	// Unmute HPL and set gain to 0dB
+	DAC_REG_WRITE(AIC3204_HPL_GAIN, 0x00),
+	// Unmute HPR and set gain to 0dB
+	DAC_REG_WRITE(AIC3204_HPR_GAIN, 0x00),
+	// Unmute Left MICPGA, Set Gain to 0dB.
+	DAC_REG_WRITE(AIC3204_LPGA_VOL, 0x00),
+	// Unmute Right MICPGA, Set Gain to 0dB.
+	DAC_REG_WRITE(AIC3204_RPGA_VOL, 0x00),
+	// Power up HPL and HPR drivers
+	DAC_REG_WRITE(AIC3204_OP_PWR_CTRL, 0x30),
+};
+
+static rtos_i2c_master_reg_op_t dac_power_up_seq[] = {
+	//
+	// Power Up DAC/ADC
+	// ----------------
+	//
+	// Select Page 0
+	DAC_REG_WRITE(AIC3204_PAGE_CTRL, 0x00),
+	// Power up the Left and Right DAC Channels. Route Left data to Left DAC and Right data to Right DAC.
+	// DAC Vol control soft step 1 step per DAC word clock.
+	DAC_REG_WRITE(AIC3204_DAC_CH_SET1, 0xd4),
+	// Unmute Left and Right DAC digital volume control
+	DAC_REG_WRITE(AIC3204_DAC_CH_SET2, 0x00),
+};
+
 /*
  * Example configuration of the TLV320AIC3204 DAC using i2c.
  *
@@ -36,98 +132,12 @@ static inline int i2c_dac_reg_write(rtos_i2c_master_t *i2c_ctx, uint8_t reg, uin
  */
 int dac_init(rtos_i2c_master_t *i2c_ctx)
 {
-	if (
-		// Set register page to 0
-		i2c_dac_reg_write(i2c_ctx, AIC3204_PAGE_CTRL, 0x00) == 0 &&
-
-		// Initiate SW reset (PLL is powered off as part of reset)
-		i2c_dac_reg_write(i2c_ctx, AIC3204_SW_RST, 0x01) == 0 &&
-
-		// Program clock settings
-
-		// Default is CODEC_CLKIN is from MCLK pin. Don't need to change this.
-		// Power up NDAC and set to 1
-		i2c_dac_reg_write(i2c_ctx, AIC3204_NDAC, 0x81) == 0 &&
-		// Power up MDAC and set to 4
-		i2c_dac_reg_write(i2c_ctx, AIC3204_MDAC, 0x84) == 0 &&
-		// Program DOSR = 128
-		i2c_dac_reg_write(i2c_ctx, AIC3204_DOSR, 0x80) == 0 &&
-		// Set Audio Interface Config: I2S, 24 bits, slave mode, DOUT always driving.
-		i2c_dac_reg_write(i2c_ctx, AIC3204_CODEC_IF, 0x20) == 0 &&
-		// Program the DAC processing block to be used - PRB_P1
-		i2c_dac_reg_write(i2c_ctx, AIC3204_DAC_SIG_PROC, 0x01) == 0 &&
-		// Select Page 1
-		i2c_dac_reg_write(i2c_ctx, AIC3204_PAGE_CTRL, 0x01) == 0 &&
-		// Enable the internal AVDD_LDO:
-		i2c_dac_reg_write(i2c_ctx, AIC3204_LDO_CTRL, 0x09) == 0 &&
-
-		//
-		// Program Analog Blocks
-		// ---------------------
-		//
-		// Disable Internal Crude AVdd in presence of external AVdd supply or before powering up internal AVdd LDO
-		i2c_dac_reg_write(i2c_ctx, AIC3204_PWR_CFG, 0x08) == 0 &&
-		// Enable Master Analog Power Control
-		i2c_dac_reg_write(i2c_ctx, AIC3204_LDO_CTRL, 0x01) == 0 &&
-		// Set Common Mode voltages: Full Chip CM to 0.9V and Output Common Mode for Headphone to 1.65V and HP powered from LDOin @ 3.3V.
-		i2c_dac_reg_write(i2c_ctx, AIC3204_CM_CTRL, 0x33) == 0 &&
-		// Set PowerTune Modes
-		// Set the Left & Right DAC PowerTune mode to PTM_P3/4. Use Class-AB driver.
-		i2c_dac_reg_write(i2c_ctx, AIC3204_PLAY_CFG1, 0x00) == 0 &&
-		i2c_dac_reg_write(i2c_ctx, AIC3204_PLAY_CFG2, 0x00) == 0 &&
-		// Set MicPGA startup delay to 3.1ms
-		i2c_dac_reg_write(i2c_ctx, AIC3204_AN_IN_CHRG, 0x31) == 0 &&
-		// Set the REF charging time to 40ms
-		i2c_dac_reg_write(i2c_ctx, AIC3204_REF_STARTUP, 0x01) == 0 &&
-		// HP soft stepping settings for optimal pop performance at power up
-		// Rpop used is 6k with N = 6 and soft step = 20usec. This should work with 47uF coupling
-		// capacitor. Can try N=5,6 or 7 time constants as well. Trade-off delay vs “pop” sound.
-		i2c_dac_reg_write(i2c_ctx, AIC3204_HP_START, 0x25) == 0 &&
-		// Route Left DAC to HPL
-		i2c_dac_reg_write(i2c_ctx, AIC3204_HPL_ROUTE, 0x08) == 0 &&
-		// Route Right DAC to HPR
-		i2c_dac_reg_write(i2c_ctx, AIC3204_HPR_ROUTE, 0x08) == 0 &&
-		// We are using Line input with low gain for PGA so can use 40k input R but lets stick to 20k for now.
-		// Route IN2_L to LEFT_P with 20K input impedance
-		i2c_dac_reg_write(i2c_ctx, AIC3204_LPGA_P_ROUTE, 0x20) == 0 &&
-		// Route IN2_R to LEFT_M with 20K input impedance
-		i2c_dac_reg_write(i2c_ctx, AIC3204_LPGA_N_ROUTE, 0x20) == 0 &&
-		// Route IN1_R to RIGHT_P with 20K input impedance
-		i2c_dac_reg_write(i2c_ctx, AIC3204_RPGA_P_ROUTE, 0x80) == 0 &&
-		// Route IN1_L to RIGHT_M with 20K input impedance
-		i2c_dac_reg_write(i2c_ctx, AIC3204_RPGA_N_ROUTE, 0x20) == 0 &&
-		// Unmute HPL and set gain to 0dB
-		i2c_dac_reg_write(i2c_ctx, AIC3204_HPL_GAIN, 0x00) == 0 &&
-		// Unmute HPR and set gain to 0dB
-		i2c_dac_reg_write(i2c_ctx, AIC3204_HPR_GAIN, 0x00) == 0 &&
-		// Unmute Left MICPGA, Set Gain to 0dB.
-		i2c_dac_reg_write(i2c_ctx, AIC3204_LPGA_VOL, 0x00) == 0 &&
-		// Unmute Right MICPGA, Set Gain to 0dB.
-		i2c_dac_reg_write(i2c_ctx, AIC3204_RPGA_VOL, 0x00) == 0 &&
-		// Power up HPL and HPR drivers
-		i2c_dac_reg_write(i2c_ctx, AIC3204_OP_PWR_CTRL, 0x30) == 0
-	) {
+	if (i2c_dac_reg_batch(i2c_ctx, dac_config_seq, ARRAY_SIZE(dac_config_seq)) == 0) {
 		// Wait for 2.5 sec for soft stepping to take effect
 		vTaskDelay(pdMS_TO_TICKS(2500));
 	} else {
 		return -1;
 	}
 
-	if (
-		//
-		// Power Up DAC/ADC
-		// ----------------
-		//
-		// Select Page 0
-		i2c_dac_reg_write(i2c_ctx, AIC3204_PAGE_CTRL, 0x00) == 0 &&
-		// Power up the Left and Right DAC Channels. Route Left data to Left DAC and Right data to Right DAC.
-		// DAC Vol control soft step 1 step per DAC word clock.
-		i2c_dac_reg_write(i2c_ctx, AIC3204_DAC_CH_SET1, 0xd4) == 0 &&
-		// Unmute Left and Right DAC digital volume control
-		i2c_dac_reg_write(i2c_ctx, AIC3204_DAC_CH_SET2, 0x00) == 0
-	) {
-		return 0;
-	} else {
-		return -1;
-	}
+	return i2c_dac_reg_batch(i2c_ctx, dac_power_up_seq, ARRAY_SIZE(dac_power_up_seq));
 }
@@ -145,15 +145,15 @@ void stage1(int32_t (*audio_frame)[FRAME_NUM_CHANS])
 static void intertile_audiopipeline_thread(QueueHandle_t output_queue)
 {
     int msg_length;
-    int32_t *msg;
+    static int32_t msg[FRAME_NUM_CHANS * appconfAUDIO_FRAME_LENGTH];
     rtos_intertile_t *intertile_ctx = intertile_addr->intertile_ctx;
     uint8_t intertile_port = intertile_addr->port;
     int32_t *data = NULL;
 
     for (;;) {
-        msg_length = rtos_intertile_rx(intertile_ctx, intertile_port, (void **) &msg, portMAX_DELAY);
+        msg_length = rtos_intertile_rx_buf(intertile_ctx, intertile_port, msg, sizeof(msg), portMAX_DELAY);
 
-        configASSERT(msg_length == FRAME_NUM_CHANS * appconfAUDIO_FRAME_LENGTH * sizeof(int32_t));
+        configASSERT(msg_length == sizeof(msg));
 
         data = pvPortMalloc(sizeof(int32_t) * appconfAUDIO_FRAME_LENGTH);
 
@@ -161,8 +161,6 @@ static void intertile_audiopipeline_thread(QueueHandle_t output_queue)
             data[i] = msg[i*2];
         }
 
-        vPortFree(msg);
-
         if (xQueueSend(output_queue, &data, pdMS_TO_TICKS(1)) == errQUEUE_FULL)
         {
             // rtos_printf("intertile rx mic frame lost\n");
@@ -54,6 +54,11 @@
 #define appconfINTERTILE_TEST 0
 #endif
 
+// Number of links on the second intertile instance, which the intertile test uses
+#ifndef appconfINTERTILE2_LINK_COUNT
+#define appconfINTERTILE2_LINK_COUNT 2
+#endif
+
 #ifndef appconfRPC_TEST
 #define appconfRPC_TEST 0
 #endif
@@ -70,6 +75,14 @@
 #define appconfSW_MEM_TEST 1
 #endif
 
+/*
+ * The GPIO and I2C RPC hosts share a pool of worker threads rather than
+ * each having threads of their own.
+ */
+#ifndef appconfRPC_HOST_POOL_WORKERS
+#define appconfRPC_HOST_POOL_WORKERS 1
+#endif
+
 // Task Priorities
 #define appconfSTARTUP_TASK_PRIORITY (configMAX_PRIORITIES - 1)
 #define appconfI2C_MASTER_RPC_HOST_TASK_PRIORITY (configMAX_PRIORITIES / 2)
@@ -78,5 +91,6 @@
 #define appconfGPIO_RPC_HOST_TASK_PRIORITY (configMAX_PRIORITIES / 2)
 #define appconfSPI_RPC_HOST_TASK_PRIORITY (configMAX_PRIORITIES / 2)
 #define appconfQSPI_RPC_HOST_TASK_PRIORITY (configMAX_PRIORITIES / 2 - 1)
+#define appconfRPC_HOST_POOL_TASK_PRIORITY (configMAX_PRIORITIES / 2)
 
 #endif /* APP_CONF_H_ */
\ No newline at end of file
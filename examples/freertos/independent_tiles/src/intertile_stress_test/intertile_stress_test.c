@@ -1,143 +1,324 @@
 // Copyright 2020-2021 XMOS LIMITED.
 // This Software is subject to the terms of the XMOS Public Licence: Version 1.
 
+#include <stdlib.h>
 #include <string.h>
+#include <platform.h>
 #include <xcore/hwtimer.h>
 
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "app_conf.h"
 #include "intertile_stress_test.h"
 
-static void intertile_test1(void *arg)
+/*
+ * Tile 0 transmits and reports throughput and latency. Tile 1 receives
+ * and reports the time spent in the intertile receive ISR.
+ */
+#define BENCH_TX_TILE 0
+#define BENCH_RX_TILE 1
+
+#define BENCH_ACK_PORT          0
+#define BENCH_DATA_PORT         1 /* Data ports are BENCH_DATA_PORT to BENCH_DATA_PORT + BENCH_MAX_PORTS - 1 */
+#define BENCH_MAX_PORTS         4
+#define BENCH_MAX_MSG_SIZE      4096
+#define BENCH_BYTES_PER_RUN     (1024 * 1024)
+#define BENCH_LATENCY_SAMPLES   200
+
+/*
+ * Messages up to this size are coalesced by the transmitter. They are held
+ * back for up to BENCH_COALESCE_WINDOW_MS, or until half of the coalesce
+ * buffer is taken up.
+ */
+#define BENCH_COALESCE_MAX_MSG_SIZE 64
+#define BENCH_COALESCE_BUF_SIZE     1024
+#define BENCH_COALESCE_WINDOW_MS    1
+
+static const size_t bench_msg_sizes[] = {16, 64, 256, 1024, 4096};
+static const int bench_port_counts[] = {1, 2, 4};
+
+/*
+ * The stress test bounces messages back and forth on the first intertile
+ * instance, which also carries the RPC traffic, while the benchmark runs.
+ */
+#define STRESS_PORT             5
+#define STRESS_MSG_SIZE         1024
+#define STRESS_BYTES            (128 * 1024 * STRESS_MSG_SIZE)
+#define STRESS_REPORT_BYTES     (16 * 1024 * 1024)
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#define TICKS_TO_US(t) ((t) / PLATFORM_REFERENCE_MHZ)
+
+typedef struct {
+    rtos_intertile_t *ctx;
+    uint8_t port;
+    size_t msg_size;
+    int msg_count;
+    SemaphoreHandle_t done;
+} bench_args_t;
+
+#if ON_TILE(BENCH_TX_TILE)
+static uint8_t tx_buf[BENCH_MAX_MSG_SIZE];
+
+static void bench_tx_thread(bench_args_t *args)
 {
-    char *inmsg;
-    char outmsg[1024] = "intertile_test_1";
-    size_t len;
-    rtos_intertile_t *ctx = arg;
-    size_t bytes_left_to_send = 128*1024*sizeof(outmsg);
-    uint32_t t1, t2;
+    for (int i = 0; i < args->msg_count; i++) {
+        rtos_intertile_tx(args->ctx, args->port, tx_buf, args->msg_size);
+    }
 
-    t1 = get_reference_time();
+    xSemaphoreGive(args->done);
+    vTaskDelete(NULL);
+}
 
-#if ON_TILE(0)
-    rtos_intertile_tx(
-            ctx,
-            5,
-            outmsg,
-            sizeof(outmsg));
-    bytes_left_to_send -= sizeof(outmsg);
+static int sample_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+
+    return (x > y) - (x < y);
+}
 #endif
 
-    while (bytes_left_to_send) {
+#if ON_TILE(BENCH_RX_TILE)
+static void bench_rx_thread(bench_args_t *args)
+{
+    uint8_t *rx_buf = pvPortMalloc(args->msg_size);
+    configASSERT(rx_buf != NULL);
 
-        len = rtos_intertile_rx(
-                ctx,
-                5,
-                (void **) &inmsg,
-                portMAX_DELAY);
+    for (int i = 0; i < args->msg_count; i++) {
+        int32_t len = rtos_intertile_rx_buf(args->ctx, args->port, rx_buf, args->msg_size, portMAX_DELAY);
+        configASSERT(len == (int32_t) args->msg_size);
+    }
 
-        xassert(strcmp(outmsg, inmsg) == 0);
-        vPortFree(inmsg);
+    vPortFree(rx_buf);
+    xSemaphoreGive(args->done);
+    vTaskDelete(NULL);
+}
+#endif
 
-        rtos_intertile_tx(
-                ctx,
-                5,
-                outmsg,
-                sizeof(outmsg));
+static void throughput_run(rtos_intertile_t *ctx, size_t msg_size, int port_count)
+{
+    bench_args_t args[BENCH_MAX_PORTS];
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(port_count, 0);
+    int msg_count = BENCH_BYTES_PER_RUN / msg_size / port_count;
+    uint8_t ack = 0;
 
-        bytes_left_to_send -= sizeof(outmsg);
-        if (bytes_left_to_send % (16*1024*1024) == 0) {
-            t2 = get_reference_time();
-            rtos_printf("%d. %d ticks\n", bytes_left_to_send, t2-t1);
-            t1 = t2;
+#if ON_TILE(BENCH_TX_TILE)
+    static rtos_intertile_coalesce_t coalesce[BENCH_MAX_PORTS];
+    static uint8_t coalesce_buf[BENCH_MAX_PORTS][BENCH_COALESCE_BUF_SIZE];
+    const int coalesced = msg_size <= BENCH_COALESCE_MAX_MSG_SIZE;
+    uint32_t start_time;
+
+    if (coalesced) {
+        for (int i = 0; i < port_count; i++) {
+            rtos_intertile_port_coalesce_set(ctx, BENCH_DATA_PORT + i, &coalesce[i], coalesce_buf[i], BENCH_COALESCE_BUF_SIZE);
+            rtos_intertile_port_coalesce_window_set(ctx, BENCH_DATA_PORT + i, BENCH_COALESCE_BUF_SIZE / 2,
+                                                    pdMS_TO_TICKS(BENCH_COALESCE_WINDOW_MS), configMAX_PRIORITIES/2);
         }
     }
 
-#if ON_TILE(0)
-    len = rtos_intertile_rx(
-            ctx,
-            5,
-            (void **) &inmsg,
-            portMAX_DELAY);
+    rtos_intertile_stats_clear(ctx);
+    start_time = get_reference_time();
+#endif
 
-    //rtos_printf("Got msg: \"%s\" on tile %d, port 5\n", inmsg, THIS_XCORE_TILE);
-    vPortFree(inmsg);
-    //vTaskDelay(pdMS_TO_TICKS(1000));
+    for (int i = 0; i < port_count; i++) {
+        args[i].ctx = ctx;
+        args[i].port = BENCH_DATA_PORT + i;
+        args[i].msg_size = msg_size;
+        args[i].msg_count = msg_count;
+        args[i].done = done;
+
+#if ON_TILE(BENCH_TX_TILE)
+        xTaskCreate((TaskFunction_t) bench_tx_thread,
+                    "bench_tx",
+                    RTOS_THREAD_STACK_SIZE(bench_tx_thread),
+                    &args[i],
+                    configMAX_PRIORITIES/2-1,
+                    NULL);
+#else
+        xTaskCreate((TaskFunction_t) bench_rx_thread,
+                    "bench_rx",
+                    RTOS_THREAD_STACK_SIZE(bench_rx_thread),
+                    &args[i],
+                    configMAX_PRIORITIES/2-1,
+                    NULL);
 #endif
+    }
 
-    rtos_printf("Completed intertile_test on tile %d\n", THIS_XCORE_TILE);
-    vTaskDelete(NULL);
+    for (int i = 0; i < port_count; i++) {
+        xSemaphoreTake(done, portMAX_DELAY);
+    }
+    vSemaphoreDelete(done);
+
+#if ON_TILE(BENCH_TX_TILE)
+    {
+        /* The receiver acknowledges once it has received every message */
+        rtos_intertile_rx_buf(ctx, BENCH_ACK_PORT, &ack, sizeof(ack), portMAX_DELAY);
+
+        uint32_t ticks = get_reference_time() - start_time;
+        uint32_t bytes = msg_count * port_count * msg_size;
+        uint32_t kbps = (uint64_t) bytes * PLATFORM_REFERENCE_MHZ * 1000 / ticks; /* bytes per ms */
+        uint32_t max_blocked = 0;
+
+        for (int i = 0; i < port_count; i++) {
+            rtos_intertile_port_stats_t stats;
+            rtos_intertile_port_stats_get(ctx, BENCH_DATA_PORT + i, &stats);
+            if (stats.tx_max_blocked_ticks > max_blocked) {
+                max_blocked = stats.tx_max_blocked_ticks;
+            }
+        }
+
+        rtos_printf("intertile bench: size %5u ports %d%s: %u bytes in %u us, %u.%03u MB/s, max tx blocked %u us\n",
+                    msg_size, port_count, coalesced ? " coalesced" : "", bytes, TICKS_TO_US(ticks),
+                    kbps / 1000, kbps % 1000, TICKS_TO_US(max_blocked));
+
+        if (coalesced) {
+            for (int i = 0; i < port_count; i++) {
+                rtos_intertile_port_coalesce_set(ctx, BENCH_DATA_PORT + i, NULL, NULL, 0);
+            }
+        }
+    }
+#else
+    {
+        for (int i = 0; i < appconfINTERTILE2_LINK_COUNT; i++) {
+            rtos_intertile_link_stats_t stats;
+
+            rtos_intertile_link_stats_get(ctx, i, &stats);
+            rtos_printf("intertile bench: size %5u ports %d link %d: %u ISRs, avg %u ticks, max %u ticks\n",
+                        msg_size, port_count, i, stats.isr_count,
+                        stats.isr_count ? stats.isr_total_ticks / stats.isr_count : 0,
+                        stats.isr_max_ticks);
+        }
+
+        /*
+         * Clear the counters before acknowledging, since the transmitter
+         * starts the next run as soon as it receives the acknowledgement.
+         */
+        rtos_intertile_stats_clear(ctx);
+        rtos_intertile_tx(ctx, BENCH_ACK_PORT, &ack, sizeof(ack));
+    }
+#endif
+}
+
+static void latency_run(rtos_intertile_t *ctx, size_t msg_size)
+{
+    uint8_t *buf = pvPortMalloc(msg_size);
+    configASSERT(buf != NULL);
+
+#if ON_TILE(BENCH_TX_TILE)
+    {
+        static uint32_t samples[BENCH_LATENCY_SAMPLES];
+
+        for (int i = 0; i < BENCH_LATENCY_SAMPLES; i++) {
+            uint32_t start_time = get_reference_time();
+
+            rtos_intertile_tx(ctx, BENCH_DATA_PORT, buf, msg_size);
+            rtos_intertile_rx_buf(ctx, BENCH_DATA_PORT, buf, msg_size, portMAX_DELAY);
+
+            samples[i] = get_reference_time() - start_time;
+        }
+
+        qsort(samples, BENCH_LATENCY_SAMPLES, sizeof(samples[0]), sample_compare);
+
+        rtos_printf("intertile bench: size %5u round trip: p50 %u us, p90 %u us, p99 %u us, max %u us\n",
+                    msg_size,
+                    TICKS_TO_US(samples[BENCH_LATENCY_SAMPLES * 50 / 100]),
+                    TICKS_TO_US(samples[BENCH_LATENCY_SAMPLES * 90 / 100]),
+                    TICKS_TO_US(samples[BENCH_LATENCY_SAMPLES * 99 / 100]),
+                    TICKS_TO_US(samples[BENCH_LATENCY_SAMPLES - 1]));
+    }
+#else
+    {
+        /* Echo each message straight back */
+        for (int i = 0; i < BENCH_LATENCY_SAMPLES; i++) {
+            rtos_intertile_rx_buf(ctx, BENCH_DATA_PORT, buf, msg_size, portMAX_DELAY);
+            rtos_intertile_tx(ctx, BENCH_DATA_PORT, buf, msg_size);
+        }
+    }
+#endif
+
+    vPortFree(buf);
 }
 
-static void intertile_test2(void *arg)
+static void intertile_stress(void *arg)
 {
     char *inmsg;
-    char outmsg[1024] = "intertile_test_2";
+    char outmsg[STRESS_MSG_SIZE] = "intertile_stress";
     size_t len;
     rtos_intertile_t *ctx = arg;
-    size_t bytes_left_to_send = 128*1024*sizeof(outmsg);
+    size_t bytes_left_to_send = STRESS_BYTES;
     uint32_t t1, t2;
 
     t1 = get_reference_time();
 
 #if ON_TILE(0)
-    rtos_intertile_tx(
-            ctx,
-            2,
-            outmsg,
-            sizeof(outmsg));
+    rtos_intertile_tx(ctx, STRESS_PORT, outmsg, sizeof(outmsg));
     bytes_left_to_send -= sizeof(outmsg);
 #endif
 
     while (bytes_left_to_send) {
+        len = rtos_intertile_rx(ctx, STRESS_PORT, (void **) &inmsg, portMAX_DELAY);
 
-        len = rtos_intertile_rx(
-                ctx,
-                2,
-                (void **) &inmsg,
-                portMAX_DELAY);
-
-        xassert(strcmp(outmsg, inmsg) == 0);
+        configASSERT(len == sizeof(outmsg));
+        configASSERT(strcmp(outmsg, inmsg) == 0);
         vPortFree(inmsg);
 
-        rtos_intertile_tx(
-                ctx,
-                2,
-                outmsg,
-                sizeof(outmsg));
+        rtos_intertile_tx(ctx, STRESS_PORT, outmsg, sizeof(outmsg));
 
         bytes_left_to_send -= sizeof(outmsg);
-        if (bytes_left_to_send % (16*1024*1024) == 0) {
+        if (bytes_left_to_send % STRESS_REPORT_BYTES == 0) {
             t2 = get_reference_time();
-            rtos_printf("%d. %d ticks\n", bytes_left_to_send, t2-t1);
+            rtos_printf("intertile stress: %u bytes left, %u us\n", bytes_left_to_send, TICKS_TO_US(t2 - t1));
             t1 = t2;
         }
     }
 
 #if ON_TILE(0)
-    len = rtos_intertile_rx(
-            ctx,
-            2,
-            (void **) &inmsg,
-            portMAX_DELAY);
+    len = rtos_intertile_rx(ctx, STRESS_PORT, (void **) &inmsg, portMAX_DELAY);
     vPortFree(inmsg);
 #endif
 
-    rtos_printf("Completed intertile_test2 on tile %d\n", THIS_XCORE_TILE);
+    rtos_printf("Completed intertile stress test on tile %d\n", THIS_XCORE_TILE);
+    vTaskDelete(NULL);
+}
+
+static void intertile_benchmark(void *arg)
+{
+    rtos_intertile_t *ctx = arg;
+
+    rtos_intertile_stats_clear(ctx);
+
+    /* Spread the data ports across the available links */
+    for (int i = 0; i < BENCH_MAX_PORTS; i++) {
+        rtos_intertile_port_priority_set(ctx, BENCH_DATA_PORT + i, i);
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(bench_msg_sizes); i++) {
+        for (size_t j = 0; j < ARRAY_SIZE(bench_port_counts); j++) {
+            throughput_run(ctx, bench_msg_sizes[i], bench_port_counts[j]);
+        }
+        latency_run(ctx, bench_msg_sizes[i]);
+    }
+
+    rtos_printf("Completed intertile benchmark on tile %d\n", THIS_XCORE_TILE);
     vTaskDelete(NULL);
 }
 
 void intertile_stress_test_start(rtos_intertile_t *intertile1_ctx, rtos_intertile_t *intertile2_ctx)
 {
-    xTaskCreate((TaskFunction_t) intertile_test1,
-                "intertile_test1",
-                RTOS_THREAD_STACK_SIZE(intertile_test1),
+    xTaskCreate((TaskFunction_t) intertile_stress,
+                "intertile_stress",
+                RTOS_THREAD_STACK_SIZE(intertile_stress),
                 intertile1_ctx,
                 configMAX_PRIORITIES/2-1,
                 NULL);
 
-    xTaskCreate((TaskFunction_t) intertile_test2,
-                "intertile_test2",
-                RTOS_THREAD_STACK_SIZE(intertile_test2),
+    xTaskCreate((TaskFunction_t) intertile_benchmark,
+                "intertile_benchmark",
+                RTOS_THREAD_STACK_SIZE(intertile_benchmark),
                 intertile2_ctx,
-                configMAX_PRIORITIES/2-1,
+                configMAX_PRIORITIES/2,
                 NULL);
 }
@@ -6,6 +6,16 @@
 
 #include "rtos/drivers/intertile/api/rtos_intertile.h"
 
+/*
+ * Runs the intertile stress test and benchmark on both tiles.
+ *
+ * The stress test bounces 1 KB messages back and forth on the first instance,
+ * alongside its RPC traffic, and checks each one. The benchmark runs on the
+ * second instance. It sweeps the message size and the number of ports used
+ * concurrently, and prints the throughput and round trip latency percentiles
+ * on tile 0 and the receive ISR time on tile 1. Small messages are coalesced
+ * by tile 0 for the throughput runs.
+ */
 void intertile_stress_test_start(rtos_intertile_t *intertile1_ctx, rtos_intertile_t *intertile2_ctx);
 
 #endif /* INTERTILE_STRESS_TEST_H_ */
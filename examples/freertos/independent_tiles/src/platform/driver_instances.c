@@ -28,4 +28,7 @@ static rtos_intertile_t intertile_ctx_s;
 rtos_intertile_t *intertile1_ctx = &intertile_ctx_s;
 
 static rtos_intertile_t intertile2_ctx_s;
-rtos_intertile_t *intertile2_ctx = &intertile2_ctx_s;
\ No newline at end of file
+rtos_intertile_t *intertile2_ctx = &intertile2_ctx_s;
+
+static rpc_host_pool_t rpc_host_pool_s;
+rpc_host_pool_t *rpc_host_pool = &rpc_host_pool_s;
\ No newline at end of file
@@ -5,6 +5,7 @@
 #define DRIVER_INSTANCES_H_
 
 #include "rtos/drivers/intertile/api/rtos_intertile.h"
+#include "rtos/drivers/rpc/api/rtos_rpc.h"
 #include "rtos/drivers/mic_array/api/rtos_mic_array.h"
 #include "rtos/drivers/i2c/api/rtos_i2c_master.h"
 #include "rtos/drivers/i2s/api/rtos_i2s.h"
@@ -20,6 +21,7 @@
 
 extern rtos_intertile_t *intertile1_ctx;
 extern rtos_intertile_t *intertile2_ctx;
+extern rpc_host_pool_t *rpc_host_pool;
 extern rtos_gpio_t *gpio_ctx;
 extern rtos_qspi_flash_t *qspi_flash_ctx;
 extern rtos_i2c_master_t *i2c_master_ctx;
@@ -143,6 +143,7 @@ void gpio_init() {
     rtos_intertile_t *client_intertile_ctx[1] = {intertile1_ctx};
     rtos_gpio_rpc_host_init(gpio_ctx, &gpio_rpc_config, client_intertile_ctx,
                             1);
+    rpc_host_pool_attach(rpc_host_pool, &gpio_rpc_config);
     rtos_printf("GPIO RPC host initialized on tile %d\n", THIS_XCORE_TILE);
   }
 #else
@@ -169,6 +170,7 @@ void i2c_init() {
     rtos_intertile_t *client_intertile_ctx[1] = {intertile1_ctx};
     rtos_i2c_master_rpc_host_init(i2c_master_ctx, &i2c_rpc_config,
                                   client_intertile_ctx, 1);
+    rpc_host_pool_attach(rpc_host_pool, &i2c_rpc_config);
     rtos_printf("I2C RPC host initialized on tile %d\n", THIS_XCORE_TILE);
   }
 #else
@@ -316,7 +318,10 @@ void platform_init(chanend_t other_tile_c) {
   mclk_port_init();
 
   rtos_intertile_init(intertile1_ctx, other_tile_c);
-  rtos_intertile_init(intertile2_ctx, other_tile_c);
+  rtos_intertile_multi_link_init(intertile2_ctx, other_tile_c, appconfINTERTILE2_LINK_COUNT);
+#if ON_TILE(0)
+  rpc_host_pool_init(rpc_host_pool, appconfRPC_HOST_POOL_WORKERS);
+#endif
   i2c_init();
   spi_init();
   flash_init();
@@ -111,6 +111,9 @@ void flash_start() {
 void platform_start(void) {
   rtos_intertile_start(intertile1_ctx);
   rtos_intertile_start(intertile2_ctx);
+#if ON_TILE(0)
+  rpc_host_pool_start(rpc_host_pool, appconfRPC_HOST_POOL_TASK_PRIORITY);
+#endif
 
   gpio_start();
   spi_start();
@@ -109,84 +109,82 @@ static uint8_t ov2640_spi_get_bit( uint8_t addr, uint8_t bit )
     return temp;
 }
 
-static void ov2640_reg_jpeg_init()
+#define OV2640_I2C_BATCH_LEN 32
+
+/*
+ * Writes a sensor program terminated by the entry { 0xFF, 0xFF }.
+ * The register writes are performed in batches so that when the I2C
+ * bus is on another tile there is not a round trip per register.
+ */
+static void ov2640_i2c_write_prog( const struct program_mem *prog )
 {
-    int i = 0;
-    i2c_regop_res_t regop_res;
+    rtos_i2c_master_reg_op_t ops[ OV2640_I2C_BATCH_LEN ];
+    size_t count = 0;
+    size_t done;
+    int end;
+
+    if( ov2640_host_ctx.i2c_dev == NULL )
+    {
+        return;
+    }
+
     do
     {
-        regop_res = ov2640_i2c_write_reg( OV2640_JPEG_INIT[i].reg, OV2640_JPEG_INIT[i].val );
-        if( regop_res != I2C_REGOP_SUCCESS )
+        end = ( prog->reg == 0xFF ) && ( prog->val == 0xFF );
+
+        if( !end )
         {
-            debug_printf("I2C operation failed.\n");
+            ops[ count ].op = rtos_i2c_master_reg_op_write;
+            ops[ count ].device_addr = ov2640_host_ctx.device_addr;
+            ops[ count ].reg_addr = prog->reg;
+            ops[ count ].data = prog->val;
+            count++;
+            prog++;
+        }
+
+        if( count == OV2640_I2C_BATCH_LEN || end )
+        {
+            size_t i = 0;
+
+            /* A batch stops at the first failure. Report it and carry on with the rest. */
+            while( i < count )
+            {
+                if( rtos_i2c_master_reg_batch( ov2640_host_ctx.i2c_dev, &ops[ i ], count - i, &done ) != I2C_REGOP_SUCCESS )
+                {
+                    debug_printf("I2C operation failed.\n");
+                    done++;
+                }
+                i += done;
+            }
+            count = 0;
         }
-        i++;
     }
-    while( ( OV2640_JPEG_INIT[i].reg != 0xFF ) | ( OV2640_JPEG_INIT[i].val != 0xFF ) );
+    while( !end );
+}
+
+static void ov2640_reg_jpeg_init()
+{
+    ov2640_i2c_write_prog( OV2640_JPEG_INIT );
 }
 
 static void ov2640_reg_yuv()
 {
-    int i = 0;
-    i2c_regop_res_t regop_res;
-    do
-    {
-        regop_res = ov2640_i2c_write_reg( OV2640_YUV422[i].reg, OV2640_YUV422[i].val );
-        if( regop_res != I2C_REGOP_SUCCESS )
-        {
-            debug_printf("I2C operation failed.\n");
-        }
-        i++;
-    }
-    while( ( OV2640_YUV422[i].reg != 0xFF ) | ( OV2640_YUV422[i].val != 0xFF ) );
+    ov2640_i2c_write_prog( OV2640_YUV422 );
 }
 
 static void ov2640_reg_no_jpeg_compression()
 {
-    int i = 0;
-    i2c_regop_res_t regop_res;
-    do
-    {
-        regop_res = ov2640_i2c_write_reg( OV2640_NONCOMPRESSED[i].reg, OV2640_NONCOMPRESSED[i].val );
-        if( regop_res != I2C_REGOP_SUCCESS )
-        {
-            debug_printf("I2C operation failed.\n");
-        }
-        i++;
-    }
-    while( ( OV2640_NONCOMPRESSED[i].reg != 0xFF ) | ( OV2640_NONCOMPRESSED[i].val != 0xFF ) );
+    ov2640_i2c_write_prog( OV2640_NONCOMPRESSED );
 }
 
 static void ov2640_reg_96x96_jpeg()
 {
-    int i = 0;
-    i2c_regop_res_t regop_res;
-    do
-    {
-        regop_res = ov2640_i2c_write_reg( OV2640_96x96_JPEG[i].reg, OV2640_96x96_JPEG[i].val );
-        if( regop_res != I2C_REGOP_SUCCESS )
-        {
-            debug_printf("I2C operation failed.\n");
-        }
-        i++;
-    }
-    while( ( OV2640_96x96_JPEG[i].reg != 0xFF ) | ( OV2640_96x96_JPEG[i].val != 0xFF ) );
+    ov2640_i2c_write_prog( OV2640_96x96_JPEG );
 }
 
 static void ov2640_reg_160x120_JPEG()
 {
-    int i = 0;
-    i2c_regop_res_t regop_res;
-    do
-    {
-        regop_res = ov2640_i2c_write_reg( OV2640_160x120_JPEG[i].reg, OV2640_160x120_JPEG[i].val );
-        if( regop_res != I2C_REGOP_SUCCESS )
-        {
-            debug_printf("I2C operation failed.\n");
-        }
-        i++;
-    }
-    while( ( OV2640_160x120_JPEG[i].reg != 0xFF ) | ( OV2640_160x120_JPEG[i].val != 0xFF ) );
+    ov2640_i2c_write_prog( OV2640_160x120_JPEG );
 }
 
 void ov2640_flush_fifo()
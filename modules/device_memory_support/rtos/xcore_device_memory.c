@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include <xcore/assert.h>
+#include <xcore/minicache.h>
 #include <xcore/port.h>
 
 #define WORDS_TO_BYTES(w) ((w) * sizeof(uint32_t))
@@ -20,17 +21,177 @@
 #include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
 #include "rtos/drivers/swmem/api/rtos_swmem.h"
 
+#define SWMEM_LINE_BYTES WORDS_TO_BYTES(SWMEM_FILL_SIZE_WORDS)
+
 static rtos_qspi_flash_t *qspi_flash_ctx = NULL;
 
-void rtos_swmem_read_request(unsigned offset, uint32_t *buf) {
+#if SWMEM_PREFETCH_LINES > 0
+
+#define SWMEM_PREFETCH_BYTES (SWMEM_PREFETCH_LINES * SWMEM_LINE_BYTES)
+
+/*
+ * Lines are read ahead into this buffer with an asynchronous flash read. The
+ * SwMem task clears prefetch_valid and hands the buffer to the QSPI flash op
+ * thread with rtos_qspi_flash_read_async(). Only the op thread writes to it
+ * until prefetch_done_cb() hands it back by giving prefetch_done, which the
+ * SwMem task takes before it touches the buffer or starts another read.
+ *
+ * The callback sets prefetch_valid only if the generation counter still
+ * matches the one the read was started with, so that a read started before
+ * swmem_flash_invalidate() is never used. The fill interrupt reads the buffer
+ * only while prefetch_valid is set, which it never is during a read.
+ */
+static uint32_t prefetch_buf[SWMEM_PREFETCH_LINES * SWMEM_FILL_SIZE_WORDS];
+static unsigned prefetch_offset;
+static volatile bool prefetch_valid;
+static volatile unsigned prefetch_generation;
+static bool prefetch_pending;
+static rtos_qspi_flash_op_t prefetch_op;
+static rtos_osal_semaphore_t prefetch_done;
+
+/* The offset of the last line filled, used to detect sequential access */
+static unsigned last_offset;
+
+static bool prefetch_contains(unsigned offset) {
+  return offset - prefetch_offset < SWMEM_PREFETCH_BYTES;
+}
+
+RTOS_QSPI_FLASH_OP_CALLBACK_ATTR
+static void prefetch_done_cb(rtos_qspi_flash_t *ctx, rtos_qspi_flash_op_t *op,
+                             void *arg) {
+  int state = rtos_osal_critical_enter();
+  if ((uintptr_t)arg == prefetch_generation) {
+    prefetch_valid = true;
+  }
+  rtos_osal_critical_exit(state);
+  rtos_osal_semaphore_put(&prefetch_done);
+}
+
+static void prefetch_wait(void) {
+  if (prefetch_pending) {
+    rtos_osal_semaphore_get(&prefetch_done, RTOS_OSAL_WAIT_FOREVER);
+    prefetch_pending = false;
+  }
+}
+
+void swmem_flash_read_request(unsigned offset, uint32_t *buf) {
+  bool sequential;
+
+  if (qspi_flash_ctx == NULL) {
+    return;
+  }
+
+  /*
+   * The line may be in a read ahead that has not completed yet. Any other
+   * read ahead must complete before its buffer is reused below.
+   */
+  prefetch_wait();
+
+  if (prefetch_valid && prefetch_contains(offset)) {
+    memcpy(buf, (uint8_t *)prefetch_buf + (offset - prefetch_offset),
+           SWMEM_LINE_BYTES);
+  } else {
+    rtos_qspi_flash_read(qspi_flash_ctx, (uint8_t *)buf, offset,
+                         SWMEM_LINE_BYTES);
+  }
+
+  sequential = offset == last_offset + SWMEM_LINE_BYTES;
+  last_offset = offset;
+
+  /*
+   * Read ahead the lines that follow this one. This is done in the
+   * background, so the fill completes without waiting for it.
+   */
+  if (sequential &&
+      !(prefetch_valid && prefetch_contains(offset + SWMEM_LINE_BYTES))) {
+    prefetch_valid = false;
+    prefetch_offset = offset + SWMEM_LINE_BYTES;
+    prefetch_pending = true;
+    rtos_qspi_flash_read_async(qspi_flash_ctx, &prefetch_op,
+                               (uint8_t *)prefetch_buf, prefetch_offset,
+                               SWMEM_PREFETCH_BYTES, prefetch_done_cb,
+                               (void *)(uintptr_t)prefetch_generation);
+  }
+}
+
+#else
+
+void swmem_flash_read_request(unsigned offset, uint32_t *buf) {
   if (qspi_flash_ctx != NULL) {
     rtos_qspi_flash_read(qspi_flash_ctx, (uint8_t *)buf, (unsigned)offset,
-                         WORDS_TO_BYTES(SWMEM_FILL_SIZE_WORDS));
+                         SWMEM_LINE_BYTES);
   }
 }
 
-void swmem_setup(rtos_qspi_flash_t *ctx, unsigned swmem_task_priority) {
+#endif /* SWMEM_PREFETCH_LINES > 0 */
+
+/*
+ * Misses are served here, without waking the SwMem task, from lines that
+ * have been read ahead or, when the flash driver allows it, straight from
+ * the flash. Only misses that cannot be served here go to the task.
+ */
+bool swmem_flash_read_request_isr(unsigned offset, uint32_t *buf) {
+#if SWMEM_PREFETCH_LINES > 0
+  if (prefetch_valid && prefetch_contains(offset)) {
+    memcpy(buf, (uint8_t *)prefetch_buf + (offset - prefetch_offset),
+           SWMEM_LINE_BYTES);
+    last_offset = offset;
+    return true;
+  }
+
+  /* Sequential misses are left to the task so that it starts a read ahead */
+  if (offset == last_offset + SWMEM_LINE_BYTES) {
+    return false;
+  }
+#endif
+
+#if RTOS_QSPI_FLASH_ISR_READ
+  if (qspi_flash_ctx != NULL &&
+      rtos_qspi_flash_read_isr(qspi_flash_ctx, (uint8_t *)buf, offset,
+                               SWMEM_LINE_BYTES)) {
+#if SWMEM_PREFETCH_LINES > 0
+    last_offset = offset;
+#endif
+    return true;
+  }
+#endif
+
+  return false;
+}
+
+#if SWMEM_FLASH_READ_HANDLERS
+void rtos_swmem_read_request(unsigned offset, uint32_t *buf) {
+  swmem_flash_read_request(offset, buf);
+}
+
+#if SWMEM_PREFETCH_LINES > 0 || RTOS_QSPI_FLASH_ISR_READ
+bool rtos_swmem_read_request_isr(unsigned offset, uint32_t *buf) {
+  return swmem_flash_read_request_isr(offset, buf);
+}
+#endif
+#endif /* SWMEM_FLASH_READ_HANDLERS */
+
+void swmem_flash_invalidate(void) {
+#if SWMEM_PREFETCH_LINES > 0
+  int state = rtos_osal_critical_enter();
+  prefetch_generation++;
+  prefetch_valid = false;
+  rtos_osal_critical_exit(state);
+#endif
+  minicache_invalidate();
+}
+
+void swmem_flash_init(rtos_qspi_flash_t *ctx) {
+#if SWMEM_PREFETCH_LINES > 0
+  if (qspi_flash_ctx == NULL) {
+    rtos_osal_semaphore_create(&prefetch_done, "swmem_prefetch", 1, 0);
+  }
+#endif
   qspi_flash_ctx = ctx;
+}
+
+void swmem_setup(rtos_qspi_flash_t *ctx, unsigned swmem_task_priority) {
+  swmem_flash_init(ctx);
   rtos_swmem_init(RTOS_SWMEM_READ_FLAG);
   rtos_swmem_start(swmem_task_priority);
 }
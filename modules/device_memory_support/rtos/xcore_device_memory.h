@@ -17,6 +17,27 @@
   (((uintptr_t)a >= XS1_SWMEM_BASE) && \
    (((uintptr_t)a <= (XS1_SWMEM_BASE - 1 + XS1_SWMEM_SIZE))))
 
+/**
+ * The number of SwMem cache lines read ahead from the flash once SwMem is
+ * seen to be read sequentially. Misses on lines that have been read ahead
+ * are served from RAM in the fill interrupt, without waiting for the flash
+ * or waking the SwMem task. Set this to 0 to disable reading ahead.
+ */
+#ifndef SWMEM_PREFETCH_LINES
+#define SWMEM_PREFETCH_LINES 8
+#endif
+
+/**
+ * When nonzero, rtos_swmem_read_request() and rtos_swmem_read_request_isr()
+ * are provided here and serve every SwMem fill from the flash. Set this to
+ * 0 to provide them in the application instead, calling
+ * swmem_flash_read_request() and swmem_flash_read_request_isr() for the
+ * lines that are backed by the flash.
+ */
+#ifndef SWMEM_FLASH_READ_HANDLERS
+#define SWMEM_FLASH_READ_HANDLERS 1
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,6 +52,42 @@ extern "C" {
  */
 void swmem_setup(rtos_qspi_flash_t *ctx, unsigned swmem_task_priority);
 
+/**
+ * Sets the flash that SwMem is read from, without starting the SwMem
+ * driver. This is called by swmem_setup().
+ *
+ * @param[in]  ctx  RTOS QSPI flash driver context
+ */
+void swmem_flash_init(rtos_qspi_flash_t *ctx);
+
+/**
+ * Fills a SwMem line from the flash, reading ahead of sequential fills.
+ * Must be called from the SwMem task.
+ *
+ * @param[in]  offset The offset of the line from the start of SwMem
+ * @param[out] buf    Buffer to fill with the line
+ */
+void swmem_flash_read_request(unsigned offset, uint32_t *buf);
+
+/**
+ * Fills a SwMem line from the read ahead buffer or, when
+ * RTOS_QSPI_FLASH_ISR_READ is enabled, straight from the flash. Must be
+ * called from the SwMem fill interrupt.
+ *
+ * @param[in]  offset The offset of the line from the start of SwMem
+ * @param[out] buf    Buffer to fill with the line
+ *
+ * @return true if the line was filled, or false if it must be filled by
+ *         swmem_flash_read_request() instead.
+ */
+bool swmem_flash_read_request_isr(unsigned offset, uint32_t *buf);
+
+/**
+ * Discards the SwMem lines held in the cache and in the read ahead buffer,
+ * so that flash that has been written since is read again.
+ */
+void swmem_flash_invalidate(void);
+
 /**
  * Load memory from the SwMem memory segment.
  *
@@ -103,6 +103,26 @@ typedef struct {
     uint32_t sr2_read_cmd; /* if 0, then read 2 bytes with the standard status register read command */
     uint32_t sr2_write_cmd;/* if 0, then write 2 bytes with the standard status register write command */
 
+    /* If false, then erase and program operations cannot be suspended */
+    bool suspend_supported;
+    uint32_t erase_suspend_cmd;
+    uint32_t erase_resume_cmd;
+    uint32_t program_suspend_cmd;
+    uint32_t program_resume_cmd;
+
+    /* The minimum time in microseconds that an operation must run for after being resumed before it may be suspended again */
+    uint32_t erase_resume_interval_us;
+    uint32_t program_resume_interval_us;
+
+    /*
+     * If false, then the flash cannot be kept in XIP mode. Otherwise these are the mode
+     * bits to send in bits 31:24 of the address of a read to enter or remain in XIP mode,
+     * and to leave it.
+     */
+    bool xip_supported;
+    uint8_t xip_enter_mode_bits;
+    uint8_t xip_exit_mode_bits;
+
 } qspi_flash_ctx_t;
 
 /**
@@ -230,6 +250,50 @@ bool qspi_flash_write_in_progress(qspi_flash_ctx_t *ctx);
  */
 void qspi_flash_wait_while_write_in_progress(qspi_flash_ctx_t *ctx);
 
+/**
+ * This suspends an erase operation that is in progress so that the flash may
+ * be read. qspi_flash_write_in_progress() returns false once the erase has
+ * been suspended. Data may not be read from the sector being erased while it
+ * is suspended. Only supported when ctx->suspend_supported is true.
+ *
+ * If the erase has already completed then this has no effect.
+ *
+ * \param ctx The QSPI flash context associated with the QSPI flash.
+ */
+void qspi_flash_erase_suspend(qspi_flash_ctx_t *ctx);
+
+/**
+ * This resumes an erase operation previously suspended with
+ * qspi_flash_erase_suspend(). The erase must be allowed to run for at
+ * least ctx->erase_resume_interval_us before it is suspended again, or it
+ * may never complete.
+ *
+ * \param ctx The QSPI flash context associated with the QSPI flash.
+ */
+void qspi_flash_erase_resume(qspi_flash_ctx_t *ctx);
+
+/**
+ * This suspends a page program operation that is in progress so that the
+ * flash may be read. qspi_flash_write_in_progress() returns false once the
+ * program has been suspended. Data may not be read from the page being
+ * programmed while it is suspended. Only supported when
+ * ctx->suspend_supported is true.
+ *
+ * If the program has already completed then this has no effect.
+ *
+ * \param ctx The QSPI flash context associated with the QSPI flash.
+ */
+void qspi_flash_program_suspend(qspi_flash_ctx_t *ctx);
+
+/**
+ * This resumes a page program operation previously suspended with
+ * qspi_flash_program_suspend(). The program must be allowed to run for at
+ * least ctx->program_resume_interval_us before it is suspended again.
+ *
+ * \param ctx The QSPI flash context associated with the QSPI flash.
+ */
+void qspi_flash_program_resume(qspi_flash_ctx_t *ctx);
+
 /**
  * This performs an erase operation. qspi_flash_write_enable() must be called
  * prior to this.
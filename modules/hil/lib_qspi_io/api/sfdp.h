@@ -36,6 +36,12 @@ enum {
 #define SFDP_BUSY_POLL_LEGACY_BM 0x01
 #define SFDP_BUSY_POLL_ALT1_BM   0x02
 
+#define SFDP_XIP_ENTRY_A5_BM     0x01
+#define SFDP_XIP_ENTRY_AX_BM     0x04
+
+#define SFDP_XIP_EXIT_00_BM      0x01
+#define SFDP_XIP_EXIT_NOT_AX_BM  0x20
+
 typedef struct {
     /* 1st DWORD */
     uint32_t : 2; /* legacy */
@@ -94,10 +100,22 @@ typedef struct {
     uint32_t : 1; /* reserved */
 
     /* 12th DWORD */
-    uint32_t : 32; /* suspend/resume info */
+    uint32_t : 4; /* operations prohibited during program suspend */
+    uint32_t : 4; /* operations prohibited during erase suspend */
+    uint32_t : 1; /* reserved */
+    uint32_t program_resume_to_suspend_interval : 4;
+    uint32_t : 5; /* program suspend latency count */
+    uint32_t : 2; /* program suspend latency units */
+    uint32_t erase_resume_to_suspend_interval : 4;
+    uint32_t : 5; /* erase suspend latency count */
+    uint32_t : 2; /* erase suspend latency units */
+    uint32_t suspend_resume_not_supported : 1;
 
     /* 13th DWORD */
-    uint32_t : 32; /* suspend/resume instructions */
+    uint8_t program_resume_cmd;
+    uint8_t program_suspend_cmd;
+    uint8_t erase_resume_cmd;
+    uint8_t erase_suspend_cmd;
 
     /* 14th DWORD */
     uint32_t : 2; /* reserved */
@@ -142,6 +160,16 @@ int sfdp_busy_poll_method(sfdp_info_t *sfdp_info,
                           uint8_t *instruction,
                           uint8_t *bit,
                           uint8_t *ready_value);
+int sfdp_suspend_resume_method(sfdp_info_t *sfdp_info,
+                               uint8_t *erase_suspend_instruction,
+                               uint8_t *erase_resume_instruction,
+                               uint8_t *program_suspend_instruction,
+                               uint8_t *program_resume_instruction,
+                               uint32_t *erase_resume_interval_us,
+                               uint32_t *program_resume_interval_us);
+int sfdp_xip_method(sfdp_info_t *sfdp_info,
+                    uint8_t *enter_mode_bits,
+                    uint8_t *exit_mode_bits);
 int sfdp_quad_enable_method(sfdp_info_t *sfdp_info,
                             uint8_t *qe_reg,
                             uint8_t *qe_bit,
@@ -141,6 +141,34 @@ void qspi_flash_wait_while_write_in_progress(qspi_flash_ctx_t *ctx)
 	qspi_flash_poll_register(ctx, ctx->busy_poll_cmd, (1 << ctx->busy_poll_bit), ctx->busy_poll_ready_value << ctx->busy_poll_bit);
 }
 
+static void qspi_flash_command(qspi_flash_ctx_t *ctx, uint32_t cmd)
+{
+	qspi_io_ctx_t *qspi_io_ctx = &ctx->qspi_io_ctx;
+
+	qspi_io_start_transaction(qspi_io_ctx, cmd, 8, qspi_io_full_speed);
+	qspi_io_end_transaction(qspi_io_ctx);
+}
+
+void qspi_flash_erase_suspend(qspi_flash_ctx_t *ctx)
+{
+	qspi_flash_command(ctx, ctx->erase_suspend_cmd);
+}
+
+void qspi_flash_erase_resume(qspi_flash_ctx_t *ctx)
+{
+	qspi_flash_command(ctx, ctx->erase_resume_cmd);
+}
+
+void qspi_flash_program_suspend(qspi_flash_ctx_t *ctx)
+{
+	qspi_flash_command(ctx, ctx->program_suspend_cmd);
+}
+
+void qspi_flash_program_resume(qspi_flash_ctx_t *ctx)
+{
+	qspi_flash_command(ctx, ctx->program_resume_cmd);
+}
+
 void qspi_flash_erase(qspi_flash_ctx_t *ctx,
                       uint32_t address,
                       qspi_flash_erase_length_t erase_length)
@@ -618,6 +646,10 @@ void qspi_flash_init(qspi_flash_ctx_t *ctx)
 	    int erase_table_entries;
 	    uint8_t read_instruction;
 	    uint8_t write_instruction;
+	    uint8_t erase_suspend_instruction;
+	    uint8_t erase_resume_instruction;
+	    uint8_t program_suspend_instruction;
+	    uint8_t program_resume_instruction;
 
 	    ctx->sfdp_supported = true;
 
@@ -635,11 +667,9 @@ void qspi_flash_init(qspi_flash_ctx_t *ctx)
 	     *    inside the flash ctx.
 	     * 7) The busy poll method.
 	     * 8) The quad enable method.
-	     *
-	     * TODO:
-	     * 9) If XIP mode is supported, The XIP entry/exit methods and implement them.
-	     *    Should have xip enter/xip exit functions. Reads will need issue the
-	     *    proper mode bits. Continue to use the xip read function?
+	     * 9) The suspend and resume commands.
+	     * 10) The XIP mode entry and exit methods, when they only depend on
+	     *     the mode bits sent by quad I/O reads.
 	     */
 
 	    /* Verify that the QSPI flash chip supports quad I/O read mode with 6 dummy cycles */
@@ -670,6 +700,29 @@ void qspi_flash_init(qspi_flash_ctx_t *ctx)
         }
         xassert(ret == 0 && "Unsupported QE enable method");
 
+        /* Save the suspend and resume commands if they are supported */
+        ret = sfdp_suspend_resume_method(&sfdp_info,
+                                         &erase_suspend_instruction,
+                                         &erase_resume_instruction,
+                                         &program_suspend_instruction,
+                                         &program_resume_instruction,
+                                         &ctx->erase_resume_interval_us,
+                                         &ctx->program_resume_interval_us);
+        ctx->suspend_supported = ret == 0;
+        if (ctx->suspend_supported) {
+            ctx->erase_suspend_cmd = QSPI_IO_BYTE_TO_MOSI(erase_suspend_instruction);
+            ctx->erase_resume_cmd = QSPI_IO_BYTE_TO_MOSI(erase_resume_instruction);
+            ctx->program_suspend_cmd = QSPI_IO_BYTE_TO_MOSI(program_suspend_instruction);
+            ctx->program_resume_cmd = QSPI_IO_BYTE_TO_MOSI(program_resume_instruction);
+        }
+
+        /*
+         * Save the XIP mode bits if XIP mode is supported. The mode bits are sent
+         * during the first two dummy cycles, so there must be two mode clocks.
+         */
+        ret = sfdp_xip_method(&sfdp_info, &ctx->xip_enter_mode_bits, &ctx->xip_exit_mode_bits);
+        ctx->xip_supported = ret == 0 && sfdp_info.basic_parameter_table.quad_144_read_mode_clocks == 2;
+
         /* Parse and save the erase table */
         erase_table_entries = 0;
         for (int i = 0; i < 4; i++) {
@@ -48,6 +48,55 @@ int sfdp_busy_poll_method(sfdp_info_t *sfdp_info,
     return 0;
 }
 
+int sfdp_suspend_resume_method(sfdp_info_t *sfdp_info,
+                               uint8_t *erase_suspend_instruction,
+                               uint8_t *erase_resume_instruction,
+                               uint8_t *program_suspend_instruction,
+                               uint8_t *program_resume_instruction,
+                               uint32_t *erase_resume_interval_us,
+                               uint32_t *program_resume_interval_us)
+{
+    sfdp_parameter_table_t *t = &sfdp_info->basic_parameter_table;
+
+    if (t->suspend_resume_not_supported) {
+        return -1;
+    }
+
+    *erase_suspend_instruction = t->erase_suspend_cmd;
+    *erase_resume_instruction = t->erase_resume_cmd;
+    *program_suspend_instruction = t->program_suspend_cmd;
+    *program_resume_instruction = t->program_resume_cmd;
+
+    /* Both intervals are given in units of 64 microseconds */
+    *erase_resume_interval_us = (t->erase_resume_to_suspend_interval + 1) * 64;
+    *program_resume_interval_us = (t->program_resume_to_suspend_interval + 1) * 64;
+
+    return 0;
+}
+
+int sfdp_xip_method(sfdp_info_t *sfdp_info,
+                    uint8_t *enter_mode_bits,
+                    uint8_t *exit_mode_bits)
+{
+    sfdp_parameter_table_t *t = &sfdp_info->basic_parameter_table;
+
+    /*
+     * Only the methods that are controlled entirely by the mode bits
+     * sent after the address of each quad I/O read are supported.
+     * 0xA5 satisfies both the A5h and Axh entry methods.
+     */
+    if (!t->xip_mode_supported ||
+            !(t->xip_mode_entry_method & (SFDP_XIP_ENTRY_A5_BM | SFDP_XIP_ENTRY_AX_BM)) ||
+            !(t->xip_mode_exit_method & (SFDP_XIP_EXIT_00_BM | SFDP_XIP_EXIT_NOT_AX_BM))) {
+        return -1;
+    }
+
+    *enter_mode_bits = 0xA5;
+    *exit_mode_bits = 0x00;
+
+    return 0;
+}
+
 int sfdp_quad_enable_method(sfdp_info_t *sfdp_info,
                             uint8_t *qe_reg,
                             uint8_t *qe_bit,
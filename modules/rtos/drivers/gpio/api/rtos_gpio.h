@@ -58,6 +58,24 @@ typedef enum {
     RTOS_GPIO_TOTAL_PORT_CNT /**< Total number of I/O ports */
 } rtos_gpio_port_id_t;
 
+/**
+ * The types of operation that may be performed by rtos_gpio_batch().
+ */
+typedef enum {
+    rtos_gpio_op_out,   /**< Outputs value to the port, as rtos_gpio_port_out() */
+    rtos_gpio_op_in,    /**< Inputs the value on the port's pins into value, as rtos_gpio_port_in() */
+    rtos_gpio_op_delay, /**< Waits for value reference clock ticks. port_id is ignored */
+} rtos_gpio_op_type_t;
+
+/**
+ * Describes one operation in a batch passed to rtos_gpio_batch().
+ */
+typedef struct {
+    rtos_gpio_op_type_t op;      /**< The operation to perform */
+    rtos_gpio_port_id_t port_id; /**< The GPIO port to perform the operation on */
+    uint32_t value;              /**< The value to output, the value input, or the delay */
+} rtos_gpio_op_t;
+
 /**
  * This attribute must be specified on all RTOS GPIO interrupt callback functions
  * provided by the application.
@@ -128,6 +146,9 @@ struct rtos_gpio_struct {
     __attribute__((fptrgroup("rtos_gpio_interrupt_disable_fptr_grp")))
     void (*interrupt_disable)(rtos_gpio_t *, rtos_gpio_port_id_t);
 
+    __attribute__((fptrgroup("rtos_gpio_batch_fptr_grp")))
+    void (*batch)(rtos_gpio_t *, rtos_gpio_op_t *, size_t);
+
     rtos_gpio_isr_info_t *isr_info[RTOS_GPIO_TOTAL_PORT_CNT];
 
     rtos_osal_mutex_t lock; /* Only used by RPC client */
@@ -319,6 +340,27 @@ inline void rtos_gpio_interrupt_disable(
     ctx->interrupt_disable(ctx, port_id);
 }
 
+/**
+ * Performs a sequence of GPIO port outputs, inputs and delays.
+ *
+ * The operations are performed in order. When called on a client tile the
+ * entire sequence is sent to the host tile in a single RPC request, and
+ * runs there without a round trip between each operation. This allows
+ * simple bit-banged protocols to be driven from a client tile.
+ *
+ * \param ctx   A pointer to the GPIO driver instance to use.
+ * \param ops   The operations to perform. The value member of each input
+ *              operation is updated with the value on the port's pins.
+ * \param count The number of operations in \p ops.
+ */
+inline void rtos_gpio_batch(
+        rtos_gpio_t *ctx,
+        rtos_gpio_op_t ops[],
+        size_t count)
+{
+    ctx->batch(ctx, ops, count);
+}
+
 /**
 * Configures a port in drive mode.  Output values will be driven
 * on the pins.  This is the default drive state of a port.  This has
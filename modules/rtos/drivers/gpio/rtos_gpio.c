@@ -3,6 +3,7 @@
 
 #include <string.h>
 #include <xcore/triggerable.h>
+#include <xcore/hwtimer.h>
 #include <xcore/assert.h>
 
 #include "rtos/drivers/gpio/api/rtos_gpio.h"
@@ -167,6 +168,28 @@ static void gpio_local_interrupt_disable(rtos_gpio_t *ctx, rtos_gpio_port_id_t p
     rtos_osal_critical_exit(state);
 }
 
+__attribute__((fptrgroup("rtos_gpio_batch_fptr_grp")))
+static void gpio_local_batch(rtos_gpio_t *ctx, rtos_gpio_op_t *ops, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        switch (ops[i].op) {
+        case rtos_gpio_op_out:
+            gpio_local_port_out(ctx, ops[i].port_id, ops[i].value);
+            break;
+        case rtos_gpio_op_in:
+            ops[i].value = gpio_local_port_in(ctx, ops[i].port_id);
+            break;
+        case rtos_gpio_op_delay: {
+            uint32_t start_time = get_reference_time();
+            while (get_reference_time() - start_time < ops[i].value);
+            break;
+        }
+        default:
+            xassert(0);
+        }
+    }
+}
+
 void rtos_gpio_start(
         rtos_gpio_t *ctx)
 {
@@ -187,4 +210,5 @@ void rtos_gpio_init(
     ctx->isr_callback_set = gpio_local_isr_callback_set;
     ctx->interrupt_enable = gpio_local_interrupt_enable;
     ctx->interrupt_disable = gpio_local_interrupt_disable;
+    ctx->batch = gpio_local_batch;
 }
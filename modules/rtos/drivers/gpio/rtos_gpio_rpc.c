@@ -48,7 +48,8 @@ enum {
     fcode_port_write_control_word,
     fcode_isr_callback_set,
     fcode_interrupt_enable,
-    fcode_interrupt_disable
+    fcode_interrupt_disable,
+    fcode_batch
 };
 
 __attribute__((fptrgroup("rtos_gpio_port_enable_fptr_grp")))
@@ -235,6 +236,31 @@ static void gpio_remote_interrupt_disable(
     rtos_osal_mutex_put(&gpio_ctx->lock);
 }
 
+__attribute__((fptrgroup("rtos_gpio_batch_fptr_grp")))
+static void gpio_remote_batch(
+        rtos_gpio_t *gpio_ctx,
+        rtos_gpio_op_t *ops,
+        size_t count)
+{
+    rtos_intertile_address_t *host_address = &gpio_ctx->rpc_config->host_address;
+    rtos_gpio_t *host_ctx_ptr = gpio_ctx->rpc_config->host_ctx_ptr;
+
+    xassert(host_address->port >= 0);
+
+    const rpc_param_desc_t rpc_param_desc[] = {
+            RPC_PARAM_TYPE(gpio_ctx),
+            RPC_PARAM_INOUT_BUFFER(ops, count),
+            RPC_PARAM_TYPE(count),
+            RPC_PARAM_LIST_END
+    };
+
+    rtos_osal_mutex_get(&gpio_ctx->lock, RTOS_OSAL_WAIT_FOREVER);
+    rpc_client_call_generic(
+            host_address->intertile_ctx, host_address->port, fcode_batch, rpc_param_desc,
+            &host_ctx_ptr, ops, &count);
+    rtos_osal_mutex_put(&gpio_ctx->lock);
+}
+
 static int gpio_port_enable_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
 {
     int msg_length;
@@ -379,73 +405,71 @@ static int gpio_interrupt_disable_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_ms
     return msg_length;
 }
 
-static void gpio_rpc_thread(rtos_intertile_address_t *client_address)
+static int gpio_batch_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
 {
     int msg_length;
-    uint8_t *req_msg;
-    uint8_t *resp_msg;
-    rpc_msg_t rpc_msg;
-    rtos_intertile_t *intertile_ctx = client_address->intertile_ctx;
-    uint8_t intertile_port = client_address->port;
-
-    for (;;) {
-        /* receive RPC request message from client */
-        msg_length = rtos_intertile_rx(intertile_ctx, intertile_port, (void **) &req_msg, RTOS_OSAL_WAIT_FOREVER);
-
-        rpc_request_parse(&rpc_msg, req_msg);
-
-        switch (rpc_msg.fcode) {
-        case fcode_port_enable:
-            msg_length = gpio_port_enable_rpc_host(&rpc_msg, &resp_msg);
-            break;
-        case fcode_port_in:
-            msg_length = gpio_port_in_rpc_host(&rpc_msg, &resp_msg);
-            break;
-        case fcode_port_out:
-            msg_length = gpio_port_out_rpc_host(&rpc_msg, &resp_msg);
-            break;
-        case fcode_port_write_control_word:
-            msg_length = gpio_port_write_control_word_rpc_host(&rpc_msg, &resp_msg);
-            break;
-        case fcode_isr_callback_set:
-            msg_length = gpio_isr_callback_set_rpc_host(&rpc_msg, &resp_msg);
-            break;
-        case fcode_interrupt_enable:
-            msg_length = gpio_interrupt_enable_rpc_host(&rpc_msg, &resp_msg);
-            break;
-        case fcode_interrupt_disable:
-            msg_length = gpio_interrupt_disable_rpc_host(&rpc_msg, &resp_msg);
-            break;
-        }
 
-        rtos_osal_free(req_msg);
+    rtos_gpio_t *gpio_ctx;
+    rtos_gpio_op_t *ops;
+    size_t count;
+
+    rpc_request_unmarshall(
+            rpc_msg,
+            &gpio_ctx, &ops, &count);
+
+    /* The input values are written into the request message and sent back from there */
+    rtos_gpio_batch(gpio_ctx, ops, count);
+
+    msg_length = rpc_response_marshall(
+            resp_msg, rpc_msg,
+            gpio_ctx, ops, count);
+
+    return msg_length;
+}
+
+RPC_HOST_DISPATCH_ATTR
+static void gpio_rpc_dispatch(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
+{
+    int msg_length;
+    uint8_t *resp_msg;
 
-        /* send RPC response message to client */
-        rtos_intertile_tx(intertile_ctx, intertile_port, resp_msg, msg_length);
-        rtos_osal_free(resp_msg);
+    switch (rpc_msg->fcode) {
+    case fcode_port_enable:
+        msg_length = gpio_port_enable_rpc_host(rpc_msg, &resp_msg);
+        break;
+    case fcode_port_in:
+        msg_length = gpio_port_in_rpc_host(rpc_msg, &resp_msg);
+        break;
+    case fcode_port_out:
+        msg_length = gpio_port_out_rpc_host(rpc_msg, &resp_msg);
+        break;
+    case fcode_port_write_control_word:
+        msg_length = gpio_port_write_control_word_rpc_host(rpc_msg, &resp_msg);
+        break;
+    case fcode_isr_callback_set:
+        msg_length = gpio_isr_callback_set_rpc_host(rpc_msg, &resp_msg);
+        break;
+    case fcode_interrupt_enable:
+        msg_length = gpio_interrupt_enable_rpc_host(rpc_msg, &resp_msg);
+        break;
+    case fcode_interrupt_disable:
+        msg_length = gpio_interrupt_disable_rpc_host(rpc_msg, &resp_msg);
+        break;
+    case fcode_batch:
+        msg_length = gpio_batch_rpc_host(rpc_msg, &resp_msg);
+        break;
     }
+
+    /* send RPC response message to client */
+    rtos_intertile_tx(client_address->intertile_ctx, client_address->port, resp_msg, msg_length);
+    rtos_osal_free(resp_msg);
 }
 
 __attribute__((fptrgroup("rtos_driver_rpc_host_start_fptr_grp")))
 static void gpio_rpc_start(
         rtos_driver_rpc_t *rpc_config)
 {
-    xassert(rpc_config->host_task_priority >= 0);
-
-    for (int i = 0; i < rpc_config->remote_client_count; i++) {
-
-        rtos_intertile_address_t *client_address = &rpc_config->client_address[i];
-
-        xassert(client_address->port >= 0);
-
-        rtos_osal_thread_create(
-                NULL,
-                "gpio_rpc_thread",
-                (rtos_osal_entry_function_t) gpio_rpc_thread,
-                client_address,
-                RTOS_THREAD_STACK_SIZE(gpio_rpc_thread),
-                rpc_config->host_task_priority);
-    }
+    rpc_host_start(rpc_config, "gpio_rpc_thread", gpio_rpc_dispatch);
 }
 
 void rtos_gpio_rpc_config(
@@ -481,6 +505,7 @@ void rtos_gpio_rpc_client_init(
     gpio_ctx->isr_callback_set = gpio_remote_isr_callback_set;
     gpio_ctx->interrupt_enable = gpio_remote_interrupt_enable;
     gpio_ctx->interrupt_disable = gpio_remote_interrupt_disable;
+    gpio_ctx->batch = gpio_remote_batch;
     rpc_config->rpc_host_start = NULL;
     rpc_config->remote_client_count = 0;
     rpc_config->host_task_priority = -1;
@@ -507,6 +532,7 @@ void rtos_gpio_rpc_host_init(
 {
     gpio_ctx->rpc_config = rpc_config;
     rpc_config->rpc_host_start = gpio_rpc_start;
+    rpc_config->host_pool = NULL;
     rpc_config->remote_client_count = remote_client_count;
 
     /* This must be configured later with rtos_gpio_rpc_config() */
@@ -16,6 +16,25 @@
 #include "rtos/osal/api/rtos_osal.h"
 #include "rtos/drivers/rpc/api/rtos_driver_rpc.h"
 
+/**
+ * The types of register operation that may be performed by
+ * rtos_i2c_master_reg_batch().
+ */
+typedef enum {
+    rtos_i2c_master_reg_op_write, /**< Writes data to the register, as rtos_i2c_master_reg_write() */
+    rtos_i2c_master_reg_op_read,  /**< Reads the register into data, as rtos_i2c_master_reg_read() */
+} rtos_i2c_master_reg_op_type_t;
+
+/**
+ * Describes one register operation in a batch passed to rtos_i2c_master_reg_batch().
+ */
+typedef struct {
+    uint8_t op;          /**< One of the values in rtos_i2c_master_reg_op_type_t */
+    uint8_t device_addr; /**< The address of the device */
+    uint8_t reg_addr;    /**< The address of the register */
+    uint8_t data;        /**< The value to write, or the value read */
+} rtos_i2c_master_reg_op_t;
+
 /**
  * Typedef to the RTOS I2C master driver instance struct.
  */
@@ -44,6 +63,9 @@ struct rtos_i2c_master_struct {
     __attribute__((fptrgroup("rtos_i2c_master_reg_read_fptr_grp")))
     i2c_regop_res_t (*reg_read)(rtos_i2c_master_t *, uint8_t, uint8_t, uint8_t *);
 
+    __attribute__((fptrgroup("rtos_i2c_master_reg_batch_fptr_grp")))
+    i2c_regop_res_t (*reg_batch)(rtos_i2c_master_t *, rtos_i2c_master_reg_op_t *, size_t, size_t *);
+
     i2c_master_t ctx;
 
     rtos_osal_mutex_t lock;
@@ -191,6 +213,39 @@ inline i2c_regop_res_t  rtos_i2c_master_reg_read(
     return ctx->reg_read(ctx, device_addr, reg_addr, data);
 }
 
+/**
+ * Performs a sequence of 8-bit register writes and reads on I2C devices.
+ *
+ * Each operation behaves as either rtos_i2c_master_reg_write() or
+ * rtos_i2c_master_reg_read(). The operations are performed in order, and
+ * no other thread may use the bus until the sequence is complete. The
+ * sequence stops at the first operation that does not succeed.
+ *
+ * When called on a client tile the entire sequence is sent to the host
+ * tile in a single RPC request, rather than one per register. This makes
+ * it the preferred way to run long device initialization sequences from
+ * a client tile.
+ *
+ * \param ctx          A pointer to the I2C master driver instance to use.
+ * \param ops          The operations to perform. The data member of each
+ *                     read operation is updated with the value read.
+ * \param count        The number of operations in \p ops.
+ * \param num_ops_done The function will set this value to the number of
+ *                     operations that completed successfully. On success
+ *                     this will be equal to \p count.
+ *
+ * \retval             ``I2C_REGOP_SUCCESS`` if all the operations succeeded.
+ * \retval             The result of the first operation that failed otherwise.
+ */
+inline i2c_regop_res_t rtos_i2c_master_reg_batch(
+        rtos_i2c_master_t *ctx,
+        rtos_i2c_master_reg_op_t ops[],
+        size_t count,
+        size_t *num_ops_done)
+{
+    return ctx->reg_batch(ctx, ops, count, num_ops_done);
+}
+
 /**@}*/
 
 /**
@@ -136,6 +136,38 @@ static i2c_regop_res_t  i2c_master_local_reg_read(
     return reg_res;
 }
 
+__attribute__((fptrgroup("rtos_i2c_master_reg_batch_fptr_grp")))
+static i2c_regop_res_t i2c_master_local_reg_batch(
+        rtos_i2c_master_t *ctx,
+        rtos_i2c_master_reg_op_t *ops,
+        size_t count,
+        size_t *num_ops_done)
+{
+    i2c_regop_res_t reg_res = I2C_REGOP_SUCCESS;
+    size_t i;
+
+    rtos_osal_mutex_get(&ctx->lock, RTOS_OSAL_WAIT_FOREVER);
+
+    for (i = 0; i < count && reg_res == I2C_REGOP_SUCCESS; i++) {
+        switch (ops[i].op) {
+        case rtos_i2c_master_reg_op_write:
+            reg_res = i2c_master_local_reg_write(ctx, ops[i].device_addr, ops[i].reg_addr, ops[i].data);
+            break;
+        case rtos_i2c_master_reg_op_read:
+            reg_res = i2c_master_local_reg_read(ctx, ops[i].device_addr, ops[i].reg_addr, &ops[i].data);
+            break;
+        default:
+            xassert(0);
+        }
+    }
+
+    rtos_osal_mutex_put(&ctx->lock);
+
+    *num_ops_done = reg_res == I2C_REGOP_SUCCESS ? i : i - 1;
+
+    return reg_res;
+}
+
 void rtos_i2c_master_start(
         rtos_i2c_master_t *i2c_master_ctx)
 {
@@ -176,4 +208,5 @@ void rtos_i2c_master_init(
     i2c_master_ctx->stop_bit_send = i2c_master_local_stop_bit_send;
     i2c_master_ctx->reg_write = i2c_master_local_reg_write;
     i2c_master_ctx->reg_read = i2c_master_local_reg_read;
+    i2c_master_ctx->reg_batch = i2c_master_local_reg_batch;
 }
@@ -10,7 +10,8 @@ enum {
     fcode_read,
     fcode_stop_bit_send,
     fcode_reg_write,
-    fcode_reg_read
+    fcode_reg_read,
+    fcode_reg_batch
 };
 
 __attribute__((fptrgroup("rtos_i2c_master_write_fptr_grp")))
@@ -154,6 +155,35 @@ static i2c_regop_res_t  i2c_master_remote_reg_read(
     return ret;
 }
 
+__attribute__((fptrgroup("rtos_i2c_master_reg_batch_fptr_grp")))
+static i2c_regop_res_t i2c_master_remote_reg_batch(
+        rtos_i2c_master_t *i2c_master_ctx,
+        rtos_i2c_master_reg_op_t *ops,
+        size_t count,
+        size_t *num_ops_done)
+{
+    rtos_intertile_address_t *host_address = &i2c_master_ctx->rpc_config->host_address;
+    rtos_i2c_master_t *host_ctx_ptr = i2c_master_ctx->rpc_config->host_ctx_ptr;
+    i2c_regop_res_t ret;
+
+    xassert(host_address->port >= 0);
+
+    const rpc_param_desc_t rpc_param_desc[] = {
+            RPC_PARAM_TYPE(i2c_master_ctx),
+            RPC_PARAM_INOUT_BUFFER(ops, count),
+            RPC_PARAM_TYPE(count),
+            RPC_PARAM_RETURN(size_t),
+            RPC_PARAM_RETURN(i2c_regop_res_t),
+            RPC_PARAM_LIST_END
+    };
+
+    rpc_client_call_generic(
+            host_address->intertile_ctx, host_address->port, fcode_reg_batch, rpc_param_desc,
+            &host_ctx_ptr, ops, &count, num_ops_done, &ret);
+
+    return ret;
+}
+
 static int i2c_master_write_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
 {
     int msg_length;
@@ -272,67 +302,67 @@ static int i2c_master_reg_read_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
     return msg_length;
 }
 
-static void i2c_master_rpc_thread(rtos_intertile_address_t *client_address)
+static int i2c_master_reg_batch_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
 {
     int msg_length;
-    uint8_t *req_msg;
-    uint8_t *resp_msg;
-    rpc_msg_t rpc_msg;
-    rtos_intertile_t *intertile_ctx = client_address->intertile_ctx;
-    uint8_t intertile_port = client_address->port;
-
-    for (;;) {
-        /* receive RPC request message from client */
-        msg_length = rtos_intertile_rx(intertile_ctx, intertile_port, (void **) &req_msg, RTOS_OSAL_WAIT_FOREVER);
-
-        rpc_request_parse(&rpc_msg, req_msg);
-
-        switch (rpc_msg.fcode) {
-        case fcode_write:
-            msg_length = i2c_master_write_rpc_host(&rpc_msg, &resp_msg);
-            break;
-        case fcode_read:
-            msg_length = i2c_master_read_rpc_host(&rpc_msg, &resp_msg);
-            break;
-        case fcode_stop_bit_send:
-            msg_length = i2c_master_stop_bit_send_rpc_host(&rpc_msg, &resp_msg);
-            break;
-        case fcode_reg_write:
-            msg_length = i2c_master_reg_write_rpc_host(&rpc_msg, &resp_msg);
-            break;
-        case fcode_reg_read:
-            msg_length = i2c_master_reg_read_rpc_host(&rpc_msg, &resp_msg);
-            break;
-        }
 
-        rtos_osal_free(req_msg);
+    rtos_i2c_master_t *i2c_master_ctx;
+    rtos_i2c_master_reg_op_t *ops;
+    size_t count;
+    size_t num_ops_done;
+    i2c_regop_res_t ret;
+
+    rpc_request_unmarshall(
+            rpc_msg,
+            &i2c_master_ctx, &ops, &count, &num_ops_done, &ret);
+
+    /* The read data is written into the request message and sent back from there */
+    ret = rtos_i2c_master_reg_batch(i2c_master_ctx, ops, count, &num_ops_done);
+
+    msg_length = rpc_response_marshall(
+            resp_msg, rpc_msg,
+            i2c_master_ctx, ops, count, num_ops_done, ret);
+
+    return msg_length;
+}
+
+RPC_HOST_DISPATCH_ATTR
+static void i2c_master_rpc_dispatch(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
+{
+    int msg_length;
+    uint8_t *resp_msg;
 
-        /* send RPC response message to client */
-        rtos_intertile_tx(intertile_ctx, intertile_port, resp_msg, msg_length);
-        rtos_osal_free(resp_msg);
+    switch (rpc_msg->fcode) {
+    case fcode_write:
+        msg_length = i2c_master_write_rpc_host(rpc_msg, &resp_msg);
+        break;
+    case fcode_read:
+        msg_length = i2c_master_read_rpc_host(rpc_msg, &resp_msg);
+        break;
+    case fcode_stop_bit_send:
+        msg_length = i2c_master_stop_bit_send_rpc_host(rpc_msg, &resp_msg);
+        break;
+    case fcode_reg_write:
+        msg_length = i2c_master_reg_write_rpc_host(rpc_msg, &resp_msg);
+        break;
+    case fcode_reg_read:
+        msg_length = i2c_master_reg_read_rpc_host(rpc_msg, &resp_msg);
+        break;
+    case fcode_reg_batch:
+        msg_length = i2c_master_reg_batch_rpc_host(rpc_msg, &resp_msg);
+        break;
     }
+
+    /* send RPC response message to client */
+    rtos_intertile_tx(client_address->intertile_ctx, client_address->port, resp_msg, msg_length);
+    rtos_osal_free(resp_msg);
 }
 
 __attribute__((fptrgroup("rtos_driver_rpc_host_start_fptr_grp")))
 static void i2c_master_rpc_start(
         rtos_driver_rpc_t *rpc_config)
 {
-    xassert(rpc_config->host_task_priority >= 0);
-
-    for (int i = 0; i < rpc_config->remote_client_count; i++) {
-
-        rtos_intertile_address_t *client_address = &rpc_config->client_address[i];
-
-        xassert(client_address->port >= 0);
-
-        rtos_osal_thread_create(
-                NULL,
-                "i2c_master_rpc_thread",
-                (rtos_osal_entry_function_t) i2c_master_rpc_thread,
-                client_address,
-                RTOS_THREAD_STACK_SIZE(i2c_master_rpc_thread),
-                rpc_config->host_task_priority);
-    }
+    rpc_host_start(rpc_config, "i2c_master_rpc_thread", i2c_master_rpc_dispatch);
 }
 
 void rtos_i2c_master_rpc_config(
@@ -364,6 +394,7 @@ void rtos_i2c_master_rpc_client_init(
     i2c_master_ctx->stop_bit_send = i2c_master_remote_stop_bit_send;
     i2c_master_ctx->reg_write = i2c_master_remote_reg_write;
     i2c_master_ctx->reg_read = i2c_master_remote_reg_read;
+    i2c_master_ctx->reg_batch = i2c_master_remote_reg_batch;
     rpc_config->rpc_host_start = NULL;
     rpc_config->remote_client_count = 0;
     rpc_config->host_task_priority = -1;
@@ -383,6 +414,7 @@ void rtos_i2c_master_rpc_host_init(
 {
     i2c_master_ctx->rpc_config = rpc_config;
     rpc_config->rpc_host_start = i2c_master_rpc_start;
+    rpc_config->host_pool = NULL;
     rpc_config->remote_client_count = remote_client_count;
 
     /* This must be configured later with rtos_i2c_master_rpc_config() */
@@ -0,0 +1,207 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Generated by tools/rpc_gen/rpc_gen.py from rtos_i2s_rpc.idl. Do not edit.
+ *
+ * This is included by the driver's RPC source file, and provides the static
+ * client stub i2s_remote_<function>() for each function, and the host
+ * dispatch function i2s_rpc_dispatch().
+ */
+
+#ifndef RTOS_I2S_RPC_GEN_H_
+#define RTOS_I2S_RPC_GEN_H_
+
+#include "rtos/drivers/rpc/api/rtos_rpc.h"
+#include "rtos/drivers/i2s/api/rtos_i2s.h"
+
+#ifndef RPC_GEN_ALIGN
+#define RPC_GEN_ALIGN(x, a) (((x) + (a) - 1) & ~((size_t) (a) - 1))
+#endif
+
+/* Sent before each input buffer to align it, no alignment exceeds 8 on xcore */
+static uint8_t i2s_rpc_pad[8];
+
+enum {
+    fcode_rx,
+    fcode_tx,
+};
+
+/*
+ * Fixed parts of the rtos_i2s_rx() request and response messages.
+ */
+typedef struct {
+    rpc_fixed_request_hdr_t hdr;
+    rtos_i2s_t *ctx;
+    size_t frame_count;
+    unsigned timeout;
+} i2s_rx_req_t;
+
+typedef struct {
+    int fcode;
+    size_t ret;
+} i2s_rx_resp_t;
+
+/*
+ * Fixed parts of the rtos_i2s_tx() request and response messages.
+ */
+typedef struct {
+    rpc_fixed_request_hdr_t hdr;
+    rtos_i2s_t *ctx;
+    size_t frame_count;
+    unsigned timeout;
+} i2s_tx_req_t;
+
+typedef struct {
+    int fcode;
+    size_t ret;
+} i2s_tx_resp_t;
+
+__attribute__((fptrgroup("rtos_i2s_rx_fptr_grp")))
+static size_t i2s_remote_rx(
+        rtos_i2s_t *ctx,
+        int32_t *i2s_sample_buf,
+        size_t frame_count,
+        unsigned timeout)
+{
+    rtos_intertile_address_t *host_address = &ctx->rpc_config->host_address;
+    rtos_intertile_t *intertile_ctx = host_address->intertile_ctx;
+    const size_t i2s_sample_buf_len = sizeof(i2s_sample_buf[0]) * (frame_count * (2 * ctx->num_in));
+    i2s_rx_req_t req;
+    i2s_rx_resp_t resp;
+    size_t msg_length;
+
+    xassert(host_address->port >= 0);
+
+    req.hdr.fcode = fcode_rx;
+    req.hdr.param_count = 0;
+    req.ctx = ctx->rpc_config->host_ctx_ptr;
+    req.frame_count = frame_count;
+    req.timeout = timeout;
+
+    rtos_osal_mutex_get(&ctx->mutex, RTOS_OSAL_WAIT_FOREVER);
+
+    rtos_intertile_tx_len(intertile_ctx, host_address->port, sizeof(req));
+    rtos_intertile_tx_data(intertile_ctx, &req, sizeof(req));
+
+    msg_length = rtos_intertile_rx_len(intertile_ctx, host_address->port, RTOS_OSAL_WAIT_FOREVER);
+    xassert(msg_length == sizeof(resp) + i2s_sample_buf_len);
+    rtos_intertile_rx_data(intertile_ctx, &resp, sizeof(resp));
+    if (i2s_sample_buf_len > 0) {
+        rtos_intertile_rx_data(intertile_ctx, i2s_sample_buf, i2s_sample_buf_len);
+    }
+
+    rtos_osal_mutex_put(&ctx->mutex);
+
+    xassert(resp.fcode == fcode_rx);
+
+    return resp.ret;
+}
+
+__attribute__((fptrgroup("rtos_i2s_tx_fptr_grp")))
+static size_t i2s_remote_tx(
+        rtos_i2s_t *ctx,
+        int32_t *i2s_sample_buf,
+        size_t frame_count,
+        unsigned timeout)
+{
+    rtos_intertile_address_t *host_address = &ctx->rpc_config->host_address;
+    rtos_intertile_t *intertile_ctx = host_address->intertile_ctx;
+    const size_t i2s_sample_buf_len = sizeof(i2s_sample_buf[0]) * (frame_count * (2 * ctx->num_out));
+    i2s_tx_req_t req;
+    const size_t i2s_sample_buf_ofs = RPC_GEN_ALIGN(sizeof(req), __alignof__(i2s_sample_buf[0]));
+    i2s_tx_resp_t resp;
+    size_t msg_length;
+
+    xassert(host_address->port >= 0);
+
+    req.hdr.fcode = fcode_tx;
+    req.hdr.param_count = 0;
+    req.ctx = ctx->rpc_config->host_ctx_ptr;
+    req.frame_count = frame_count;
+    req.timeout = timeout;
+
+    rtos_osal_mutex_get(&ctx->mutex, RTOS_OSAL_WAIT_FOREVER);
+
+    rtos_intertile_tx_len(intertile_ctx, host_address->port, i2s_sample_buf_ofs + i2s_sample_buf_len);
+    rtos_intertile_tx_data(intertile_ctx, &req, sizeof(req));
+    if (i2s_sample_buf_ofs > sizeof(req)) {
+        rtos_intertile_tx_data(intertile_ctx, i2s_rpc_pad, i2s_sample_buf_ofs - (sizeof(req)));
+    }
+    if (i2s_sample_buf_len > 0) {
+        rtos_intertile_tx_data(intertile_ctx, i2s_sample_buf, i2s_sample_buf_len);
+    }
+
+    msg_length = rtos_intertile_rx_len(intertile_ctx, host_address->port, RTOS_OSAL_WAIT_FOREVER);
+    xassert(msg_length == sizeof(resp));
+    rtos_intertile_rx_data(intertile_ctx, &resp, sizeof(resp));
+
+    rtos_osal_mutex_put(&ctx->mutex);
+
+    xassert(resp.fcode == fcode_tx);
+
+    return resp.ret;
+}
+
+static void i2s_rx_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
+{
+    i2s_rx_req_t *req = rpc_msg->msg_buf;
+    rtos_i2s_t *ctx = req->ctx;
+    size_t frame_count = req->frame_count;
+    unsigned timeout = req->timeout;
+    int32_t *i2s_sample_buf;
+    const size_t i2s_sample_buf_len = sizeof(i2s_sample_buf[0]) * (frame_count * (2 * ctx->num_in));
+    i2s_rx_resp_t resp;
+
+    /* Output only buffers are allocated here, as the caller would have */
+    i2s_sample_buf = rtos_osal_malloc(i2s_sample_buf_len);
+
+    resp.ret = rtos_i2s_rx(ctx, i2s_sample_buf, frame_count, timeout);
+    resp.fcode = req->hdr.fcode;
+
+    /* send RPC response message to client */
+    rtos_intertile_tx_len(client_address->intertile_ctx, client_address->port, sizeof(resp) + i2s_sample_buf_len);
+    rtos_intertile_tx_data(client_address->intertile_ctx, &resp, sizeof(resp));
+    if (i2s_sample_buf_len > 0) {
+        rtos_intertile_tx_data(client_address->intertile_ctx, i2s_sample_buf, i2s_sample_buf_len);
+    }
+    rtos_osal_free(i2s_sample_buf);
+}
+
+static void i2s_tx_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
+{
+    i2s_tx_req_t *req = rpc_msg->msg_buf;
+    rtos_i2s_t *ctx = req->ctx;
+    size_t frame_count = req->frame_count;
+    unsigned timeout = req->timeout;
+    int32_t *i2s_sample_buf;
+    const size_t i2s_sample_buf_ofs = RPC_GEN_ALIGN(sizeof(*req), __alignof__(i2s_sample_buf[0]));
+    i2s_tx_resp_t resp;
+
+    /* Input buffers are used in place in the request message */
+    i2s_sample_buf = (void *) ((uint8_t *) req + i2s_sample_buf_ofs);
+
+    resp.ret = rtos_i2s_tx(ctx, i2s_sample_buf, frame_count, timeout);
+    resp.fcode = req->hdr.fcode;
+
+    /* send RPC response message to client */
+    rtos_intertile_tx_len(client_address->intertile_ctx, client_address->port, sizeof(resp));
+    rtos_intertile_tx_data(client_address->intertile_ctx, &resp, sizeof(resp));
+}
+
+RPC_HOST_DISPATCH_ATTR
+static void i2s_rpc_dispatch(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
+{
+    switch (rpc_msg->fcode) {
+    case fcode_rx:
+        i2s_rx_rpc_host(client_address, rpc_msg);
+        break;
+    case fcode_tx:
+        i2s_tx_rpc_host(client_address, rpc_msg);
+        break;
+    default:
+        xassert(0);
+    }
+}
+
+#endif /* RTOS_I2S_RPC_GEN_H_ */
@@ -3,7 +3,7 @@
 
 /**
  * Facilitates channel communication between tiles.
- * Essentially a thin wrapper around a streaming channel.
+ * Essentially a thin wrapper around one or more streaming channels.
  *
  * Recommend limiting to one per tile pair. There should be at
  * least one more RTOS core usable by all tasks that use these
@@ -29,18 +29,205 @@
 #include "rtos/osal/api/rtos_osal.h"
 
 /**
- * Struct representing an RTOS intertile driver instance.
+ * The maximum number of channel links that a single intertile driver instance
+ * may use. See rtos_intertile_multi_link_init().
+ */
+#ifndef RTOS_INTERTILE_MAX_LINKS
+#define RTOS_INTERTILE_MAX_LINKS 4
+#endif
+
+/**
+ * The number of ports supported by each intertile driver instance. Port numbers
+ * must be less than this. This is limited by the number of usable bits in an
+ * RTOS event group.
+ */
+#define RTOS_INTERTILE_MAX_PORTS 24
+
+/**
+ * Set in the port number sent ahead of a transfer that holds several coalesced
+ * messages. See rtos_intertile_port_coalesce_set().
+ */
+#define RTOS_INTERTILE_COALESCED_FLAG 0x80
+
+/**
+ * Returned by rtos_intertile_rx_buf() and rtos_intertile_rx_pool() when no
+ * message is received before the timeout expires.
+ */
+#define RTOS_INTERTILE_RX_TIMEOUT (-1)
+
+/**
+ * Returned by rtos_intertile_rx_buf() and rtos_intertile_rx_pool() when the
+ * received message is longer than the buffer it is received into. The buffer
+ * holds the start of the message and the remainder is discarded.
+ */
+#define RTOS_INTERTILE_RX_TRUNCATED (-2)
+
+typedef struct rtos_intertile_struct rtos_intertile_t;
+
+/**
+ * Struct holding the traffic counters for a single port of an intertile
+ * driver instance. See rtos_intertile_port_stats_get().
+ */
+typedef struct {
+    uint64_t tx_bytes;             /**< Number of bytes transmitted to this port */
+    uint32_t tx_messages;          /**< Number of messages transmitted to this port */
+    uint32_t tx_coalesced;         /**< Number of messages transmitted to this port that shared
+                                        a transfer with other messages. See
+                                        rtos_intertile_port_coalesce_set() */
+    uint32_t tx_max_blocked_ticks; /**< The longest time, in reference clock ticks, that a
+                                        transmit to this port took to complete, including
+                                        the time spent waiting for the link */
+    uint64_t rx_bytes;             /**< Number of bytes received on this port */
+    uint32_t rx_messages;          /**< Number of messages received on this port */
+} rtos_intertile_port_stats_t;
+
+/**
+ * Struct holding the receive interrupt counters for a single link of an
+ * intertile driver instance. See rtos_intertile_link_stats_get().
+ */
+typedef struct {
+    uint32_t isr_count;       /**< Number of times the receive ISR has run */
+    uint32_t isr_total_ticks; /**< Total time, in reference clock ticks, spent in the receive ISR,
+                                   including the receive notification callback */
+    uint32_t isr_max_ticks;   /**< The longest time, in reference clock ticks, spent in a single run
+                                   of the receive ISR, including the receive notification callback */
+} rtos_intertile_link_stats_t;
+
+/**
+ * Struct representing a single channel link within an RTOS intertile
+ * driver instance.
  *
  * The members in this struct should not be accessed directly.
  */
 typedef struct {
+    rtos_intertile_t *ctx;
+    chanend_t c;
+    rtos_osal_mutex_t lock;
+    rtos_intertile_link_stats_t stats;
+} rtos_intertile_link_t;
+
+/**
+ * Struct holding the messages sent to a port that are waiting to be coalesced
+ * into a single transfer. See rtos_intertile_port_coalesce_set().
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    rtos_osal_mutex_t lock;
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    unsigned count;
+
+    rtos_intertile_t *ctx;
+    uint8_t port;
+    size_t flush_len;
+    unsigned window;
+    rtos_osal_semaphore_t started;
+    rtos_osal_thread_t flush_thread;
+} rtos_intertile_coalesce_t;
+
+/**
+ * Function pointer type for functions that are called from the intertile
+ * receive ISR when a message arrives on a port. See rtos_intertile_rx_notify_set().
+ *
+ * \param ctx  A pointer to the intertile driver instance that received the message.
+ * \param port The port that the message was received on.
+ * \param arg  The argument that was given to rtos_intertile_rx_notify_set().
+ */
+typedef void (*rtos_intertile_rx_notify_cb_t)(rtos_intertile_t *ctx, uint8_t port, void *arg);
+
+/**
+ * Declares an intertile receive notification callback function.
+ */
+#define RTOS_INTERTILE_RX_NOTIFY_CALLBACK_ATTR __attribute__((fptrgroup("rtos_intertile_rx_notify_cb_fptr_grp")))
+
+/**
+ * Struct representing an RTOS intertile driver instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rtos_intertile_struct {
     chanend_t c;
 
     size_t tx_len;
     size_t rx_len;
-    rtos_osal_mutex_t lock;
+    uint8_t tx_port;
+    uint32_t tx_start_time;
     rtos_osal_event_group_t event_group;
-} rtos_intertile_t;
+
+    int link_count;
+    rtos_intertile_link_t link[RTOS_INTERTILE_MAX_LINKS];
+    uint8_t tx_link[RTOS_INTERTILE_MAX_PORTS];
+    uint8_t rx_link[RTOS_INTERTILE_MAX_PORTS];
+    rtos_intertile_port_stats_t port_stats[RTOS_INTERTILE_MAX_PORTS];
+
+    RTOS_INTERTILE_RX_NOTIFY_CALLBACK_ATTR rtos_intertile_rx_notify_cb_t rx_notify[RTOS_INTERTILE_MAX_PORTS];
+    void *rx_notify_arg[RTOS_INTERTILE_MAX_PORTS];
+    uint32_t rx_unnotified_mask;
+
+    uint32_t tx_coalesce_mask;
+    rtos_intertile_coalesce_t *tx_coalesce[RTOS_INTERTILE_MAX_PORTS];
+    uint8_t rx_coalesced[RTOS_INTERTILE_MAX_PORTS];
+    uint8_t *rx_batch[RTOS_INTERTILE_MAX_PORTS];
+    size_t rx_batch_pos[RTOS_INTERTILE_MAX_PORTS];
+    size_t rx_batch_len[RTOS_INTERTILE_MAX_PORTS];
+    uint8_t rx_port;
+};
+
+/**
+ * Struct representing a fixed-size message pool that may be used to receive
+ * intertile messages without allocating them from the heap. See
+ * rtos_intertile_pool_init() and rtos_intertile_rx_pool().
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    size_t block_size;
+    rtos_osal_queue_t free_blocks;
+} rtos_intertile_pool_t;
+
+/**
+ * The maximum number of frames that the receive ring of an intertile stream
+ * may hold. This is also the maximum number of credits that a transmitting
+ * stream may hold at once.
+ */
+#ifndef RTOS_INTERTILE_STREAM_MAX_FRAMES
+#define RTOS_INTERTILE_STREAM_MAX_FRAMES 64
+#endif
+
+/**
+ * The maximum number of words of a frame that the stream receive interrupt
+ * reads each time it runs. Longer frames are read over several runs of the
+ * interrupt, so that other interrupts on the same core are not held off
+ * while a whole frame is copied.
+ */
+#ifndef RTOS_INTERTILE_STREAM_ISR_WORDS
+#define RTOS_INTERTILE_STREAM_ISR_WORDS 16
+#endif
+
+/**
+ * Struct representing one end of an intertile stream. See
+ * rtos_intertile_stream_tx_init() and rtos_intertile_stream_rx_init().
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    chanend_t c;
+    size_t frame_size;
+
+    /* Transmit end */
+    rtos_osal_mutex_t lock;
+    rtos_osal_semaphore_t credits;
+
+    /* Receive end */
+    uint8_t *ring;
+    size_t frame_count;
+    size_t wr_index;
+    size_t wr_word;
+    size_t rd_index;
+    rtos_osal_semaphore_t frames;
+} rtos_intertile_stream_t;
 
 /**
  * Struct to hold an address to a remote function, consisting
@@ -60,6 +247,20 @@ typedef struct {
  * @{
  */
 
+/**
+ * Begins a transmit to an intertile link whose data will be provided by one
+ * or more subsequent calls to rtos_intertile_tx_data(). The link is held until
+ * all \p len bytes have been transmitted.
+ *
+ * \note This, along with rtos_intertile_tx_data(), rtos_intertile_rx_len() and
+ * rtos_intertile_rx_data(), always uses the instance's first link, regardless of
+ * the priority set for \p port. A port that has been given a non-zero priority
+ * with rtos_intertile_port_priority_set() should not also be used with these.
+ *
+ * \param ctx  A pointer to the intertile driver instance to use.
+ * \param port The number of the port to send the data to.
+ * \param len  The total number of bytes that will be transmitted.
+ */
 void rtos_intertile_tx_len(
         rtos_intertile_t *ctx,
         uint8_t port,
@@ -123,8 +324,358 @@ size_t rtos_intertile_rx(
         void **msg,
         unsigned timeout);
 
+/**
+ * Receives data from an intertile link directly into a buffer supplied by the
+ * caller. No memory is allocated from the heap.
+ *
+ * \param ctx     A pointer to the intertile driver instance to use.
+ * \param port    The number of the port to listen for data on. Only
+ *                data sent to this port by the remote tile will be
+ *                received.
+ *                \note It is important that no other thread listen
+ *                on this port simultaneously.
+ * \param buf     A pointer to the buffer to write the received data to.
+ * \param len     The size in bytes of \p buf. If the received message is
+ *                longer than this, only the first \p len bytes are written
+ *                to \p buf and the remainder is discarded.
+ * \param timeout The amount of time to wait before data become
+ *                available.
+ *
+ * \returns the length in bytes of the received message, which may be 0.
+ * \retval RTOS_INTERTILE_RX_TIMEOUT   if the timeout expired.
+ * \retval RTOS_INTERTILE_RX_TRUNCATED if the message was longer than \p len.
+ *         The first \p len bytes of it are in \p buf.
+ */
+int32_t rtos_intertile_rx_buf(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        void *buf,
+        size_t len,
+        unsigned timeout);
+
+/**
+ * Receives data from an intertile link into a block obtained from a message pool.
+ * This behaves like rtos_intertile_rx(), except that the message buffer is taken
+ * from \p pool rather than the heap. This is intended for ports that carry a steady
+ * stream of messages with a known maximum size, such as audio frames, so that they
+ * never touch the heap.
+ *
+ * \note the buffer returned via \p msg must be returned to the pool by the
+ * application using rtos_intertile_pool_free().
+ *
+ * \param ctx     A pointer to the intertile driver instance to use.
+ * \param port    The number of the port to listen for data on.
+ * \param pool    The message pool to obtain the receive buffer from. This must
+ *                have been initialized with rtos_intertile_pool_init(). If the
+ *                received message is longer than the pool's block size, then
+ *                the remainder is discarded.
+ * \param msg     A pointer to the received data is written to this
+ *                pointer variable. This is set whenever a message is received,
+ *                including a message of length 0 and a truncated message, and
+ *                is set to NULL if the timeout expired.
+ * \param timeout The amount of time to wait for both a free pool block and
+ *                for data to become available.
+ *
+ * \returns the length in bytes of the received message, which may be 0.
+ * \retval RTOS_INTERTILE_RX_TIMEOUT   if the timeout expired.
+ * \retval RTOS_INTERTILE_RX_TRUNCATED if the message was longer than the pool's
+ *         block size. The block returned via \p msg holds the start of it.
+ */
+int32_t rtos_intertile_rx_pool(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        rtos_intertile_pool_t *pool,
+        void **msg,
+        unsigned timeout);
+
+/**
+ * Returns a message buffer obtained with rtos_intertile_rx_pool() to its pool.
+ *
+ * \param pool A pointer to the pool that \p msg was obtained from.
+ * \param msg  The message buffer to return to the pool.
+ */
+void rtos_intertile_pool_free(
+        rtos_intertile_pool_t *pool,
+        void *msg);
+
+/**
+ * Sets the priority of a port. Messages sent to a port are always carried by
+ * the same link, so they are received in the order they were sent. The link
+ * used is selected by the port's priority, with priority 0 (the default for
+ * all ports) mapping to the first link and each higher priority mapping to the
+ * next link, up to the last link on the instance.
+ *
+ * Ports that carry short, latency sensitive messages sent with
+ * rtos_intertile_tx() may therefore be given a higher priority than ports that
+ * carry bulk data so that they never have to wait for a long transfer to
+ * complete. This has no effect on an instance initialized with a single link.
+ *
+ * \note Ports used with rtos_intertile_tx_len() and rtos_intertile_rx_len(),
+ * which include all RPC ports, must stay at priority 0, as these functions
+ * always use the first link. Bulk data ports may instead be moved to higher
+ * priorities so that RPC messages on the first link do not wait behind them.
+ *
+ * The priority of a port only affects messages sent from this tile, so it need
+ * only be set on the tile that transmits to the port. It should be set before
+ * any messages are sent to the port.
+ *
+ * \param ctx      A pointer to the intertile driver instance to use.
+ * \param port     The number of the port to set the priority of.
+ * \param priority The priority of the port. Values greater than or equal to
+ *                 the number of links on the instance select the last link.
+ */
+void rtos_intertile_port_priority_set(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        unsigned priority);
+
+/**
+ * Enables coalescing of the small messages sent to a port. A message that is
+ * sent to the port with rtos_intertile_tx() while its link is busy with another
+ * transfer is copied into \p buf and rtos_intertile_tx() returns straight away.
+ * All of the messages held in \p buf are then sent together, as a single
+ * transfer, as soon as the link is free or when \p buf has no room for the next
+ * message. The receiving tile splits them up again, so each is still received
+ * as a separate message, in the order they were sent.
+ *
+ * This saves the receive interrupt and the thread wake up that each message
+ * would otherwise take, and lets the sending thread continue without waiting for
+ * the link. It does not delay a message when its link is already free, unless
+ * rtos_intertile_port_coalesce_window_set() is also called.
+ *
+ * Each message takes up its length plus 4 bytes of \p buf. Messages that do not
+ * fit into an empty buffer are always sent on their own. The receiving tile reads
+ * a transfer holding several messages into a buffer allocated from its heap as
+ * soon as it is received by the first receive call on the port, so the link is
+ * free again for other ports while the rest of the messages are received. Such
+ * messages must be received with rtos_intertile_rx(), rtos_intertile_rx_buf() or
+ * rtos_intertile_rx_pool(), not rtos_intertile_rx_len().
+ *
+ * This only needs to be called on the tile that transmits to the port, and must
+ * be called before any messages are sent to it. Calling it with \p coalesce set
+ * to NULL sends any messages still waiting and stops coalescing on the port. No
+ * other thread may send to the port while this is done.
+ *
+ * \param ctx      A pointer to the intertile driver instance to use.
+ * \param port     The number of the port to coalesce messages on.
+ * \param coalesce A pointer to the struct to hold the state of the waiting messages,
+ *                 or NULL to stop coalescing.
+ * \param buf      The buffer to hold the waiting messages in.
+ * \param size     The size in bytes of \p buf.
+ */
+void rtos_intertile_port_coalesce_set(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        rtos_intertile_coalesce_t *coalesce,
+        void *buf,
+        size_t size);
+
+/**
+ * Makes a port that coalesces messages hold them back even while its link is
+ * free, so that messages sent close together are sent as a single transfer.
+ * The messages waiting on the port are sent once they take up \p flush_len bytes
+ * of its coalesce buffer, or once the first of them has waited for \p window
+ * ticks, whichever happens first. They are also sent whenever another transfer
+ * on the same link completes.
+ *
+ * A thread is created to send the messages when the window expires. It is
+ * deleted when coalescing is stopped with rtos_intertile_port_coalesce_set().
+ *
+ * This must be called after rtos_intertile_port_coalesce_set(), and only once
+ * for each time coalescing is started on the port.
+ *
+ * \param ctx       A pointer to the intertile driver instance to use.
+ * \param port      The number of the port.
+ * \param flush_len The number of bytes of the coalesce buffer that, once taken up,
+ *                  causes the waiting messages to be sent straight away. Each
+ *                  message takes up its length plus 4 bytes.
+ * \param window    The longest time in RTOS ticks that a message may be held back.
+ *                  See RTOS_OSAL_WAIT_MS().
+ * \param priority  The priority of the thread that sends the messages when the
+ *                  window expires.
+ */
+void rtos_intertile_port_coalesce_window_set(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        size_t flush_len,
+        unsigned window,
+        unsigned priority);
+
+/**
+ * Checks whether there are messages waiting to be read on a port that are
+ * part of a coalesced transfer that has already been received. Such
+ * messages do not cause the receive notification callback to be called again.
+ *
+ * \param ctx  A pointer to the intertile driver instance to use.
+ * \param port The number of the port to check.
+ *
+ * \retval 1 if there is at least one such message waiting.
+ * \retval 0 otherwise.
+ */
+int rtos_intertile_rx_pending(
+        rtos_intertile_t *ctx,
+        uint8_t port);
+
+/**
+ * Sets a function to be called from the intertile receive ISR each time a
+ * message arrives on a port. The callback is called after the thread waiting
+ * on the port, if any, has been woken, and must not block. It is intended to
+ * let a single thread service several ports, for example by queuing the port
+ * to a thread that then receives the message with rtos_intertile_rx().
+ *
+ * The next message on the same link does not arrive until this one has been
+ * received, so the callback is called at most once per port until the message
+ * it reports is received. When the transmitting tile coalesces messages sent to
+ * the port, the callback is called once for each transfer, which may hold several
+ * messages. See rtos_intertile_rx_pending().
+ *
+ * If a message has already arrived on the port and not yet been received when
+ * the callback is set, the callback is called for it before this returns.
+ *
+ * \param ctx  A pointer to the intertile driver instance to use.
+ * \param port The number of the port to set the callback for.
+ * \param cb   The function to call, or NULL to remove the callback.
+ * \param arg  An argument to pass to \p cb.
+ */
+void rtos_intertile_rx_notify_set(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        rtos_intertile_rx_notify_cb_t cb,
+        void *arg);
+
+/**
+ * Gets the traffic counters for a port. The counters are maintained for every
+ * port from the time the instance is initialized, and may be read at any time.
+ * Transmit counters are updated on the tile that transmits to the port, and
+ * receive counters on the tile that receives from it.
+ *
+ * \param ctx   A pointer to the intertile driver instance to use.
+ * \param port  The number of the port to get the counters for.
+ * \param stats A pointer to the struct to copy the counters to.
+ */
+void rtos_intertile_port_stats_get(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        rtos_intertile_port_stats_t *stats);
+
+/**
+ * Gets the receive interrupt counters for a link.
+ *
+ * \param ctx   A pointer to the intertile driver instance to use.
+ * \param link  The index of the link to get the counters for. This must be less
+ *              than the number of links the instance was initialized with.
+ * \param stats A pointer to the struct to copy the counters to.
+ */
+void rtos_intertile_link_stats_get(
+        rtos_intertile_t *ctx,
+        int link,
+        rtos_intertile_link_stats_t *stats);
+
+/**
+ * Resets all of the port and link counters of an intertile driver instance to zero.
+ * This should not be called while messages are being transferred.
+ *
+ * \param ctx A pointer to the intertile driver instance to use.
+ */
+void rtos_intertile_stats_clear(
+        rtos_intertile_t *ctx);
+
 /**@}*/
 
+/**
+ * \addtogroup rtos_intertile_driver_stream rtos_intertile_driver_stream
+ *
+ * The functions for using an intertile stream after it has been initialized
+ * and started.
+ *
+ * An intertile stream carries fixed-size frames in one direction over its own
+ * streaming channel. The receiving end holds the frames in a ring buffer and
+ * advertises how many free slots the ring has as credits. The transmitting end
+ * may send one frame per credit without waiting for the receiver, and a credit
+ * is returned each time the receiver releases a frame. Frames carry no length
+ * or port header, and the receive interrupt stays enabled the whole time, so
+ * this is suited to continuous data such as audio or camera frames.
+ * @{
+ */
+
+/**
+ * Transmits a frame on an intertile stream. If the transmitting end holds a
+ * credit, then this returns as soon as the frame has been sent. Otherwise it
+ * waits until the receiving end releases a frame from its ring.
+ *
+ * \param stream  A pointer to the transmit end of the stream.
+ * \param frame   A pointer to the frame to transmit. This must be word aligned
+ *                and contain the stream's frame size in bytes.
+ * \param timeout The amount of time to wait for a credit.
+ *
+ * \returns the number of bytes transmitted, or 0 if the timeout expired.
+ */
+size_t rtos_intertile_stream_tx(
+        rtos_intertile_stream_t *stream,
+        const void *frame,
+        unsigned timeout);
+
+/**
+ * Receives the next frame from an intertile stream. The frame is not copied;
+ * a pointer to it in the stream's ring buffer is returned. Once the application
+ * is finished with it, it must call rtos_intertile_stream_rx_release() so that
+ * the slot may be reused.
+ *
+ * Only one thread may receive from a stream.
+ *
+ * \param stream  A pointer to the receive end of the stream.
+ * \param frame   A pointer to the received frame is written to this pointer
+ *                variable. It is set to NULL if no frame is received.
+ * \param timeout The amount of time to wait for a frame.
+ *
+ * \returns the number of bytes received, or 0 if the timeout expired.
+ */
+size_t rtos_intertile_stream_rx(
+        rtos_intertile_stream_t *stream,
+        void **frame,
+        unsigned timeout);
+
+/**
+ * Releases the oldest frame obtained with rtos_intertile_stream_rx() and returns
+ * its credit to the transmitting end. Frames must be released in the order they
+ * were received.
+ *
+ * \param stream  A pointer to the receive end of the stream.
+ */
+void rtos_intertile_stream_rx_release(
+        rtos_intertile_stream_t *stream);
+
+/**@}*/
+
+/**
+ * Initializes a fixed-size message pool for use with rtos_intertile_rx_pool().
+ * It may be called either before or after starting the RTOS.
+ *
+ * \param pool        A pointer to the message pool to initialize.
+ * \param mem         The memory to carve the pool blocks out of. This must be at
+ *                    least \p block_size * \p block_count bytes and must have
+ *                    the same scope as \p pool.
+ * \param block_size  The size in bytes of each block. This should be a multiple
+ *                    of four so that each block remains word aligned.
+ * \param block_count The number of blocks in the pool.
+ */
+void rtos_intertile_pool_init(
+        rtos_intertile_pool_t *pool,
+        void *mem,
+        size_t block_size,
+        size_t block_count);
+
+/**
+ * Deinitializes a message pool, freeing the queue that holds its free blocks.
+ * All of the pool's blocks must have been returned to it with
+ * rtos_intertile_pool_free(), and no thread may be receiving into it. The
+ * memory that the blocks were carved out of is not freed.
+ *
+ * \param pool A pointer to the message pool to deinitialize.
+ */
+void rtos_intertile_pool_deinit(
+        rtos_intertile_pool_t *pool);
+
 /**
  * Starts an RTOS intertile driver instance. It may be called either before or after
  * starting the RTOS, but must be called before any of the core intertile driver functions
@@ -156,6 +707,99 @@ void rtos_intertile_init(
         rtos_intertile_t *intertile_ctx,
         chanend_t c);
 
+/**
+ * Initializes an RTOS intertile driver instance that uses more than one link.
+ * This behaves like rtos_intertile_init(), except that \p link_count streaming
+ * channels are established between the two tiles instead of one. Each link
+ * has its own transmit lock and receive interrupt, so messages sent to ports
+ * that use different links do not wait for each other. See
+ * rtos_intertile_port_priority_set().
+ *
+ * This must be called simultaneously on the two tiles establishing the intertile
+ * link, with the same value of \p link_count on both.
+ *
+ * \param intertile_ctx A pointer to the intertile driver instance to initialize.
+ * \param c             A channel end that is already allocated and connected to channel
+ *                      end on the tile with which to establish an intertile link.
+ *                      After this function returns, this channel end is no longer needed
+ *                      and may be deallocated or used for other purposes.
+ * \param link_count    The number of links to establish. This must be between 1 and
+ *                      RTOS_INTERTILE_MAX_LINKS. Each link uses one channel end on
+ *                      each tile.
+ */
+void rtos_intertile_multi_link_init(
+        rtos_intertile_t *intertile_ctx,
+        chanend_t c,
+        int link_count);
+
+/**
+ * Starts one end of an intertile stream. The receiving end advertises its
+ * ring size to the transmitting end when it is started. It may be called either
+ * before or after starting the RTOS, but must be called before any of the
+ * stream functions are called with this stream.
+ *
+ * \param stream A pointer to the stream to start.
+ */
+void rtos_intertile_stream_start(
+        rtos_intertile_stream_t *stream);
+
+/**
+ * Initializes the transmit end of an intertile stream. This must be called
+ * simultaneously with rtos_intertile_stream_rx_init() on the tile that receives
+ * the stream. It may be called either before or after starting the RTOS, but must
+ * be called before calling rtos_intertile_stream_start().
+ *
+ * \param stream     A pointer to the stream to initialize.
+ * \param c          A channel end that is already allocated and connected to channel
+ *                   end on the receiving tile. This is only used to establish the
+ *                   stream's own streaming channel, and may be the same channel end
+ *                   used to initialize an intertile driver instance.
+ * \param frame_size The size in bytes of each frame. This must be a multiple of four
+ *                   and must be the same on both ends.
+ */
+void rtos_intertile_stream_tx_init(
+        rtos_intertile_stream_t *stream,
+        chanend_t c,
+        size_t frame_size);
+
+/**
+ * Initializes the receive end of an intertile stream. This must be called
+ * simultaneously with rtos_intertile_stream_tx_init() on the tile that transmits
+ * the stream. It may be called either before or after starting the RTOS, but must
+ * be called before calling rtos_intertile_stream_start().
+ *
+ * \param stream      A pointer to the stream to initialize.
+ * \param c           A channel end that is already allocated and connected to channel
+ *                    end on the transmitting tile.
+ * \param ring        The memory to use for the receive ring buffer. This must be word
+ *                    aligned, at least \p frame_size * \p frame_count bytes, and must
+ *                    have the same scope as \p stream.
+ * \param frame_size  The size in bytes of each frame. This must be a multiple of four
+ *                    and must be the same on both ends.
+ * \param frame_count The number of frames the ring buffer holds. This is the number of
+ *                    frames that the transmitting end may send before it must wait
+ *                    for one to be released. It must not be greater than
+ *                    RTOS_INTERTILE_STREAM_MAX_FRAMES.
+ */
+void rtos_intertile_stream_rx_init(
+        rtos_intertile_stream_t *stream,
+        chanend_t c,
+        void *ring,
+        size_t frame_size,
+        size_t frame_count);
+
+/**
+ * Deinitializes one end of an intertile stream, closing its streaming channel
+ * and freeing its channel end and RTOS objects. This must be called on both
+ * ends of the stream. The transmitting end must not be sending a frame, and
+ * the receiving end must have released all the frames it received. Credits
+ * and frames still on their way when the stream is closed are discarded.
+ *
+ * \param stream A pointer to the stream to deinitialize.
+ */
+void rtos_intertile_stream_deinit(
+        rtos_intertile_stream_t *stream);
+
 /**@}*/
 
 #endif /* RTOS_INTERTILE_H_ */
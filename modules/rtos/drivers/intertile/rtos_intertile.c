@@ -1,28 +1,284 @@
 // Copyright 2020-2021 XMOS LIMITED.
 // This Software is subject to the terms of the XMOS Public Licence: Version 1.
 
+#include <xcore/chanend.h>
 #include <xcore/triggerable.h>
 #include <xcore/assert.h>
 #include <xcore/interrupt.h>
+#include <xcore/hwtimer.h>
+#include <string.h>
 
 #include "rtos_interrupt.h"
 
 #include "rtos/drivers/intertile/api/rtos_intertile.h"
 
+static void tx_stats_update(
+        rtos_intertile_port_stats_t *stats,
+        uint32_t start_time)
+{
+    uint32_t blocked_ticks = get_reference_time() - start_time;
+
+    if (blocked_ticks > stats->tx_max_blocked_ticks) {
+        stats->tx_max_blocked_ticks = blocked_ticks;
+    }
+}
+
 DEFINE_RTOS_INTERRUPT_CALLBACK(rtos_intertile_isr, arg)
 {
-    rtos_intertile_t *ctx = arg;
+    rtos_intertile_link_t *link = arg;
+    rtos_intertile_t *ctx = link->ctx;
+    uint32_t start_time = get_reference_time();
+    uint32_t isr_ticks;
     uint8_t port;
+    uint8_t coalesced;
+    RTOS_INTERTILE_RX_NOTIFY_CALLBACK_ATTR rtos_intertile_rx_notify_cb_t notify;
+    void *notify_arg;
+    int state;
 
-    triggerable_disable_trigger(ctx->c);
+    triggerable_disable_trigger(link->c);
 
-    port = s_chan_in_byte(ctx->c);
+    port = s_chan_in_byte(link->c);
+    coalesced = (port & RTOS_INTERTILE_COALESCED_FLAG) != 0;
+    port &= ~RTOS_INTERTILE_COALESCED_FLAG;
+    xassert(port < RTOS_INTERTILE_MAX_PORTS);
+    ctx->rx_coalesced[port] = coalesced;
+
+    /* the receiving task must read the rest of the message from this link */
+    ctx->rx_link[port] = link - ctx->link;
 
     /* wake up the task waiting to receive on this port */
     if (rtos_osal_event_group_set_bits(&ctx->event_group, (1 << port)) != RTOS_OSAL_SUCCESS) {
         /* This shouldn't fail */
         xassert(0);
     }
+
+    /*
+     * When there is no callback yet, remember the message so that
+     * rtos_intertile_rx_notify_set() can report it.
+     */
+    state = rtos_osal_critical_enter();
+    {
+        notify = ctx->rx_notify[port];
+        notify_arg = ctx->rx_notify_arg[port];
+        if (notify == NULL) {
+            ctx->rx_unnotified_mask |= (1 << port);
+        }
+    }
+    rtos_osal_critical_exit(state);
+
+    if (notify != NULL) {
+        notify(ctx, port, notify_arg);
+    }
+
+    /*
+     * The whole handler is timed, including waking the receiving task and
+     * the notify callback. The receiving task may already have re-enabled
+     * this interrupt, so the counters are updated in a critical section.
+     */
+    isr_ticks = get_reference_time() - start_time;
+
+    state = rtos_osal_critical_enter();
+    {
+        link->stats.isr_count++;
+        link->stats.isr_total_ticks += isr_ticks;
+        if (isr_ticks > link->stats.isr_max_ticks) {
+            link->stats.isr_max_ticks = isr_ticks;
+        }
+    }
+    rtos_osal_critical_exit(state);
+}
+
+DEFINE_RTOS_INTERRUPT_CALLBACK(rtos_intertile_stream_rx_isr, arg)
+{
+    rtos_intertile_stream_t *stream = arg;
+    uint32_t *frame = (uint32_t *) (stream->ring + stream->wr_index * stream->frame_size);
+    const size_t frame_words = stream->frame_size / sizeof(uint32_t);
+    size_t words = frame_words - stream->wr_word;
+
+    if (stream->wr_word == 0 && chanend_test_control_token_next_byte(stream->c)) {
+        /* The transmitter is closing the stream. The token is left for rtos_intertile_stream_deinit(). */
+        triggerable_disable_trigger(stream->c);
+        return;
+    }
+
+    /*
+     * The transmitter only sends a frame when it holds a credit, so this
+     * slot is free and the rest of the frame is already on its way. At most
+     * RTOS_INTERTILE_STREAM_ISR_WORDS of it are read per interrupt. The
+     * interrupt fires again straight away for the rest, but other interrupts
+     * may be serviced in between.
+     */
+    if (words > RTOS_INTERTILE_STREAM_ISR_WORDS) {
+        words = RTOS_INTERTILE_STREAM_ISR_WORDS;
+    }
+
+    s_chan_in_buf_word(stream->c, frame + stream->wr_word, words);
+    stream->wr_word += words;
+
+    if (stream->wr_word < frame_words) {
+        return;
+    }
+    stream->wr_word = 0;
+
+    if (++stream->wr_index == stream->frame_count) {
+        stream->wr_index = 0;
+    }
+
+    rtos_osal_semaphore_put(&stream->frames);
+}
+
+DEFINE_RTOS_INTERRUPT_CALLBACK(rtos_intertile_stream_credit_isr, arg)
+{
+    rtos_intertile_stream_t *stream = arg;
+    uint32_t credits;
+
+    if (chanend_test_control_token_next_byte(stream->c)) {
+        /* The receiver is closing the stream. The token is left for rtos_intertile_stream_deinit(). */
+        triggerable_disable_trigger(stream->c);
+        return;
+    }
+
+    credits = s_chan_in_word(stream->c);
+
+    while (credits-- > 0) {
+        if (rtos_osal_semaphore_put(&stream->credits) != RTOS_OSAL_SUCCESS) {
+            /* The receiver advertised more credits than it has frames */
+            xassert(0);
+        }
+    }
+}
+
+/*
+ * Sends all of the messages waiting in a port's coalesce buffer. Must be
+ * called with both the port's link and its coalesce buffer locked.
+ */
+static void tx_batch_flush(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        rtos_intertile_link_t *link)
+{
+    rtos_intertile_coalesce_t *coalesce = ctx->tx_coalesce[port];
+
+    if (coalesce->count == 1) {
+        /* A lone message is sent just as it would be without coalescing */
+        s_chan_out_byte(link->c, port); //to the ISR
+        s_chan_out_word(link->c, coalesce->len - sizeof(uint32_t));
+        s_chan_out_buf_byte(link->c, coalesce->buf + sizeof(uint32_t), coalesce->len - sizeof(uint32_t));
+    } else if (coalesce->count > 1) {
+        s_chan_out_byte(link->c, port | RTOS_INTERTILE_COALESCED_FLAG); //to the ISR
+        s_chan_out_word(link->c, coalesce->len);
+        s_chan_out_buf_byte(link->c, coalesce->buf, coalesce->len);
+        ctx->port_stats[port].tx_coalesced += coalesce->count;
+    }
+
+    coalesce->len = 0;
+    coalesce->count = 0;
+}
+
+/*
+ * Copies a message into its port's coalesce buffer. Returns 0 when
+ * there is no room for it. When the port has a window, *flush is set
+ * when the buffer has reached its flush length.
+ */
+static int tx_batch_append(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        void *msg,
+        size_t len,
+        int *flush)
+{
+    rtos_intertile_coalesce_t *coalesce = ctx->tx_coalesce[port];
+    rtos_intertile_port_stats_t *stats = &ctx->port_stats[port];
+    uint32_t start_time = get_reference_time();
+    uint32_t msg_len = len;
+    int appended = 0;
+
+    *flush = 0;
+
+    rtos_osal_mutex_get(&coalesce->lock, RTOS_OSAL_WAIT_FOREVER);
+
+    if (coalesce->len + sizeof(msg_len) + len <= coalesce->size) {
+        memcpy(coalesce->buf + coalesce->len, &msg_len, sizeof(msg_len));
+        memcpy(coalesce->buf + coalesce->len + sizeof(msg_len), msg, len);
+        coalesce->len += sizeof(msg_len) + len;
+        coalesce->count++;
+
+        stats->tx_bytes += len;
+        stats->tx_messages++;
+        tx_stats_update(stats, start_time);
+        appended = 1;
+
+        if (coalesce->window > 0) {
+            if (coalesce->len >= coalesce->flush_len) {
+                *flush = 1;
+            } else if (coalesce->count == 1) {
+                /* Start the window. This fails harmlessly if it is already running. */
+                rtos_osal_semaphore_put(&coalesce->started);
+            }
+        }
+    }
+
+    rtos_osal_mutex_put(&coalesce->lock);
+
+    return appended;
+}
+
+/*
+ * Sends the messages that were coalesced while the link was held and then
+ * unlocks it.
+ */
+static void link_release(
+        rtos_intertile_t *ctx,
+        rtos_intertile_link_t *link)
+{
+    const int link_index = link - ctx->link;
+    int pending;
+
+    do {
+        pending = 0;
+
+        for (int port = 0; port < RTOS_INTERTILE_MAX_PORTS; port++) {
+            if ((ctx->tx_coalesce_mask & (1 << port)) && ctx->tx_link[port] == link_index) {
+                rtos_osal_mutex_get(&ctx->tx_coalesce[port]->lock, RTOS_OSAL_WAIT_FOREVER);
+                tx_batch_flush(ctx, port, link);
+                rtos_osal_mutex_put(&ctx->tx_coalesce[port]->lock);
+            }
+        }
+
+        rtos_osal_mutex_put(&link->lock);
+
+        /*
+         * A message appended after its buffer was flushed above, but by a
+         * thread that found the link still locked, must be sent by whoever
+         * gets the link next. If that is not already happening then it is
+         * up to this thread.
+         */
+        for (int port = 0; port < RTOS_INTERTILE_MAX_PORTS; port++) {
+            if ((ctx->tx_coalesce_mask & (1 << port)) && ctx->tx_link[port] == link_index) {
+                pending |= ctx->tx_coalesce[port]->count > 0;
+            }
+        }
+    } while (pending && rtos_osal_mutex_get(&link->lock, RTOS_OSAL_NO_WAIT) == RTOS_OSAL_SUCCESS);
+}
+
+/*
+ * Sends the messages waiting on a port with a window once the first of
+ * them has waited for it. Anything else waiting on the same link is sent
+ * along with them.
+ */
+static void tx_batch_flush_thread(
+        rtos_intertile_coalesce_t *coalesce)
+{
+    rtos_intertile_t *ctx = coalesce->ctx;
+
+    for (;;) {
+        rtos_osal_semaphore_get(&coalesce->started, RTOS_OSAL_WAIT_FOREVER);
+        rtos_osal_delay(coalesce->window);
+
+        rtos_intertile_link_t *link = &ctx->link[ctx->tx_link[coalesce->port]];
+        rtos_osal_mutex_get(&link->lock, RTOS_OSAL_PORT_WAIT_FOREVER);
+        link_release(ctx, link);
+    }
 }
 
 void rtos_intertile_tx_len(
@@ -30,10 +286,27 @@ void rtos_intertile_tx_len(
         uint8_t port,
         size_t len)
 {
-    rtos_osal_mutex_get(&ctx->lock, RTOS_OSAL_PORT_WAIT_FOREVER);
+    uint32_t start_time = get_reference_time();
+
+    rtos_osal_mutex_get(&ctx->link[0].lock, RTOS_OSAL_PORT_WAIT_FOREVER);
 
     xassert(ctx->tx_len == 0);
 
+    /* Partial transfers always use the first link */
+    xassert(ctx->tx_link[port] == 0);
+
+    if (ctx->tx_coalesce[port] != NULL && ctx->tx_link[port] == 0) {
+        /* Keep this message behind the ones already waiting on the same link */
+        rtos_osal_mutex_get(&ctx->tx_coalesce[port]->lock, RTOS_OSAL_WAIT_FOREVER);
+        tx_batch_flush(ctx, port, &ctx->link[0]);
+        rtos_osal_mutex_put(&ctx->tx_coalesce[port]->lock);
+    }
+
+    ctx->tx_port = port;
+    ctx->tx_start_time = start_time;
+    ctx->port_stats[port].tx_bytes += len;
+    ctx->port_stats[port].tx_messages++;
+
     ctx->tx_len = len;
     s_chan_out_byte(ctx->c, port); //to the ISR
     s_chan_out_word(ctx->c, len);
@@ -51,7 +324,8 @@ size_t rtos_intertile_tx_data(
     ctx->tx_len -= tx_len;
 
     if (ctx->tx_len == 0) {
-        rtos_osal_mutex_put(&ctx->lock);
+        tx_stats_update(&ctx->port_stats[ctx->tx_port], ctx->tx_start_time);
+        link_release(ctx, &ctx->link[0]);
     }
 
     return tx_len;
@@ -63,36 +337,209 @@ void rtos_intertile_tx(
         void *msg,
         size_t len)
 {
-    rtos_osal_mutex_get(&ctx->lock, RTOS_OSAL_PORT_WAIT_FOREVER);
+    rtos_intertile_link_t *link = &ctx->link[ctx->tx_link[port]];
+    rtos_intertile_port_stats_t *stats = &ctx->port_stats[port];
+    rtos_intertile_coalesce_t *coalesce = ctx->tx_coalesce[port];
+    uint32_t start_time = get_reference_time();
+    int flush;
 
-    s_chan_out_byte(ctx->c, port); //to the ISR
-    s_chan_out_word(ctx->c, len);
-    s_chan_out_buf_byte(ctx->c, msg, len);
+    if (coalesce == NULL) {
+        rtos_osal_mutex_get(&link->lock, RTOS_OSAL_PORT_WAIT_FOREVER);
+    } else if (coalesce->window > 0) {
+        /*
+         * The message is held back even though the link may be free. It is
+         * sent once the buffer reaches its flush length, the window expires,
+         * or another transfer on the link completes.
+         */
+        if (tx_batch_append(ctx, port, msg, len, &flush)) {
+            if (flush) {
+                rtos_osal_mutex_get(&link->lock, RTOS_OSAL_PORT_WAIT_FOREVER);
+                link_release(ctx, link);
+            }
+            return;
+        }
+
+        rtos_osal_mutex_get(&link->lock, RTOS_OSAL_PORT_WAIT_FOREVER);
+    } else if (rtos_osal_mutex_get(&link->lock, RTOS_OSAL_NO_WAIT) != RTOS_OSAL_SUCCESS) {
+        if (tx_batch_append(ctx, port, msg, len, &flush)) {
+            /*
+             * The thread holding the link sends it when it is done, unless
+             * it has released the link since it was found to be locked.
+             */
+            if (rtos_osal_mutex_get(&link->lock, RTOS_OSAL_NO_WAIT) == RTOS_OSAL_SUCCESS) {
+                link_release(ctx, link);
+            }
+            return;
+        }
+
+        rtos_osal_mutex_get(&link->lock, RTOS_OSAL_PORT_WAIT_FOREVER);
+    }
+
+    if (coalesce != NULL) {
+        /* Anything still waiting must go first */
+        rtos_osal_mutex_get(&coalesce->lock, RTOS_OSAL_WAIT_FOREVER);
+        tx_batch_flush(ctx, port, link);
+    }
+
+    s_chan_out_byte(link->c, port); //to the ISR
+    s_chan_out_word(link->c, len);
+    s_chan_out_buf_byte(link->c, msg, len);
+
+    stats->tx_bytes += len;
+    stats->tx_messages++;
+    tx_stats_update(stats, start_time);
+
+    if (coalesce != NULL) {
+        rtos_osal_mutex_put(&coalesce->lock);
+    }
 
-    rtos_osal_mutex_put(&ctx->lock);
+    link_release(ctx, link);
 }
 
-size_t rtos_intertile_rx_len(
+/*
+ * Waits for the next message on a port and reads its length. A coalesced
+ * transfer is read from its link in its entirety when it arrives, and its
+ * link's interrupt re-enabled, so that the link is not held while its
+ * messages are received. Each of its messages is then read from the port's
+ * batch buffer, in which case *c is set to 0. Otherwise the caller must read
+ * the message from the link *c. Either way it must be read with rx_read()
+ * and then rx_done() called.
+ */
+static rtos_osal_status_t rx_wait(
         rtos_intertile_t *ctx,
         uint8_t port,
-        unsigned timeout)
+        unsigned timeout,
+        size_t *len,
+        chanend_t *c)
 {
+    size_t *batch_len = &ctx->rx_batch_len[port];
     uint32_t flags;
-    rtos_osal_status_t status;
+    rtos_osal_status_t status = RTOS_OSAL_SUCCESS;
+
+    if (*batch_len == 0) {
+        status = rtos_osal_event_group_get_bits(&ctx->event_group,
+                            (1 << port),
+                            RTOS_OSAL_OR_CLEAR,
+                            &flags,
+                            timeout);
+
+        if (status == RTOS_OSAL_SUCCESS) {
+            int state = rtos_osal_critical_enter();
+            ctx->rx_unnotified_mask &= ~(1 << port);
+            rtos_osal_critical_exit(state);
 
-    xassert(ctx->rx_len == 0);
+            *c = ctx->link[ctx->rx_link[port]].c;
 
-    status = rtos_osal_event_group_get_bits(&ctx->event_group,
-                        (1 << port),
-                        RTOS_OSAL_OR_CLEAR,
-                        &flags,
-                        timeout);
+            if (ctx->rx_coalesced[port]) {
+                *batch_len = s_chan_in_word(*c);
+                ctx->rx_batch[port] = rtos_osal_malloc(*batch_len);
+                xassert(ctx->rx_batch[port] != NULL);
+                ctx->rx_batch_pos[port] = 0;
+
+                s_chan_in_buf_byte(*c, ctx->rx_batch[port], *batch_len);
+                triggerable_enable_trigger(*c);
+            }
+        }
+    }
 
     if (status == RTOS_OSAL_SUCCESS) {
-        ctx->rx_len = s_chan_in_word(ctx->c);
+        if (*batch_len > 0) {
+            uint32_t msg_len;
+
+            memcpy(&msg_len, ctx->rx_batch[port] + ctx->rx_batch_pos[port], sizeof(msg_len));
+            ctx->rx_batch_pos[port] += sizeof(msg_len);
+
+            xassert(*batch_len >= sizeof(msg_len) + msg_len);
+            *batch_len -= sizeof(msg_len) + msg_len;
+
+            *c = 0;
+            *len = msg_len;
+        } else {
+            *c = ctx->link[ctx->rx_link[port]].c;
+            *len = s_chan_in_word(*c);
+        }
+
+        ctx->port_stats[port].rx_bytes += *len;
+        ctx->port_stats[port].rx_messages++;
+    }
+
+    return status;
+}
+
+/*
+ * Reads part of a message returned by rx_wait(), from its link or from
+ * the port's batch buffer. The data is discarded when data is NULL.
+ */
+static void rx_read(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        chanend_t c,
+        void *data,
+        size_t len)
+{
+    if (c == 0) {
+        if (data != NULL) {
+            memcpy(data, ctx->rx_batch[port] + ctx->rx_batch_pos[port], len);
+        }
+        ctx->rx_batch_pos[port] += len;
+    } else if (data != NULL) {
+        s_chan_in_buf_byte(c, data, len);
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            (void) s_chan_in_byte(c);
+        }
+    }
+}
+
+/*
+ * Called once a message returned by rx_wait() has been read. The link's
+ * interrupt is re-enabled when the message was read from it, and the
+ * port's batch buffer is freed once its last message has been read.
+ */
+static void rx_done(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        chanend_t c)
+{
+    if (c != 0) {
+        triggerable_enable_trigger(c);
+    } else if (ctx->rx_batch_len[port] == 0) {
+        rtos_osal_free(ctx->rx_batch[port]);
+        ctx->rx_batch[port] = NULL;
+    }
+}
+
+size_t rtos_intertile_rx_len(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        unsigned timeout)
+{
+    size_t len = 0;
+    chanend_t c;
+
+    if (rx_wait(ctx, port, timeout, &len, &c) == RTOS_OSAL_SUCCESS) {
+        xassert(ctx->rx_len == 0);
+
+        /*
+         * Partial receives are only supported on the first link. Its
+         * interrupt stays disabled until the previous partial receive
+         * has read its entire message, so only one can be in progress.
+         * The messages of a coalesced transfer are not read from the
+         * link, so they cannot be received this way.
+         */
+        xassert(ctx->rx_link[port] == 0);
+        xassert(c != 0);
+
+        if (len > 0) {
+            ctx->rx_len = len;
+            ctx->rx_port = port;
+        } else {
+            /* There is no data to follow */
+            rx_done(ctx, port, c);
+        }
     }
 
-    return ctx->rx_len;
+    return len;
 }
 
 size_t rtos_intertile_rx_data(
@@ -107,7 +554,7 @@ size_t rtos_intertile_rx_data(
     ctx->rx_len -= rx_len;
 
     if (ctx->rx_len == 0) {
-        triggerable_enable_trigger(ctx->c);
+        rx_done(ctx, ctx->rx_port, ctx->c);
     }
 
     return rx_len;
@@ -119,38 +566,320 @@ size_t rtos_intertile_rx(
         void **msg,
         unsigned timeout)
 {
-    uint32_t len = 0;
-    uint32_t flags;
-    rtos_osal_status_t status;
+    size_t len = 0;
+    chanend_t c;
 
     *msg = NULL;
 
-    status = rtos_osal_event_group_get_bits(&ctx->event_group,
-                        (1 << port),
-                        RTOS_OSAL_OR_CLEAR,
-                        &flags,
-                        timeout);
+    if (rx_wait(ctx, port, timeout, &len, &c) == RTOS_OSAL_SUCCESS) {
+        *msg = rtos_osal_malloc(len);
+        xassert(*msg != NULL);
+
+        rx_read(ctx, port, c, *msg, len);
+        rx_done(ctx, port, c);
+    }
 
-    if (status == RTOS_OSAL_SUCCESS) {
+    return len;
+}
+
+int32_t rtos_intertile_rx_buf(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        void *buf,
+        size_t len,
+        unsigned timeout)
+{
+    size_t msg_len = 0;
+    chanend_t c;
 
-        len = s_chan_in_word(ctx->c);
+    if (rx_wait(ctx, port, timeout, &msg_len, &c) != RTOS_OSAL_SUCCESS) {
+        return RTOS_INTERTILE_RX_TIMEOUT;
+    }
 
-        *msg = rtos_osal_malloc(len);
-        xassert(*msg != NULL);
+    rx_read(ctx, port, c, buf, msg_len <= len ? msg_len : len);
+
+    /* Discard whatever did not fit into the caller's buffer */
+    if (msg_len > len) {
+        rx_read(ctx, port, c, NULL, msg_len - len);
+    }
+
+    rx_done(ctx, port, c);
+
+    return msg_len <= len ? (int32_t) msg_len : RTOS_INTERTILE_RX_TRUNCATED;
+}
+
+int32_t rtos_intertile_rx_pool(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        rtos_intertile_pool_t *pool,
+        void **msg,
+        unsigned timeout)
+{
+    int32_t len;
+    void *block;
+
+    *msg = NULL;
 
-        s_chan_in_buf_byte(ctx->c, *msg, len);
+    if (rtos_osal_queue_receive(&pool->free_blocks, &block, timeout) != RTOS_OSAL_SUCCESS) {
+        return RTOS_INTERTILE_RX_TIMEOUT;
+    }
+
+    len = rtos_intertile_rx_buf(ctx, port, block, pool->block_size, timeout);
 
-        triggerable_enable_trigger(ctx->c);
+    if (len != RTOS_INTERTILE_RX_TIMEOUT) {
+        *msg = block;
+    } else {
+        rtos_intertile_pool_free(pool, block);
     }
 
     return len;
 }
 
+void rtos_intertile_pool_free(
+        rtos_intertile_pool_t *pool,
+        void *msg)
+{
+    if (msg != NULL) {
+        rtos_osal_queue_send(&pool->free_blocks, &msg, RTOS_OSAL_WAIT_FOREVER);
+    }
+}
+
+void rtos_intertile_pool_init(
+        rtos_intertile_pool_t *pool,
+        void *mem,
+        size_t block_size,
+        size_t block_count)
+{
+    uint8_t *block = mem;
+
+    xassert(block_size > 0 && block_count > 0);
+
+    pool->block_size = block_size;
+    rtos_osal_queue_create(&pool->free_blocks, "intertile_pool", block_count, sizeof(void *));
+
+    for (size_t i = 0; i < block_count; i++) {
+        rtos_intertile_pool_free(pool, block);
+        block += block_size;
+    }
+}
+
+void rtos_intertile_pool_deinit(
+        rtos_intertile_pool_t *pool)
+{
+    rtos_osal_queue_delete(&pool->free_blocks);
+}
+
+size_t rtos_intertile_stream_tx(
+        rtos_intertile_stream_t *stream,
+        const void *frame,
+        unsigned timeout)
+{
+    if (rtos_osal_semaphore_get(&stream->credits, timeout) != RTOS_OSAL_SUCCESS) {
+        return 0;
+    }
+
+    rtos_osal_mutex_get(&stream->lock, RTOS_OSAL_WAIT_FOREVER);
+    s_chan_out_buf_word(stream->c, frame, stream->frame_size / sizeof(uint32_t));
+    rtos_osal_mutex_put(&stream->lock);
+
+    return stream->frame_size;
+}
+
+size_t rtos_intertile_stream_rx(
+        rtos_intertile_stream_t *stream,
+        void **frame,
+        unsigned timeout)
+{
+    *frame = NULL;
+
+    if (rtos_osal_semaphore_get(&stream->frames, timeout) != RTOS_OSAL_SUCCESS) {
+        return 0;
+    }
+
+    *frame = stream->ring + stream->rd_index * stream->frame_size;
+
+    return stream->frame_size;
+}
+
+void rtos_intertile_stream_rx_release(
+        rtos_intertile_stream_t *stream)
+{
+    if (++stream->rd_index == stream->frame_count) {
+        stream->rd_index = 0;
+    }
+
+    /* Return the slot's credit to the transmitter */
+    s_chan_out_word(stream->c, 1);
+}
+
+void rtos_intertile_port_stats_get(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        rtos_intertile_port_stats_t *stats)
+{
+    xassert(port < RTOS_INTERTILE_MAX_PORTS);
+
+    *stats = ctx->port_stats[port];
+}
+
+void rtos_intertile_link_stats_get(
+        rtos_intertile_t *ctx,
+        int link,
+        rtos_intertile_link_stats_t *stats)
+{
+    xassert(link >= 0 && link < ctx->link_count);
+
+    *stats = ctx->link[link].stats;
+}
+
+void rtos_intertile_stats_clear(
+        rtos_intertile_t *ctx)
+{
+    memset(ctx->port_stats, 0, sizeof(ctx->port_stats));
+
+    for (int i = 0; i < ctx->link_count; i++) {
+        memset(&ctx->link[i].stats, 0, sizeof(ctx->link[i].stats));
+    }
+}
+
+void rtos_intertile_rx_notify_set(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        rtos_intertile_rx_notify_cb_t cb,
+        void *arg)
+{
+    RTOS_INTERTILE_RX_NOTIFY_CALLBACK_ATTR rtos_intertile_rx_notify_cb_t notify = NULL;
+
+    xassert(port < RTOS_INTERTILE_MAX_PORTS);
+
+    int state = rtos_osal_critical_enter();
+    {
+        ctx->rx_notify[port] = cb;
+        ctx->rx_notify_arg[port] = arg;
+
+        /* Report a message that arrived before there was a callback to tell */
+        if (cb != NULL && (ctx->rx_unnotified_mask & (1 << port)) != 0) {
+            ctx->rx_unnotified_mask &= ~(1 << port);
+            notify = ctx->rx_notify[port];
+        }
+    }
+    rtos_osal_critical_exit(state);
+
+    if (notify != NULL) {
+        notify(ctx, port, arg);
+    }
+}
+
+int rtos_intertile_rx_pending(
+        rtos_intertile_t *ctx,
+        uint8_t port)
+{
+    xassert(port < RTOS_INTERTILE_MAX_PORTS);
+
+    return ctx->rx_batch_len[port] > 0;
+}
+
+void rtos_intertile_port_coalesce_set(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        rtos_intertile_coalesce_t *coalesce,
+        void *buf,
+        size_t size)
+{
+    xassert(port < RTOS_INTERTILE_MAX_PORTS);
+
+    if (coalesce != NULL) {
+        xassert(buf != NULL && size > sizeof(uint32_t));
+
+        coalesce->buf = buf;
+        coalesce->size = size;
+        coalesce->len = 0;
+        coalesce->count = 0;
+        coalesce->ctx = ctx;
+        coalesce->port = port;
+        coalesce->window = 0;
+        rtos_osal_mutex_create(&coalesce->lock, "intertile_coalesce_mutex", RTOS_OSAL_NOT_RECURSIVE);
+
+        ctx->tx_coalesce[port] = coalesce;
+        ctx->tx_coalesce_mask |= (1 << port);
+    } else if (ctx->tx_coalesce[port] != NULL) {
+        rtos_intertile_link_t *link = &ctx->link[ctx->tx_link[port]];
+
+        coalesce = ctx->tx_coalesce[port];
+
+        /* Send anything still waiting before coalescing stops */
+        rtos_osal_mutex_get(&link->lock, RTOS_OSAL_WAIT_FOREVER);
+        rtos_osal_mutex_get(&coalesce->lock, RTOS_OSAL_WAIT_FOREVER);
+        tx_batch_flush(ctx, port, link);
+        ctx->tx_coalesce_mask &= ~(1 << port);
+        ctx->tx_coalesce[port] = NULL;
+
+        /* The flush thread cannot be holding either lock */
+        if (coalesce->window > 0) {
+            rtos_osal_thread_delete(&coalesce->flush_thread);
+            rtos_osal_semaphore_delete(&coalesce->started);
+        }
+
+        rtos_osal_mutex_put(&coalesce->lock);
+        link_release(ctx, link);
+
+        rtos_osal_mutex_delete(&coalesce->lock);
+    }
+}
+
+void rtos_intertile_port_coalesce_window_set(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        size_t flush_len,
+        unsigned window,
+        unsigned priority)
+{
+    rtos_intertile_coalesce_t *coalesce;
+
+    xassert(port < RTOS_INTERTILE_MAX_PORTS);
+    coalesce = ctx->tx_coalesce[port];
+    xassert(coalesce != NULL && coalesce->window == 0);
+    xassert(window > 0);
+
+    rtos_osal_semaphore_create(&coalesce->started, "intertile_coalesce_window", 1, 0);
+
+    rtos_osal_mutex_get(&coalesce->lock, RTOS_OSAL_WAIT_FOREVER);
+    coalesce->flush_len = flush_len;
+    coalesce->window = window;
+    rtos_osal_mutex_put(&coalesce->lock);
+
+    rtos_osal_thread_create(
+            &coalesce->flush_thread,
+            "intertile_coalesce_flush",
+            (rtos_osal_entry_function_t) tx_batch_flush_thread,
+            coalesce,
+            RTOS_THREAD_STACK_SIZE(tx_batch_flush_thread),
+            priority);
+}
+
+void rtos_intertile_port_priority_set(
+        rtos_intertile_t *ctx,
+        uint8_t port,
+        unsigned priority)
+{
+    xassert(port < RTOS_INTERTILE_MAX_PORTS);
+
+    if (priority >= (unsigned) ctx->link_count) {
+        priority = ctx->link_count - 1;
+    }
+
+    ctx->tx_link[port] = priority;
+}
+
 void rtos_intertile_start(
         rtos_intertile_t *intertile_ctx)
 {
-    triggerable_setup_interrupt_callback(intertile_ctx->c, intertile_ctx, RTOS_INTERRUPT_CALLBACK(rtos_intertile_isr));
-    triggerable_enable_trigger(intertile_ctx->c);
+    for (int i = 0; i < intertile_ctx->link_count; i++) {
+        rtos_intertile_link_t *link = &intertile_ctx->link[i];
+
+        triggerable_setup_interrupt_callback(link->c, link, RTOS_INTERRUPT_CALLBACK(rtos_intertile_isr));
+        triggerable_enable_trigger(link->c);
+    }
 }
 
 static chanend_t channel_establish(
@@ -174,13 +903,122 @@ static chanend_t channel_establish(
     return local_c;
 }
 
-void rtos_intertile_init(
+void rtos_intertile_stream_start(
+        rtos_intertile_stream_t *stream)
+{
+    if (stream->ring != NULL) {
+        triggerable_setup_interrupt_callback(stream->c, stream, RTOS_INTERRUPT_CALLBACK(rtos_intertile_stream_rx_isr));
+        triggerable_enable_trigger(stream->c);
+
+        /* Advertise the entire ring to the transmitter */
+        s_chan_out_word(stream->c, stream->frame_count);
+    } else {
+        triggerable_setup_interrupt_callback(stream->c, stream, RTOS_INTERRUPT_CALLBACK(rtos_intertile_stream_credit_isr));
+        triggerable_enable_trigger(stream->c);
+    }
+}
+
+void rtos_intertile_stream_tx_init(
+        rtos_intertile_stream_t *stream,
+        chanend_t c,
+        size_t frame_size)
+{
+    xassert(frame_size > 0 && frame_size % sizeof(uint32_t) == 0);
+
+    stream->c = channel_establish(c);
+    stream->frame_size = frame_size;
+    stream->ring = NULL;
+    stream->frame_count = 0;
+
+    rtos_osal_mutex_create(&stream->lock, "intertile_stream_mutex", RTOS_OSAL_NOT_RECURSIVE);
+    rtos_osal_semaphore_create(&stream->credits, "intertile_stream_credits", RTOS_INTERTILE_STREAM_MAX_FRAMES, 0);
+}
+
+void rtos_intertile_stream_rx_init(
+        rtos_intertile_stream_t *stream,
+        chanend_t c,
+        void *ring,
+        size_t frame_size,
+        size_t frame_count)
+{
+    xassert(ring != NULL);
+    xassert(frame_size > 0 && frame_size % sizeof(uint32_t) == 0);
+    xassert(frame_count > 0 && frame_count <= RTOS_INTERTILE_STREAM_MAX_FRAMES);
+
+    stream->c = channel_establish(c);
+    stream->frame_size = frame_size;
+    stream->ring = ring;
+    stream->frame_count = frame_count;
+    stream->wr_index = 0;
+    stream->wr_word = 0;
+    stream->rd_index = 0;
+
+    rtos_osal_semaphore_create(&stream->frames, "intertile_stream_frames", frame_count, 0);
+}
+
+void rtos_intertile_stream_deinit(
+        rtos_intertile_stream_t *stream)
+{
+    triggerable_disable_trigger(stream->c);
+
+    /*
+     * Close the channel. Anything else still on its way from the other end,
+     * such as credits for frames it released, is discarded.
+     */
+    chanend_out_control_token(stream->c, XS1_CT_END);
+    while (!chanend_test_control_token_next_byte(stream->c)) {
+        (void) chanend_in_byte(stream->c);
+    }
+    chanend_check_control_token(stream->c, XS1_CT_END);
+    chanend_free(stream->c);
+
+    if (stream->ring != NULL) {
+        rtos_osal_semaphore_delete(&stream->frames);
+    } else {
+        rtos_osal_semaphore_delete(&stream->credits);
+        rtos_osal_mutex_delete(&stream->lock);
+    }
+}
+
+void rtos_intertile_multi_link_init(
         rtos_intertile_t *intertile_ctx,
-        chanend_t c)
+        chanend_t c,
+        int link_count)
 {
-    intertile_ctx->c = channel_establish(c);
+    xassert(link_count >= 1 && link_count <= RTOS_INTERTILE_MAX_LINKS);
+
+    for (int i = 0; i < link_count; i++) {
+        rtos_intertile_link_t *link = &intertile_ctx->link[i];
+
+        link->ctx = intertile_ctx;
+        link->c = channel_establish(c);
+        rtos_osal_mutex_create(&link->lock, "intertile_mutex", RTOS_OSAL_NOT_RECURSIVE);
+        memset(&link->stats, 0, sizeof(link->stats));
+    }
+
+    /* The first link is also used directly for handshakes during RPC initialization */
+    intertile_ctx->c = intertile_ctx->link[0].c;
+    intertile_ctx->link_count = link_count;
     intertile_ctx->tx_len = 0;
     intertile_ctx->rx_len = 0;
-    rtos_osal_mutex_create(&intertile_ctx->lock, "intertile_mutex", RTOS_OSAL_NOT_RECURSIVE);
+    memset(intertile_ctx->tx_link, 0, sizeof(intertile_ctx->tx_link));
+    memset(intertile_ctx->rx_link, 0, sizeof(intertile_ctx->rx_link));
+    memset(intertile_ctx->port_stats, 0, sizeof(intertile_ctx->port_stats));
+    memset(intertile_ctx->rx_notify, 0, sizeof(intertile_ctx->rx_notify));
+    memset(intertile_ctx->rx_notify_arg, 0, sizeof(intertile_ctx->rx_notify_arg));
+    intertile_ctx->rx_unnotified_mask = 0;
+    intertile_ctx->tx_coalesce_mask = 0;
+    memset(intertile_ctx->tx_coalesce, 0, sizeof(intertile_ctx->tx_coalesce));
+    memset(intertile_ctx->rx_coalesced, 0, sizeof(intertile_ctx->rx_coalesced));
+    memset(intertile_ctx->rx_batch, 0, sizeof(intertile_ctx->rx_batch));
+    memset(intertile_ctx->rx_batch_pos, 0, sizeof(intertile_ctx->rx_batch_pos));
+    memset(intertile_ctx->rx_batch_len, 0, sizeof(intertile_ctx->rx_batch_len));
     rtos_osal_event_group_create(&intertile_ctx->event_group, "intertile_group");
 }
+
+void rtos_intertile_init(
+        rtos_intertile_t *intertile_ctx,
+        chanend_t c)
+{
+    rtos_intertile_multi_link_init(intertile_ctx, c, 1);
+}
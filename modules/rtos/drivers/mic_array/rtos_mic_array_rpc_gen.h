@@ -0,0 +1,111 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Generated by tools/rpc_gen/rpc_gen.py from rtos_mic_array_rpc.idl. Do not edit.
+ *
+ * This is included by the driver's RPC source file, and provides the static
+ * client stub mic_array_remote_<function>() for each function, and the host
+ * dispatch function mic_array_rpc_dispatch().
+ */
+
+#ifndef RTOS_MIC_ARRAY_RPC_GEN_H_
+#define RTOS_MIC_ARRAY_RPC_GEN_H_
+
+#include "rtos/drivers/rpc/api/rtos_rpc.h"
+#include "rtos/drivers/mic_array/api/rtos_mic_array.h"
+
+enum {
+    fcode_rx,
+};
+
+/*
+ * Fixed parts of the rtos_mic_array_rx() request and response messages.
+ */
+typedef struct {
+    rpc_fixed_request_hdr_t hdr;
+    rtos_mic_array_t *ctx;
+    size_t frame_count;
+    unsigned timeout;
+} mic_array_rx_req_t;
+
+typedef struct {
+    int fcode;
+    size_t ret;
+} mic_array_rx_resp_t;
+
+__attribute__((fptrgroup("rtos_mic_array_rx_fptr_grp")))
+static size_t mic_array_remote_rx(
+        rtos_mic_array_t *ctx,
+        int32_t (*sample_buf)[MIC_DUAL_NUM_CHANNELS + MIC_DUAL_NUM_REF_CHANNELS],
+        size_t frame_count,
+        unsigned timeout)
+{
+    rtos_intertile_address_t *host_address = &ctx->rpc_config->host_address;
+    rtos_intertile_t *intertile_ctx = host_address->intertile_ctx;
+    const size_t sample_buf_len = sizeof(sample_buf[0]) * (frame_count);
+    mic_array_rx_req_t req;
+    mic_array_rx_resp_t resp;
+    size_t msg_length;
+
+    xassert(host_address->port >= 0);
+
+    req.hdr.fcode = fcode_rx;
+    req.hdr.param_count = 0;
+    req.ctx = ctx->rpc_config->host_ctx_ptr;
+    req.frame_count = frame_count;
+    req.timeout = timeout;
+
+    rtos_intertile_tx_len(intertile_ctx, host_address->port, sizeof(req));
+    rtos_intertile_tx_data(intertile_ctx, &req, sizeof(req));
+
+    msg_length = rtos_intertile_rx_len(intertile_ctx, host_address->port, RTOS_OSAL_WAIT_FOREVER);
+    xassert(msg_length == sizeof(resp) + sample_buf_len);
+    rtos_intertile_rx_data(intertile_ctx, &resp, sizeof(resp));
+    if (sample_buf_len > 0) {
+        rtos_intertile_rx_data(intertile_ctx, sample_buf, sample_buf_len);
+    }
+
+    xassert(resp.fcode == fcode_rx);
+
+    return resp.ret;
+}
+
+static void mic_array_rx_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
+{
+    mic_array_rx_req_t *req = rpc_msg->msg_buf;
+    rtos_mic_array_t *ctx = req->ctx;
+    size_t frame_count = req->frame_count;
+    unsigned timeout = req->timeout;
+    int32_t (*sample_buf)[MIC_DUAL_NUM_CHANNELS + MIC_DUAL_NUM_REF_CHANNELS];
+    const size_t sample_buf_len = sizeof(sample_buf[0]) * (frame_count);
+    mic_array_rx_resp_t resp;
+
+    /* Output only buffers are allocated here, as the caller would have */
+    sample_buf = rtos_osal_malloc(sample_buf_len);
+
+    resp.ret = rtos_mic_array_rx(ctx, sample_buf, frame_count, timeout);
+    resp.fcode = req->hdr.fcode;
+
+    /* send RPC response message to client */
+    rtos_intertile_tx_len(client_address->intertile_ctx, client_address->port, sizeof(resp) + sample_buf_len);
+    rtos_intertile_tx_data(client_address->intertile_ctx, &resp, sizeof(resp));
+    if (sample_buf_len > 0) {
+        rtos_intertile_tx_data(client_address->intertile_ctx, sample_buf, sample_buf_len);
+    }
+    rtos_osal_free(sample_buf);
+}
+
+RPC_HOST_DISPATCH_ATTR
+static void mic_array_rpc_dispatch(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
+{
+    switch (rpc_msg->fcode) {
+    case fcode_rx:
+        mic_array_rx_rpc_host(client_address, rpc_msg);
+        break;
+    default:
+        xassert(0);
+    }
+}
+
+#endif /* RTOS_MIC_ARRAY_RPC_GEN_H_ */
@@ -15,14 +15,179 @@
 
 #include "rtos/osal/api/rtos_osal.h"
 #include "rtos/drivers/rpc/api/rtos_driver_rpc.h"
+#include "rtos/drivers/rpc/api/rtos_rpc.h"
 
+/**
+ * When nonzero, rtos_qspi_flash_read_isr() may be used to read the flash from
+ * interrupt handlers. This uses a hardware lock, which is taken around each
+ * command that the driver's thread sends to the flash.
+ */
+#ifndef RTOS_QSPI_FLASH_ISR_READ
+#define RTOS_QSPI_FLASH_ISR_READ 0
+#endif
+
+#if RTOS_QSPI_FLASH_ISR_READ
+#include <xcore/lock.h>
+#endif
+
+/**
+ * The maximum number of bytes read from the flash by a single read command.
+ * Interrupts on the core running the driver's thread are masked while each
+ * read command is performed, so this bounds the interrupt latency that
+ * flash reads add on that core. Longer reads are split into multiple read
+ * commands, each of which costs about as much time as reading ten more
+ * bytes. With a 25 MHz QSPI clock each kilobyte takes about 80
+ * microseconds to read.
+ *
+ * When RTOS_QSPI_FLASH_ISR_READ is enabled, an interrupt handler that reads
+ * the flash may spin for a whole read command, so this defaults to 1024 and
+ * may not be set any larger.
+ */
+#ifndef RTOS_QSPI_FLASH_READ_CHUNK_SIZE
+#if RTOS_QSPI_FLASH_ISR_READ
+#define RTOS_QSPI_FLASH_READ_CHUNK_SIZE 1024
+#else
 #define RTOS_QSPI_FLASH_READ_CHUNK_SIZE (24*1024)
+#endif
+#endif
+
+#if RTOS_QSPI_FLASH_ISR_READ && RTOS_QSPI_FLASH_READ_CHUNK_SIZE > 1024
+#error RTOS_QSPI_FLASH_READ_CHUNK_SIZE must not be more than 1024 when RTOS_QSPI_FLASH_ISR_READ is enabled
+#endif
+
+/**
+ * When nonzero, and the flash supports it, the flash is left in XIP
+ * (continuous read) mode after each read. Reads that follow then skip the
+ * read command, saving eight QSPI clocks each, until the flash is next
+ * programmed or erased. This matters most for long sequential reads made
+ * in many small pieces. The flash is taken out of XIP mode whenever the
+ * driver has no more operations queued, and after each read made from an
+ * interrupt handler, so that the boot ROM can read it after a reset.
+ */
+#ifndef RTOS_QSPI_FLASH_XIP
+#define RTOS_QSPI_FLASH_XIP 0
+#endif
+
+/**
+ * The number of lines in the read cache of a QSPI flash driver instance.
+ * Set this to 0 to disable the cache.
+ */
+#ifndef RTOS_QSPI_FLASH_CACHE_LINES
+#define RTOS_QSPI_FLASH_CACHE_LINES 0
+#endif
+
+/**
+ * The size in bytes of each line in the read cache. This must be a power of two.
+ */
+#ifndef RTOS_QSPI_FLASH_CACHE_LINE_SIZE
+#define RTOS_QSPI_FLASH_CACHE_LINE_SIZE 4096
+#endif
+
+/**
+ * The maximum number of operations that may be queued on a QSPI flash driver
+ * instance at once. Submitting an operation blocks while the queue is full.
+ * This may not be more than 24.
+ */
+#ifndef RTOS_QSPI_FLASH_OP_QUEUE_LEN
+#define RTOS_QSPI_FLASH_OP_QUEUE_LEN 8
+#endif
+
+/**
+ * When nonzero, sectors given to rtos_qspi_flash_trim() are erased in the
+ * background, and erases of sectors that are already known to be erased are
+ * skipped. This costs two bits of RAM for each sector of the flash.
+ */
+#ifndef RTOS_QSPI_FLASH_PRE_ERASE
+#define RTOS_QSPI_FLASH_PRE_ERASE 0
+#endif
+
+/**
+ * The priority of the thread that erases trimmed sectors in the background.
+ * Its erases are queued behind all operations submitted by higher priority
+ * threads.
+ */
+#ifndef RTOS_QSPI_FLASH_PRE_ERASE_TASK_PRIORITY
+#define RTOS_QSPI_FLASH_PRE_ERASE_TASK_PRIORITY 1
+#endif
+
+/*
+ * The largest read made in a single call from an RPC client tile. The host
+ * holds the intertile link while it streams the response, so this bounds
+ * how long other ports wait for the link. It must be less than the 16 MB
+ * that the 24 bit RPC parameter length field can describe.
+ */
+#ifndef QSPI_FLASH_RPC_READ_MAX
+#define QSPI_FLASH_RPC_READ_MAX (16 * 1024)
+#endif
 
 /**
  * Typedef to the RTOS QSPI flash driver instance struct.
  */
 typedef struct rtos_qspi_flash_struct rtos_qspi_flash_t;
 
+/**
+ * The types of operation that may be queued on a QSPI flash driver instance.
+ */
+typedef enum {
+    rtos_qspi_flash_op_read,
+    rtos_qspi_flash_op_write,
+    rtos_qspi_flash_op_erase,
+} rtos_qspi_flash_op_type_t;
+
+/**
+ * Typedef to the struct holding an asynchronous QSPI flash operation.
+ */
+typedef struct rtos_qspi_flash_op_struct rtos_qspi_flash_op_t;
+
+/**
+ * Function pointer type for functions that are called when an asynchronous
+ * QSPI flash operation completes. They are called from the driver's thread,
+ * so should not block. The operation struct may be reused or freed by the
+ * callback.
+ *
+ * \param ctx A pointer to the QSPI flash driver instance that performed the operation.
+ * \param op  A pointer to the operation that completed.
+ * \param arg The argument given when the operation was submitted.
+ */
+typedef void (*rtos_qspi_flash_op_cb_t)(rtos_qspi_flash_t *ctx, rtos_qspi_flash_op_t *op, void *arg);
+
+/**
+ * This attribute must be specified on all QSPI flash operation completion
+ * callback functions provided by the application.
+ */
+#define RTOS_QSPI_FLASH_OP_CALLBACK_ATTR __attribute__((fptrgroup("rtos_qspi_flash_op_cb_fptr_grp")))
+
+/**
+ * Struct holding an asynchronous QSPI flash operation. It is filled in by
+ * the function that submits it and must remain valid until it completes.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rtos_qspi_flash_op_struct {
+    rtos_qspi_flash_op_type_t type;
+    uint8_t *data;
+    unsigned address;
+    size_t len;
+    unsigned priority;
+    RTOS_QSPI_FLASH_OP_CALLBACK_ATTR rtos_qspi_flash_op_cb_t cb;
+    void *arg;
+    int slot;
+    rtos_qspi_flash_op_t *next;
+    rpc_call_t rpc_call;
+};
+
+/**
+ * Struct holding a single line of the read cache of a QSPI flash driver
+ * instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    unsigned address;
+    uint32_t last_used;
+    uint8_t *data;
+} rtos_qspi_flash_cache_line_t;
+
 /**
  * Struct representing an RTOS QSPI flash driver instance.
  *
@@ -46,14 +211,51 @@ struct rtos_qspi_flash_struct {
     __attribute__((fptrgroup("rtos_qspi_flash_unlock_fptr_grp")))
     void (*unlock)(rtos_qspi_flash_t *);
 
+    __attribute__((fptrgroup("rtos_qspi_flash_submit_fptr_grp")))
+    void (*submit)(rtos_qspi_flash_t *, rtos_qspi_flash_op_t *);
+
+    __attribute__((fptrgroup("rtos_qspi_flash_op_wait_fptr_grp")))
+    rtos_osal_status_t (*op_wait)(rtos_qspi_flash_t *, rtos_qspi_flash_op_t *, unsigned);
+
+    __attribute__((fptrgroup("rtos_qspi_flash_trim_fptr_grp")))
+    void (*trim)(rtos_qspi_flash_t *, unsigned, size_t);
+
     qspi_flash_ctx_t ctx;
     size_t flash_size;
 
     unsigned op_task_priority;
     rtos_osal_thread_t op_task;
-    rtos_osal_queue_t op_queue;
-    rtos_osal_semaphore_t data_ready;
+    rtos_qspi_flash_op_t *op_head;
+    uint32_t op_free_slots;
+    int op_reserved_slot;
+    rtos_osal_semaphore_t op_pending;
+    rtos_osal_semaphore_t op_slots;
+    rtos_osal_event_group_t op_done;
     rtos_osal_mutex_t mutex;
+    rpc_client_t rpc_client;
+
+#if RTOS_QSPI_FLASH_XIP
+    bool xip_active;
+#endif
+
+#if RTOS_QSPI_FLASH_ISR_READ
+    lock_t isr_lock;
+    volatile bool isr_read_blocked;
+#endif
+
+#if RTOS_QSPI_FLASH_CACHE_LINES > 0
+    rtos_qspi_flash_cache_line_t cache[RTOS_QSPI_FLASH_CACHE_LINES];
+    uint32_t cache_clock;
+    unsigned cache_fill_address;
+#endif
+
+#if RTOS_QSPI_FLASH_PRE_ERASE
+    uint32_t *erased_map;
+    uint32_t *trim_map;
+    size_t sector_count;
+    rtos_osal_semaphore_t trim_request;
+    rtos_osal_thread_t pre_erase_task;
+#endif
 };
 
 #include "rtos/drivers/qspi_flash/api/rtos_qspi_flash_rpc.h"
@@ -78,6 +280,10 @@ struct rtos_qspi_flash_struct {
  * obtains and releases the lock automatically so that they cannot run while another
  * thread has the lock.
  *
+ * Asynchronous operations also wait for the lock, except when they are
+ * submitted from a completion callback, so that a thread that holds the
+ * lock may wait for an operation whose callback submits another.
+ *
  * The lock MUST be released when it is no longer needed by calling
  * rtos_qspi_flash_unlock().
  *
@@ -105,6 +311,13 @@ inline void rtos_qspi_flash_unlock(
  * This reads data from the flash in quad I/O mode. All four lines are
  * used to send the address and to read the data.
  *
+ * When RTOS_QSPI_FLASH_CACHE_LINES is greater than 0, reads on the tile that
+ * owns the driver instance are served from a read cache of that many lines of
+ * RTOS_QSPI_FLASH_CACHE_LINE_SIZE bytes. Lines are replaced least recently used
+ * first, and are invalidated by writes and erases that overlap them. Reads
+ * larger than half of the cache bypass it, so that they do not evict everything
+ * else from it.
+ *
  * \param ctx     A pointer to the QSPI flash driver instance to use.
  * \param data    Pointer to the buffer to save the read data to.
  * \param address The byte address in the flash to begin reading at.
@@ -168,6 +381,10 @@ inline void rtos_qspi_flash_write(
  * This function may return before the write operation is complete, as the actual
  * erase operation is queued and executed by a thread created by the driver.
  *
+ * When RTOS_QSPI_FLASH_PRE_ERASE is enabled, erase commands are not sent for
+ * sectors that the driver knows have not been written since they were last
+ * erased.
+ *
  * \note The smallest amount of data that can be erased is a 4k sector.
  * This means that data outside the address range specified by \p address
  * and \p len will be erased if the address range does not both begin and
@@ -189,6 +406,165 @@ inline void rtos_qspi_flash_erase(
     ctx->erase(ctx, address, len);
 }
 
+/**
+ * Informs the driver that the data in a range of the flash is no longer
+ * needed. The sectors that lie entirely within the range are erased in the
+ * background when RTOS_QSPI_FLASH_PRE_ERASE is enabled, so that a later
+ * erase of them may be skipped and writing them does not wait for the erase.
+ * A sector that is written or erased before the background erase reaches it
+ * is no longer considered trimmed.
+ *
+ * This does nothing when RTOS_QSPI_FLASH_PRE_ERASE is not enabled, or when
+ * called from an RPC client tile.
+ *
+ * \param ctx     A pointer to the QSPI flash driver instance to use.
+ * \param address The byte address of the start of the range.
+ * \param len     The number of bytes in the range.
+ */
+inline void rtos_qspi_flash_trim(
+        rtos_qspi_flash_t *ctx,
+        unsigned address,
+        size_t len)
+{
+    ctx->trim(ctx, address, len);
+}
+
+/**
+ * Queues a read from the flash and returns without waiting for it. When
+ * the read completes, \p cb is called if it is not NULL. Otherwise
+ * rtos_qspi_flash_op_wait() must be called to wait for it.
+ *
+ * Operations are performed in order of the priority of the threads that
+ * submitted them, and in the order they were submitted within a priority.
+ * An operation is never moved ahead of an earlier one that it overlaps
+ * unless both are reads. Queued reads of adjacent addresses into adjacent
+ * buffers are performed as a single read.
+ *
+ * If the flash supports suspending program and erase operations, reads at the
+ * front of the queue that do not overlap a write or erase in progress are
+ * performed while it is suspended, rather than waiting for it to complete.
+ *
+ * Asynchronous reads do not use the read cache.
+ *
+ * Operations may be submitted from a completion callback, including by
+ * reusing the operation that completed. They are not held back by another
+ * thread's rtos_qspi_flash_lock(). The first one submitted by each callback
+ * takes the queue slot of the operation that completed, so it never waits
+ * for room in the queue. Submitting another from the same callback fails
+ * an assertion if the queue is full.
+ *
+ * On RPC client tiles the operation is sent to the host tile before this
+ * returns, and \p cb is called from the RPC client's callback thread.
+ * Several operations may be outstanding at once, so that their round trips
+ * overlap. Reads may not be longer than QSPI_FLASH_RPC_READ_MAX bytes.
+ *
+ * \param ctx     A pointer to the QSPI flash driver instance to use.
+ * \param op      A pointer to the struct to hold the operation.
+ * \param data    Pointer to the buffer to save the read data to.
+ * \param address The byte address in the flash to begin reading at.
+ * \param len     The number of bytes to read and save to \p data.
+ * \param cb      The function to call when the read completes, or NULL.
+ * \param arg     An argument to pass to \p cb.
+ */
+inline void rtos_qspi_flash_read_async(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op,
+        uint8_t *data,
+        unsigned address,
+        size_t len,
+        rtos_qspi_flash_op_cb_t cb,
+        void *arg)
+{
+    op->type = rtos_qspi_flash_op_read;
+    op->data = data;
+    op->address = address;
+    op->len = len;
+    op->cb = cb;
+    op->arg = arg;
+    ctx->submit(ctx, op);
+}
+
+/**
+ * Queues a write to the flash and returns without waiting for it. Unlike
+ * rtos_qspi_flash_write(), the data is not copied, so \p data must remain
+ * valid until the write completes. See rtos_qspi_flash_read_async().
+ *
+ * \param ctx     A pointer to the QSPI flash driver instance to use.
+ * \param op      A pointer to the struct to hold the operation.
+ * \param data    Pointer to the data to write to the flash.
+ * \param address The byte address in the flash to begin writing at.
+ * \param len     The number of bytes to write to the flash.
+ * \param cb      The function to call when the write completes, or NULL.
+ * \param arg     An argument to pass to \p cb.
+ */
+inline void rtos_qspi_flash_write_async(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op,
+        const uint8_t *data,
+        unsigned address,
+        size_t len,
+        rtos_qspi_flash_op_cb_t cb,
+        void *arg)
+{
+    op->type = rtos_qspi_flash_op_write;
+    op->data = (uint8_t *) data;
+    op->address = address;
+    op->len = len;
+    op->cb = cb;
+    op->arg = arg;
+    ctx->submit(ctx, op);
+}
+
+/**
+ * Queues an erase of the flash and returns without waiting for it. See
+ * rtos_qspi_flash_erase() and rtos_qspi_flash_read_async().
+ *
+ * \param ctx     A pointer to the QSPI flash driver instance to use.
+ * \param op      A pointer to the struct to hold the operation.
+ * \param address The byte address to begin erasing.
+ * \param len     The minimum number of bytes to erase.
+ * \param cb      The function to call when the erase completes, or NULL.
+ * \param arg     An argument to pass to \p cb.
+ */
+inline void rtos_qspi_flash_erase_async(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op,
+        unsigned address,
+        size_t len,
+        rtos_qspi_flash_op_cb_t cb,
+        void *arg)
+{
+    op->type = rtos_qspi_flash_op_erase;
+    op->data = NULL;
+    op->address = address;
+    op->len = len;
+    op->cb = cb;
+    op->arg = arg;
+    ctx->submit(ctx, op);
+}
+
+/**
+ * Waits for an asynchronous operation that was submitted without a
+ * completion callback to complete. This must be called exactly once for
+ * each such operation, and may not be called for operations submitted with
+ * a callback.
+ *
+ * \param ctx     A pointer to the QSPI flash driver instance the operation was submitted to.
+ * \param op      A pointer to the operation to wait for.
+ * \param timeout The maximum time to wait for the operation to complete.
+ *
+ * \retval RTOS_OSAL_SUCCESS once the operation has completed.
+ * \retval RTOS_OSAL_TIMEOUT if it has not completed before the timeout. It must
+ *         then be waited for again.
+ */
+inline rtos_osal_status_t rtos_qspi_flash_op_wait(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op,
+        unsigned timeout)
+{
+    return ctx->op_wait(ctx, op, timeout);
+}
+
 /**
  * This gets the size in bytes of the flash chip.
  *
@@ -241,6 +617,38 @@ inline size_t rtos_qspi_flash_sector_size_get(
     return qspi_flash_erase_type_size(&qspi_flash_ctx->ctx, 0);
 }
 
+#if RTOS_QSPI_FLASH_ISR_READ
+/**
+ * Reads from the flash from within an interrupt handler. The read is sent to
+ * the flash in between the commands of any operation that the driver's thread
+ * is performing, so it waits for at most one command, which may be a read of
+ * up to RTOS_QSPI_FLASH_READ_CHUNK_SIZE bytes. It is sent as a single command,
+ * so \p len should be small.
+ *
+ * The flash cannot be read while it is programming or erasing, so the read
+ * is not performed then. The caller should instead perform the read from a
+ * thread, which allows the program or erase to be suspended for it.
+ *
+ * This must be called with interrupts masked, and only after
+ * rtos_qspi_flash_start() has been called. The read is never performed on
+ * RPC client tiles.
+ *
+ * \param ctx     A pointer to the QSPI flash driver instance to use.
+ * \param data    Pointer to the buffer to save the read data to.
+ * \param address The byte address in the flash to begin reading at.
+ * \param len     The number of bytes to read and save to \p data.
+ *
+ * \retval true  if the read was performed.
+ * \retval false if the flash is busy or on another tile, or the read is
+ *                outside of the flash.
+ */
+bool rtos_qspi_flash_read_isr(
+        rtos_qspi_flash_t *ctx,
+        uint8_t *data,
+        unsigned address,
+        size_t len);
+#endif
+
 /**@}*/
 
 /**
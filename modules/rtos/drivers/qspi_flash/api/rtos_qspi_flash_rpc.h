@@ -75,7 +75,8 @@ void rtos_qspi_flash_rpc_host_init(
  *                           must not be shared by any other functions. The port must be the same
  *                           for the host and all its clients.
  * \param host_task_priority The priority to use for the task on the host tile that handles RPC
- *                           requests from the clients.
+ *                           requests from the clients. On the client tiles this is the priority
+ *                           of the task that receives the RPC responses from the host.
  */
 void rtos_qspi_flash_rpc_config(
         rtos_qspi_flash_t *qspi_flash_ctx,
@@ -6,17 +6,43 @@
 #include <string.h>
 
 #include <xcore/assert.h>
+#include <xcore/hwtimer.h>
 #include <xcore/interrupt.h>
 
 #include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
 
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 
-#define FLASH_OP_READ  0
-#define FLASH_OP_WRITE 1
-#define FLASH_OP_ERASE 2
+/*
+ * Each command is sent to the flash with interrupts masked. When the flash
+ * may also be read from interrupt handlers, the bus lock is held as well, so
+ * that they do not send a read in the middle of it.
+ */
+static void bus_acquire(
+        rtos_qspi_flash_t *ctx)
+{
+    interrupt_mask_all();
+#if RTOS_QSPI_FLASH_ISR_READ
+    lock_acquire(ctx->isr_lock);
+#endif
+}
 
-static void read_op(
+static void bus_release(
+        rtos_qspi_flash_t *ctx)
+{
+#if RTOS_QSPI_FLASH_ISR_READ
+    lock_release(ctx->isr_lock);
+#endif
+    interrupt_unmask_all();
+}
+
+/*
+ * Performs a single read command. When XIP mode is enabled and supported,
+ * the mode bits sent with the address leave the flash in XIP mode, and the
+ * read command is not sent if it is already in XIP mode. The bus must be
+ * held by the caller.
+ */
+static void device_read_command(
         rtos_qspi_flash_t *ctx,
         uint8_t *data,
         unsigned address,
@@ -24,6 +50,78 @@ static void read_op(
 {
     qspi_flash_ctx_t *qspi_flash_ctx = &ctx->ctx;
 
+#if RTOS_QSPI_FLASH_XIP
+    if (qspi_flash_ctx->xip_supported) {
+        address |= (uint32_t) qspi_flash_ctx->xip_enter_mode_bits << 24;
+
+        if (ctx->xip_active) {
+            qspi_flash_xip_read(qspi_flash_ctx, data, address, len);
+        } else {
+            qspi_flash_read(qspi_flash_ctx, data, address, len);
+        }
+
+        ctx->xip_active = true;
+        return;
+    }
+#endif
+
+    qspi_flash_read(qspi_flash_ctx, data, address, len);
+}
+
+/*
+ * Reads from interrupt handlers are refused while the flash is programming
+ * or erasing. This is checked with the bus lock held, so setting it before
+ * the next command is sent is enough to keep them out.
+ */
+static void isr_read_block(
+        rtos_qspi_flash_t *ctx,
+        bool blocked)
+{
+#if RTOS_QSPI_FLASH_ISR_READ
+    ctx->isr_read_blocked = blocked;
+#endif
+}
+
+/*
+ * Takes the flash out of XIP mode, if it is in it, so that it will accept
+ * commands again. The bus must be held by the caller.
+ */
+static inline void xip_exit_command(
+        rtos_qspi_flash_t *ctx)
+{
+#if RTOS_QSPI_FLASH_XIP
+    qspi_flash_ctx_t *qspi_flash_ctx = &ctx->ctx;
+    uint8_t dummy;
+
+    if (ctx->xip_active) {
+        /* The mode bits sent with this read end XIP mode once it completes */
+        qspi_flash_xip_read(qspi_flash_ctx, &dummy, (uint32_t) qspi_flash_ctx->xip_exit_mode_bits << 24, 1);
+        ctx->xip_active = false;
+    }
+#endif
+}
+
+/*
+ * This must be called before any command other than a read is sent, and
+ * whenever the driver goes idle, so that the flash is not left in XIP mode
+ * where the boot ROM cannot read it after a reset.
+ */
+static void xip_exit(
+        rtos_qspi_flash_t *ctx)
+{
+#if RTOS_QSPI_FLASH_XIP
+    bus_acquire(ctx);
+    xip_exit_command(ctx);
+    bus_release(ctx);
+#endif
+}
+
+static void read_op(
+        rtos_qspi_flash_t *ctx,
+        uint8_t *data,
+        unsigned address,
+        size_t len)
+{
     rtos_printf("Asked to read %d bytes at address 0x%08x\n", len, address);
 
     while (len > 0) {
@@ -51,9 +149,9 @@ static void read_op(
 
         rtos_printf("Read %d bytes from flash at address 0x%x\n", read_len, address);
 
-        interrupt_mask_all();
-        qspi_flash_read(qspi_flash_ctx, data, address, read_len);
-        interrupt_unmask_all();
+        bus_acquire(ctx);
+        device_read_command(ctx, data, address, read_len);
+        bus_release(ctx);
 
         len -= read_len;
         data += read_len;
@@ -61,31 +159,315 @@ static void read_op(
     }
 }
 
-static void while_busy(qspi_flash_ctx_t *ctx)
+static void while_busy(rtos_qspi_flash_t *ctx)
 {
     bool busy;
 
     do {
-        interrupt_mask_all();
-        busy = qspi_flash_write_in_progress(ctx);
-        interrupt_unmask_all();
+        bus_acquire(ctx);
+        busy = qspi_flash_write_in_progress(&ctx->ctx);
+        bus_release(ctx);
     } while (busy);
 }
 
-static void write_op(
+/* A slot is free when its bit is set */
+#define OP_SLOTS_ALL ((1 << RTOS_QSPI_FLASH_OP_QUEUE_LEN) - 1)
+
+#if RTOS_QSPI_FLASH_OP_QUEUE_LEN < 1 || RTOS_QSPI_FLASH_OP_QUEUE_LEN > 24
+#error RTOS_QSPI_FLASH_OP_QUEUE_LEN must be between 1 and 24
+#endif
+
+/*
+ * Gets the range of addresses that an operation may change or depend on.
+ * Erases are widened to whole sectors.
+ */
+static void op_range(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op,
+        unsigned *start,
+        unsigned *end)
+{
+    *start = op->address;
+    *end = op->address + op->len;
+
+    if (op->type == rtos_qspi_flash_op_erase) {
+        if (op->address == 0 && op->len >= ctx->flash_size) {
+            /* The whole chip */
+            *end = 0xFFFFFFFF;
+        } else {
+            size_t sector_size = rtos_qspi_flash_sector_size_get(ctx);
+            *start &= ~(sector_size - 1);
+            *end = (*end + sector_size - 1) & ~(sector_size - 1);
+        }
+    }
+}
+
+/*
+ * Two operations must be performed in the order they were submitted when
+ * they overlap and at least one of them changes the flash.
+ */
+static int ops_conflict(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *a,
+        rtos_qspi_flash_op_t *b)
+{
+    unsigned a_start, a_end;
+    unsigned b_start, b_end;
+
+    if (a->type == rtos_qspi_flash_op_read && b->type == rtos_qspi_flash_op_read) {
+        return 0;
+    }
+
+    op_range(ctx, a, &a_start, &a_end);
+    op_range(ctx, b, &b_start, &b_end);
+
+    return a_start < b_end && b_start < a_end;
+}
+
+static void op_slot_free(
+        rtos_qspi_flash_t *ctx,
+        int slot)
+{
+    int state = rtos_osal_critical_enter();
+    ctx->op_free_slots |= 1 << slot;
+    rtos_osal_critical_exit(state);
+
+    rtos_osal_semaphore_put(&ctx->op_slots);
+}
+
+static void op_complete(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op)
+{
+    if (op->cb != NULL) {
+        /*
+         * The callback may free the op or submit it again. The op's slot is
+         * kept for an op that the callback submits, as this thread would
+         * never get one back if it waited for it. It is freed if the
+         * callback does not use it.
+         */
+        ctx->op_reserved_slot = op->slot;
+        op->cb(ctx, op, op->arg);
+
+        if (ctx->op_reserved_slot >= 0) {
+            op_slot_free(ctx, ctx->op_reserved_slot);
+            ctx->op_reserved_slot = -1;
+        }
+    } else {
+        rtos_osal_event_group_set_bits(&ctx->op_done, 1 << op->slot);
+    }
+}
+
+/* The reference clock runs at 100 MHz */
+#define REFERENCE_TICKS_PER_US 100
+
+/*
+ * Removes the read at the front of the queue, if there is one and it does
+ * not touch the flash that the given program or erase may change.
+ */
+static rtos_qspi_flash_op_t *suspended_read_pop(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op)
+{
+    rtos_qspi_flash_op_t *read;
+    int state;
+
+    state = rtos_osal_critical_enter();
+    {
+        read = ctx->op_head;
+        if (read != NULL && read->type == rtos_qspi_flash_op_read && !ops_conflict(ctx, op, read)) {
+            ctx->op_head = read->next;
+            read->next = NULL;
+        } else {
+            read = NULL;
+        }
+    }
+    rtos_osal_critical_exit(state);
+
+    return read;
+}
+
+/*
+ * Waits for a program or erase to complete. When the flash supports it, the
+ * operation is suspended while any reads waiting at the front of the queue
+ * are performed, so that they are not held up behind it. It is allowed to run
+ * for the flash's resume to suspend interval before being suspended again.
+ */
+static void while_busy_suspendable(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op)
+{
+    qspi_flash_ctx_t *qspi_flash_ctx = &ctx->ctx;
+    const bool erase = op->type == rtos_qspi_flash_op_erase;
+    uint32_t interval;
+    uint32_t resume_time;
+    rtos_qspi_flash_op_t *read;
+    bool busy;
+
+    if (!qspi_flash_ctx->suspend_supported) {
+        while_busy(ctx);
+        return;
+    }
+
+    interval = erase ? qspi_flash_ctx->erase_resume_interval_us : qspi_flash_ctx->program_resume_interval_us;
+    interval *= REFERENCE_TICKS_PER_US;
+    resume_time = get_reference_time();
+
+    for (;;) {
+        bus_acquire(ctx);
+        busy = qspi_flash_write_in_progress(qspi_flash_ctx);
+        bus_release(ctx);
+
+        if (!busy) {
+            break;
+        }
+
+        if (get_reference_time() - resume_time < interval) {
+            continue;
+        }
+
+        read = suspended_read_pop(ctx, op);
+        if (read == NULL) {
+            continue;
+        }
+
+        bus_acquire(ctx);
+        if (erase) {
+            qspi_flash_erase_suspend(qspi_flash_ctx);
+        } else {
+            qspi_flash_program_suspend(qspi_flash_ctx);
+        }
+        bus_release(ctx);
+        while_busy(ctx);
+
+        do {
+            read_op(ctx, read->data, read->address, read->len);
+            op_complete(ctx, read);
+        } while ((read = suspended_read_pop(ctx, op)) != NULL);
+        xip_exit(ctx);
+
+        /*
+         * If the operation completed before it could be suspended
+         * then the flash ignores this.
+         */
+        bus_acquire(ctx);
+        if (erase) {
+            qspi_flash_erase_resume(qspi_flash_ctx);
+        } else {
+            qspi_flash_program_resume(qspi_flash_ctx);
+        }
+        bus_release(ctx);
+        resume_time = get_reference_time();
+    }
+}
+
+#if RTOS_QSPI_FLASH_PRE_ERASE
+
+/* The most sectors erased by the background thread at once */
+#define PRE_ERASE_MAX_SECTORS 16
+
+#define SECTOR_MAP_WORDS(n) (((n) + 31) / 32)
+
+/*
+ * The sector maps have a bit for each of the smallest erasable sectors.
+ * erased_map marks the sectors known to be erased, and is only accessed by
+ * the op thread, which sees the operations in the order they are performed.
+ * trim_map marks the sectors waiting to be erased in the background, and is
+ * only accessed in critical sections.
+ */
+static void sector_map_write(
+        rtos_qspi_flash_t *ctx,
+        uint32_t *map,
+        unsigned first,
+        unsigned last,
+        bool set)
+{
+    if (last > ctx->sector_count) {
+        last = ctx->sector_count;
+    }
+
+    for (unsigned i = first; i < last; i++) {
+        if (set) {
+            map[i / 32] |= 1 << (i % 32);
+        } else {
+            map[i / 32] &= ~(1 << (i % 32));
+        }
+    }
+}
+
+static bool sector_map_all_set(
+        rtos_qspi_flash_t *ctx,
+        uint32_t *map,
+        unsigned first,
+        unsigned last)
+{
+    if (last > ctx->sector_count) {
+        last = ctx->sector_count;
+    }
+
+    for (unsigned i = first; i < last; i++) {
+        if ((map[i / 32] & (1 << (i % 32))) == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Gets the sectors that the given range of bytes overlaps.
+ */
+static void sector_range(
         rtos_qspi_flash_t *ctx,
-        const uint8_t *data,
         unsigned address,
-        size_t len)
+        size_t len,
+        unsigned *first,
+        unsigned *last)
+{
+    uint32_t sector_size_log2 = qspi_flash_erase_type_size_log2(&ctx->ctx, 0);
+    unsigned end = address + len;
+
+    if (end < address || end > ctx->flash_size) {
+        end = ctx->flash_size;
+    }
+
+    *first = address >> sector_size_log2;
+    *last = (end + (1 << sector_size_log2) - 1) >> sector_size_log2;
+}
+
+static void erased_map_write(
+        rtos_qspi_flash_t *ctx,
+        unsigned address,
+        size_t len,
+        bool erased)
+{
+    unsigned first, last;
+
+    sector_range(ctx, address, len, &first, &last);
+    sector_map_write(ctx, ctx->erased_map, first, last, erased);
+}
+
+#endif /* RTOS_QSPI_FLASH_PRE_ERASE */
+
+static void write_op(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op)
 {
     qspi_flash_ctx_t *qspi_flash_ctx = &ctx->ctx;
 
-    size_t bytes_left_to_write = len;
-    unsigned address_to_write = address;
-    const uint8_t *write_buf = data;
+    size_t bytes_left_to_write = op->len;
+    unsigned address_to_write = op->address;
+    const uint8_t *write_buf = op->data;
 
     rtos_printf("Asked to write %d bytes at address 0x%08x\n", bytes_left_to_write, address_to_write);
 
+    isr_read_block(ctx, true);
+    xip_exit(ctx);
+
+#if RTOS_QSPI_FLASH_PRE_ERASE
+    erased_map_write(ctx, address_to_write, bytes_left_to_write, false);
+#endif
+
     while (bytes_left_to_write > 0) {
         /* compute the maximum number of bytes that can be written to the current page. */
         size_t max_bytes_to_write = qspi_flash_ctx->page_size_bytes - (address_to_write & (qspi_flash_ctx->page_size_bytes - 1));
@@ -96,18 +478,20 @@ static void write_op(
         }
 
         rtos_printf("Write %d bytes from flash at address 0x%x\n", bytes_to_write, address_to_write);
-        interrupt_mask_all();
+        bus_acquire(ctx);
         qspi_flash_write_enable(qspi_flash_ctx);
-        interrupt_unmask_all();
-        interrupt_mask_all();
+        bus_release(ctx);
+        bus_acquire(ctx);
         qspi_flash_write(qspi_flash_ctx, write_buf, address_to_write, bytes_to_write);
-        interrupt_unmask_all();
-        while_busy(qspi_flash_ctx);
+        bus_release(ctx);
+        while_busy_suspendable(ctx, op);
 
         bytes_left_to_write -= bytes_to_write;
         write_buf += bytes_to_write;
         address_to_write += bytes_to_write;
     }
+
+    isr_read_block(ctx, false);
 }
 
 #define SECTORS_TO_BYTES(s, ss_log2) ((s) << (ss_log2))
@@ -118,26 +502,32 @@ static void write_op(
 
 static void erase_op(
         rtos_qspi_flash_t *ctx,
-        unsigned address,
-        size_t len)
+        rtos_qspi_flash_op_t *op)
 {
     qspi_flash_ctx_t *qspi_flash_ctx = &ctx->ctx;
 
-    size_t bytes_left_to_erase = len;
-    unsigned address_to_erase = address;
+    size_t bytes_left_to_erase = op->len;
+    unsigned address_to_erase = op->address;
 
     rtos_printf("Asked to erase %d bytes at address 0x%08x\n", bytes_left_to_erase, address_to_erase);
 
+    isr_read_block(ctx, true);
+    xip_exit(ctx);
+
     if (address_to_erase == 0 && bytes_left_to_erase >= ctx->flash_size) {
         /* Use chip erase when being asked to erase the entire address range */
         rtos_printf("Erasing entire chip\n");
-        interrupt_mask_all();
+        bus_acquire(ctx);
         qspi_flash_write_enable(qspi_flash_ctx);
-        interrupt_unmask_all();
-        interrupt_mask_all();
+        bus_release(ctx);
+        bus_acquire(ctx);
         qspi_flash_erase(qspi_flash_ctx, address_to_erase, qspi_flash_erase_chip);
-        interrupt_unmask_all();
-        while_busy(qspi_flash_ctx);
+        bus_release(ctx);
+        while_busy(ctx);
+
+#if RTOS_QSPI_FLASH_PRE_ERASE
+        sector_map_write(ctx, ctx->erased_map, 0, ctx->sector_count, true);
+#endif
     } else {
 
         if (SECTOR_TO_BYTE_ADDRESS(BYTE_TO_SECTOR_ADDRESS(address_to_erase, qspi_flash_erase_type_size_log2(qspi_flash_ctx, 0)), qspi_flash_erase_type_size_log2(qspi_flash_ctx, 0)) != address_to_erase) {
@@ -179,85 +569,394 @@ static void erase_op(
 
             xassert(address_to_erase == SECTOR_TO_BYTE_ADDRESS(BYTE_TO_SECTOR_ADDRESS(address_to_erase, erase_length_log2), erase_length_log2));
 
-            rtos_printf("Erasing %d bytes (%d) at byte address %d\n", erase_length, bytes_left_to_erase, address_to_erase);
+            bool already_erased = false;
+#if RTOS_QSPI_FLASH_PRE_ERASE
+            unsigned first_sector, last_sector;
+            sector_range(ctx, address_to_erase, erase_length, &first_sector, &last_sector);
+            already_erased = sector_map_all_set(ctx, ctx->erased_map, first_sector, last_sector);
+#endif
 
-            interrupt_mask_all();
-            qspi_flash_write_enable(qspi_flash_ctx);
-            interrupt_unmask_all();
+            if (already_erased) {
+                rtos_printf("Skipping erase of %d bytes at byte address %d\n", erase_length, address_to_erase);
+            } else {
+                rtos_printf("Erasing %d bytes (%d) at byte address %d\n", erase_length, bytes_left_to_erase, address_to_erase);
 
-            interrupt_mask_all();
-            qspi_flash_erase(qspi_flash_ctx, address_to_erase, erase_cmd);
-            interrupt_unmask_all();
+                bus_acquire(ctx);
+                qspi_flash_write_enable(qspi_flash_ctx);
+                bus_release(ctx);
 
-            while_busy(qspi_flash_ctx);
+                bus_acquire(ctx);
+                qspi_flash_erase(qspi_flash_ctx, address_to_erase, erase_cmd);
+                bus_release(ctx);
+
+                while_busy_suspendable(ctx, op);
+
+#if RTOS_QSPI_FLASH_PRE_ERASE
+                sector_map_write(ctx, ctx->erased_map, first_sector, last_sector, true);
+#endif
+            }
 
             address_to_erase += erase_length;
             bytes_left_to_erase -= erase_length < bytes_left_to_erase ? erase_length : bytes_left_to_erase;
         }
     }
 
+    isr_read_block(ctx, false);
+
     rtos_printf("Erasing complete\n");
 }
 
-typedef struct {
-    int op;
-    uint8_t *data;
-    unsigned address;
-    size_t len;
-    unsigned priority;
-} qspi_flash_op_req_t;
-
 static void qspi_flash_op_thread(rtos_qspi_flash_t *ctx)
 {
-    qspi_flash_op_req_t op;
+    rtos_qspi_flash_op_t *op;
+    rtos_qspi_flash_op_t *last;
+    size_t len;
     bool quad_enabled;
+    int state;
 
     quad_enabled = qspi_flash_quad_enable_write(&ctx->ctx, true);
     xassert(quad_enabled && "QE bit could not be set\n");
+    isr_read_block(ctx, false);
 
     for (;;) {
-        rtos_osal_queue_receive(&ctx->op_queue, &op, RTOS_OSAL_WAIT_FOREVER);
+        if (rtos_osal_semaphore_get(&ctx->op_pending, RTOS_OSAL_NO_WAIT) != RTOS_OSAL_SUCCESS) {
+            /* Nothing is queued, so the flash may be reset or rebooted from */
+            xip_exit(ctx);
+            rtos_osal_semaphore_get(&ctx->op_pending, RTOS_OSAL_WAIT_FOREVER);
+        }
+
+        state = rtos_osal_critical_enter();
+        {
+            op = ctx->op_head;
+            if (op == NULL) {
+                /* Already done together with an earlier operation */
+                rtos_osal_critical_exit(state);
+                continue;
+            }
+            last = op;
+            len = op->len;
+
+            /*
+             * Reads that continue this one, both in the flash and in memory,
+             * are done together with it.
+             */
+            if (op->type == rtos_qspi_flash_op_read) {
+                while (last->next != NULL &&
+                       last->next->type == rtos_qspi_flash_op_read &&
+                       last->next->address == last->address + last->len &&
+                       last->next->data == last->data + last->len) {
+                    last = last->next;
+                    len += last->len;
+                }
+            }
+
+            ctx->op_head = last->next;
+            last->next = NULL;
+        }
+        rtos_osal_critical_exit(state);
 
         /*
          * Inherit the priority of the task that requested this
          * operation.
          */
-        rtos_osal_thread_priority_set(&ctx->op_task, op.priority);
+        rtos_osal_thread_priority_set(&ctx->op_task, op->priority);
 
-        switch (op.op) {
-        case FLASH_OP_READ:
-            read_op(ctx, op.data, op.address, op.len);
-            rtos_osal_semaphore_put(&ctx->data_ready);
+        switch (op->type) {
+        case rtos_qspi_flash_op_read:
+            read_op(ctx, op->data, op->address, len);
             break;
-        case FLASH_OP_WRITE:
-            write_op(ctx, op.data, op.address, op.len);
-            rtos_osal_free(op.data);
+        case rtos_qspi_flash_op_write:
+            write_op(ctx, op);
             break;
-        case FLASH_OP_ERASE:
-            erase_op(ctx, op.address, op.len);
+        case rtos_qspi_flash_op_erase:
+            erase_op(ctx, op);
             break;
-
         }
 
         /*
          * Reset back to the priority set by rtos_qspi_flash_start().
          */
         rtos_osal_thread_priority_set(&ctx->op_task, ctx->op_task_priority);
+
+        while (op != NULL) {
+            rtos_qspi_flash_op_t *next = op->next;
+            op_complete(ctx, op);
+            op = next;
+        }
     }
 }
 
-static void request(
+#if RTOS_QSPI_FLASH_CACHE_LINES > 0
+
+#if (RTOS_QSPI_FLASH_CACHE_LINE_SIZE & (RTOS_QSPI_FLASH_CACHE_LINE_SIZE - 1)) != 0
+#error RTOS_QSPI_FLASH_CACHE_LINE_SIZE must be a power of two
+#endif
+
+#define CACHE_LINE_INVALID 0xFFFFFFFF
+
+static bool cache_line_overlaps(
+        unsigned line_address,
+        unsigned address,
+        size_t len)
+{
+    return line_address != CACHE_LINE_INVALID &&
+           line_address < address + len &&
+           address < line_address + RTOS_QSPI_FLASH_CACHE_LINE_SIZE;
+}
+
+/*
+ * Invalidates every cache line that overlaps the given address range,
+ * including one that is being filled. Must be called in a critical section,
+ * before the write or erase is queued.
+ */
+static void cache_invalidate(
         rtos_qspi_flash_t *ctx,
-        qspi_flash_op_req_t *op)
+        unsigned address,
+        size_t len)
 {
-    rtos_osal_mutex_get(&ctx->mutex, RTOS_OSAL_WAIT_FOREVER);
+    for (int i = 0; i < RTOS_QSPI_FLASH_CACHE_LINES; i++) {
+        rtos_qspi_flash_cache_line_t *line = &ctx->cache[i];
+
+        if (cache_line_overlaps(line->address, address, len)) {
+            line->address = CACHE_LINE_INVALID;
+        }
+    }
+
+    if (cache_line_overlaps(ctx->cache_fill_address, address, len)) {
+        ctx->cache_fill_address = CACHE_LINE_INVALID;
+    }
+}
+
+#endif /* RTOS_QSPI_FLASH_CACHE_LINES > 0 */
+
+/*
+ * Puts an operation into the queue. Must be called in a critical section,
+ * once a slot has been taken from op_slots.
+ */
+static void op_queue(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op)
+{
+    rtos_qspi_flash_op_t **pos;
+
+#if RTOS_QSPI_FLASH_CACHE_LINES > 0 || RTOS_QSPI_FLASH_PRE_ERASE
+    if (op->type != rtos_qspi_flash_op_read) {
+        unsigned start, end;
+
+        op_range(ctx, op, &start, &end);
+#if RTOS_QSPI_FLASH_CACHE_LINES > 0
+        cache_invalidate(ctx, start, end - start);
+#endif
+#if RTOS_QSPI_FLASH_PRE_ERASE
+        /*
+         * The sectors being changed are no longer free, so they must not
+         * be erased by the background thread after this.
+         */
+        unsigned first, last;
+        sector_range(ctx, start, end - start, &first, &last);
+        sector_map_write(ctx, ctx->trim_map, first, last, false);
+#endif
+    }
+#endif
+
+    op->slot = __builtin_ctz(ctx->op_free_slots);
+    ctx->op_free_slots &= ~(1 << op->slot);
+
+    /*
+     * Go behind the last queued operation that has at least the same
+     * priority or that must stay ahead of this one.
+     */
+    pos = &ctx->op_head;
+    for (rtos_qspi_flash_op_t **p = &ctx->op_head; *p != NULL; p = &(*p)->next) {
+        if ((*p)->priority >= op->priority || ops_conflict(ctx, *p, op)) {
+            pos = &(*p)->next;
+        }
+    }
+    op->next = *pos;
+    *pos = op;
+}
+
+/*
+ * Operations submitted from a completion callback, which runs on the op
+ * thread, neither take the driver's mutex nor wait for a slot. A thread
+ * that holds the lock may be waiting for the op thread, and only the op
+ * thread frees the slots of operations that have callbacks.
+ */
+__attribute__((fptrgroup("rtos_qspi_flash_submit_fptr_grp")))
+static void qspi_flash_local_submit(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op)
+{
+    int state;
+    int from_callback = rtos_osal_thread_is_current(&ctx->op_task);
 
     rtos_osal_thread_priority_get(NULL, &op->priority);
-    rtos_osal_queue_send(&ctx->op_queue, op, RTOS_OSAL_WAIT_FOREVER);
+    op->next = NULL;
+
+    if (from_callback) {
+        if (ctx->op_reserved_slot >= 0) {
+            /* Reuse the slot of the operation that just completed */
+            state = rtos_osal_critical_enter();
+            ctx->op_free_slots |= 1 << ctx->op_reserved_slot;
+            rtos_osal_critical_exit(state);
+            ctx->op_reserved_slot = -1;
+        } else if (rtos_osal_semaphore_get(&ctx->op_slots, RTOS_OSAL_NO_WAIT) != RTOS_OSAL_SUCCESS) {
+            /* A callback submitted more operations than the queue has room for */
+            xassert(0);
+        }
+    } else {
+        /* Not queued while another thread holds the lock */
+        rtos_osal_mutex_get(&ctx->mutex, RTOS_OSAL_WAIT_FOREVER);
 
-    rtos_osal_mutex_put(&ctx->mutex);
+        /* Wait for room in the queue */
+        rtos_osal_semaphore_get(&ctx->op_slots, RTOS_OSAL_WAIT_FOREVER);
+    }
+
+    state = rtos_osal_critical_enter();
+    op_queue(ctx, op);
+    rtos_osal_critical_exit(state);
+
+    if (!from_callback) {
+        rtos_osal_mutex_put(&ctx->mutex);
+    }
+
+    rtos_osal_semaphore_put(&ctx->op_pending);
+}
+
+__attribute__((fptrgroup("rtos_qspi_flash_op_wait_fptr_grp")))
+static rtos_osal_status_t qspi_flash_local_op_wait(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op,
+        unsigned timeout)
+{
+    rtos_osal_status_t status;
+    uint32_t flags;
+
+    xassert(op->cb == NULL);
+
+    status = rtos_osal_event_group_get_bits(&ctx->op_done,
+                                            1 << op->slot,
+                                            RTOS_OSAL_OR_CLEAR,
+                                            &flags,
+                                            timeout);
+
+    if (status == RTOS_OSAL_SUCCESS) {
+        op_slot_free(ctx, op->slot);
+    }
+
+    return status;
+}
+
+__attribute__((fptrgroup("rtos_qspi_flash_trim_fptr_grp")))
+static void qspi_flash_local_trim(
+        rtos_qspi_flash_t *ctx,
+        unsigned address,
+        size_t len)
+{
+#if RTOS_QSPI_FLASH_PRE_ERASE
+    uint32_t sector_size_log2 = qspi_flash_erase_type_size_log2(&ctx->ctx, 0);
+    unsigned end = address + len;
+    unsigned first, last;
+
+    if (end < address) {
+        end = ctx->flash_size;
+    }
+
+    /* Only sectors that lie entirely within the range are free */
+    first = (address + (1 << sector_size_log2) - 1) >> sector_size_log2;
+    last = end >> sector_size_log2;
+
+    if (first < last) {
+        int state = rtos_osal_critical_enter();
+        sector_map_write(ctx, ctx->trim_map, first, last, true);
+        rtos_osal_critical_exit(state);
+
+        rtos_osal_semaphore_put(&ctx->trim_request);
+    }
+#endif
+}
+
+#if RTOS_QSPI_FLASH_PRE_ERASE
+
+/*
+ * Takes the first run of trimmed sectors out of the trim map. Must be called
+ * in a critical section.
+ */
+static unsigned trim_map_take(
+        rtos_qspi_flash_t *ctx,
+        unsigned *first)
+{
+    unsigned count = 0;
+    unsigned i;
+
+    for (i = 0; i < SECTOR_MAP_WORDS(ctx->sector_count); i++) {
+        if (ctx->trim_map[i] != 0) {
+            break;
+        }
+    }
+    if (i == SECTOR_MAP_WORDS(ctx->sector_count)) {
+        return 0;
+    }
+
+    *first = i * 32 + __builtin_ctz(ctx->trim_map[i]);
+
+    while (count < PRE_ERASE_MAX_SECTORS && sector_map_all_set(ctx, ctx->trim_map, *first + count, *first + count + 1)) {
+        count++;
+    }
+    sector_map_write(ctx, ctx->trim_map, *first, *first + count, false);
+
+    return count;
 }
 
+static void qspi_flash_pre_erase_thread(rtos_qspi_flash_t *ctx)
+{
+    uint32_t sector_size_log2 = qspi_flash_erase_type_size_log2(&ctx->ctx, 0);
+    rtos_qspi_flash_op_t op;
+    unsigned first;
+    unsigned count;
+    int state;
+
+    op.type = rtos_qspi_flash_op_erase;
+    op.data = NULL;
+    op.cb = NULL;
+    op.arg = NULL;
+
+    for (;;) {
+        rtos_osal_semaphore_get(&ctx->trim_request, RTOS_OSAL_WAIT_FOREVER);
+
+        for (;;) {
+            rtos_osal_thread_priority_get(NULL, &op.priority);
+            op.next = NULL;
+            rtos_osal_semaphore_get(&ctx->op_slots, RTOS_OSAL_WAIT_FOREVER);
+
+            /*
+             * The erase is queued in the same critical section that its
+             * sectors are taken from the trim map in, so that a write to
+             * them cannot be queued ahead of it.
+             */
+            state = rtos_osal_critical_enter();
+            count = trim_map_take(ctx, &first);
+            if (count > 0) {
+                op.address = first << sector_size_log2;
+                op.len = count << sector_size_log2;
+                op_queue(ctx, &op);
+            }
+            rtos_osal_critical_exit(state);
+
+            if (count == 0) {
+                rtos_osal_semaphore_put(&ctx->op_slots);
+                break;
+            }
+
+            rtos_osal_semaphore_put(&ctx->op_pending);
+
+            rtos_qspi_flash_op_wait(ctx, &op, RTOS_OSAL_WAIT_FOREVER);
+        }
+    }
+}
+
+#endif /* RTOS_QSPI_FLASH_PRE_ERASE */
+
 __attribute__((fptrgroup("rtos_qspi_flash_lock_fptr_grp")))
 static void qspi_flash_local_lock(
         rtos_qspi_flash_t *ctx)
@@ -272,6 +971,95 @@ static void qspi_flash_local_unlock(
     rtos_osal_mutex_put(&ctx->mutex);
 }
 
+static void device_read(
+        rtos_qspi_flash_t *ctx,
+        uint8_t *data,
+        unsigned address,
+        size_t len)
+{
+    rtos_qspi_flash_op_t op;
+
+    rtos_qspi_flash_read_async(ctx, &op, data, address, len, NULL, NULL);
+    qspi_flash_local_op_wait(ctx, &op, RTOS_OSAL_WAIT_FOREVER);
+}
+
+#if RTOS_QSPI_FLASH_CACHE_LINES > 0
+
+/*
+ * Gets the cache line holding the given line address, filling the least
+ * recently used line from the flash if none does.
+ */
+static rtos_qspi_flash_cache_line_t *cache_line_get(
+        rtos_qspi_flash_t *ctx,
+        unsigned line_address)
+{
+    rtos_qspi_flash_cache_line_t *victim = &ctx->cache[0];
+    int state;
+
+    for (int i = 0; i < RTOS_QSPI_FLASH_CACHE_LINES; i++) {
+        rtos_qspi_flash_cache_line_t *line = &ctx->cache[i];
+
+        if (line->address == line_address) {
+            return line;
+        }
+        if (line->address == CACHE_LINE_INVALID) {
+            if (victim->address != CACHE_LINE_INVALID) {
+                victim = line;
+            }
+        } else if (victim->address != CACHE_LINE_INVALID && line->last_used < victim->last_used) {
+            victim = line;
+        }
+    }
+
+    /*
+     * A write or erase queued while the line is filled clears
+     * cache_fill_address, so that the old contents are not kept.
+     */
+    state = rtos_osal_critical_enter();
+    victim->address = CACHE_LINE_INVALID;
+    ctx->cache_fill_address = line_address;
+    rtos_osal_critical_exit(state);
+
+    device_read(ctx, victim->data, line_address, RTOS_QSPI_FLASH_CACHE_LINE_SIZE);
+
+    state = rtos_osal_critical_enter();
+    if (ctx->cache_fill_address == line_address) {
+        victim->address = line_address;
+    }
+    ctx->cache_fill_address = CACHE_LINE_INVALID;
+    rtos_osal_critical_exit(state);
+
+    return victim;
+}
+
+static void cached_read(
+        rtos_qspi_flash_t *ctx,
+        uint8_t *data,
+        unsigned address,
+        size_t len)
+{
+    /* The mutex keeps other threads from filling or replacing lines */
+    rtos_osal_mutex_get(&ctx->mutex, RTOS_OSAL_WAIT_FOREVER);
+
+    while (len > 0) {
+        unsigned line_address = address & ~(RTOS_QSPI_FLASH_CACHE_LINE_SIZE - 1);
+        unsigned offset = address - line_address;
+        size_t copy_len = MIN(len, RTOS_QSPI_FLASH_CACHE_LINE_SIZE - offset);
+        rtos_qspi_flash_cache_line_t *line = cache_line_get(ctx, line_address);
+
+        line->last_used = ++ctx->cache_clock;
+        memcpy(data, line->data + offset, copy_len);
+
+        data += copy_len;
+        address += copy_len;
+        len -= copy_len;
+    }
+
+    rtos_osal_mutex_put(&ctx->mutex);
+}
+
+#endif /* RTOS_QSPI_FLASH_CACHE_LINES > 0 */
+
 __attribute__((fptrgroup("rtos_qspi_flash_read_fptr_grp")))
 static void qspi_flash_local_read(
         rtos_qspi_flash_t *ctx,
@@ -279,16 +1067,23 @@ static void qspi_flash_local_read(
         unsigned address,
         size_t len)
 {
-    qspi_flash_op_req_t op = {
-            .op = FLASH_OP_READ,
-            .data = data,
-            .address = address,
-            .len = len
-    };
+#if RTOS_QSPI_FLASH_CACHE_LINES > 0
+    if (len <= RTOS_QSPI_FLASH_CACHE_LINES * RTOS_QSPI_FLASH_CACHE_LINE_SIZE / 2) {
+        cached_read(ctx, data, address, len);
+        return;
+    }
+#endif
 
-    request(ctx, &op);
+    device_read(ctx, data, address, len);
+}
 
-    rtos_osal_semaphore_get(&ctx->data_ready, RTOS_OSAL_WAIT_FOREVER);
+RTOS_QSPI_FLASH_OP_CALLBACK_ATTR
+static void op_free_cb(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op,
+        void *arg)
+{
+    rtos_osal_free(op);
 }
 
 __attribute__((fptrgroup("rtos_qspi_flash_write_fptr_grp")))
@@ -298,16 +1093,13 @@ static void qspi_flash_local_write(
         unsigned address,
         size_t len)
 {
-    qspi_flash_op_req_t op = {
-            .op = FLASH_OP_WRITE,
-            .address = address,
-            .len = len
-    };
+    /* The data is copied in after the op so that both are freed together */
+    rtos_qspi_flash_op_t *op = rtos_osal_malloc(sizeof(rtos_qspi_flash_op_t) + len);
+    xassert(op != NULL);
 
-    op.data = rtos_osal_malloc(len);
-    memcpy(op.data, data, len);
+    memcpy(op + 1, data, len);
 
-    request(ctx, &op);
+    rtos_qspi_flash_write_async(ctx, op, (uint8_t *) (op + 1), address, len, op_free_cb, NULL);
 }
 
 __attribute__((fptrgroup("rtos_qspi_flash_erase_fptr_grp")))
@@ -316,22 +1108,95 @@ static void qspi_flash_local_erase(
         unsigned address,
         size_t len)
 {
-    qspi_flash_op_req_t op = {
-            .op = FLASH_OP_ERASE,
-            .address = address,
-            .len = len
-    };
+    rtos_qspi_flash_op_t *op = rtos_osal_malloc(sizeof(rtos_qspi_flash_op_t));
+    xassert(op != NULL);
+
+    rtos_qspi_flash_erase_async(ctx, op, address, len, op_free_cb, NULL);
+}
+
+#if RTOS_QSPI_FLASH_ISR_READ
+bool rtos_qspi_flash_read_isr(
+        rtos_qspi_flash_t *ctx,
+        uint8_t *data,
+        unsigned address,
+        size_t len)
+{
+    bool done = false;
+
+    if (ctx->rpc_config != NULL && ctx->rpc_config->remote_client_count == 0) {
+        /* The flash belongs to another tile */
+        return false;
+    }
+
+    if (address >= ctx->flash_size || len > ctx->flash_size - address) {
+        return false;
+    }
+
+    /* Interrupts are already masked */
+    lock_acquire(ctx->isr_lock);
+    if (!ctx->isr_read_blocked) {
+        /* The op thread may be idle, so the flash is not left in XIP mode */
+        device_read_command(ctx, data, address, len);
+        xip_exit_command(ctx);
+        done = true;
+    }
+    lock_release(ctx->isr_lock);
 
-    request(ctx, &op);
+    return done;
 }
+#endif
 
 void rtos_qspi_flash_start(
         rtos_qspi_flash_t *ctx,
         unsigned priority)
 {
     rtos_osal_mutex_create(&ctx->mutex, "qspi_lock", RTOS_OSAL_RECURSIVE);
-    rtos_osal_queue_create(&ctx->op_queue, "qspi_req_queue", 2, sizeof(qspi_flash_op_req_t));
-    rtos_osal_semaphore_create(&ctx->data_ready, "qspi_dr_sem", 1, 0);
+    rtos_osal_semaphore_create(&ctx->op_pending, "qspi_op_pending", RTOS_QSPI_FLASH_OP_QUEUE_LEN, 0);
+    rtos_osal_semaphore_create(&ctx->op_slots, "qspi_op_slots", RTOS_QSPI_FLASH_OP_QUEUE_LEN, RTOS_QSPI_FLASH_OP_QUEUE_LEN);
+    rtos_osal_event_group_create(&ctx->op_done, "qspi_op_done");
+    ctx->op_head = NULL;
+    ctx->op_free_slots = OP_SLOTS_ALL;
+    ctx->op_reserved_slot = -1;
+
+#if RTOS_QSPI_FLASH_ISR_READ
+    /* Reads from interrupts are refused until the op thread has set up the flash */
+    ctx->isr_read_blocked = true;
+    ctx->isr_lock = lock_alloc();
+    xassert(ctx->isr_lock != 0);
+#endif
+
+#if RTOS_QSPI_FLASH_XIP
+    ctx->xip_active = false;
+#endif
+
+#if RTOS_QSPI_FLASH_CACHE_LINES > 0
+    ctx->cache_clock = 0;
+    ctx->cache_fill_address = CACHE_LINE_INVALID;
+    for (int i = 0; i < RTOS_QSPI_FLASH_CACHE_LINES; i++) {
+        ctx->cache[i].address = CACHE_LINE_INVALID;
+        ctx->cache[i].last_used = 0;
+        ctx->cache[i].data = rtos_osal_malloc(RTOS_QSPI_FLASH_CACHE_LINE_SIZE);
+        xassert(ctx->cache[i].data != NULL);
+    }
+#endif
+
+#if RTOS_QSPI_FLASH_PRE_ERASE
+    ctx->sector_count = ctx->flash_size / rtos_qspi_flash_sector_size_get(ctx);
+    ctx->erased_map = rtos_osal_malloc(SECTOR_MAP_WORDS(ctx->sector_count) * sizeof(uint32_t));
+    ctx->trim_map = rtos_osal_malloc(SECTOR_MAP_WORDS(ctx->sector_count) * sizeof(uint32_t));
+    xassert(ctx->erased_map != NULL && ctx->trim_map != NULL);
+    memset(ctx->erased_map, 0, SECTOR_MAP_WORDS(ctx->sector_count) * sizeof(uint32_t));
+    memset(ctx->trim_map, 0, SECTOR_MAP_WORDS(ctx->sector_count) * sizeof(uint32_t));
+    rtos_osal_semaphore_create(&ctx->trim_request, "qspi_trim_sem", 1, 0);
+
+    rtos_osal_thread_create(
+            &ctx->pre_erase_task,
+            "qspi_flash_pre_erase_thread",
+            (rtos_osal_entry_function_t) qspi_flash_pre_erase_thread,
+            ctx,
+            RTOS_THREAD_STACK_SIZE(qspi_flash_pre_erase_thread),
+            RTOS_QSPI_FLASH_PRE_ERASE_TASK_PRIORITY);
+#endif
 
     ctx->op_task_priority = priority;
     rtos_osal_thread_create(
@@ -398,4 +1263,7 @@ void rtos_qspi_flash_init(
     ctx->erase = qspi_flash_local_erase;
     ctx->lock = qspi_flash_local_lock;
     ctx->unlock = qspi_flash_local_unlock;
+    ctx->submit = qspi_flash_local_submit;
+    ctx->op_wait = qspi_flash_local_op_wait;
+    ctx->trim = qspi_flash_local_trim;
 }
@@ -1,6 +1,7 @@
 // Copyright 2020-2021 XMOS LIMITED.
 // This Software is subject to the terms of the XMOS Public Licence: Version 1.
 
+#include <stddef.h>
 #include <string.h>
 #include <xcore/assert.h>
 
@@ -10,6 +11,20 @@
 
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 
+/*
+ * The size of each of the two chunks that the host streams a read
+ * through. One is read from the flash while the other is sent.
+ */
+#define QSPI_FLASH_RPC_STREAM_CHUNK_SIZE 4096
+
+/*
+ * The host streams reads through these buffers. They are shared by the
+ * host threads of all clients, so each read holds the mutex throughout.
+ */
+static uint8_t stream_buf[2][QSPI_FLASH_RPC_STREAM_CHUNK_SIZE];
+static rtos_osal_mutex_t stream_lock;
+static int stream_lock_created;
+
 enum {
     fcode_lock,
     fcode_unlock,
@@ -34,8 +49,8 @@ static void qspi_flash_remote_lock(
 
     rtos_osal_mutex_get(&ctx->mutex, RTOS_OSAL_WAIT_FOREVER);
 
-    rpc_client_call_generic(
-            host_address->intertile_ctx, host_address->port, fcode_lock, rpc_param_desc,
+    rpc_client_call(
+            &ctx->rpc_client, fcode_lock, rpc_param_desc,
             &host_ctx_ptr);
 }
 
@@ -53,48 +68,170 @@ static void qspi_flash_remote_unlock(
             RPC_PARAM_LIST_END
     };
 
-    rpc_client_call_generic(
-            host_address->intertile_ctx, host_address->port, fcode_unlock, rpc_param_desc,
+    rpc_client_call(
+            &ctx->rpc_client, fcode_unlock, rpc_param_desc,
             &host_ctx_ptr);
 
     rtos_osal_mutex_put(&ctx->mutex);
 }
 
-__attribute__((fptrgroup("rtos_qspi_flash_read_fptr_grp")))
-static void qspi_flash_remote_read(
+RPC_CALL_DONE_CALLBACK_ATTR
+static void qspi_flash_remote_op_done(
+        rpc_call_t *call,
+        void *arg)
+{
+    rtos_qspi_flash_t *ctx = arg;
+    rtos_qspi_flash_op_t *op = (rtos_qspi_flash_op_t *) ((uint8_t *) call - offsetof(rtos_qspi_flash_op_t, rpc_call));
+
+    op->cb(ctx, op, op->arg);
+}
+
+/*
+ * Sends an operation to the host and returns without waiting for its
+ * response, so that several may be outstanding at once. When the response
+ * is received, the operation's callback is called from the RPC client's
+ * callback thread if it has one. Otherwise the operation must be waited for with
+ * qspi_flash_remote_op_wait().
+ *
+ * The lock is held only while the request is sent. The host performs
+ * requests in the order they are received, so none are performed while
+ * another thread holds the lock. Operations submitted from a completion
+ * callback do not take it, as a thread that holds it may be waiting for
+ * the callback's thread.
+ */
+__attribute__((fptrgroup("rtos_qspi_flash_submit_fptr_grp")))
+static void qspi_flash_remote_submit(
         rtos_qspi_flash_t *ctx,
-        uint8_t *data,
-        unsigned address,
-        size_t len)
+        rtos_qspi_flash_op_t *op)
 {
     rtos_intertile_address_t *host_address = &ctx->rpc_config->host_address;
     rtos_qspi_flash_t *host_ctx_ptr = ctx->rpc_config->host_ctx_ptr;
+    int from_callback = rtos_osal_thread_is_current(&ctx->rpc_client.done_thread);
 
     xassert(host_address->port >= 0);
 
-    rtos_osal_mutex_get(&ctx->mutex, RTOS_OSAL_WAIT_FOREVER);
+    if (!from_callback) {
+        rtos_osal_mutex_get(&ctx->mutex, RTOS_OSAL_WAIT_FOREVER);
+    }
 
-    do {
-        size_t read_len = MIN(len, RTOS_QSPI_FLASH_READ_CHUNK_SIZE);
+    switch (op->type) {
+    case rtos_qspi_flash_op_read: {
+        const rpc_param_desc_t rpc_param_desc[] = {
+                RPC_PARAM_TYPE(ctx),
+                RPC_PARAM_OUT_BUFFER(op->data, op->len),
+                RPC_PARAM_TYPE(op->address),
+                RPC_PARAM_TYPE(op->len),
+                RPC_PARAM_LIST_END
+        };
+
+        xassert(op->len <= QSPI_FLASH_RPC_READ_MAX);
+
+        if (op->cb != NULL) {
+            rpc_client_call_async_cb(
+                    &ctx->rpc_client, &op->rpc_call, qspi_flash_remote_op_done, ctx,
+                    fcode_read, rpc_param_desc,
+                    &host_ctx_ptr, op->data, &op->address, &op->len);
+        } else {
+            rpc_client_call_async(
+                    &ctx->rpc_client, &op->rpc_call,
+                    fcode_read, rpc_param_desc,
+                    &host_ctx_ptr, op->data, &op->address, &op->len);
+        }
+        break;
+    }
+    case rtos_qspi_flash_op_write: {
+        const rpc_param_desc_t rpc_param_desc[] = {
+                RPC_PARAM_TYPE(ctx),
+                RPC_PARAM_IN_BUFFER(op->data, op->len),
+                RPC_PARAM_TYPE(op->address),
+                RPC_PARAM_TYPE(op->len),
+                RPC_PARAM_LIST_END
+        };
 
+        if (op->cb != NULL) {
+            rpc_client_call_async_cb(
+                    &ctx->rpc_client, &op->rpc_call, qspi_flash_remote_op_done, ctx,
+                    fcode_write, rpc_param_desc,
+                    &host_ctx_ptr, op->data, &op->address, &op->len);
+        } else {
+            rpc_client_call_async(
+                    &ctx->rpc_client, &op->rpc_call,
+                    fcode_write, rpc_param_desc,
+                    &host_ctx_ptr, op->data, &op->address, &op->len);
+        }
+        break;
+    }
+    case rtos_qspi_flash_op_erase: {
         const rpc_param_desc_t rpc_param_desc[] = {
                 RPC_PARAM_TYPE(ctx),
-                RPC_PARAM_OUT_BUFFER(data, read_len),
-                RPC_PARAM_TYPE(address),
-                RPC_PARAM_TYPE(read_len),
+                RPC_PARAM_TYPE(op->address),
+                RPC_PARAM_TYPE(op->len),
                 RPC_PARAM_LIST_END
         };
 
-        rpc_client_call_generic(
-                host_address->intertile_ctx, host_address->port, fcode_read, rpc_param_desc,
-                &host_ctx_ptr, data, &address, &read_len);
+        if (op->cb != NULL) {
+            rpc_client_call_async_cb(
+                    &ctx->rpc_client, &op->rpc_call, qspi_flash_remote_op_done, ctx,
+                    fcode_erase, rpc_param_desc,
+                    &host_ctx_ptr, &op->address, &op->len);
+        } else {
+            rpc_client_call_async(
+                    &ctx->rpc_client, &op->rpc_call,
+                    fcode_erase, rpc_param_desc,
+                    &host_ctx_ptr, &op->address, &op->len);
+        }
+        break;
+    }
+    }
 
-        len -= read_len;
-        data += read_len;
-        address += read_len;
-    } while (len > 0);
+    if (!from_callback) {
+        rtos_osal_mutex_put(&ctx->mutex);
+    }
+}
 
-    rtos_osal_mutex_put(&ctx->mutex);
+__attribute__((fptrgroup("rtos_qspi_flash_op_wait_fptr_grp")))
+static rtos_osal_status_t qspi_flash_remote_op_wait(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op,
+        unsigned timeout)
+{
+    return rpc_client_call_wait(&ctx->rpc_client, &op->rpc_call, timeout);
+}
+
+__attribute__((fptrgroup("rtos_qspi_flash_read_fptr_grp")))
+static void qspi_flash_remote_read(
+        rtos_qspi_flash_t *ctx,
+        uint8_t *data,
+        unsigned address,
+        size_t len)
+{
+    rtos_qspi_flash_op_t op[2];
+    int sent = 0;
+    int done = 0;
+
+    /*
+     * The host streams the data as it reads it from the flash, and it is
+     * received straight into the caller's buffer. Longer reads are split
+     * into several calls, so that the link is released between them. Each
+     * call is sent before the one before it is waited for, so that the host
+     * starts on it as soon as it has streamed the previous one, rather than
+     * waiting a round trip for it.
+     */
+    while (len > 0 || done < sent) {
+        if (len > 0 && sent - done < 2) {
+            size_t read_len = MIN(len, QSPI_FLASH_RPC_READ_MAX);
+
+            rtos_qspi_flash_read_async(ctx, &op[sent % 2], data, address, read_len, NULL, NULL);
+            sent++;
+
+            len -= read_len;
+            data += read_len;
+            address += read_len;
+        } else {
+            qspi_flash_remote_op_wait(ctx, &op[done % 2], RTOS_OSAL_WAIT_FOREVER);
+            done++;
+        }
+    }
 }
 
 __attribute__((fptrgroup("rtos_qspi_flash_write_fptr_grp")))
@@ -104,26 +241,10 @@ static void qspi_flash_remote_write(
         unsigned address,
         size_t len)
 {
-    rtos_intertile_address_t *host_address = &ctx->rpc_config->host_address;
-    rtos_qspi_flash_t *host_ctx_ptr = ctx->rpc_config->host_ctx_ptr;
+    rtos_qspi_flash_op_t op;
 
-    xassert(host_address->port >= 0);
-
-    const rpc_param_desc_t rpc_param_desc[] = {
-            RPC_PARAM_TYPE(ctx),
-            RPC_PARAM_IN_BUFFER(data, len),
-            RPC_PARAM_TYPE(address),
-            RPC_PARAM_TYPE(len),
-            RPC_PARAM_LIST_END
-    };
-
-    rtos_osal_mutex_get(&ctx->mutex, RTOS_OSAL_WAIT_FOREVER);
-
-    rpc_client_call_generic(
-            host_address->intertile_ctx, host_address->port, fcode_write, rpc_param_desc,
-            &host_ctx_ptr, data, &address, &len);
-
-    rtos_osal_mutex_put(&ctx->mutex);
+    rtos_qspi_flash_write_async(ctx, &op, data, address, len, NULL, NULL);
+    qspi_flash_remote_op_wait(ctx, &op, RTOS_OSAL_WAIT_FOREVER);
 }
 
 __attribute__((fptrgroup("rtos_qspi_flash_erase_fptr_grp")))
@@ -132,31 +253,26 @@ static void qspi_flash_remote_erase(
         unsigned address,
         size_t len)
 {
-    rtos_intertile_address_t *host_address = &ctx->rpc_config->host_address;
-    rtos_qspi_flash_t *host_ctx_ptr = ctx->rpc_config->host_ctx_ptr;
+    rtos_qspi_flash_op_t op;
 
-    xassert(host_address->port >= 0);
-
-    const rpc_param_desc_t rpc_param_desc[] = {
-            RPC_PARAM_TYPE(ctx),
-            RPC_PARAM_TYPE(address),
-            RPC_PARAM_TYPE(len),
-            RPC_PARAM_LIST_END
-    };
-
-    rtos_osal_mutex_get(&ctx->mutex, RTOS_OSAL_WAIT_FOREVER);
-
-    rpc_client_call_generic(
-            host_address->intertile_ctx, host_address->port, fcode_erase, rpc_param_desc,
-            &host_ctx_ptr, &address, &len);
-
-    rtos_osal_mutex_put(&ctx->mutex);
+    rtos_qspi_flash_erase_async(ctx, &op, address, len, NULL, NULL);
+    qspi_flash_remote_op_wait(ctx, &op, RTOS_OSAL_WAIT_FOREVER);
 }
 
-static int qspi_flash_lock_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
+/*
+ * Trimming only allows erases to be done ahead of time, so it is not
+ * forwarded to the host.
+ */
+__attribute__((fptrgroup("rtos_qspi_flash_trim_fptr_grp")))
+static void qspi_flash_remote_trim(
+        rtos_qspi_flash_t *ctx,
+        unsigned address,
+        size_t len)
 {
-    int msg_length;
+}
 
+static void qspi_flash_lock_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
+{
     rtos_qspi_flash_t *ctx;
 
     rpc_request_unmarshall(
@@ -165,17 +281,13 @@ static int qspi_flash_lock_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
 
     rtos_qspi_flash_lock(ctx);
 
-    msg_length = rpc_response_marshall(
-            resp_msg, rpc_msg,
+    rpc_response_send(
+            client_address->intertile_ctx, client_address->port, rpc_msg,
             ctx);
-
-    return msg_length;
 }
 
-static int qspi_flash_unlock_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
+static void qspi_flash_unlock_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
 {
-    int msg_length;
-
     rtos_qspi_flash_t *ctx;
 
     rpc_request_unmarshall(
@@ -184,17 +296,13 @@ static int qspi_flash_unlock_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
 
     rtos_qspi_flash_unlock(ctx);
 
-    msg_length = rpc_response_marshall(
-            resp_msg, rpc_msg,
+    rpc_response_send(
+            client_address->intertile_ctx, client_address->port, rpc_msg,
             ctx);
-
-    return msg_length;
 }
 
-static int qspi_flash_read_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
+static void qspi_flash_read_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
 {
-    int msg_length;
-
     rtos_qspi_flash_t *ctx;
     uint8_t *data;
     unsigned address;
@@ -204,29 +312,52 @@ static int qspi_flash_read_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
             rpc_msg,
             &ctx, &data, &address, &len);
 
-    if (len > 0) {
-        data = rtos_osal_malloc(len);
+    if (len == 0) {
+        rpc_response_stream_start(client_address->intertile_ctx, client_address->port, rpc_msg);
     } else {
-        data = NULL;
-    }
+        rtos_qspi_flash_op_t op;
+        size_t chunk_len = MIN(len, QSPI_FLASH_RPC_STREAM_CHUNK_SIZE);
+        int cur = 0;
 
-    rtos_qspi_flash_read(ctx, data, address, len);
+        rtos_osal_mutex_get(&stream_lock, RTOS_OSAL_WAIT_FOREVER);
 
-    msg_length = rpc_response_marshall(
-            resp_msg, rpc_msg,
-            ctx, data, address, len);
+        /*
+         * The first chunk is read before the response is started, as the
+         * intertile link is held from then until the last chunk is sent.
+         * After that, each chunk is read from the flash while the one
+         * before it is sent.
+         */
+        rtos_qspi_flash_read(ctx, stream_buf[cur], address, chunk_len);
+        rpc_response_stream_start(client_address->intertile_ctx, client_address->port, rpc_msg);
 
-    if (len > 0) {
-        rtos_osal_free(data);
-    }
+        for (;;) {
+            size_t next_len;
+
+            address += chunk_len;
+            len -= chunk_len;
+            next_len = MIN(len, QSPI_FLASH_RPC_STREAM_CHUNK_SIZE);
+
+            if (next_len > 0) {
+                rtos_qspi_flash_read_async(ctx, &op, stream_buf[!cur], address, next_len, NULL, NULL);
+            }
+
+            rtos_intertile_tx_data(client_address->intertile_ctx, stream_buf[cur], chunk_len);
+
+            if (next_len == 0) {
+                break;
+            }
 
-    return msg_length;
+            rtos_qspi_flash_op_wait(ctx, &op, RTOS_OSAL_WAIT_FOREVER);
+            chunk_len = next_len;
+            cur = !cur;
+        }
+
+        rtos_osal_mutex_put(&stream_lock);
+    }
 }
 
-static int qspi_flash_write_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
+static void qspi_flash_write_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
 {
-    int msg_length;
-
     rtos_qspi_flash_t *ctx;
     uint8_t *data;
     unsigned address;
@@ -238,17 +369,13 @@ static int qspi_flash_write_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
 
     rtos_qspi_flash_write(ctx, data, address, len);
 
-    msg_length = rpc_response_marshall(
-            resp_msg, rpc_msg,
+    rpc_response_send(
+            client_address->intertile_ctx, client_address->port, rpc_msg,
             ctx, data, address, len);
-
-    return msg_length;
 }
 
-static int qspi_flash_erase_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
+static void qspi_flash_erase_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
 {
-    int msg_length;
-
     rtos_qspi_flash_t *ctx;
     unsigned address;
     size_t len;
@@ -259,51 +386,45 @@ static int qspi_flash_erase_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
 
     rtos_qspi_flash_erase(ctx, address, len);
 
-    msg_length = rpc_response_marshall(
-            resp_msg, rpc_msg,
+    rpc_response_send(
+            client_address->intertile_ctx, client_address->port, rpc_msg,
             ctx, address, len);
-
-    return msg_length;
 }
 
 static void qspi_flash_rpc_thread(rtos_intertile_address_t *client_address)
 {
-    int msg_length;
+    __attribute__((aligned(8))) uint8_t req_buf[RPC_HOST_REQUEST_BUF_SIZE];
     uint8_t *req_msg;
-    uint8_t *resp_msg;
     rpc_msg_t rpc_msg;
     rtos_intertile_t *intertile_ctx = client_address->intertile_ctx;
     uint8_t intertile_port = client_address->port;
 
     for (;;) {
         /* receive RPC request message from client */
-        msg_length = rtos_intertile_rx(intertile_ctx, intertile_port, (void **) &req_msg, RTOS_OSAL_WAIT_FOREVER);
+        req_msg = rpc_request_receive(intertile_ctx, intertile_port, req_buf, sizeof(req_buf));
 
         rpc_request_parse(&rpc_msg, req_msg);
 
+        /* each handler sends the RPC response message to the client */
         switch (rpc_msg.fcode) {
         case fcode_lock:
-            msg_length = qspi_flash_lock_rpc_host(&rpc_msg, &resp_msg);
+            qspi_flash_lock_rpc_host(client_address, &rpc_msg);
             break;
         case fcode_unlock:
-            msg_length = qspi_flash_unlock_rpc_host(&rpc_msg, &resp_msg);
+            qspi_flash_unlock_rpc_host(client_address, &rpc_msg);
             break;
         case fcode_read:
-            msg_length = qspi_flash_read_rpc_host(&rpc_msg, &resp_msg);
+            qspi_flash_read_rpc_host(client_address, &rpc_msg);
             break;
         case fcode_write:
-            msg_length = qspi_flash_write_rpc_host(&rpc_msg, &resp_msg);
+            qspi_flash_write_rpc_host(client_address, &rpc_msg);
             break;
         case fcode_erase:
-            msg_length = qspi_flash_erase_rpc_host(&rpc_msg, &resp_msg);
+            qspi_flash_erase_rpc_host(client_address, &rpc_msg);
             break;
         }
 
-        rtos_osal_free(req_msg);
-
-        /* send RPC response message to client */
-        rtos_intertile_tx(intertile_ctx, intertile_port, resp_msg, msg_length);
-        rtos_osal_free(resp_msg);
+        rpc_request_release(req_msg, req_buf);
     }
 }
 
@@ -311,8 +432,18 @@ __attribute__((fptrgroup("rtos_driver_rpc_host_start_fptr_grp")))
 static void qspi_flash_rpc_start(
         rtos_driver_rpc_t *rpc_config)
 {
+    /*
+     * The host lock is a mutex taken by one request and released by a later
+     * one, which must run on the same thread. Each client therefore always
+     * gets a thread of its own, even when a host pool is attached.
+     */
     xassert(rpc_config->host_task_priority >= 0);
 
+    if (!stream_lock_created) {
+        rtos_osal_mutex_create(&stream_lock, "qspi_rpc_stream", RTOS_OSAL_NOT_RECURSIVE);
+        stream_lock_created = 1;
+    }
+
     for (int i = 0; i < rpc_config->remote_client_count; i++) {
 
         rtos_intertile_address_t *client_address = &rpc_config->client_address[i];
@@ -339,9 +470,13 @@ void rtos_qspi_flash_rpc_config(
     if (rpc_config->remote_client_count == 0) {
         /* This is a client */
         rpc_config->host_address.port = intertile_port;
+        rpc_config->host_task_priority = host_task_priority;
 
         rtos_osal_mutex_create(&qspi_flash_ctx->mutex, "qspi_lock", RTOS_OSAL_RECURSIVE);
 
+        rpc_client_init(&qspi_flash_ctx->rpc_client, rpc_config->host_address.intertile_ctx, intertile_port);
+        rpc_client_start(&qspi_flash_ctx->rpc_client, host_task_priority);
+
     } else {
         for (int i = 0; i < rpc_config->remote_client_count; i++) {
             rpc_config->client_address[i].port = intertile_port;
@@ -361,6 +496,9 @@ void rtos_qspi_flash_rpc_client_init(
     qspi_flash_ctx->read = qspi_flash_remote_read;
     qspi_flash_ctx->write = qspi_flash_remote_write;
     qspi_flash_ctx->erase = qspi_flash_remote_erase;
+    qspi_flash_ctx->submit = qspi_flash_remote_submit;
+    qspi_flash_ctx->op_wait = qspi_flash_remote_op_wait;
+    qspi_flash_ctx->trim = qspi_flash_remote_trim;
     rpc_config->rpc_host_start = NULL;
     rpc_config->remote_client_count = 0;
     rpc_config->host_task_priority = -1;
@@ -384,6 +522,7 @@ void rtos_qspi_flash_rpc_host_init(
 {
     qspi_flash_ctx->rpc_config = rpc_config;
     rpc_config->rpc_host_start = qspi_flash_rpc_start;
+    rpc_config->host_pool = NULL;
     rpc_config->remote_client_count = remote_client_count;
 
     /* This must be configured later with rtos_qspi_flash_rpc_config() */
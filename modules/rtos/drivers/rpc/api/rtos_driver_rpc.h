@@ -8,6 +8,8 @@
 
 #include "rtos_intertile.h"
 
+struct rpc_host_pool_struct;
+
 /**
  * Typedef to the RTOS driver RPC configuration struct.
  */
@@ -31,6 +33,7 @@ struct rtos_driver_rpc_struct {
 
     size_t remote_client_count; /* This must be > 0 on the host. It must be 0 on the client */
     int host_task_priority; /* TODO: Consider renaming to rpc_task_priority. Could be used by client as well. */
+    struct rpc_host_pool_struct *host_pool; /* When not NULL, requests are serviced by this pool rather than by dedicated threads */
 
     __attribute__((fptrgroup("rtos_driver_rpc_host_start_fptr_grp")))
     void (*rpc_host_start)(rtos_driver_rpc_t *rpc_config); /* TODO: Consider renaming to rpc_task_start(). Could be used by client as well. */
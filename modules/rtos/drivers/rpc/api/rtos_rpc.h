@@ -11,8 +11,67 @@
 #define RTOS_RPC_H_
 
 #include <stdint.h>
+#include <stdarg.h>
 
+#include "rtos/osal/api/rtos_osal.h"
 #include "rtos_intertile.h"
+#include "rtos/drivers/rpc/api/rtos_driver_rpc.h"
+
+/**
+ * The maximum number of requests that a single RPC client may have
+ * outstanding at once. Request IDs are 1 to RPC_CLIENT_MAX_PENDING.
+ */
+#ifndef RPC_CLIENT_MAX_PENDING
+#define RPC_CLIENT_MAX_PENDING 8
+#endif
+
+/**
+ * The maximum number of parameters, including return values, that a
+ * function called with rpc_client_call_async() may have.
+ */
+#ifndef RPC_CALL_MAX_PARAMS
+#define RPC_CALL_MAX_PARAMS 8
+#endif
+
+#if RPC_CLIENT_MAX_PENDING > 24
+#error RPC_CLIENT_MAX_PENDING must not be greater than 24
+#endif
+
+/**
+ * The maximum number of worker threads that an RPC host pool may have.
+ */
+#ifndef RPC_HOST_POOL_MAX_WORKERS
+#define RPC_HOST_POOL_MAX_WORKERS 4
+#endif
+
+/**
+ * The maximum number of services, one per remote client of each driver,
+ * that may be registered with an RPC host pool.
+ */
+#ifndef RPC_HOST_POOL_MAX_SERVICES
+#define RPC_HOST_POOL_MAX_SERVICES 12
+#endif
+
+/**
+ * The maximum number of requests that an RPC host pool may hold after they
+ * have been received and before a worker has finished servicing them. Each
+ * one has a buffer of RPC_HOST_REQUEST_BUF_SIZE bytes in the pool. Once they
+ * are all in use, further requests are left unreceived on the intertile link
+ * until a worker finishes one, so this should be more than the number of
+ * workers.
+ */
+#ifndef RPC_HOST_POOL_MAX_REQUESTS
+#define RPC_HOST_POOL_MAX_REQUESTS 4
+#endif
+
+/**
+ * The size in bytes of the buffer that each RPC host thread receives
+ * requests into. Requests longer than this are received into a buffer
+ * allocated from the heap instead.
+ */
+#ifndef RPC_HOST_REQUEST_BUF_SIZE
+#define RPC_HOST_REQUEST_BUF_SIZE 256
+#endif
 
 /**
  * Initializes a parameter descriptor for parameters of standard types.
@@ -90,6 +149,7 @@ typedef struct {
  */
 typedef struct {
     int fcode;        /**< An enumerator that identifies the function */
+    int request_id;   /**< Identifies the request that a response belongs to. This is 0 for synchronous requests */
     int param_count;  /**< The number of parameters the function takes. Only populated by rpc_request_parse() */
     rpc_param_desc_t *param_desc; /**< A list of parameter descriptors for the function. Only populated by rpc_request_parse() */
     void *params;     /**< Pointer to the beginning of the receieved parameter values */
@@ -144,6 +204,33 @@ int rpc_request_marshall(uint8_t **msg, int fcode, const rpc_param_desc_t param_
  */
 void rpc_request_parse(rpc_msg_t *rpc_msg, uint8_t *msg_buf);
 
+/**
+ * Receives an RPC request message into a buffer provided by the caller, rather
+ * than into one allocated from the heap as rtos_intertile_rx() does. A request
+ * that does not fit in the buffer is received into a buffer allocated with
+ * rtos_osal_malloc() instead. Either way, the message must be released with
+ * rpc_request_release() once it has been serviced.
+ *
+ * Because this uses rtos_intertile_rx_len(), \p port must not be given a non-zero
+ * priority with rtos_intertile_port_priority_set().
+ *
+ * \param[in] intertile_ctx The intertile driver instance to receive the request on.
+ * \param[in] port          The intertile port to receive the request on.
+ * \param[in] buf           The buffer to receive the request into. This must be 8 byte aligned.
+ * \param[in] buf_size      The size in bytes of \p buf.
+ *
+ * \returns A pointer to the received RPC request message. This may be passed to rpc_request_parse().
+ */
+uint8_t *rpc_request_receive(rtos_intertile_t *intertile_ctx, uint8_t port, uint8_t *buf, size_t buf_size);
+
+/**
+ * Releases an RPC request message received by rpc_request_receive().
+ *
+ * \param[in] msg_buf A pointer to the RPC request message returned by rpc_request_receive().
+ * \param[in] buf     The buffer that was passed to rpc_request_receive().
+ */
+void rpc_request_release(uint8_t *msg_buf, uint8_t *buf);
+
 /**
  * Retrieves the arguments from a parsed RPC request message into a list of parameters.
  *
@@ -200,6 +287,56 @@ int rpc_response_marshall_va(uint8_t **msg, const rpc_msg_t *rpc_msg, va_list ap
  */
 int rpc_response_marshall(uint8_t **msg, const rpc_msg_t *rpc_msg, ...);
 
+/**
+ * Sends an RPC response message back to the remote caller. This sends the same message that
+ * rpc_response_marshall_va() creates, but rather than copying the return value and output buffer
+ * data into a newly allocated message buffer, each is transmitted directly from where it is. This
+ * is the preferred way to respond to a request that is made with rpc_client_call_generic(),
+ * particularly when the function has large output buffers.
+ *
+ * \param[in] intertile_ctx The intertile driver instance that the request was received on.
+ * \param[in] port          The intertile port that the request was received on.
+ * \param[in] rpc_msg       A pointer to an rpc_msg_t struct that has already been filled in by rpc_request_parse().
+ * \param[in] ap            The arguments that were passed to the called function. They must be in the same order
+ *                          and match the parameters that were passed to the function. Note that these should be the
+ *                          arguments as passed to the function, not pointers to them.
+ */
+void rpc_response_send_va(rtos_intertile_t *intertile_ctx, uint8_t port, const rpc_msg_t *rpc_msg, va_list ap);
+
+/**
+ * This is the same as rpc_response_send_va(), except that it takes a variable number
+ * of arguments for the function arguments, rather than a va_list of them.
+ *
+ * \param[in] intertile_ctx The intertile driver instance that the request was received on.
+ * \param[in] port          The intertile port that the request was received on.
+ * \param[in] rpc_msg       A pointer to an rpc_msg_t struct that has already been filled in by rpc_request_parse().
+ * \param[in] ...           The arguments that were passed to the called function. They must be in the same order
+ *                          and match the parameters that were passed to the function. Note that these should be the
+ *                          arguments as passed to the function, not pointers to them.
+ */
+void rpc_response_send(rtos_intertile_t *intertile_ctx, uint8_t port, const rpc_msg_t *rpc_msg, ...);
+
+/**
+ * Begins streaming an RPC response message for a function call to the client.
+ * Only the message length and function code are sent. The caller must then send
+ * the data of each of the function's output parameters, in order, with
+ * rtos_intertile_tx_data(), which it may split across any number of calls.
+ *
+ * This allows a large output buffer to be sent in pieces as it is produced,
+ * rather than all at once from a buffer that holds all of it. The client
+ * receives each output parameter straight into the buffer it passed to
+ * rpc_client_call().
+ *
+ * \note The intertile link is held from this call until the last byte of the
+ * output parameters has been sent. No other thread on this tile can send over
+ * it until then, so the data should be produced promptly.
+ *
+ * \param[in] intertile_ctx The intertile driver instance that the request was received on.
+ * \param[in] port          The intertile port that the request was received on.
+ * \param[in] rpc_msg       A pointer to an rpc_msg_t struct that has already been filled in by rpc_request_parse().
+ */
+void rpc_response_stream_start(rtos_intertile_t *intertile_ctx, uint8_t port, const rpc_msg_t *rpc_msg);
+
 /**
  * Parses a received RPC response message and fills in a provided rpc_msg_t struct. See also rpc_client_call_generic().
  *
@@ -240,6 +377,11 @@ void rpc_response_unmarshall(const rpc_msg_t *rpc_msg, const rpc_param_desc_t pa
  * This function may be used to call a remote function rather than the three separate functions rpc_request_marshall_va(),
  * rpc_response_parse(), and rpc_response_unmarshall_va(), as the sequence is generic enough to handle most remote functions.
  *
+ * The request is sent straight from the argument data, and output argument data is received straight into the argument
+ * buffers, so no message buffers are allocated from the heap. Because this uses rtos_intertile_tx_len() and
+ * rtos_intertile_rx_len(), \p port must not be given a non-zero priority with rtos_intertile_port_priority_set()
+ * on either tile.
+ *
  * \param[in] intertile_ctx An intertile driver instance that has already been initialized and started, and is connected
  *                          to the tile that hosts the remote function.
  * \param[in] port          The intertile port to send the request to, and listen for the response from.
@@ -249,7 +391,297 @@ void rpc_response_unmarshall(const rpc_msg_t *rpc_msg, const rpc_param_desc_t pa
  *                          the parameters described in the list \p param_desc. Each must be a pointer to the argument
  *                          data. Input argument data will be copied into the request message and sent to the remote
  *                          function. Output argument data will be received and copied to the argument pointers.
+ *
+ * \retval 0  on success.
+ * \retval -1 if the host responded with an empty message. The output arguments are not written in this case.
+ */
+int rpc_client_call_generic(rtos_intertile_t *intertile_ctx, uint8_t port, int fcode, const rpc_param_desc_t param_desc[], ...);
+
+/**
+ * The header of request messages that have a fixed layout, rather than one
+ * described by a list of parameter descriptors. These are built by the stubs
+ * that tools/rpc_gen/rpc_gen.py generates. Because param_count is 0,
+ * rpc_request_parse() may still be used on them, and the fixed part of the
+ * request starts at rpc_msg_t::msg_buf.
+ */
+typedef struct {
+    int fcode;        /**< The function code and request ID */
+    int param_count;  /**< Always 0 */
+} rpc_fixed_request_hdr_t;
+
+/**
+ * Typedef to the struct representing an asynchronous RPC call.
+ */
+typedef struct rpc_call_struct rpc_call_t;
+
+/**
+ * Function pointer type for functions that are called when an RPC call
+ * started with rpc_client_call_async_cb() completes. They are called one at
+ * a time from a thread that the client creates for them, so should not block
+ * for long. They may start another call with the same client, including by
+ * reusing \p call, and this never blocks waiting for a free request ID.
+ *
+ * \param call A pointer to the call that completed. Its output arguments
+ *             have been written.
+ * \param arg  The argument given when the call was started.
+ */
+typedef void (*rpc_call_done_cb_t)(rpc_call_t *call, void *arg);
+
+/**
+ * This attribute must be specified on all RPC call completion callback
+ * functions.
+ */
+#define RPC_CALL_DONE_CALLBACK_ATTR __attribute__((fptrgroup("rpc_call_done_cb_fptr_grp")))
+
+/**
+ * Struct representing an asynchronous RPC call that has been started with
+ * rpc_client_call_async(). The members in this struct should not be accessed
+ * directly.
+ */
+struct rpc_call_struct {
+    int fcode;
+    int request_id;
+    int param_count;
+    rpc_param_desc_t param_desc[RPC_CALL_MAX_PARAMS];
+    void *args[RPC_CALL_MAX_PARAMS];
+    RPC_CALL_DONE_CALLBACK_ATTR rpc_call_done_cb_t done_cb;
+    void *done_arg;
+};
+
+/**
+ * Struct representing an RPC client that may have several requests
+ * outstanding to the remote tile at once. Responses are matched to their
+ * requests by request ID, so they may be returned in any order.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    rtos_intertile_t *intertile_ctx;
+    uint8_t port;
+    rtos_osal_mutex_t lock;
+    rtos_osal_semaphore_t free_ids;
+    rtos_osal_event_group_t done;
+    rtos_osal_queue_t done_queue;
+    rtos_osal_thread_t done_thread;
+    int reserved_id;
+    rpc_call_t *pending[RPC_CLIENT_MAX_PENDING];
+} rpc_client_t;
+
+/**
+ * Initializes an RPC client.
+ *
+ * The client must have exclusive use of \p port on its tile. Calls made with
+ * rpc_client_call_generic() may not be made on the same port.
+ *
+ * \param client        A pointer to the RPC client to initialize.
+ * \param intertile_ctx An intertile driver instance that is connected to the tile
+ *                      that hosts the remote functions.
+ * \param port          The intertile port to send requests to, and receive responses from.
+ *                      This must not be given a non-zero priority with
+ *                      rtos_intertile_port_priority_set() on either tile.
+ */
+void rpc_client_init(rpc_client_t *client, rtos_intertile_t *intertile_ctx, uint8_t port);
+
+/**
+ * Starts an RPC client. This creates the thread that receives responses and
+ * completes the outstanding calls, and the thread that calls the completion
+ * callbacks of calls started with rpc_client_call_async_cb(). Calls may be
+ * started before this is called, but they will not complete until it has been.
+ *
+ * \param client   A pointer to the RPC client to start.
+ * \param priority The priority of the client's threads.
+ */
+void rpc_client_start(rpc_client_t *client, unsigned priority);
+
+/**
+ * Starts a call to a remote function and returns as soon as the request has been sent,
+ * without waiting for the response. The call must subsequently be completed with
+ * rpc_client_call_wait().
+ *
+ * If the client already has RPC_CLIENT_MAX_PENDING calls outstanding, this blocks until
+ * one of them completes.
+ *
+ * \param client     A pointer to the RPC client to make the call with.
+ * \param call       A pointer to the call to start. This must remain valid until the call is
+ *                   passed to rpc_client_call_wait().
+ * \param fcode      The function code enumerator. This must be less than 0x10000.
+ * \param param_desc Parameter descriptor list. This describes each of the remote function's
+ *                   parameters, as well as its return value(s). It must not have more than
+ *                   RPC_CALL_MAX_PARAMS entries.
+ * \param ap         The arguments to pass to the remote function. Each must be a pointer to
+ *                   the argument data. Input argument data is sent before this returns. Output
+ *                   argument data is written straight to the argument pointers when the response
+ *                   is received, so these must remain valid until rpc_client_call_wait() returns.
+ */
+void rpc_client_call_async_va(rpc_client_t *client, rpc_call_t *call, int fcode, const rpc_param_desc_t param_desc[], va_list ap);
+
+/**
+ * This is the same as rpc_client_call_async_va(), except that it takes a variable number
+ * of arguments for the remote function arguments, rather than a va_list of them.
+ */
+void rpc_client_call_async(rpc_client_t *client, rpc_call_t *call, int fcode, const rpc_param_desc_t param_desc[], ...);
+
+/**
+ * This is the same as rpc_client_call_async(), except that rather than being waited for
+ * with rpc_client_call_wait(), the call calls \p done_cb when it completes.
+ *
+ * When this is called from within a completion callback of the same client, the request
+ * ID of the call that just completed is reused, so that a callback never blocks waiting
+ * for a free one.
+ *
+ * \param client     A pointer to the RPC client to make the call with.
+ * \param call       A pointer to the call to start. This must remain valid until \p done_cb
+ *                   is called.
+ * \param done_cb    The function to call when the response is received.
+ * \param done_arg   An argument to pass to \p done_cb.
+ * \param fcode      The function code enumerator. This must be less than 0x10000.
+ * \param param_desc Parameter descriptor list. It must not have more than
+ *                   RPC_CALL_MAX_PARAMS entries.
+ * \param ...        The arguments to pass to the remote function. Each must be a pointer to
+ *                   the argument data. Output argument data must remain valid until \p done_cb
+ *                   is called.
+ */
+void rpc_client_call_async_cb(rpc_client_t *client, rpc_call_t *call, rpc_call_done_cb_t done_cb, void *done_arg, int fcode, const rpc_param_desc_t param_desc[], ...);
+
+/**
+ * Waits for a call started with rpc_client_call_async() to complete. Once this returns
+ * RTOS_OSAL_SUCCESS the output arguments of the call have been written.
+ *
+ * \param client  A pointer to the RPC client that the call was made with.
+ * \param call    A pointer to the call to wait for.
+ * \param timeout The maximum time to wait for the call to complete.
+ *
+ * \retval RTOS_OSAL_SUCCESS once the call has completed.
+ * \retval RTOS_OSAL_TIMEOUT if it has not completed before the timeout. It must
+ *         then be waited for again.
+ */
+rtos_osal_status_t rpc_client_call_wait(rpc_client_t *client, rpc_call_t *call, unsigned timeout);
+
+/**
+ * Calls a remote function and waits for it to complete. This is the same as
+ * rpc_client_call_async() followed by rpc_client_call_wait(). Several threads
+ * may use this at once with the same client, in which case their requests are
+ * all outstanding together rather than each waiting for the previous one to
+ * complete.
+ *
+ * \param client     A pointer to the RPC client to make the call with.
+ * \param fcode      The function code enumerator. This must be less than 0x10000.
+ * \param param_desc Parameter descriptor list. It must not have more than
+ *                   RPC_CALL_MAX_PARAMS entries.
+ * \param ...        The arguments to pass to the remote function. Each must be a pointer to
+ *                   the argument data.
+ */
+void rpc_client_call(rpc_client_t *client, int fcode, const rpc_param_desc_t param_desc[], ...);
+
+/**
+ * Function pointer type for the functions that service the requests made to an
+ * RPC host. The function must execute the request described by \p rpc_msg and send
+ * the response to \p client_address. It must not free the request message.
+ *
+ * \param client_address The address of the client that made the request.
+ * \param rpc_msg        The parsed request message.
+ */
+typedef void (*rpc_host_dispatch_t)(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg);
+
+/**
+ * Declares an RPC host dispatch function.
+ */
+#define RPC_HOST_DISPATCH_ATTR __attribute__((fptrgroup("rpc_host_dispatch_fptr_grp")))
+
+/**
+ * Typedef to the RPC host pool struct.
+ */
+typedef struct rpc_host_pool_struct rpc_host_pool_t;
+
+/**
+ * Struct representing the requests from a single client to a single RPC host.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    rpc_host_pool_t *pool;
+    rtos_intertile_address_t *client_address;
+    RPC_HOST_DISPATCH_ATTR rpc_host_dispatch_t dispatch;
+} rpc_host_service_t;
+
+/**
+ * Struct representing a request that an RPC host pool has received and
+ * that is waiting for, or being serviced by, a worker.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    rpc_host_service_t *service;
+    uint8_t *msg_buf;
+    int buf_index;
+} rpc_host_request_t;
+
+/**
+ * Struct representing a pool of worker threads that services the requests
+ * made to several RPC hosts. When a request arrives, the pool's receive thread
+ * reads it from the intertile link into one of the pool's request buffers, and
+ * the first worker to become free services it. The link is therefore never
+ * left waiting for a worker to finish a request that blocks.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+struct rpc_host_pool_struct {
+    int worker_count;
+    rtos_osal_queue_t notify_queue;
+    rtos_osal_queue_t request_queue;
+    rtos_osal_queue_t free_queue;
+    __attribute__((aligned(8))) uint8_t request_buf[RPC_HOST_POOL_MAX_REQUESTS][RPC_HOST_REQUEST_BUF_SIZE];
+
+    int service_count;
+    rpc_host_service_t service[RPC_HOST_POOL_MAX_SERVICES];
+};
+
+/**
+ * Initializes an RPC host pool.
+ *
+ * \param pool         A pointer to the RPC host pool to initialize.
+ * \param worker_count The number of worker threads in the pool. This must not
+ *                     be greater than RPC_HOST_POOL_MAX_WORKERS. A request that blocks,
+ *                     such as an I2S or mic array receive, occupies a worker until it
+ *                     completes, so there should be more workers than there are hosts
+ *                     with requests that may block for a long time.
+ */
+void rpc_host_pool_init(rpc_host_pool_t *pool, int worker_count);
+
+/**
+ * Starts an RPC host pool. This creates its receive thread and its worker threads.
+ *
+ * \param pool     A pointer to the RPC host pool to start.
+ * \param priority The priority of the receive and worker threads.
+ */
+void rpc_host_pool_start(rpc_host_pool_t *pool, unsigned priority);
+
+/**
+ * Sets the RPC host pool that will service the requests made to a driver
+ * instance that hosts RPC. This must be called after the driver's RPC host
+ * initialization function, and before its RPC start function is called.
+ *
+ * Drivers whose hosts take a lock in one request and release it in a later one,
+ * such as the SPI master and QSPI flash drivers, ignore the pool and always use
+ * threads of their own, as the lock must be released by the thread that took it.
+ *
+ * \param pool       A pointer to the RPC host pool.
+ * \param rpc_config A pointer to the driver instance's RPC configuration.
+ */
+void rpc_host_pool_attach(rpc_host_pool_t *pool, rtos_driver_rpc_t *rpc_config);
+
+/**
+ * Starts servicing the requests made by each remote client of an RPC host.
+ * If a pool has been attached to \p rpc_config with rpc_host_pool_attach(),
+ * each client is registered with it. Otherwise a thread is created for each
+ * client, with the priority set in \p rpc_config.
+ *
+ * This is intended for use by the drivers' RPC start functions.
+ *
+ * \param rpc_config The RPC configuration of the driver instance.
+ * \param name       The name of the threads, if any are created.
+ * \param dispatch   The function that services each request.
  */
-void rpc_client_call_generic(rtos_intertile_t *intertile_ctx, uint8_t port, int fcode, const rpc_param_desc_t param_desc[], ...);
+void rpc_host_start(rtos_driver_rpc_t *rpc_config, char *name, rpc_host_dispatch_t dispatch);
 
 #endif /* RTOS_RPC_H_ */
@@ -10,6 +10,27 @@
 #include "rtos/osal/api/rtos_osal.h"
 #include "rtos/drivers/rpc/api/rtos_rpc.h"
 
+/*
+ * The first word of every request and response message holds the function
+ * code in its lower 16 bits and the request ID in the 8 bits above that.
+ * Synchronous requests use ID 0, so their messages are unchanged.
+ */
+#define RPC_FCODE_MASK          0xFFFF
+#define RPC_REQUEST_ID_SHIFT    16
+#define RPC_REQUEST_ID_MASK     0xFF
+
+static int fcode_word_get(int fcode, int request_id)
+{
+    xassert((fcode & ~RPC_FCODE_MASK) == 0);
+    return fcode | (request_id << RPC_REQUEST_ID_SHIFT);
+}
+
+static void fcode_word_parse(rpc_msg_t *rpc_msg, int fcode_word)
+{
+    rpc_msg->fcode = fcode_word & RPC_FCODE_MASK;
+    rpc_msg->request_id = (fcode_word >> RPC_REQUEST_ID_SHIFT) & RPC_REQUEST_ID_MASK;
+}
+
 int rpc_request_marshall_va(uint8_t **msg, int fcode, const rpc_param_desc_t param_desc[], va_list ap)
 {
     int param_count;
@@ -31,6 +52,8 @@ int rpc_request_marshall_va(uint8_t **msg, int fcode, const rpc_param_desc_t par
                  sizeof(rpc_param_desc_t) * param_count +  /* Space for each parameter descriptor */
                  param_total_length;                       /* Space for the parameters themselves */
 
+    fcode = fcode_word_get(fcode, 0);
+
     *msg = rtos_osal_malloc(msg_length);
     msg_ptr = *msg;
 
@@ -67,9 +90,12 @@ int rpc_request_marshall(uint8_t **msg, int fcode, const rpc_param_desc_t param_
 
 void rpc_request_parse(rpc_msg_t *rpc_msg, uint8_t *msg_buf)
 {
+    int fcode_word;
+
     rpc_msg->msg_buf = msg_buf;
 
-    memcpy(&rpc_msg->fcode, msg_buf, sizeof(int));
+    memcpy(&fcode_word, msg_buf, sizeof(int));
+    fcode_word_parse(rpc_msg, fcode_word);
     msg_buf += sizeof(int);
     memcpy(&rpc_msg->param_count, msg_buf, sizeof(int));
     msg_buf += sizeof(int);
@@ -78,6 +104,34 @@ void rpc_request_parse(rpc_msg_t *rpc_msg, uint8_t *msg_buf)
     rpc_msg->params = msg_buf;
 }
 
+uint8_t *rpc_request_receive(rtos_intertile_t *intertile_ctx, uint8_t port, uint8_t *buf, size_t buf_size)
+{
+    size_t msg_length;
+    uint8_t *msg_buf;
+
+    do {
+        msg_length = rtos_intertile_rx_len(intertile_ctx, port, RTOS_OSAL_WAIT_FOREVER);
+    } while (msg_length == 0);
+
+    if (msg_length <= buf_size) {
+        msg_buf = buf;
+    } else {
+        msg_buf = rtos_osal_malloc(msg_length);
+        xassert(msg_buf != NULL);
+    }
+
+    rtos_intertile_rx_data(intertile_ctx, msg_buf, msg_length);
+
+    return msg_buf;
+}
+
+void rpc_request_release(uint8_t *msg_buf, uint8_t *buf)
+{
+    if (msg_buf != buf) {
+        rtos_osal_free(msg_buf);
+    }
+}
+
 void rpc_request_unmarshall_va(rpc_msg_t *rpc_msg, va_list ap)
 {
     int i;
@@ -121,65 +175,95 @@ void rpc_request_unmarshall(rpc_msg_t *rpc_msg, ...)
     va_end(ap);
 }
 
-int rpc_response_marshall_va(uint8_t **msg, const rpc_msg_t *rpc_msg, va_list ap)
+typedef union {
+    int64_t arg64;
+    int32_t arg32;
+    int16_t arg16;
+    int8_t arg8;
+} rpc_arg_t;
+
+/*
+ * Gets a pointer to the data of the next function argument passed to
+ * one of the response marshalling functions. Arguments that are not
+ * pointers are passed by value and are stored in arg.
+ */
+static void *response_arg_get(const rpc_param_desc_t *param_desc, va_list *ap, rpc_arg_t *arg)
+{
+    void *arg_ptr = NULL;
+
+    if (param_desc->ptr) {
+        arg_ptr = va_arg(*ap, void *);
+    } else {
+        switch (param_desc->length) {
+        case sizeof(int8_t):
+            arg->arg8 = va_arg(*ap, int32_t);
+            arg_ptr = &arg->arg8;
+            break;
+        case sizeof(int16_t):
+            arg->arg16 = va_arg(*ap, int32_t);
+            arg_ptr = &arg->arg16;
+            break;
+        case sizeof(int32_t):
+            arg->arg32 = va_arg(*ap, int32_t);
+            arg_ptr = &arg->arg32;
+            break;
+        case sizeof(int64_t):
+            arg->arg64 = va_arg(*ap, int64_t);
+            arg_ptr = &arg->arg64;
+            break;
+        default:
+            xassert(0);
+        }
+    }
+
+    return arg_ptr;
+}
+
+static int response_length_get(const rpc_msg_t *rpc_msg)
 {
     int param_total_length = 0;
-    int i;
-    int msg_length;
-    uint8_t *msg_ptr;
 
-    for (i = 0; i < rpc_msg->param_count; i++) {
+    for (int i = 0; i < rpc_msg->param_count; i++) {
         if (rpc_msg->param_desc[i].output) {
             param_total_length += rpc_msg->param_desc[i].length;
         }
     }
 
-    msg_length = sizeof(int) +                             /* Space for the function code */
-                 param_total_length;                       /* Space for the parameters themselves */
+    return sizeof(int) +                             /* Space for the function code */
+           param_total_length;                       /* Space for the parameters themselves */
+}
+
+int rpc_response_marshall_va(uint8_t **msg, const rpc_msg_t *rpc_msg, va_list ap)
+{
+    int i;
+    int msg_length;
+    int fcode_word;
+    uint8_t *msg_ptr;
+    va_list ap_copy;
+
+    msg_length = response_length_get(rpc_msg);
+    fcode_word = fcode_word_get(rpc_msg->fcode, rpc_msg->request_id);
 
     *msg = rtos_osal_malloc(msg_length);
     msg_ptr = *msg;
 
-    memcpy(msg_ptr, &rpc_msg->fcode, sizeof(int));
+    memcpy(msg_ptr, &fcode_word, sizeof(int));
     msg_ptr += sizeof(int);
 
+    va_copy(ap_copy, ap);
+
     for (i = 0; i < rpc_msg->param_count; i++) {
-        int64_t arg64;
-        void *arg_ptr;
-        int32_t arg32;
-        int16_t arg16;
-        int8_t arg8;
+        rpc_arg_t arg;
+        void *arg_ptr = response_arg_get(&rpc_msg->param_desc[i], &ap_copy, &arg);
 
-        if (rpc_msg->param_desc[i].ptr) {
-            arg_ptr = va_arg(ap, void *);
-        } else {
-            switch (rpc_msg->param_desc[i].length) {
-            case sizeof(int8_t):
-                arg8 = va_arg(ap, int32_t);
-                arg_ptr = &arg8;
-                break;
-            case sizeof(int16_t):
-                arg16 = va_arg(ap, int32_t);
-                arg_ptr = &arg16;
-                break;
-            case sizeof(int32_t):
-                arg32 = va_arg(ap, int32_t);
-                arg_ptr = &arg32;
-                break;
-            case sizeof(int64_t):
-                arg64 = va_arg(ap, int64_t);
-                arg_ptr = &arg64;
-                break;
-            default:
-                xassert(0);
-            }
-        }
         if (rpc_msg->param_desc[i].output) {
             memcpy(msg_ptr, arg_ptr, rpc_msg->param_desc[i].length);
             msg_ptr += rpc_msg->param_desc[i].length;
         }
     }
 
+    va_end(ap_copy);
+
     return msg_length;
 }
 
@@ -195,11 +279,54 @@ int rpc_response_marshall(uint8_t **msg, const rpc_msg_t *rpc_msg, ...)
     return msg_length;
 }
 
+void rpc_response_send_va(rtos_intertile_t *intertile_ctx, uint8_t port, const rpc_msg_t *rpc_msg, va_list ap)
+{
+    int i;
+    int fcode_word = fcode_word_get(rpc_msg->fcode, rpc_msg->request_id);
+    va_list ap_copy;
+
+    rtos_intertile_tx_len(intertile_ctx, port, response_length_get(rpc_msg));
+    rtos_intertile_tx_data(intertile_ctx, &fcode_word, sizeof(int));
+
+    va_copy(ap_copy, ap);
+
+    for (i = 0; i < rpc_msg->param_count; i++) {
+        rpc_arg_t arg;
+        void *arg_ptr = response_arg_get(&rpc_msg->param_desc[i], &ap_copy, &arg);
+
+        if (rpc_msg->param_desc[i].output && rpc_msg->param_desc[i].length > 0) {
+            rtos_intertile_tx_data(intertile_ctx, arg_ptr, rpc_msg->param_desc[i].length);
+        }
+    }
+
+    va_end(ap_copy);
+}
+
+void rpc_response_stream_start(rtos_intertile_t *intertile_ctx, uint8_t port, const rpc_msg_t *rpc_msg)
+{
+    int fcode_word = fcode_word_get(rpc_msg->fcode, rpc_msg->request_id);
+
+    rtos_intertile_tx_len(intertile_ctx, port, response_length_get(rpc_msg));
+    rtos_intertile_tx_data(intertile_ctx, &fcode_word, sizeof(int));
+}
+
+void rpc_response_send(rtos_intertile_t *intertile_ctx, uint8_t port, const rpc_msg_t *rpc_msg, ...)
+{
+    va_list ap;
+
+    va_start(ap, rpc_msg);
+    rpc_response_send_va(intertile_ctx, port, rpc_msg, ap);
+    va_end(ap);
+}
+
 void rpc_response_parse(rpc_msg_t *rpc_msg, uint8_t *msg_buf)
 {
+    int fcode_word;
+
     rpc_msg->msg_buf = msg_buf;
 
-    memcpy(&rpc_msg->fcode, msg_buf, sizeof(int));
+    memcpy(&fcode_word, msg_buf, sizeof(int));
+    fcode_word_parse(rpc_msg, fcode_word);
     msg_buf += sizeof(int);
     rpc_msg->params = msg_buf;
 }
@@ -228,44 +355,496 @@ void rpc_response_unmarshall(const rpc_msg_t *rpc_msg, const rpc_param_desc_t pa
     va_end(ap);
 }
 
-void rpc_client_call_generic(rtos_intertile_t *intertile_ctx, uint8_t port, int fcode, const rpc_param_desc_t param_desc[], ...)
+int rpc_client_call_generic(rtos_intertile_t *intertile_ctx, uint8_t port, int fcode, const rpc_param_desc_t param_desc[], ...)
 {
-    uint8_t *req_msg;
-    uint8_t *resp_msg;
-    rpc_msg_t rpc_msg;
+    int param_count;
+    int param_total_length = 0;
+    int i;
     int msg_length;
+    int resp_fcode;
     va_list ap_init, ap;
 
     va_start(ap_init, param_desc);
 
+    for (i = 0; param_desc[i].input || param_desc[i].output; i++) {
+        if (param_desc[i].input) {
+            param_total_length += param_desc[i].length;
+        }
+    }
+
+    param_count = i;
+
+    msg_length = sizeof(int) +                             /* Space for the function code */
+                 sizeof(int) +                             /* Space for the parameter count */
+                 sizeof(rpc_param_desc_t) * param_count +  /* Space for each parameter descriptor */
+                 param_total_length;                       /* Space for the parameters themselves */
+
+    /*
+     * Send the RPC request message to the host. This has the same layout
+     * as the message built by rpc_request_marshall_va(), but each part is
+     * sent straight from the caller's memory rather than first being copied
+     * into a contiguous buffer.
+     */
+    fcode = fcode_word_get(fcode, 0);
+
+    rtos_intertile_tx_len(intertile_ctx, port, msg_length);
+    rtos_intertile_tx_data(intertile_ctx, &fcode, sizeof(int));
+    rtos_intertile_tx_data(intertile_ctx, &param_count, sizeof(int));
+    rtos_intertile_tx_data(intertile_ctx, (void *) param_desc, sizeof(rpc_param_desc_t) * param_count);
+
     va_copy(ap, ap_init);
-    msg_length = rpc_request_marshall_va(
-            &req_msg, fcode, param_desc,
-            ap);
-    va_end(ap);
+    for (i = 0; i < param_count; i++) {
+        void *arg_ptr = va_arg(ap, void *);
 
-    /* send RPC request message to host */
-    rtos_intertile_tx(intertile_ctx, port, req_msg, msg_length);
-    rtos_osal_free(req_msg);
+        if (param_desc[i].input && param_desc[i].length > 0) {
+            rtos_intertile_tx_data(intertile_ctx, arg_ptr, param_desc[i].length);
+        }
+    }
+    va_end(ap);
 
-    /* receive RPC response message from host */
-    msg_length = rtos_intertile_rx(intertile_ctx, port, (void **) &resp_msg, RTOS_OSAL_WAIT_FOREVER);
+    /*
+     * Receive the RPC response message from the host, with each output
+     * parameter written straight to the caller's memory.
+     */
+    msg_length = rtos_intertile_rx_len(intertile_ctx, port, RTOS_OSAL_WAIT_FOREVER);
     if (msg_length == 0) {
-        /* TODO: What to do here? */
-        xassert(0);
+        /* The host sent no response, so there are no output arguments to write */
+        va_end(ap_init);
+        return -1;
     }
 
-    rpc_response_parse(&rpc_msg, resp_msg);
+    rtos_intertile_rx_data(intertile_ctx, &resp_fcode, sizeof(int));
+    msg_length -= sizeof(int);
 
-    xassert(rpc_msg.fcode == fcode);
+    xassert(resp_fcode == fcode);
 
     va_copy(ap, ap_init);
-    rpc_response_unmarshall_va(
-            &rpc_msg, param_desc,
-            ap);
+    for (i = 0; i < param_count; i++) {
+        void *arg_ptr = va_arg(ap, void *);
+
+        if (param_desc[i].output && param_desc[i].length > 0) {
+            rtos_intertile_rx_data(intertile_ctx, arg_ptr, param_desc[i].length);
+            msg_length -= param_desc[i].length;
+        }
+    }
     va_end(ap);
 
-    rtos_osal_free(resp_msg);
+    xassert(msg_length == 0);
 
     va_end(ap_init);
+
+    return 0;
+}
+
+static void rpc_client_thread(rpc_client_t *client)
+{
+    rtos_intertile_t *intertile_ctx = client->intertile_ctx;
+    int msg_length;
+    int fcode_word;
+    rpc_msg_t rpc_msg;
+    rpc_call_t *call;
+
+    for (;;) {
+        msg_length = rtos_intertile_rx_len(intertile_ctx, client->port, RTOS_OSAL_WAIT_FOREVER);
+        if (msg_length == 0) {
+            continue;
+        }
+
+        rtos_intertile_rx_data(intertile_ctx, &fcode_word, sizeof(int));
+        msg_length -= sizeof(int);
+        fcode_word_parse(&rpc_msg, fcode_word);
+
+        xassert(rpc_msg.request_id >= 1 && rpc_msg.request_id <= RPC_CLIENT_MAX_PENDING);
+
+        rtos_osal_mutex_get(&client->lock, RTOS_OSAL_WAIT_FOREVER);
+        call = client->pending[rpc_msg.request_id - 1];
+        rtos_osal_mutex_put(&client->lock);
+
+        xassert(call != NULL);
+        xassert(call->fcode == rpc_msg.fcode);
+
+        /* Output parameters are written straight to the caller's memory */
+        for (int i = 0; i < call->param_count; i++) {
+            if (call->param_desc[i].output && call->param_desc[i].length > 0) {
+                rtos_intertile_rx_data(intertile_ctx, call->args[i], call->param_desc[i].length);
+                msg_length -= call->param_desc[i].length;
+            }
+        }
+
+        xassert(msg_length == 0);
+
+        if (call->done_cb != NULL) {
+            /*
+             * The callback may send another request, which would block while
+             * the host is blocked sending a response to this thread. It is
+             * therefore called from a thread of its own. The queue has room
+             * for every outstanding call, so this never blocks.
+             */
+            rtos_osal_queue_send(&client->done_queue, &call, RTOS_OSAL_WAIT_FOREVER);
+        } else {
+            rtos_osal_event_group_set_bits(&client->done, 1 << (rpc_msg.request_id - 1));
+        }
+    }
+}
+
+static void rpc_client_done_thread(rpc_client_t *client)
+{
+    rpc_call_t *call;
+
+    for (;;) {
+        rtos_osal_queue_receive(&client->done_queue, &call, RTOS_OSAL_WAIT_FOREVER);
+
+        /*
+         * The request ID is kept for a call that the callback may start, so
+         * that it never waits for an ID on this thread, which is the one
+         * that frees the IDs of calls that have callbacks.
+         */
+        client->reserved_id = call->request_id;
+        call->done_cb(call, call->done_arg);
+
+        if (client->reserved_id != 0) {
+            rtos_osal_mutex_get(&client->lock, RTOS_OSAL_WAIT_FOREVER);
+            client->pending[client->reserved_id - 1] = NULL;
+            rtos_osal_mutex_put(&client->lock);
+            client->reserved_id = 0;
+            rtos_osal_semaphore_put(&client->free_ids);
+        }
+    }
+}
+
+static void rpc_client_call_start(rpc_client_t *client, rpc_call_t *call, rpc_call_done_cb_t done_cb, void *done_arg, int fcode, const rpc_param_desc_t param_desc[], va_list ap)
+{
+    int param_count;
+    int param_total_length = 0;
+    int i;
+    int msg_length;
+    int fcode_word;
+
+    for (i = 0; param_desc[i].input || param_desc[i].output; i++) {
+        xassert(i < RPC_CALL_MAX_PARAMS);
+        call->param_desc[i] = param_desc[i];
+        call->args[i] = va_arg(ap, void *);
+        if (param_desc[i].input) {
+            param_total_length += param_desc[i].length;
+        }
+    }
+
+    param_count = i;
+    call->param_count = param_count;
+    call->fcode = fcode;
+    call->done_cb = done_cb;
+    call->done_arg = done_arg;
+
+    if (client->reserved_id != 0 && rtos_osal_thread_is_current(&client->done_thread)) {
+        /* Called from a completion callback, which reuses the ID of the call that completed */
+        rtos_osal_mutex_get(&client->lock, RTOS_OSAL_WAIT_FOREVER);
+        client->pending[client->reserved_id - 1] = call;
+        call->request_id = client->reserved_id;
+        rtos_osal_mutex_put(&client->lock);
+        client->reserved_id = 0;
+    } else {
+        /* Reserve a request ID, waiting for an outstanding call to complete if there are none free */
+        rtos_osal_semaphore_get(&client->free_ids, RTOS_OSAL_WAIT_FOREVER);
+
+        rtos_osal_mutex_get(&client->lock, RTOS_OSAL_WAIT_FOREVER);
+        for (i = 0; client->pending[i] != NULL; i++) {
+            xassert(i < RPC_CLIENT_MAX_PENDING - 1);
+        }
+        client->pending[i] = call;
+        call->request_id = i + 1;
+        rtos_osal_mutex_put(&client->lock);
+    }
+
+    msg_length = sizeof(int) +                             /* Space for the function code */
+                 sizeof(int) +                             /* Space for the parameter count */
+                 sizeof(rpc_param_desc_t) * param_count +  /* Space for each parameter descriptor */
+                 param_total_length;                       /* Space for the parameters themselves */
+
+    fcode_word = fcode_word_get(fcode, call->request_id);
+
+    /*
+     * The intertile link is held from rtos_intertile_tx_len() until the last
+     * byte of the message is sent, so requests from several threads are never
+     * interleaved.
+     */
+    rtos_intertile_tx_len(client->intertile_ctx, client->port, msg_length);
+    rtos_intertile_tx_data(client->intertile_ctx, &fcode_word, sizeof(int));
+    rtos_intertile_tx_data(client->intertile_ctx, &param_count, sizeof(int));
+    rtos_intertile_tx_data(client->intertile_ctx, call->param_desc, sizeof(rpc_param_desc_t) * param_count);
+
+    for (i = 0; i < param_count; i++) {
+        if (param_desc[i].input && param_desc[i].length > 0) {
+            rtos_intertile_tx_data(client->intertile_ctx, call->args[i], param_desc[i].length);
+        }
+    }
+}
+
+void rpc_client_call_async_va(rpc_client_t *client, rpc_call_t *call, int fcode, const rpc_param_desc_t param_desc[], va_list ap)
+{
+    rpc_client_call_start(client, call, NULL, NULL, fcode, param_desc, ap);
+}
+
+void rpc_client_call_async(rpc_client_t *client, rpc_call_t *call, int fcode, const rpc_param_desc_t param_desc[], ...)
+{
+    va_list ap;
+
+    va_start(ap, param_desc);
+    rpc_client_call_start(client, call, NULL, NULL, fcode, param_desc, ap);
+    va_end(ap);
+}
+
+void rpc_client_call_async_cb(rpc_client_t *client, rpc_call_t *call, rpc_call_done_cb_t done_cb, void *done_arg, int fcode, const rpc_param_desc_t param_desc[], ...)
+{
+    va_list ap;
+
+    xassert(done_cb != NULL);
+
+    va_start(ap, param_desc);
+    rpc_client_call_start(client, call, done_cb, done_arg, fcode, param_desc, ap);
+    va_end(ap);
+}
+
+rtos_osal_status_t rpc_client_call_wait(rpc_client_t *client, rpc_call_t *call, unsigned timeout)
+{
+    uint32_t flags;
+    rtos_osal_status_t status;
+
+    status = rtos_osal_event_group_get_bits(&client->done,
+                                            1 << (call->request_id - 1),
+                                            RTOS_OSAL_OR_CLEAR,
+                                            &flags,
+                                            timeout);
+
+    if (status != RTOS_OSAL_SUCCESS) {
+        return status;
+    }
+
+    rtos_osal_mutex_get(&client->lock, RTOS_OSAL_WAIT_FOREVER);
+    client->pending[call->request_id - 1] = NULL;
+    rtos_osal_mutex_put(&client->lock);
+
+    rtos_osal_semaphore_put(&client->free_ids);
+
+    return RTOS_OSAL_SUCCESS;
+}
+
+void rpc_client_call(rpc_client_t *client, int fcode, const rpc_param_desc_t param_desc[], ...)
+{
+    rpc_call_t call;
+    va_list ap;
+
+    va_start(ap, param_desc);
+    rpc_client_call_async_va(client, &call, fcode, param_desc, ap);
+    va_end(ap);
+
+    rpc_client_call_wait(client, &call, RTOS_OSAL_WAIT_FOREVER);
+}
+
+void rpc_client_start(rpc_client_t *client, unsigned priority)
+{
+    rtos_osal_thread_create(
+            NULL,
+            "rpc_client_thread",
+            (rtos_osal_entry_function_t) rpc_client_thread,
+            client,
+            RTOS_THREAD_STACK_SIZE(rpc_client_thread),
+            priority);
+
+    rtos_osal_thread_create(
+            &client->done_thread,
+            "rpc_client_done_thread",
+            (rtos_osal_entry_function_t) rpc_client_done_thread,
+            client,
+            RTOS_THREAD_STACK_SIZE(rpc_client_done_thread),
+            priority);
+}
+
+void rpc_client_init(rpc_client_t *client, rtos_intertile_t *intertile_ctx, uint8_t port)
+{
+    client->intertile_ctx = intertile_ctx;
+    client->port = port;
+    client->reserved_id = 0;
+
+    for (int i = 0; i < RPC_CLIENT_MAX_PENDING; i++) {
+        client->pending[i] = NULL;
+    }
+
+    rtos_osal_mutex_create(&client->lock, "rpc_client_lock", RTOS_OSAL_NOT_RECURSIVE);
+    rtos_osal_semaphore_create(&client->free_ids, "rpc_client_ids", RPC_CLIENT_MAX_PENDING, RPC_CLIENT_MAX_PENDING);
+    rtos_osal_event_group_create(&client->done, "rpc_client_done");
+    rtos_osal_queue_create(&client->done_queue, "rpc_client_done_queue", RPC_CLIENT_MAX_PENDING, sizeof(rpc_call_t *));
+}
+
+static void rpc_host_service_run(rpc_host_service_t *service)
+{
+    rtos_intertile_address_t *client_address = service->client_address;
+    __attribute__((aligned(8))) uint8_t req_buf[RPC_HOST_REQUEST_BUF_SIZE];
+    uint8_t *req_msg;
+    rpc_msg_t rpc_msg;
+
+    /*
+     * A coalesced transfer may hold several requests but is only notified
+     * once, so service all of them before returning to the pool.
+     */
+    do {
+        /* receive RPC request message from client */
+        req_msg = rpc_request_receive(client_address->intertile_ctx, client_address->port, req_buf, sizeof(req_buf));
+
+        rpc_request_parse(&rpc_msg, req_msg);
+        service->dispatch(client_address, &rpc_msg);
+
+        rpc_request_release(req_msg, req_buf);
+    } while (rtos_intertile_rx_pending(client_address->intertile_ctx, client_address->port));
+}
+
+static void rpc_host_thread(rpc_host_service_t *service)
+{
+    for (;;) {
+        rpc_host_service_run(service);
+    }
+}
+
+/*
+ * Receives each request made to the services in a pool as soon as it is
+ * notified, so that the link it arrived on is free again for other ports
+ * even while every worker is busy. The request is then queued for the
+ * next worker that becomes free.
+ */
+static void rpc_host_pool_rx_thread(rpc_host_pool_t *pool)
+{
+    rpc_host_service_t *service;
+    rpc_host_request_t request;
+
+    for (;;) {
+        rtos_osal_queue_receive(&pool->notify_queue, &service, RTOS_OSAL_WAIT_FOREVER);
+
+        /*
+         * A coalesced transfer may hold several requests but is only notified
+         * once, so receive all of them.
+         */
+        do {
+            rtos_osal_queue_receive(&pool->free_queue, &request.buf_index, RTOS_OSAL_WAIT_FOREVER);
+
+            request.service = service;
+            request.msg_buf = rpc_request_receive(service->client_address->intertile_ctx,
+                                                  service->client_address->port,
+                                                  pool->request_buf[request.buf_index],
+                                                  RPC_HOST_REQUEST_BUF_SIZE);
+
+            rtos_osal_queue_send(&pool->request_queue, &request, RTOS_OSAL_WAIT_FOREVER);
+        } while (rtos_intertile_rx_pending(service->client_address->intertile_ctx, service->client_address->port));
+    }
+}
+
+static void rpc_host_worker_thread(rpc_host_pool_t *pool)
+{
+    rpc_host_request_t request;
+    rpc_msg_t rpc_msg;
+
+    for (;;) {
+        rtos_osal_queue_receive(&pool->request_queue, &request, RTOS_OSAL_WAIT_FOREVER);
+
+        rpc_request_parse(&rpc_msg, request.msg_buf);
+        request.service->dispatch(request.service->client_address, &rpc_msg);
+
+        rpc_request_release(request.msg_buf, pool->request_buf[request.buf_index]);
+        rtos_osal_queue_send(&pool->free_queue, &request.buf_index, RTOS_OSAL_WAIT_FOREVER);
+    }
+}
+
+RTOS_INTERTILE_RX_NOTIFY_CALLBACK_ATTR
+static void rpc_host_pool_notify(rtos_intertile_t *intertile_ctx, uint8_t port, void *arg)
+{
+    rpc_host_service_t *service = arg;
+
+    /*
+     * Each service has at most one request waiting to be received, so the
+     * queue has room for every service and this cannot fail.
+     */
+    if (rtos_osal_queue_send(&service->pool->notify_queue, &service, RTOS_OSAL_NO_WAIT) != RTOS_OSAL_SUCCESS) {
+        xassert(0);
+    }
+}
+
+void rpc_host_start(rtos_driver_rpc_t *rpc_config, char *name, rpc_host_dispatch_t dispatch)
+{
+    rpc_host_pool_t *pool = rpc_config->host_pool;
+
+    for (int i = 0; i < rpc_config->remote_client_count; i++) {
+        rtos_intertile_address_t *client_address = &rpc_config->client_address[i];
+        rpc_host_service_t *service;
+
+        xassert(client_address->port >= 0);
+
+        if (pool != NULL) {
+            xassert(pool->service_count < RPC_HOST_POOL_MAX_SERVICES);
+            service = &pool->service[pool->service_count++];
+        } else {
+            service = rtos_osal_malloc(sizeof(rpc_host_service_t));
+            xassert(service != NULL);
+        }
+
+        service->pool = pool;
+        service->client_address = client_address;
+        service->dispatch = dispatch;
+
+        if (pool != NULL) {
+            /* This also hands out a request that arrived before the host started */
+            rtos_intertile_rx_notify_set(client_address->intertile_ctx, client_address->port, rpc_host_pool_notify, service);
+        } else {
+            xassert(rpc_config->host_task_priority >= 0);
+
+            rtos_osal_thread_create(
+                    NULL,
+                    name,
+                    (rtos_osal_entry_function_t) rpc_host_thread,
+                    service,
+                    RTOS_THREAD_STACK_SIZE(rpc_host_thread),
+                    rpc_config->host_task_priority);
+        }
+    }
+}
+
+void rpc_host_pool_attach(rpc_host_pool_t *pool, rtos_driver_rpc_t *rpc_config)
+{
+    xassert(rpc_config->remote_client_count > 0);
+
+    rpc_config->host_pool = pool;
+}
+
+void rpc_host_pool_start(rpc_host_pool_t *pool, unsigned priority)
+{
+    rtos_osal_thread_create(
+            NULL,
+            "rpc_host_pool_rx",
+            (rtos_osal_entry_function_t) rpc_host_pool_rx_thread,
+            pool,
+            RTOS_THREAD_STACK_SIZE(rpc_host_pool_rx_thread),
+            priority);
+
+    for (int i = 0; i < pool->worker_count; i++) {
+        rtos_osal_thread_create(
+                NULL,
+                "rpc_host_worker",
+                (rtos_osal_entry_function_t) rpc_host_worker_thread,
+                pool,
+                RTOS_THREAD_STACK_SIZE(rpc_host_worker_thread),
+                priority);
+    }
+}
+
+void rpc_host_pool_init(rpc_host_pool_t *pool, int worker_count)
+{
+    xassert(worker_count >= 1 && worker_count <= RPC_HOST_POOL_MAX_WORKERS);
+
+    pool->worker_count = worker_count;
+    pool->service_count = 0;
+
+    rtos_osal_queue_create(&pool->notify_queue, "rpc_host_notify_queue", RPC_HOST_POOL_MAX_SERVICES, sizeof(rpc_host_service_t *));
+    rtos_osal_queue_create(&pool->request_queue, "rpc_host_request_queue", RPC_HOST_POOL_MAX_REQUESTS, sizeof(rpc_host_request_t));
+    rtos_osal_queue_create(&pool->free_queue, "rpc_host_free_queue", RPC_HOST_POOL_MAX_REQUESTS, sizeof(int));
+
+    for (int i = 0; i < RPC_HOST_POOL_MAX_REQUESTS; i++) {
+        rtos_osal_queue_send(&pool->free_queue, &i, RTOS_OSAL_NO_WAIT);
+    }
 }
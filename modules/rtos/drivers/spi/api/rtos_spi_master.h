@@ -16,6 +16,18 @@
 #include "rtos/osal/api/rtos_osal.h"
 #include "rtos/drivers/rpc/api/rtos_driver_rpc.h"
 
+/**
+ * The maximum number of bytes transferred with interrupts masked. Interrupts
+ * on the core running the driver's thread are masked during transfers, so
+ * longer transfers are split into pieces of this size, with interrupts
+ * unmasked between them. Chip select stays asserted throughout, but the
+ * clock pauses briefly between pieces. When 0, transfers are not split.
+ * With a 50 MHz SPI clock, 512 bytes take about 80 microseconds.
+ */
+#ifndef RTOS_SPI_MASTER_XFER_CHUNK_SIZE
+#define RTOS_SPI_MASTER_XFER_CHUNK_SIZE 0
+#endif
+
 /**
  * Typedef to the RTOS SPI master driver instance struct.
  */
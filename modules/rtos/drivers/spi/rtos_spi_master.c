@@ -8,6 +8,8 @@
 
 #include "rtos/drivers/spi/api/rtos_spi_master.h"
 
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
 #define SPI_OP_START 0
 #define SPI_OP_XFER  1
 #define SPI_OP_DELAY 2
@@ -46,6 +48,25 @@ static void spi_xfer_thread(rtos_spi_master_t *ctx)
              * interrupted. At the moment it doesn't seem possible. This is
              * the safest thing to do.
              */
+#if RTOS_SPI_MASTER_XFER_CHUNK_SIZE > 0
+            for (size_t i = 0; i < req.len; i += RTOS_SPI_MASTER_XFER_CHUNK_SIZE) {
+                size_t xfer_len = MIN(req.len - i, RTOS_SPI_MASTER_XFER_CHUNK_SIZE);
+
+                /*
+                 * Chip select remains asserted, so each piece is a
+                 * continuation of the same transfer as far as the device
+                 * is concerned.
+                 */
+                interrupt_mask_all();
+
+                spi_master_transfer(&req.ctx->dev_ctx,
+                        req.data_out != NULL ? req.data_out + i : NULL,
+                        req.data_in != NULL ? req.data_in + i : NULL,
+                        xfer_len);
+
+                interrupt_unmask_all();
+            }
+#else
             interrupt_mask_all();
 
             spi_master_transfer(&req.ctx->dev_ctx,
@@ -54,6 +75,7 @@ static void spi_xfer_thread(rtos_spi_master_t *ctx)
                     req.len);
 
             interrupt_unmask_all();
+#endif
 
             if (req.data_in != NULL) {
                 rtos_osal_semaphore_put(&ctx->data_ready);
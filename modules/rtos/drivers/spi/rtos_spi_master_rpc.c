@@ -104,10 +104,8 @@ static void spi_master_remote_transaction_end(
     rtos_osal_mutex_put(&bus_ctx->lock);
 }
 
-static int spi_transaction_start_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
+static void spi_transaction_start_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
 {
-    int msg_length;
-
     rtos_spi_master_device_t *dev_ctx;
 
     rpc_request_unmarshall(
@@ -116,17 +114,13 @@ static int spi_transaction_start_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg
 
     rtos_spi_master_transaction_start(dev_ctx);
 
-    msg_length = rpc_response_marshall(
-            resp_msg, rpc_msg,
+    rpc_response_send(
+            client_address->intertile_ctx, client_address->port, rpc_msg,
             dev_ctx);
-
-    return msg_length;
 }
 
-static int spi_transfer_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
+static void spi_transfer_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
 {
-    int msg_length;
-
     rtos_spi_master_device_t *dev_ctx;
     uint8_t *data_out;
     uint8_t *data_in;
@@ -142,19 +136,16 @@ static int spi_transfer_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
 
     rtos_spi_master_transfer(dev_ctx, data_out, data_in, len);
 
-    msg_length = rpc_response_marshall(
-            resp_msg, rpc_msg,
+    /* The received data is sent straight from this buffer */
+    rpc_response_send(
+            client_address->intertile_ctx, client_address->port, rpc_msg,
             dev_ctx, data_out, data_in, len);
 
     rtos_osal_free(data_in);
-
-    return msg_length;
 }
 
-static int spi_delay_before_next_transfer_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
+static void spi_delay_before_next_transfer_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
 {
-    int msg_length;
-
     rtos_spi_master_device_t *dev_ctx;
     uint32_t delay_ticks;
 
@@ -164,17 +155,13 @@ static int spi_delay_before_next_transfer_rpc_host(rpc_msg_t *rpc_msg, uint8_t *
 
     rtos_spi_master_delay_before_next_transfer(dev_ctx, delay_ticks);
 
-    msg_length = rpc_response_marshall(
-            resp_msg, rpc_msg,
+    rpc_response_send(
+            client_address->intertile_ctx, client_address->port, rpc_msg,
             dev_ctx, delay_ticks);
-
-    return msg_length;
 }
 
-static int spi_transaction_end_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
+static void spi_transaction_end_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)
 {
-    int msg_length;
-
     rtos_spi_master_device_t *dev_ctx;
 
     rpc_request_unmarshall(
@@ -183,48 +170,42 @@ static int spi_transaction_end_rpc_host(rpc_msg_t *rpc_msg, uint8_t **resp_msg)
 
     rtos_spi_master_transaction_end(dev_ctx);
 
-    msg_length = rpc_response_marshall(
-            resp_msg, rpc_msg,
+    rpc_response_send(
+            client_address->intertile_ctx, client_address->port, rpc_msg,
             dev_ctx);
-
-    return msg_length;
 }
 
 static void spi_master_rpc_thread(rtos_intertile_address_t *client_address)
 {
-    int msg_length;
+    __attribute__((aligned(8))) uint8_t req_buf[RPC_HOST_REQUEST_BUF_SIZE];
     uint8_t *req_msg;
-    uint8_t *resp_msg;
     rpc_msg_t rpc_msg;
     rtos_intertile_t *intertile_ctx = client_address->intertile_ctx;
     uint8_t intertile_port = client_address->port;
 
     for (;;) {
         /* receive RPC request message from client */
-        msg_length = rtos_intertile_rx(intertile_ctx, intertile_port, (void **) &req_msg, RTOS_OSAL_WAIT_FOREVER);
+        req_msg = rpc_request_receive(intertile_ctx, intertile_port, req_buf, sizeof(req_buf));
 
         rpc_request_parse(&rpc_msg, req_msg);
 
+        /* each handler sends the RPC response message to the client */
         switch (rpc_msg.fcode) {
         case fcode_transaction_start:
-            msg_length = spi_transaction_start_rpc_host(&rpc_msg, &resp_msg);
+            spi_transaction_start_rpc_host(client_address, &rpc_msg);
             break;
         case fcode_transfer:
-            msg_length = spi_transfer_rpc_host(&rpc_msg, &resp_msg);
+            spi_transfer_rpc_host(client_address, &rpc_msg);
             break;
         case fcode_delay_before_next_transfer:
-            msg_length = spi_delay_before_next_transfer_rpc_host(&rpc_msg, &resp_msg);
+            spi_delay_before_next_transfer_rpc_host(client_address, &rpc_msg);
             break;
         case fcode_transaction_end:
-            msg_length = spi_transaction_end_rpc_host(&rpc_msg, &resp_msg);
+            spi_transaction_end_rpc_host(client_address, &rpc_msg);
             break;
         }
 
-        rtos_osal_free(req_msg);
-
-        /* send RPC response message to client */
-        rtos_intertile_tx(intertile_ctx, intertile_port, resp_msg, msg_length);
-        rtos_osal_free(resp_msg);
+        rpc_request_release(req_msg, req_buf);
     }
 }
 
@@ -232,6 +213,11 @@ __attribute__((fptrgroup("rtos_driver_rpc_host_start_fptr_grp")))
 static void spi_master_rpc_start(
         rtos_driver_rpc_t *rpc_config)
 {
+    /*
+     * The host lock is a mutex taken by one request and released by a later
+     * one, which must run on the same thread. Each client therefore always
+     * gets a thread of its own, even when a host pool is attached.
+     */
     xassert(rpc_config->host_task_priority >= 0);
 
     for (int i = 0; i < rpc_config->remote_client_count; i++) {
@@ -309,6 +295,7 @@ void rtos_spi_master_rpc_host_init(
 {
     spi_master_ctx->rpc_config = rpc_config;
     rpc_config->rpc_host_start = spi_master_rpc_start;
+    rpc_config->host_pool = NULL;
     rpc_config->remote_client_count = remote_client_count;
 
     /* This must be configured later with rtos_spi_master_rpc_config() */
@@ -116,6 +116,20 @@ __attribute__((weak)) void rtos_swmem_read_request(unsigned offset, uint32_t *bu
  */
 __attribute__((weak)) void rtos_swmem_write_request(unsigned offset, uint32_t dirty_mask, const uint32_t *buf);
 
+/**
+ * Gets a pointer to the software memory at a byte offset. This is the
+ * reverse of the offsets that are passed to the read and write request
+ * handlers, so it gives the address at which the handlers present the data
+ * at \p offset.
+ *
+ * \param offset The byte offset into the software memory.
+ *
+ * \returns a pointer to the software memory at \p offset, or NULL if software
+ *          memory reads have not been enabled by rtos_swmem_init() or the offset
+ *          is outside of the software memory.
+ */
+void *rtos_swmem_ptr_get(unsigned offset);
+
 /**
  * Starts the RTOS software memory driver.
  *
@@ -121,6 +121,15 @@ static void rtos_swmem_thread(void *arg)
     }
 }
 
+void *rtos_swmem_ptr_get(unsigned offset)
+{
+    if (swmem_fill_res == 0 || offset - __swmem_address >= XS1_SWMEM_SIZE) {
+        return NULL;
+    }
+
+    return (void *) (XS1_SWMEM_BASE + (offset - __swmem_address));
+}
+
 void rtos_swmem_start(unsigned priority)
 {
     if (!started) {
@@ -98,3 +98,8 @@ rtos_osal_status_t rtos_osal_thread_delete(rtos_osal_thread_t *thread)
 
     return RTOS_OSAL_SUCCESS;
 }
+
+int rtos_osal_thread_is_current(rtos_osal_thread_t *thread)
+{
+    return xTaskGetCurrentTaskHandle() == thread->thread;
+}
@@ -68,6 +68,7 @@ rtos_osal_status_t rtos_osal_thread_preemption_disable(rtos_osal_thread_t *threa
 rtos_osal_status_t rtos_osal_thread_priority_set(rtos_osal_thread_t *thread, unsigned int priority);
 rtos_osal_status_t rtos_osal_thread_priority_get(rtos_osal_thread_t *thread, unsigned int *priority);
 rtos_osal_status_t rtos_osal_thread_delete(rtos_osal_thread_t *thread);
+int rtos_osal_thread_is_current(rtos_osal_thread_t *thread);
 
 /*
  * Mutexes
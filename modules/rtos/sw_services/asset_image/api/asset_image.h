@@ -0,0 +1,139 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef ASSET_IMAGE_H_
+#define ASSET_IMAGE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+
+/**
+ * The size in bytes of each entry in the index of an asset image. An asset's
+ * name, including its terminating NUL, must fit in the entry along with the
+ * asset's offset and size, so names may be at most 55 characters long.
+ * This must match the size used by tools/asset_image/asset_image.py.
+ */
+#define ASSET_IMAGE_ENTRY_SIZE 64
+
+/**
+ * The maximum length of an asset name, not including its terminating NUL.
+ */
+#define ASSET_IMAGE_NAME_MAX (ASSET_IMAGE_ENTRY_SIZE - 2 * sizeof(uint32_t) - 1)
+
+/**
+ * Struct representing a mounted asset image.
+ *
+ * An asset image is a read only collection of named blobs in the flash,
+ * built by tools/asset_image/asset_image.py. It starts with a header, a
+ * table of bucket displacements and an index with a slot for each name,
+ * followed by the blobs. The index is a perfect hash that grows linearly
+ * with the number of assets. The displacement table is kept in RAM while
+ * the image is mounted, about one byte per asset, so an asset is found by
+ * reading a single index entry.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    rtos_qspi_flash_t *flash;
+    unsigned address;
+    uint32_t seed;
+    uint32_t slot_count;
+    uint32_t bucket_count;
+    uint32_t asset_count;
+    uint32_t size;
+    uint32_t *displacements;
+} asset_image_t;
+
+/**
+ * Struct describing a single asset in an asset image, filled in by
+ * asset_image_find().
+ */
+typedef struct {
+    unsigned address; /**< The byte address of the asset's data in the flash */
+    size_t size;      /**< The size of the asset's data in bytes */
+} asset_image_asset_t;
+
+/**
+ * Mounts an asset image. The image's header and displacement table are
+ * read, and the table is kept in memory allocated with rtos_osal_malloc()
+ * until the image is unmounted.
+ *
+ * The image may be placed anywhere in the flash that the application does
+ * not otherwise use, for example after the FatFs volume, or in place of it.
+ *
+ * \param image   A pointer to the asset image instance to mount.
+ * \param flash   A pointer to the QSPI flash driver instance holding the image.
+ * \param address The byte address of the start of the image in the flash.
+ *
+ * \retval 0  on success.
+ * \retval -1 if there is no valid asset image at \p address, or there is
+ *            not enough memory for its displacement table.
+ */
+int asset_image_mount(
+        asset_image_t *image,
+        rtos_qspi_flash_t *flash,
+        unsigned address);
+
+/**
+ * Unmounts an asset image, freeing its displacement table. Assets found in
+ * the image remain valid to read and map.
+ *
+ * \param image A pointer to the mounted asset image to unmount.
+ */
+void asset_image_unmount(
+        asset_image_t *image);
+
+/**
+ * Looks up an asset by name. This reads a single entry of the image's index.
+ *
+ * \param image A pointer to the mounted asset image to search.
+ * \param name  The name of the asset, as given to the image builder.
+ * \param asset A pointer to the struct to fill in with the asset's location.
+ *
+ * \retval 0  on success.
+ * \retval -1 if the image holds no asset named \p name.
+ */
+int asset_image_find(
+        asset_image_t *image,
+        const char *name,
+        asset_image_asset_t *asset);
+
+/**
+ * Reads data from an asset with a single flash read.
+ *
+ * \param image  A pointer to the mounted asset image holding the asset.
+ * \param asset  A pointer to the asset to read, filled in by asset_image_find().
+ * \param buf    The buffer to read the data into.
+ * \param offset The byte offset into the asset to begin reading at.
+ * \param len    The maximum number of bytes to read.
+ *
+ * \returns the number of bytes read, which is less than \p len if the end
+ *          of the asset is reached.
+ */
+size_t asset_image_read(
+        asset_image_t *image,
+        const asset_image_asset_t *asset,
+        void *buf,
+        size_t offset,
+        size_t len);
+
+#if USE_SWMEM
+/**
+ * Gets a read only view of an asset's data through software memory, which
+ * must be backed by the flash on this tile with swmem_setup(). No data is
+ * copied.
+ *
+ * \param image  A pointer to the mounted asset image holding the asset.
+ * \param asset  A pointer to the asset to map, filled in by asset_image_find().
+ *
+ * \returns a pointer to the asset's data, or NULL if it is not in the software
+ *          memory.
+ */
+const void *asset_image_map(
+        asset_image_t *image,
+        const asset_image_asset_t *asset);
+#endif
+
+#endif /* ASSET_IMAGE_H_ */
@@ -0,0 +1,203 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Reader for the packed read only asset images built by
+ * tools/asset_image/asset_image.py. All fields are little endian.
+ *
+ * The image begins with a header, followed by a table of bucket_count 32-bit
+ * displacements, and then an index of slot_count entries of
+ * ASSET_IMAGE_ENTRY_SIZE bytes. bucket_count and slot_count are powers of
+ * two. The name hash is the 32-bit FNV-1a hash, with its offset basis XORed
+ * with a seed, followed by the MurmurHash3 finalizer. An asset named n is in
+ * the bucket given by the low bits of the hash of n with the image's seed.
+ * It is in the slot given by the low bits of the hash of n with the seed
+ * seed + 1 + d, where d is the bucket's displacement. The builder chooses
+ * the displacements so that every name has a different slot. The slots that
+ * are not used have an empty name. The data of each asset follows the index,
+ * at an offset from the start of the image that is a multiple of the
+ * image's alignment.
+ *
+ * The displacements are read into RAM when the image is mounted, so that a
+ * lookup needs only the one flash read of its index entry.
+ */
+
+#include <string.h>
+
+#include "rtos/osal/api/rtos_osal.h"
+#include "asset_image.h"
+
+#if USE_SWMEM
+#include "rtos/drivers/swmem/api/rtos_swmem.h"
+#endif
+
+#define ASSET_IMAGE_MAGIC   0x4D494158 /* "XAIM" */
+#define ASSET_IMAGE_VERSION 2
+
+#define FNV_OFFSET_BASIS    2166136261u
+#define FNV_PRIME           16777619u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seed;
+    uint32_t slot_count;
+    uint32_t asset_count;
+    uint32_t alignment;
+    uint32_t size; /* The size of the whole image in bytes */
+    uint32_t bucket_count;
+} asset_image_header_t;
+
+typedef struct {
+    uint32_t offset; /* From the start of the image */
+    uint32_t size;
+    char name[ASSET_IMAGE_NAME_MAX + 1];
+} asset_image_entry_t;
+
+_Static_assert(sizeof(asset_image_entry_t) == ASSET_IMAGE_ENTRY_SIZE, "asset_image_entry_t must be ASSET_IMAGE_ENTRY_SIZE bytes");
+
+static uint32_t name_hash(const char *name, uint32_t seed)
+{
+    uint32_t hash = FNV_OFFSET_BASIS ^ seed;
+
+    while (*name != '\0') {
+        hash ^= (uint8_t) *name++;
+        hash *= FNV_PRIME;
+    }
+
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6B;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+int asset_image_mount(
+        asset_image_t *image,
+        rtos_qspi_flash_t *flash,
+        unsigned address)
+{
+    asset_image_header_t header;
+
+    rtos_qspi_flash_read(flash, (uint8_t *) &header, address, sizeof(header));
+
+    if (header.magic != ASSET_IMAGE_MAGIC || header.version != ASSET_IMAGE_VERSION) {
+        return -1;
+    }
+
+    if (header.slot_count == 0 || (header.slot_count & (header.slot_count - 1)) != 0) {
+        return -1;
+    }
+
+    /* The builder never makes more buckets than slots */
+    if (header.bucket_count == 0 || (header.bucket_count & (header.bucket_count - 1)) != 0 ||
+            header.bucket_count > header.slot_count) {
+        return -1;
+    }
+
+    image->displacements = rtos_osal_malloc(header.bucket_count * sizeof(uint32_t));
+    if (image->displacements == NULL) {
+        return -1;
+    }
+
+    rtos_qspi_flash_read(
+            flash,
+            (uint8_t *) image->displacements,
+            address + sizeof(asset_image_header_t),
+            header.bucket_count * sizeof(uint32_t));
+
+    image->flash = flash;
+    image->address = address;
+    image->seed = header.seed;
+    image->slot_count = header.slot_count;
+    image->bucket_count = header.bucket_count;
+    image->asset_count = header.asset_count;
+    image->size = header.size;
+
+    return 0;
+}
+
+void asset_image_unmount(
+        asset_image_t *image)
+{
+    rtos_osal_free(image->displacements);
+    image->displacements = NULL;
+}
+
+int asset_image_find(
+        asset_image_t *image,
+        const char *name,
+        asset_image_asset_t *asset)
+{
+    asset_image_entry_t entry;
+    unsigned index_address;
+    uint32_t bucket;
+    uint32_t slot;
+
+    if (strlen(name) > ASSET_IMAGE_NAME_MAX) {
+        return -1;
+    }
+
+    bucket = name_hash(name, image->seed) & (image->bucket_count - 1);
+    slot = name_hash(name, image->seed + 1 + image->displacements[bucket]) & (image->slot_count - 1);
+    index_address = image->address + sizeof(asset_image_header_t) + image->bucket_count * sizeof(uint32_t);
+
+    rtos_qspi_flash_read(
+            image->flash,
+            (uint8_t *) &entry,
+            index_address + slot * ASSET_IMAGE_ENTRY_SIZE,
+            sizeof(entry));
+
+    /* Another name may hash to this slot, so the name must be checked */
+    entry.name[ASSET_IMAGE_NAME_MAX] = '\0';
+    if (strcmp(entry.name, name) != 0) {
+        return -1;
+    }
+
+    if (entry.offset > image->size || entry.size > image->size - entry.offset) {
+        return -1;
+    }
+
+    asset->address = image->address + entry.offset;
+    asset->size = entry.size;
+
+    return 0;
+}
+
+size_t asset_image_read(
+        asset_image_t *image,
+        const asset_image_asset_t *asset,
+        void *buf,
+        size_t offset,
+        size_t len)
+{
+    if (offset >= asset->size) {
+        return 0;
+    }
+
+    if (len > asset->size - offset) {
+        len = asset->size - offset;
+    }
+
+    rtos_qspi_flash_read(image->flash, buf, asset->address + offset, len);
+
+    return len;
+}
+
+#if USE_SWMEM
+const void *asset_image_map(
+        asset_image_t *image,
+        const asset_image_asset_t *asset)
+{
+    const void *start = rtos_swmem_ptr_get(asset->address);
+
+    /* Both ends of the asset must be inside the software memory */
+    if (asset->size > 0 && rtos_swmem_ptr_get(asset->address + asset->size - 1) == NULL) {
+        return NULL;
+    }
+
+    return start;
+}
+#endif
@@ -12,6 +12,8 @@
 
 #include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
 
+extern rtos_qspi_flash_t *ff_qspi_flash_ctx;
+
 #ifndef QSPI_FLASH_FILESYSTEM_START_ADDRESS
 #define QSPI_FLASH_FILESYSTEM_START_ADDRESS 0x100000
 #endif
@@ -20,6 +22,53 @@
 #define QSPI_FLASH_SECTOR_SIZE 4096
 #endif
 
+#if USE_FATFS_FTL
+#include "diskio_ftl.h"
+
+#if DISKIO_FTL_SECTOR_SIZE != QSPI_FLASH_SECTOR_SIZE
+#error DISKIO_FTL_SECTOR_SIZE must match QSPI_FLASH_SECTOR_SIZE
+#endif
+
+static diskio_ftl_t ftl;
+#endif
+
+/*
+ * FatFs reads the FAT and directory entries one sector at a time through
+ * its single sector window, so walking a FAT chain or scanning a directory
+ * reads the same few sectors over and over. Single sector reads are served
+ * from a small cache of lines of DISKIO_CACHE_LINE_SECTORS adjacent sectors.
+ * A miss reads the whole line with one flash read, so the sectors that
+ * follow are usually already cached when FatFs asks for them.
+ *
+ * Each line uses DISKIO_CACHE_LINE_SECTORS * QSPI_FLASH_SECTOR_SIZE bytes
+ * of RAM, so the cache is off by default. Applications that can spare the
+ * RAM enable it by setting DISKIO_CACHE_LINES to the number of lines.
+ */
+#ifndef DISKIO_CACHE_LINES
+#define DISKIO_CACHE_LINES 0
+#endif
+
+#ifndef DISKIO_CACHE_LINE_SECTORS
+#define DISKIO_CACHE_LINE_SECTORS 2
+#endif
+
+#if DISKIO_CACHE_LINES > 0
+#include <string.h>
+#include "rtos/osal/api/rtos_osal.h"
+
+typedef struct {
+    LBA_t first;
+    UINT count;
+    uint32_t last_used;
+    BYTE data[DISKIO_CACHE_LINE_SECTORS * QSPI_FLASH_SECTOR_SIZE];
+} cache_line_t;
+
+static cache_line_t cache[DISKIO_CACHE_LINES];
+static uint32_t cache_clock;
+static LBA_t disk_sector_count;
+static rtos_osal_mutex_t cache_lock;
+#endif
+
 static DSTATUS drive_status[FF_VOLUMES] = {
 #if FF_VOLUMES >= 10
         STA_NOINIT,
@@ -54,6 +103,133 @@ static DSTATUS drive_status[FF_VOLUMES] = {
 
 };
 
+static LBA_t backend_sector_count(void)
+{
+#if USE_FATFS_FTL
+    return diskio_ftl_sector_count(&ftl);
+#else
+    /* The volume runs from QSPI_FLASH_FILESYSTEM_START_ADDRESS to the end of the flash */
+    return (rtos_qspi_flash_size_get(ff_qspi_flash_ctx) - QSPI_FLASH_FILESYSTEM_START_ADDRESS) / QSPI_FLASH_SECTOR_SIZE;
+#endif
+}
+
+static int backend_read(
+        BYTE *buff,
+        LBA_t sector,
+        UINT count)
+{
+#if USE_FATFS_FTL
+    return diskio_ftl_read(&ftl, buff, sector, count);
+#else
+    rtos_qspi_flash_read(
+            ff_qspi_flash_ctx,
+            buff,
+            QSPI_FLASH_FILESYSTEM_START_ADDRESS + (sector * QSPI_FLASH_SECTOR_SIZE),
+            count * QSPI_FLASH_SECTOR_SIZE);
+    return 0;
+#endif
+}
+
+#if DISKIO_CACHE_LINES > 0
+
+static void cache_init(void)
+{
+    disk_sector_count = backend_sector_count();
+
+    for (int i = 0; i < DISKIO_CACHE_LINES; i++) {
+        cache[i].count = 0;
+    }
+
+    rtos_osal_mutex_create(&cache_lock, "diskio_cache", RTOS_OSAL_RECURSIVE);
+}
+
+static cache_line_t *cache_line_get(LBA_t sector)
+{
+    cache_line_t *victim = &cache[0];
+
+    for (int i = 0; i < DISKIO_CACHE_LINES; i++) {
+        if (sector >= cache[i].first && sector < cache[i].first + cache[i].count) {
+            return &cache[i];
+        }
+        if (cache[i].count == 0) {
+            victim = &cache[i];
+        } else if (victim->count != 0 && cache[i].last_used < victim->last_used) {
+            victim = &cache[i];
+        }
+    }
+
+    /* Miss. Load the least recently used line with the line holding the sector. */
+    victim->first = sector - (sector % DISKIO_CACHE_LINE_SECTORS);
+    victim->count = DISKIO_CACHE_LINE_SECTORS;
+    if (victim->first + victim->count > disk_sector_count) {
+        victim->count = disk_sector_count - victim->first;
+    }
+
+    if (backend_read(victim->data, victim->first, victim->count) != 0) {
+        victim->count = 0;
+        return NULL;
+    }
+
+    return victim;
+}
+
+static int cache_read(
+        BYTE *buff,
+        LBA_t sector,
+        UINT count)
+{
+    cache_line_t *line;
+    int ret = -1;
+
+    /*
+     * Multi-sector reads are file data going straight into the caller's
+     * buffer. They are already a single flash read and are not cached.
+     */
+    if (count != 1 || sector >= disk_sector_count) {
+        return backend_read(buff, sector, count);
+    }
+
+    rtos_osal_mutex_get(&cache_lock, RTOS_OSAL_WAIT_FOREVER);
+
+    line = cache_line_get(sector);
+    if (line != NULL) {
+        memcpy(buff, &line->data[(sector - line->first) * QSPI_FLASH_SECTOR_SIZE], QSPI_FLASH_SECTOR_SIZE);
+        line->last_used = ++cache_clock;
+        ret = 0;
+    }
+
+    rtos_osal_mutex_put(&cache_lock);
+
+    return ret;
+}
+
+/*
+ * Copies written sectors into any cached lines that hold them, or drops
+ * those lines when buff is NULL. Must be called with cache_lock held.
+ */
+static void cache_update(
+        const BYTE *buff,
+        LBA_t sector,
+        UINT count)
+{
+    for (int i = 0; i < DISKIO_CACHE_LINES; i++) {
+        LBA_t start = sector > cache[i].first ? sector : cache[i].first;
+        LBA_t end = sector + count < cache[i].first + cache[i].count ? sector + count : cache[i].first + cache[i].count;
+
+        if (start < end) {
+            if (buff != NULL) {
+                memcpy(&cache[i].data[(start - cache[i].first) * QSPI_FLASH_SECTOR_SIZE],
+                       &buff[(start - sector) * QSPI_FLASH_SECTOR_SIZE],
+                       (end - start) * QSPI_FLASH_SECTOR_SIZE);
+            } else {
+                cache[i].count = 0;
+            }
+        }
+    }
+}
+
+#endif /* DISKIO_CACHE_LINES > 0 */
+
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
 /*-----------------------------------------------------------------------*/
@@ -88,6 +264,12 @@ DSTATUS disk_initialize (
 #if FF_VOLUMES >= 1
     case 0:
          if ((drive_status[pdrv] & STA_NOINIT )== STA_NOINIT) {
+#if USE_FATFS_FTL
+            diskio_ftl_init(&ftl, ff_qspi_flash_ctx, QSPI_FLASH_FILESYSTEM_START_ADDRESS);
+#endif
+#if DISKIO_CACHE_LINES > 0
+            cache_init();
+#endif
             drive_status[pdrv] &= ~STA_NOINIT;
         }
         stat = drive_status[pdrv];
@@ -115,19 +297,17 @@ DRESULT disk_read (
     UINT count        /* Number of sectors to read */
 )
 {
-    extern rtos_qspi_flash_t *ff_qspi_flash_ctx;
     DRESULT res;
 
     switch (pdrv) {
 #if FF_VOLUMES >= 1
     case 0:
         if ((drive_status[pdrv] & ~STA_PROTECT) == 0) {
-            rtos_qspi_flash_read(
-                    ff_qspi_flash_ctx,
-                    buff,
-                    QSPI_FLASH_FILESYSTEM_START_ADDRESS + (sector * QSPI_FLASH_SECTOR_SIZE),
-                    count * QSPI_FLASH_SECTOR_SIZE);
-            res = RES_OK;
+#if DISKIO_CACHE_LINES > 0
+            res = cache_read(buff, sector, count) == 0 ? RES_OK : RES_PARERR;
+#else
+            res = backend_read(buff, sector, count) == 0 ? RES_OK : RES_PARERR;
+#endif
         } else if (drive_status[pdrv] & STA_NOINIT) {
             res = RES_NOTRDY;
         } else {
@@ -159,13 +339,18 @@ DRESULT disk_write (
     UINT count            /* Number of sectors to write */
 )
 {
-    extern rtos_qspi_flash_t *ff_qspi_flash_ctx;
     DRESULT res;
 
     switch (pdrv) {
 #if FF_VOLUMES >= 1
     case 0:
         if (drive_status[pdrv] == 0) {
+#if DISKIO_CACHE_LINES > 0
+            rtos_osal_mutex_get(&cache_lock, RTOS_OSAL_WAIT_FOREVER);
+#endif
+#if USE_FATFS_FTL
+            res = diskio_ftl_write(&ftl, buff, sector, count) == 0 ? RES_OK : RES_PARERR;
+#else
             rtos_qspi_flash_lock(ff_qspi_flash_ctx);
             rtos_qspi_flash_erase(
                     ff_qspi_flash_ctx,
@@ -178,6 +363,11 @@ DRESULT disk_write (
                     count * QSPI_FLASH_SECTOR_SIZE );
             rtos_qspi_flash_unlock(ff_qspi_flash_ctx);
             res = RES_OK;
+#endif
+#if DISKIO_CACHE_LINES > 0
+            cache_update(res == RES_OK ? buff : NULL, sector, count);
+            rtos_osal_mutex_put(&cache_lock);
+#endif
         } else if (drive_status[pdrv] & STA_NOINIT) {
             res = RES_NOTRDY;
         } else if (drive_status[pdrv] & STA_PROTECT) {
@@ -209,7 +399,6 @@ DRESULT disk_ioctl (
     void *buff        /* Buffer to send/receive control data */
 )
 {
-    extern rtos_qspi_flash_t *ff_qspi_flash_ctx;
     DRESULT res;
 
     switch (pdrv) {
@@ -227,7 +416,7 @@ DRESULT disk_ioctl (
                 break;
 
             case GET_SECTOR_COUNT:
-                *((LBA_t *) buff) = rtos_qspi_flash_size_get(ff_qspi_flash_ctx) / QSPI_FLASH_SECTOR_SIZE;
+                *((LBA_t *) buff) = backend_sector_count();
                 res = RES_OK;
                 break;
 
@@ -241,16 +430,43 @@ DRESULT disk_ioctl (
                 res = RES_OK;
                 break;
 
-            case CTRL_TRIM:
+            case CTRL_TRIM: {
+                /* The start and end sectors of the block to trim, inclusive */
+                LBA_t start = ((LBA_t *) buff)[0];
+                LBA_t count = ((LBA_t *) buff)[1] - start + 1;
+#if DISKIO_CACHE_LINES > 0
+                rtos_osal_mutex_get(&cache_lock, RTOS_OSAL_WAIT_FOREVER);
+                cache_update(NULL, start, count);
+#endif
+#if USE_FATFS_FTL
+                res = diskio_ftl_trim(&ftl, start, count) == 0 ? RES_OK : RES_PARERR;
+#else
+                rtos_qspi_flash_trim(
+                        ff_qspi_flash_ctx,
+                        QSPI_FLASH_FILESYSTEM_START_ADDRESS + (start * QSPI_FLASH_SECTOR_SIZE),
+                        count * QSPI_FLASH_SECTOR_SIZE);
+                res = RES_OK;
+#endif
+#if DISKIO_CACHE_LINES > 0
+                rtos_osal_mutex_put(&cache_lock);
+#endif
+                break;
+            }
+
+            case QSPI_FLASH_GET_ADDRESS:
+#if USE_FATFS_FTL
+                /* Sectors behind the flash translation layer move around */
+                res = RES_PARERR;
+#else
+                *((LBA_t *) buff) = QSPI_FLASH_FILESYSTEM_START_ADDRESS + (*((LBA_t *) buff) * QSPI_FLASH_SECTOR_SIZE);
                 res = RES_OK;
+#endif
                 break;
 
             default:
                 res = RES_PARERR;
                 break;
             }
-
-            res = RES_OK;
         } else if (drive_status[pdrv] & STA_NOINIT) {
             res = RES_NOTRDY;
         } else {
@@ -53,6 +53,7 @@ DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
 
 
 /* QSPI Flash specific ioctl command */
+#define QSPI_FLASH_GET_ADDRESS	50	/* Get the byte address in the flash of a sector (fails when sectors are not stored in place) */
 
 
 #ifdef __cplusplus
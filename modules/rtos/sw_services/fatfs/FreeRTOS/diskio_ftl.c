@@ -0,0 +1,608 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * A log structured flash translation layer for the FatFs disk backend.
+ *
+ * The flash is divided into blocks of DISKIO_FTL_BLOCK_SECTORS sectors.
+ * Logical sectors are written one after another into the free slots of the
+ * active block, and the logical sector number of each slot is then programmed
+ * into the block's header. A logical sector that is written again simply goes
+ * into the next slot, leaving its old slot stale. No slot is ever programmed
+ * twice between erases, so no sector is erased in the write path.
+ *
+ * Each block header also holds a sequence number that increases every time a
+ * block is opened, and the block's erase count. The magic number and erase
+ * count are written as soon as a block is erased, leaving the sequence number
+ * erased until the block is opened, so that the erase counts of free blocks
+ * survive initialization too. When a logical sector is found
+ * in more than one slot during initialization, the slot in the block with the
+ * highest sequence number, and then the highest slot within it, holds its
+ * current contents. A slot whose data was programmed but whose header entry
+ * was not is ignored.
+ *
+ * Garbage collection moves the live sectors out of the block with the fewest
+ * of them and then erases it. It normally runs in a background thread, so
+ * that writes find erased blocks waiting for them. Erased blocks are handed
+ * out least worn first, and the data in a block that has fallen too far
+ * behind the most worn one is moved out, so that blocks holding data that
+ * never changes also take their share of the erases.
+ */
+
+#if USE_FATFS_FTL
+
+#include <string.h>
+#include <stddef.h>
+
+#include <xcore/assert.h>
+
+#include "diskio_ftl.h"
+
+#define FTL_MAGIC       0x314C5446 /* "FTL1" */
+#define FTL_UNMAPPED    0xFFFF
+#define FTL_SEQ_ERASED  0xFFFFFFFF
+
+#define FTL_SLOTS       (DISKIO_FTL_BLOCK_SECTORS - 1)
+#define FTL_BLOCK_SIZE  (DISKIO_FTL_BLOCK_SECTORS * DISKIO_FTL_SECTOR_SIZE)
+
+#if DISKIO_FTL_BLOCK_SECTORS < 2 || DISKIO_FTL_BLOCK_SECTORS > 256
+#error DISKIO_FTL_BLOCK_SECTORS must be between 2 and 256
+#endif
+
+enum {
+    FTL_BLOCK_DIRTY,    /* Holds nothing but has not been erased */
+    FTL_BLOCK_FREE,     /* Erased */
+    FTL_BLOCK_ACTIVE,   /* Being written to */
+    FTL_BLOCK_USED,     /* Full, or partly written before initialization */
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t erase_count;
+    uint32_t lsn[FTL_SLOTS]; /* The logical sector in each slot, left erased until it is written */
+} ftl_block_header_t;
+
+#define BLOCK_OF(loc) ((loc) / DISKIO_FTL_BLOCK_SECTORS)
+#define SLOT_OF(loc)  ((loc) % DISKIO_FTL_BLOCK_SECTORS)
+
+static unsigned block_address(
+        diskio_ftl_t *ftl,
+        int block)
+{
+    return ftl->start_address + block * FTL_BLOCK_SIZE;
+}
+
+static unsigned sector_address(
+        diskio_ftl_t *ftl,
+        unsigned loc)
+{
+    return ftl->start_address + loc * DISKIO_FTL_SECTOR_SIZE;
+}
+
+/*
+ * Erases a block and writes its header with everything but the sequence
+ * number, which is left erased until the block is opened.
+ */
+static void block_erase(
+        diskio_ftl_t *ftl,
+        int block)
+{
+    ftl_block_header_t header;
+
+    header.magic = FTL_MAGIC;
+    header.seq = FTL_SEQ_ERASED;
+    header.erase_count = ftl->block[block].erase_count + 1;
+
+    rtos_qspi_flash_lock(ftl->flash);
+    rtos_qspi_flash_erase(ftl->flash, block_address(ftl, block), FTL_BLOCK_SIZE);
+    rtos_qspi_flash_write(ftl->flash, (uint8_t *) &header, block_address(ftl, block), offsetof(ftl_block_header_t, lsn));
+    rtos_qspi_flash_unlock(ftl->flash);
+
+    ftl->block[block].erase_count = header.erase_count;
+    ftl->block[block].state = FTL_BLOCK_FREE;
+}
+
+/*
+ * Makes the least worn free block the active block.
+ */
+static void block_open(
+        diskio_ftl_t *ftl)
+{
+    uint32_t seq;
+    int block = -1;
+
+    for (int i = 0; i < ftl->block_count; i++) {
+        diskio_ftl_block_t *b = &ftl->block[i];
+
+        if (b->state != FTL_BLOCK_FREE && b->state != FTL_BLOCK_DIRTY) {
+            continue;
+        }
+        if (block < 0 ||
+                b->erase_count < ftl->block[block].erase_count ||
+                (b->erase_count == ftl->block[block].erase_count && b->state == FTL_BLOCK_FREE)) {
+            block = i;
+        }
+    }
+
+    xassert(block >= 0);
+
+    if (ftl->block[block].state == FTL_BLOCK_DIRTY) {
+        block_erase(ftl, block);
+    }
+
+    seq = ++ftl->seq;
+    rtos_qspi_flash_write(ftl->flash, (uint8_t *) &seq, block_address(ftl, block) + offsetof(ftl_block_header_t, seq), sizeof(seq));
+
+    ftl->block[block].seq = seq;
+    ftl->block[block].valid = 0;
+    ftl->block[block].state = FTL_BLOCK_ACTIVE;
+    ftl->free_count--;
+
+    ftl->active = block;
+    ftl->active_slot = 1;
+}
+
+/*
+ * Writes a logical sector into the next slot of the active block,
+ * opening a new one if it is full.
+ */
+static void sector_program(
+        diskio_ftl_t *ftl,
+        unsigned sector,
+        const uint8_t *data)
+{
+    uint32_t lsn = sector;
+    unsigned loc;
+
+    if (ftl->active < 0 || ftl->active_slot == DISKIO_FTL_BLOCK_SECTORS) {
+        if (ftl->active >= 0) {
+            ftl->block[ftl->active].state = FTL_BLOCK_USED;
+        }
+        block_open(ftl);
+    }
+
+    loc = ftl->active * DISKIO_FTL_BLOCK_SECTORS + ftl->active_slot;
+
+    /* The header entry commits the slot, so it must be written after the data */
+    rtos_qspi_flash_lock(ftl->flash);
+    rtos_qspi_flash_write(ftl->flash, data, sector_address(ftl, loc), DISKIO_FTL_SECTOR_SIZE);
+    rtos_qspi_flash_write(ftl->flash,
+                          (uint8_t *) &lsn,
+                          block_address(ftl, ftl->active) + offsetof(ftl_block_header_t, lsn[ftl->active_slot - 1]),
+                          sizeof(lsn));
+    rtos_qspi_flash_unlock(ftl->flash);
+
+    if (ftl->map[sector] != FTL_UNMAPPED) {
+        ftl->block[BLOCK_OF(ftl->map[sector])].valid--;
+    }
+    ftl->map[sector] = loc;
+    ftl->block[ftl->active].valid++;
+    ftl->active_slot++;
+}
+
+static int active_room(
+        diskio_ftl_t *ftl)
+{
+    return ftl->active < 0 ? 0 : DISKIO_FTL_BLOCK_SECTORS - ftl->active_slot;
+}
+
+/*
+ * Moves the live sectors out of a block and erases it.
+ */
+static void block_collect(
+        diskio_ftl_t *ftl,
+        int block)
+{
+    ftl_block_header_t header;
+
+    xassert(ftl->block[block].state == FTL_BLOCK_USED);
+    xassert(ftl->block[block].valid <= active_room(ftl) + (ftl->free_count > 0 ? FTL_SLOTS : 0));
+
+    rtos_qspi_flash_read(ftl->flash, (uint8_t *) &header, block_address(ftl, block), sizeof(header));
+
+    for (int i = 0; i < FTL_SLOTS && ftl->block[block].valid > 0; i++) {
+        unsigned loc = block * DISKIO_FTL_BLOCK_SECTORS + i + 1;
+        uint32_t sector = header.lsn[i];
+
+        if (sector < ftl->sector_count && ftl->map[sector] == loc) {
+            rtos_qspi_flash_read(ftl->flash, ftl->copy_buf, sector_address(ftl, loc), DISKIO_FTL_SECTOR_SIZE);
+            sector_program(ftl, sector, ftl->copy_buf);
+        }
+    }
+
+    xassert(ftl->block[block].valid == 0);
+
+    block_erase(ftl, block);
+    ftl->free_count++;
+}
+
+/*
+ * Finds the full block with the fewest live sectors, preferring the least
+ * worn one when there is a tie.
+ */
+static int victim_find(
+        diskio_ftl_t *ftl)
+{
+    int victim = -1;
+
+    for (int i = 0; i < ftl->block_count; i++) {
+        diskio_ftl_block_t *b = &ftl->block[i];
+
+        if (b->state != FTL_BLOCK_USED) {
+            continue;
+        }
+        if (victim < 0 ||
+                b->valid < ftl->block[victim].valid ||
+                (b->valid == ftl->block[victim].valid && b->erase_count < ftl->block[victim].erase_count)) {
+            victim = i;
+        }
+    }
+
+    return victim;
+}
+
+/*
+ * Performs one step of background work. Returns 0 once there is nothing
+ * left to do.
+ */
+static int gc_step(
+        diskio_ftl_t *ftl)
+{
+    int victim;
+
+    /* Blocks found empty during initialization are erased first */
+    for (int i = 0; i < ftl->block_count; i++) {
+        if (ftl->block[i].state == FTL_BLOCK_DIRTY) {
+            block_erase(ftl, i);
+            return 1;
+        }
+    }
+
+    if (ftl->free_count < DISKIO_FTL_GC_FREE_BLOCKS) {
+        victim = victim_find(ftl);
+
+        /* Only collect a block when doing so frees up space */
+        if (victim >= 0 && ftl->block[victim].valid < FTL_SLOTS &&
+                ftl->block[victim].valid <= active_room(ftl) + (ftl->free_count > 0 ? FTL_SLOTS : 0)) {
+            block_collect(ftl, victim);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Moves the data out of the least worn full block when it has fallen too
+ * far behind the most worn block, so that it rejoins the pool of free
+ * blocks. This is done once each time the garbage collector is woken.
+ */
+static void wear_level(
+        diskio_ftl_t *ftl)
+{
+    uint32_t max_erase_count = 0;
+    int coldest = -1;
+
+    if (ftl->free_count < 2) {
+        return;
+    }
+
+    for (int i = 0; i < ftl->block_count; i++) {
+        diskio_ftl_block_t *b = &ftl->block[i];
+
+        if (b->erase_count > max_erase_count) {
+            max_erase_count = b->erase_count;
+        }
+        if (b->state == FTL_BLOCK_USED && (coldest < 0 || b->erase_count < ftl->block[coldest].erase_count)) {
+            coldest = i;
+        }
+    }
+
+    if (coldest >= 0 && max_erase_count - ftl->block[coldest].erase_count > DISKIO_FTL_WEAR_LEVEL_THRESHOLD) {
+        block_collect(ftl, coldest);
+    }
+}
+
+static void diskio_ftl_gc_thread(
+        diskio_ftl_t *ftl)
+{
+    int more;
+
+    for (;;) {
+        rtos_osal_semaphore_get(&ftl->gc_request, RTOS_OSAL_WAIT_FOREVER);
+
+        /* Release the lock between steps so that reads and writes are not held up for long */
+        do {
+            rtos_osal_mutex_get(&ftl->lock, RTOS_OSAL_WAIT_FOREVER);
+            more = gc_step(ftl);
+            rtos_osal_mutex_put(&ftl->lock);
+        } while (more);
+
+        rtos_osal_mutex_get(&ftl->lock, RTOS_OSAL_WAIT_FOREVER);
+        wear_level(ftl);
+        rtos_osal_mutex_put(&ftl->lock);
+    }
+}
+
+int diskio_ftl_read(
+        diskio_ftl_t *ftl,
+        uint8_t *buf,
+        unsigned sector,
+        unsigned count)
+{
+    if (sector + count > ftl->sector_count || sector + count < sector) {
+        return -1;
+    }
+
+    rtos_osal_mutex_get(&ftl->lock, RTOS_OSAL_WAIT_FOREVER);
+
+    while (count > 0) {
+        unsigned loc = ftl->map[sector];
+        unsigned run = 1;
+
+        if (loc == FTL_UNMAPPED) {
+            memset(buf, 0xFF, DISKIO_FTL_SECTOR_SIZE);
+        } else {
+            /* Sectors that were written together are usually next to each other */
+            while (run < count &&
+                   SLOT_OF(loc + run) != 0 &&
+                   ftl->map[sector + run] == loc + run) {
+                run++;
+            }
+            rtos_qspi_flash_read(ftl->flash, buf, sector_address(ftl, loc), run * DISKIO_FTL_SECTOR_SIZE);
+        }
+
+        buf += run * DISKIO_FTL_SECTOR_SIZE;
+        sector += run;
+        count -= run;
+    }
+
+    rtos_osal_mutex_put(&ftl->lock);
+
+    return 0;
+}
+
+int diskio_ftl_write(
+        diskio_ftl_t *ftl,
+        const uint8_t *buf,
+        unsigned sector,
+        unsigned count)
+{
+    if (sector + count > ftl->sector_count || sector + count < sector) {
+        return -1;
+    }
+
+    rtos_osal_mutex_get(&ftl->lock, RTOS_OSAL_WAIT_FOREVER);
+
+    while (count-- > 0) {
+        /*
+         * Garbage collection needs a free block to move sectors into,
+         * so when the background thread has fallen behind it is done
+         * here before the last free block is taken.
+         */
+        while (active_room(ftl) == 0 && ftl->free_count <= 1) {
+            int victim = victim_find(ftl);
+            xassert(victim >= 0);
+            block_collect(ftl, victim);
+        }
+
+        sector_program(ftl, sector++, buf);
+        buf += DISKIO_FTL_SECTOR_SIZE;
+    }
+
+    if (ftl->free_count < DISKIO_FTL_GC_FREE_BLOCKS) {
+        rtos_osal_semaphore_put(&ftl->gc_request);
+    }
+
+    rtos_osal_mutex_put(&ftl->lock);
+
+    return 0;
+}
+
+int diskio_ftl_trim(
+        diskio_ftl_t *ftl,
+        unsigned sector,
+        unsigned count)
+{
+    int erase = 0;
+
+    if (sector + count > ftl->sector_count || sector + count < sector) {
+        return -1;
+    }
+
+    rtos_osal_mutex_get(&ftl->lock, RTOS_OSAL_WAIT_FOREVER);
+
+    for (; count > 0; sector++, count--) {
+        unsigned loc = ftl->map[sector];
+        diskio_ftl_block_t *b;
+
+        if (loc == FTL_UNMAPPED) {
+            continue;
+        }
+
+        ftl->map[sector] = FTL_UNMAPPED;
+        b = &ftl->block[BLOCK_OF(loc)];
+        b->valid--;
+
+        /* A full block with nothing left in it can be erased without moving anything */
+        if (b->state == FTL_BLOCK_USED && b->valid == 0) {
+            b->state = FTL_BLOCK_DIRTY;
+            ftl->free_count++;
+            erase = 1;
+        }
+    }
+
+    if (erase) {
+        rtos_osal_semaphore_put(&ftl->gc_request);
+    }
+
+    rtos_osal_mutex_put(&ftl->lock);
+
+    return 0;
+}
+
+unsigned diskio_ftl_sector_count(
+        diskio_ftl_t *ftl)
+{
+    return ftl->sector_count;
+}
+
+/*
+ * Rebuilds the sector map and block states from the block headers.
+ */
+static void ftl_mount(
+        diskio_ftl_t *ftl)
+{
+    ftl_block_header_t header;
+    int last_block = -1;
+    int last_slot = 0;
+
+    memset(ftl->map, 0xFF, ftl->sector_count * sizeof(ftl->map[0]));
+    ftl->seq = 0;
+    ftl->free_count = 0;
+    ftl->active = -1;
+    ftl->active_slot = 0;
+
+    for (int i = 0; i < ftl->block_count; i++) {
+        diskio_ftl_block_t *b = &ftl->block[i];
+
+        rtos_qspi_flash_read(ftl->flash, (uint8_t *) &header, block_address(ftl, i), sizeof(header));
+
+        b->valid = 0;
+
+        if (header.magic != FTL_MAGIC) {
+            /* Erased, never written by the translation layer, or its erase was interrupted */
+            b->seq = 0;
+            b->erase_count = 0;
+            b->state = FTL_BLOCK_DIRTY;
+            continue;
+        }
+
+        b->erase_count = header.erase_count;
+
+        if (header.seq == FTL_SEQ_ERASED) {
+            /* Erased since it was last used, and not opened since */
+            b->seq = 0;
+            b->state = FTL_BLOCK_FREE;
+            continue;
+        }
+
+        b->seq = header.seq;
+        b->state = FTL_BLOCK_USED;
+
+        if (last_block < 0 || header.seq > ftl->seq) {
+            ftl->seq = header.seq;
+            last_block = i;
+            last_slot = 0;
+        }
+
+        for (int j = 0; j < FTL_SLOTS; j++) {
+            uint32_t sector = header.lsn[j];
+            unsigned loc = i * DISKIO_FTL_BLOCK_SECTORS + j + 1;
+            unsigned old_loc;
+
+            if (sector != 0xFFFFFFFF && last_block == i) {
+                last_slot = j + 1;
+            }
+
+            if (sector >= ftl->sector_count) {
+                continue;
+            }
+
+            old_loc = ftl->map[sector];
+
+            if (old_loc != FTL_UNMAPPED) {
+                /* Blocks are scanned in order, so a copy in the same block is older */
+                if (BLOCK_OF(old_loc) != i && ftl->block[BLOCK_OF(old_loc)].seq > b->seq) {
+                    continue;
+                }
+                ftl->block[BLOCK_OF(old_loc)].valid--;
+            }
+
+            ftl->map[sector] = loc;
+            b->valid++;
+        }
+    }
+
+    /*
+     * Writing continues in the block that was opened last. The slot after
+     * its last entry may hold a partially written sector, so it is skipped.
+     */
+    if (last_block >= 0 && last_slot + 2 < DISKIO_FTL_BLOCK_SECTORS) {
+        ftl->block[last_block].state = FTL_BLOCK_ACTIVE;
+        ftl->active = last_block;
+        ftl->active_slot = last_slot + 2;
+    }
+
+    /* Any other block without live sectors is free */
+    for (int i = 0; i < ftl->block_count; i++) {
+        diskio_ftl_block_t *b = &ftl->block[i];
+
+        if (b->state == FTL_BLOCK_USED && b->valid == 0) {
+            b->state = FTL_BLOCK_DIRTY;
+        }
+        if (b->state == FTL_BLOCK_DIRTY || b->state == FTL_BLOCK_FREE) {
+            ftl->free_count++;
+        }
+    }
+}
+
+void diskio_ftl_init(
+        diskio_ftl_t *ftl,
+        rtos_qspi_flash_t *flash,
+        unsigned start_address)
+{
+    size_t flash_size = rtos_qspi_flash_size_get(flash);
+
+    xassert(start_address % FTL_BLOCK_SIZE == 0);
+    xassert(start_address < flash_size);
+
+    ftl->flash = flash;
+    ftl->start_address = start_address;
+    ftl->block_count = (flash_size - start_address) / FTL_BLOCK_SIZE;
+
+    xassert(ftl->block_count > DISKIO_FTL_SPARE_BLOCKS);
+    xassert(ftl->block_count * DISKIO_FTL_BLOCK_SECTORS < FTL_UNMAPPED);
+
+    ftl->sector_count = (ftl->block_count - DISKIO_FTL_SPARE_BLOCKS) * FTL_SLOTS;
+
+    ftl->map = rtos_osal_malloc(ftl->sector_count * sizeof(ftl->map[0]));
+    ftl->block = rtos_osal_malloc(ftl->block_count * sizeof(ftl->block[0]));
+    ftl->copy_buf = rtos_osal_malloc(DISKIO_FTL_SECTOR_SIZE);
+    xassert(ftl->map != NULL && ftl->block != NULL && ftl->copy_buf != NULL);
+
+    ftl_mount(ftl);
+
+    rtos_osal_mutex_create(&ftl->lock, "ftl_lock", RTOS_OSAL_NOT_RECURSIVE);
+    rtos_osal_semaphore_create(&ftl->gc_request, "ftl_gc_sem", 1, 0);
+
+    rtos_osal_thread_create(
+            &ftl->gc_thread,
+            "ftl_gc_thread",
+            (rtos_osal_entry_function_t) diskio_ftl_gc_thread,
+            ftl,
+            RTOS_THREAD_STACK_SIZE(diskio_ftl_gc_thread),
+            DISKIO_FTL_GC_TASK_PRIORITY);
+
+    /* Erase whatever was found empty in the background */
+    rtos_osal_semaphore_put(&ftl->gc_request);
+}
+
+void diskio_ftl_deinit(
+        diskio_ftl_t *ftl)
+{
+    /* The garbage collector only stops between steps, with the lock released */
+    rtos_osal_mutex_get(&ftl->lock, RTOS_OSAL_WAIT_FOREVER);
+    rtos_osal_thread_delete(&ftl->gc_thread);
+    rtos_osal_mutex_put(&ftl->lock);
+
+    rtos_osal_semaphore_delete(&ftl->gc_request);
+    rtos_osal_mutex_delete(&ftl->lock);
+
+    rtos_osal_free(ftl->map);
+    rtos_osal_free(ftl->block);
+    rtos_osal_free(ftl->copy_buf);
+}
+
+#endif /* USE_FATFS_FTL */
@@ -0,0 +1,202 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef DISKIO_FTL_H_
+#define DISKIO_FTL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+
+/**
+ * The size in bytes of each logical sector presented to FatFs, and of each
+ * physical flash sector that holds one.
+ */
+#ifndef DISKIO_FTL_SECTOR_SIZE
+#define DISKIO_FTL_SECTOR_SIZE 4096
+#endif
+
+/**
+ * The number of flash sectors in each block. A block is the unit that is
+ * garbage collected. Its first sector holds the block's header and the rest
+ * hold logical sectors.
+ */
+#ifndef DISKIO_FTL_BLOCK_SECTORS
+#define DISKIO_FTL_BLOCK_SECTORS 16
+#endif
+
+/**
+ * The number of blocks held back from the logical capacity of the disk.
+ * More spare blocks means less data is moved by garbage collection.
+ */
+#ifndef DISKIO_FTL_SPARE_BLOCKS
+#define DISKIO_FTL_SPARE_BLOCKS 4
+#endif
+
+/**
+ * The background garbage collector tries to keep at least this many
+ * erased blocks available so that writes do not have to wait for it.
+ */
+#ifndef DISKIO_FTL_GC_FREE_BLOCKS
+#define DISKIO_FTL_GC_FREE_BLOCKS 3
+#endif
+
+/**
+ * When the erase counts of two blocks differ by more than this, the data
+ * in the least worn block is moved so that the block can take its share
+ * of the writes.
+ */
+#ifndef DISKIO_FTL_WEAR_LEVEL_THRESHOLD
+#define DISKIO_FTL_WEAR_LEVEL_THRESHOLD 64
+#endif
+
+/**
+ * The priority of the background garbage collection thread.
+ */
+#ifndef DISKIO_FTL_GC_TASK_PRIORITY
+#define DISKIO_FTL_GC_TASK_PRIORITY 1
+#endif
+
+#if DISKIO_FTL_SPARE_BLOCKS <= DISKIO_FTL_GC_FREE_BLOCKS
+#error DISKIO_FTL_SPARE_BLOCKS must be greater than DISKIO_FTL_GC_FREE_BLOCKS
+#endif
+
+/**
+ * Struct holding the state of a single block of a flash translation layer
+ * instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    uint32_t seq;
+    uint32_t erase_count;
+    uint8_t valid;
+    uint8_t state;
+} diskio_ftl_block_t;
+
+/**
+ * Struct representing a flash translation layer instance.
+ *
+ * The members in this struct should not be accessed directly.
+ */
+typedef struct {
+    rtos_qspi_flash_t *flash;
+    unsigned start_address;
+    unsigned block_count;
+    unsigned sector_count;
+
+    uint16_t *map;
+    diskio_ftl_block_t *block;
+    uint8_t *copy_buf;
+
+    unsigned free_count;
+    int active;
+    unsigned active_slot;
+    uint32_t seq;
+
+    rtos_osal_mutex_t lock;
+    rtos_osal_semaphore_t gc_request;
+    rtos_osal_thread_t gc_thread;
+} diskio_ftl_t;
+
+/**
+ * Initializes a flash translation layer instance over the flash from
+ * \p start_address to the end of the flash, and starts its garbage collection
+ * thread.
+ *
+ * The headers of all the blocks are read to rebuild the map from logical to
+ * physical sectors. Data that was not written through the translation layer
+ * is not visible through it, so a FAT volume written directly into the flash
+ * must be created again through it.
+ *
+ * \param ftl           A pointer to the flash translation layer instance to initialize.
+ * \param flash         A pointer to the QSPI flash driver instance to use.
+ * \param start_address The byte address of the start of the flash to use. This
+ *                      must be aligned to a block.
+ */
+void diskio_ftl_init(
+        diskio_ftl_t *ftl,
+        rtos_qspi_flash_t *flash,
+        unsigned start_address);
+
+/**
+ * Stops a flash translation layer instance's garbage collection thread and
+ * frees everything allocated by diskio_ftl_init(). Everything written to it
+ * is already in the flash, and is found again by the next diskio_ftl_init().
+ *
+ * \param ftl A pointer to the flash translation layer instance to deinitialize.
+ */
+void diskio_ftl_deinit(
+        diskio_ftl_t *ftl);
+
+/**
+ * Reads logical sectors. Sectors that have never been written read as 0xFF.
+ *
+ * \param ftl    A pointer to the flash translation layer instance to use.
+ * \param buf    The buffer to read the sectors into.
+ * \param sector The first logical sector to read.
+ * \param count  The number of sectors to read.
+ *
+ * \retval 0  on success.
+ * \retval -1 if the sectors are outside of the disk.
+ */
+int diskio_ftl_read(
+        diskio_ftl_t *ftl,
+        uint8_t *buf,
+        unsigned sector,
+        unsigned count);
+
+/**
+ * Writes logical sectors. Each is written to the next erased flash sector
+ * and the sector that held its previous contents is left for garbage
+ * collection, so that no erase is needed in the write path unless the
+ * background garbage collector has fallen behind.
+ *
+ * \param ftl    A pointer to the flash translation layer instance to use.
+ * \param buf    The sectors to write.
+ * \param sector The first logical sector to write.
+ * \param count  The number of sectors to write.
+ *
+ * \retval 0  on success.
+ * \retval -1 if the sectors are outside of the disk.
+ */
+int diskio_ftl_write(
+        diskio_ftl_t *ftl,
+        const uint8_t *buf,
+        unsigned sector,
+        unsigned count);
+
+/**
+ * Discards the contents of logical sectors, which then read as 0xFF. The
+ * flash sectors that held them are left for garbage collection, and blocks
+ * left holding nothing are erased in the background, ready for later writes.
+ *
+ * Discarded sectors are not recorded in the flash, so their old contents
+ * may be visible again after the next initialization if their blocks have
+ * not been erased by then.
+ *
+ * \param ftl    A pointer to the flash translation layer instance to use.
+ * \param sector The first logical sector to discard.
+ * \param count  The number of sectors to discard.
+ *
+ * \retval 0  on success.
+ * \retval -1 if the sectors are outside of the disk.
+ */
+int diskio_ftl_trim(
+        diskio_ftl_t *ftl,
+        unsigned sector,
+        unsigned count);
+
+/**
+ * Gets the number of logical sectors.
+ *
+ * \param ftl A pointer to the flash translation layer instance to query.
+ *
+ * \returns the number of logical sectors.
+ */
+unsigned diskio_ftl_sector_count(
+        diskio_ftl_t *ftl);
+
+#endif /* DISKIO_FTL_H_ */
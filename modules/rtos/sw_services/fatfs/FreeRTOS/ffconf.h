@@ -52,9 +52,15 @@
 
 
 #ifndef FF_USE_MKFS
+#if USE_FATFS_FTL
+#define FF_USE_MKFS		1
+#else
 #define FF_USE_MKFS		0
 #endif
-/* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
+#endif
+/* This option switches f_mkfs() function. (0:Disable or 1:Enable)
+/  It is required by USE_FATFS_FTL, as the volume behind the flash translation
+/  layer is created by rtos_fatfs_init(). */
 
 
 #ifndef FF_USE_FASTSEEK
@@ -268,7 +274,7 @@
 
 
 #ifndef FF_USE_TRIM
-#define FF_USE_TRIM		0
+#define FF_USE_TRIM		1
 #endif
 /* This option switches support for ATA-TRIM. (0:Disable or 1:Enable)
 /  To enable Trim function, also CTRL_TRIM command should be implemented to the
@@ -358,6 +364,9 @@
 #ifndef FF_FS_TIMEOUT
 #define FF_FS_TIMEOUT	1000
 #endif
+#ifndef FF_FS_YIELD_SECTORS
+#define FF_FS_YIELD_SECTORS	4
+#endif
 
 /* The option FF_FS_REENTRANT switches the re-entrancy (thread safe) of the FatFs
 /  module itself. Note that regardless of this option, file access to different
@@ -372,6 +381,11 @@
 /      option/syscall.c.
 /
 /  The FF_FS_TIMEOUT defines timeout period in unit of time tick.
+/  The FF_FS_YIELD_SECTORS defines how many sectors f_read() and f_write() transfer
+/  before releasing the volume to any other tasks waiting on it, so that a long
+/  transfer does not hold off short accesses from other tasks until it completes.
+/  Tasks waiting on the volume are granted it in priority order. A transfer is only
+/  split up while other tasks are waiting on the volume. 0 disables this.
 /  The FF_SYNC_t defines O/S dependent sync object type. e.g. HANDLE, ID, OS_EVENT*,
 /  SemaphoreHandle_t and etc. A header file for O/S definitions needs to be
 /  included somewhere in the scope of ff.h. */
@@ -56,6 +56,46 @@ DWORD get_fattime (
 
 #if FF_FS_REENTRANT	/* Mutal exclusion */
 
+#if FF_FS_YIELD_SECTORS > 0
+/* The number of tasks waiting on, or about to wait on, each volume's sync object */
+static struct {
+	FF_SYNC_t sobj;
+	volatile UBaseType_t waiters;
+} grant_waiters[FF_VOLUMES];
+
+static volatile UBaseType_t* grant_waiters_get (
+	FF_SYNC_t sobj
+)
+{
+	for (int i = 0; i < FF_VOLUMES; i++) {
+		if (grant_waiters[i].sobj == sobj) {
+			return &grant_waiters[i].waiters;
+		}
+	}
+	return NULL;
+}
+
+static int grant_take (
+	FF_SYNC_t sobj
+)
+{
+	volatile UBaseType_t* waiters = grant_waiters_get(sobj);
+	int ret;
+
+	taskENTER_CRITICAL();
+	(*waiters)++;
+	taskEXIT_CRITICAL();
+
+	ret = (int)(xSemaphoreTake(sobj, FF_FS_TIMEOUT) == pdTRUE);
+
+	taskENTER_CRITICAL();
+	(*waiters)--;
+	taskEXIT_CRITICAL();
+
+	return ret;
+}
+#endif
+
 /*------------------------------------------------------------------------*/
 /* Create a Synchronization Object                                        */
 /*------------------------------------------------------------------------*/
@@ -71,6 +111,10 @@ int ff_cre_syncobj (	/* 1:Function succeeded, 0:Could not create the sync object
 {
 	/* FreeRTOS */
 	*sobj = xSemaphoreCreateMutex();
+#if FF_FS_YIELD_SECTORS > 0
+	grant_waiters[vol].sobj = *sobj;
+	grant_waiters[vol].waiters = 0;
+#endif
 	return (int)(*sobj != NULL);
 }
 
@@ -87,6 +131,13 @@ int ff_del_syncobj (	/* 1:Function succeeded, 0:Could not delete due to an error
 	FF_SYNC_t sobj		/* Sync object tied to the logical drive to be deleted */
 )
 {
+#if FF_FS_YIELD_SECTORS > 0
+	for (int i = 0; i < FF_VOLUMES; i++) {
+		if (grant_waiters[i].sobj == sobj) {
+			grant_waiters[i].sobj = NULL;
+		}
+	}
+#endif
 	vSemaphoreDelete(sobj);
 	return 1;
 }
@@ -103,7 +154,11 @@ int ff_req_grant (	/* 1:Got a grant to access the volume, 0:Could not get a gran
 	FF_SYNC_t sobj	/* Sync object to wait */
 )
 {
+#if FF_FS_YIELD_SECTORS > 0
+	return grant_take(sobj);
+#else
 	return (int)(xSemaphoreTake(sobj, FF_FS_TIMEOUT) == pdTRUE);
+#endif
 }
 
 
@@ -120,5 +175,49 @@ void ff_rel_grant (
 	xSemaphoreGive(sobj);
 }
 
+
+#if FF_FS_YIELD_SECTORS > 0
+/*------------------------------------------------------------------------*/
+/* Check for Tasks Waiting to Access the Volume                           */
+/*------------------------------------------------------------------------*/
+/* This function is called by f_read() and f_write() while they hold the
+/  volume. They only split a transfer up and yield the volume when it returns
+/  1, so that a transfer nobody else is waiting behind runs at full speed.
+*/
+
+int ff_grant_waiting (	/* 1:Other tasks are waiting on the volume, 0:None are */
+	FF_SYNC_t sobj	/* Sync object held by the caller */
+)
+{
+	volatile UBaseType_t* waiters = grant_waiters_get(sobj);
+
+	return (int)(waiters != NULL && *waiters > 0);
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Yield Grant to Access the Volume                                       */
+/*------------------------------------------------------------------------*/
+/* This function is called by f_read() and f_write() every FF_FS_YIELD_SECTORS
+/  sectors while other tasks are waiting on the volume. A task of higher
+/  priority waiting on the volume takes it as soon as it is released. The
+/  yield lets a task of the same priority take it too, rather than it being
+/  taken straight back. The volume is kept if no task is waiting on it any
+/  more. When a 0 is returned, the file function fails with FR_TIMEOUT.
+*/
+
+int ff_yield_grant (	/* 1:Got the grant back, 0:Could not get a grant */
+	FF_SYNC_t sobj	/* Sync object to yield */
+)
+{
+	if (!ff_grant_waiting(sobj)) {
+		return 1;
+	}
+	xSemaphoreGive(sobj);
+	taskYIELD();
+	return grant_take(sobj);
+}
+#endif
+
 #endif
 
@@ -4,6 +4,16 @@
 #include <xcore/assert.h>
 
 #include "fs_support.h"
+#include "diskio.h"
+
+#if USE_FATFS_FTL && !FF_USE_MKFS
+#error FF_USE_MKFS must be enabled with USE_FATFS_FTL, as the volume is created through the flash translation layer
+#endif
+
+#if USE_SWMEM
+#include "rtos/drivers/swmem/api/rtos_swmem.h"
+#include "xcore_device_memory.h"
+#endif
 
 rtos_qspi_flash_t *ff_qspi_flash_ctx;
 
@@ -56,6 +66,80 @@ int rtos_ff_get_file(const char* filename, FIL* outfile, unsigned int* len )
 	return retval;
 }
 
+int rtos_ff_get_file_flash_address(FIL* fp, unsigned int* address )
+{
+	int retval = FS_SUP_FAIL;
+
+	if( ( fp != NULL ) && ( address != NULL ) && ( fp->obj.sclust != 0 ) )
+	{
+		FATFS *fs = fp->obj.fs;
+		FSIZE_t fptr = f_tell( fp );
+		DWORD clust = fp->obj.sclust;
+		LBA_t sector;
+		FSIZE_t cluster_bytes;
+		FSIZE_t ofs;
+
+#if FF_MAX_SS != FF_MIN_SS
+		cluster_bytes = ( FSIZE_t )fs->csize * fs->ssize;
+#else
+		cluster_bytes = ( FSIZE_t )fs->csize * FF_MAX_SS;
+#endif
+
+		/*
+		 * Follow the cluster chain by seeking into each cluster in turn,
+		 * and check that each cluster follows the one before it.
+		 */
+		for( ofs = cluster_bytes; ofs < f_size( fp ); ofs += cluster_bytes )
+		{
+			if( ( f_lseek( fp, ofs + 1 ) != FR_OK ) || ( fp->clust != clust + 1 ) )
+			{
+				break;
+			}
+			clust++;
+		}
+
+		if( ofs >= f_size( fp ) )
+		{
+			sector = fs->database + ( LBA_t )fs->csize * ( fp->obj.sclust - 2 );
+
+			if( disk_ioctl( fs->pdrv, QSPI_FLASH_GET_ADDRESS, &sector ) == RES_OK )
+			{
+				*address = sector;
+				retval = FS_SUP_SUCCESS;
+			}
+		}
+
+		f_lseek( fp, fptr );
+	}
+
+	return retval;
+}
+
+#if USE_SWMEM
+int rtos_ff_map_file(FIL* fp, const void** data )
+{
+	int retval = FS_SUP_FAIL;
+	unsigned int address;
+
+	if( ( data != NULL ) && ( rtos_ff_get_file_flash_address( fp, &address ) == FS_SUP_SUCCESS ) )
+	{
+		/* Both ends of the file must be inside the software memory */
+		void *start = rtos_swmem_ptr_get( address );
+		void *end = rtos_swmem_ptr_get( address + f_size( fp ) - 1 );
+
+		if( ( start != NULL ) && ( end != NULL ) )
+		{
+			/* Lines of the file's sectors may be cached from before it was written */
+			swmem_flash_invalidate();
+			*data = start;
+			retval = FS_SUP_SUCCESS;
+		}
+	}
+
+	return retval;
+}
+#endif
+
 void rtos_fatfs_init( rtos_qspi_flash_t *qspi_flash_ctx )
 {
     FATFS *fs;
@@ -69,6 +153,23 @@ void rtos_fatfs_init( rtos_qspi_flash_t *qspi_flash_ctx )
 
     ff_qspi_flash_ctx = qspi_flash_ctx;
 
+#if USE_FATFS_FTL
+    /*
+     * A volume behind the flash translation layer cannot be written into
+     * the flash directly, so one is created the first time it is mounted.
+     */
+    if( f_mount( fs, "", 1 ) == FR_NO_FILESYSTEM )
+    {
+        void *work = FS_SUP_MALLOC( FF_MAX_SS );
+
+        if( ( work == NULL ) || ( f_mkfs( "", NULL, work, FF_MAX_SS ) != FR_OK ) )
+        {
+            xassert(0);	/* Failed to create the file system */
+        }
+        FS_SUP_FREE( work );
+    }
+#endif
+
 	if( f_mount( fs, "", 0 ) != FR_OK )
 	{
 		FS_SUP_FREE( fs );
@@ -20,9 +20,47 @@
  */
 int rtos_ff_get_file(const char* filename, FIL* outfile, unsigned int* len );
 
+/**
+ * Get the byte address in flash of the data of an open file
+ *
+ * This is only possible when the file's clusters are consecutive, and the
+ * volume is stored in place in the flash rather than behind the flash
+ * translation layer. The file's read/write pointer is left unchanged.
+ *
+ * \param[in]     fp               FIL pointer of the open file
+ * \param[out]    address          Pointer to populate with the flash address
+ *
+ * \returns       FS_SUP_SUCCESS on success
+ * 				  FS_SUP_FAIL otherwise
+ */
+int rtos_ff_get_file_flash_address(FIL* fp, unsigned int* address );
+
+#if USE_SWMEM
+/**
+ * Get a read only view of the data of an open file without copying it
+ *
+ * The view is a pointer into software memory, which must be backed by the
+ * flash on this tile with swmem_setup(). The file's data must be in flash
+ * as described for rtos_ff_get_file_flash_address(). The view remains valid
+ * while the file is neither modified nor deleted, even after it is closed.
+ * Mapping a file discards everything that SwMem has cached from the flash.
+ *
+ * \param[in]     fp               FIL pointer of the open file
+ * \param[out]    data             Pointer to populate with the view of the
+ *                                 file's f_size() bytes
+ *
+ * \returns       FS_SUP_SUCCESS on success
+ * 				  FS_SUP_FAIL otherwise
+ */
+int rtos_ff_map_file(FIL* fp, const void** data );
+#endif
+
 /**
  *  Initialize and mount file system
  *
+ *  When the flash translation layer is enabled with USE_FATFS_FTL and
+ *  FF_USE_MKFS is enabled, an empty volume is created if none is found.
+ *
  *  \param[in] qspi_flash_ctx The QSPI Flash driver context to be used
  *                            by the default implementations of the diskio
  *                            functions.
@@ -377,6 +377,10 @@ int ff_cre_syncobj (BYTE vol, FF_SYNC_t* sobj);	/* Create a sync object */
 int ff_req_grant (FF_SYNC_t sobj);		/* Lock sync object */
 void ff_rel_grant (FF_SYNC_t sobj);		/* Unlock sync object */
 int ff_del_syncobj (FF_SYNC_t sobj);	/* Delete a sync object */
+#if FF_FS_YIELD_SECTORS > 0
+int ff_grant_waiting (FF_SYNC_t sobj);	/* Check for tasks waiting on sync object */
+int ff_yield_grant (FF_SYNC_t sobj);	/* Unlock sync object, let waiting tasks run and lock it again */
+#endif
 #endif
 
 
@@ -952,6 +952,22 @@ static void unlock_fs (
 	}
 }
 
+
+#if FF_FS_YIELD_SECTORS > 0
+/*-----------------------------------------------------------------------*/
+/* Let other tasks access the volume in the middle of a long transfer    */
+/*-----------------------------------------------------------------------*/
+static FRESULT yield_fs (	/* FR_OK:Grant is held again, FR_TIMEOUT:Grant is not held, FR_INVALID_OBJECT:Grant is held */
+	FATFS* fs,		/* Filesystem object */
+	FFOBJID* obj	/* Object being transferred */
+)
+{
+	if (!ff_yield_grant(fs->sobj)) return FR_TIMEOUT;
+	if (!fs->fs_type || obj->id != fs->id) return FR_INVALID_OBJECT;	/* Volume was unmounted or remounted meanwhile */
+	return FR_OK;
+}
+#endif
+
 #endif
 
 
@@ -3894,6 +3910,9 @@ FRESULT f_read (
 	FSIZE_t remain;
 	UINT rcnt, cc, csect;
 	BYTE *rbuff = (BYTE*)buff;
+#if FF_FS_REENTRANT && FF_FS_YIELD_SECTORS > 0
+	UINT ybase = 0;
+#endif
 
 
 	*br = 0;	/* Clear read byte counter */
@@ -3905,6 +3924,13 @@ FRESULT f_read (
 
 	for ( ;  btr;								/* Repeat until btr bytes read */
 		btr -= rcnt, *br += rcnt, rbuff += rcnt, fp->fptr += rcnt) {
+#if FF_FS_REENTRANT && FF_FS_YIELD_SECTORS > 0
+		if (*br - ybase >= (UINT)FF_FS_YIELD_SECTORS * SS(fs) && ff_grant_waiting(fs->sobj)) {	/* Let waiting tasks in between long reads */
+			ybase = *br;
+			res = yield_fs(fs, &fp->obj);
+			if (res != FR_OK) LEAVE_FF(fs, res);
+		}
+#endif
 		if (fp->fptr % SS(fs) == 0) {			/* On the sector boundary? */
 			csect = (UINT)(fp->fptr / SS(fs) & (fs->csize - 1));	/* Sector offset in the cluster */
 			if (csect == 0) {					/* On the cluster boundary? */
@@ -3932,6 +3958,9 @@ FRESULT f_read (
 				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
 					cc = fs->csize - csect;
 				}
+#if FF_FS_REENTRANT && FF_FS_YIELD_SECTORS > 0
+				if (cc > FF_FS_YIELD_SECTORS && ff_grant_waiting(fs->sobj)) cc = FF_FS_YIELD_SECTORS;	/* Clip at yield interval while other tasks wait */
+#endif
 				if (disk_read(fs->pdrv, rbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
 #if !FF_FS_READONLY && FF_FS_MINIMIZE <= 2		/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if FF_FS_TINY
@@ -3994,6 +4023,9 @@ FRESULT f_write (
 	LBA_t sect;
 	UINT wcnt, cc, csect;
 	const BYTE *wbuff = (const BYTE*)buff;
+#if FF_FS_REENTRANT && FF_FS_YIELD_SECTORS > 0
+	UINT ybase = 0;
+#endif
 
 
 	*bw = 0;	/* Clear write byte counter */
@@ -4008,6 +4040,14 @@ FRESULT f_write (
 
 	for ( ;  btw;							/* Repeat until all data written */
 		btw -= wcnt, *bw += wcnt, wbuff += wcnt, fp->fptr += wcnt, fp->obj.objsize = (fp->fptr > fp->obj.objsize) ? fp->fptr : fp->obj.objsize) {
+#if FF_FS_REENTRANT && FF_FS_YIELD_SECTORS > 0
+		if (*bw - ybase >= (UINT)FF_FS_YIELD_SECTORS * SS(fs) && ff_grant_waiting(fs->sobj)) {	/* Let waiting tasks in between long writes */
+			ybase = *bw;
+			fp->flag |= FA_MODIFIED;		/* Set file change flag in case the write ends here */
+			res = yield_fs(fs, &fp->obj);
+			if (res != FR_OK) LEAVE_FF(fs, res);
+		}
+#endif
 		if (fp->fptr % SS(fs) == 0) {		/* On the sector boundary? */
 			csect = (UINT)(fp->fptr / SS(fs)) & (fs->csize - 1);	/* Sector offset in the cluster */
 			if (csect == 0) {				/* On the cluster boundary? */
@@ -4048,6 +4088,9 @@ FRESULT f_write (
 				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
 					cc = fs->csize - csect;
 				}
+#if FF_FS_REENTRANT && FF_FS_YIELD_SECTORS > 0
+				if (cc > FF_FS_YIELD_SECTORS && ff_grant_waiting(fs->sobj)) cc = FF_FS_YIELD_SECTORS;	/* Clip at yield interval while other tasks wait */
+#endif
 				if (disk_write(fs->pdrv, wbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
 #if FF_FS_MINIMIZE <= 2
 #if FF_FS_TINY
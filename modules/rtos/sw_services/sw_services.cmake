@@ -17,6 +17,7 @@ set(SNTPD_DIR "${SW_SERVICES_DIR}/sntpd")
 set(TLS_SUPPORT_DIR "${SW_SERVICES_DIR}/tls_support")
 set(TINYUSB_DIR "${SW_SERVICES_DIR}/usb")
 set(DISPATCHER_DIR "${SW_SERVICES_DIR}/dispatcher")
+set(ASSET_IMAGE_DIR "${SW_SERVICES_DIR}/asset_image")
 
 #**********************
 # Options
@@ -25,6 +26,7 @@ option(USE_WIFI_MANAGER "Enable to use WiFi manager" FALSE)
 option(USE_DHCPD "Enable to use DHCP" FALSE)
 option(USE_DEVICE_CONTROL "Enable to use Device Control" FALSE)
 option(USE_FATFS "Enable to use FATFS filesystem" FALSE)
+option(USE_FATFS_FTL "Enable to put a wear leveling flash translation layer under the FATFS disk backend" FALSE)
 option(USE_HTTP_CORE "Enable to use HTTP client and parser" FALSE)
 option(USE_HTTP_PARSER "Enable to use HTTP parser" FALSE)
 option(USE_JSON_PARSER "Enable to use JSON parser" FALSE)
@@ -35,6 +37,7 @@ option(USE_CUSTOM_MBEDTLS_CONFIG "Enable to provide an alternate mbedtls_config.
 option(USE_TINYUSB "Enable to use TinyUSB" FALSE)
 option(USE_DISK_MANAGER_TUSB "Enable to use RAM and Flash disk manager" FALSE)
 option(USE_DISPATCHER "Enable to use Dispatcher" FALSE)
+option(USE_ASSET_IMAGE "Enable to use read only asset images in flash" FALSE)
 
 #********************************
 # Gather wifi manager sources
@@ -140,6 +143,12 @@ if(${USE_${THIS_LIB}})
     add_compile_definitions(
         USE_FATFS=1
     )
+    if(${USE_FATFS_FTL})
+        add_compile_definitions(
+            USE_FATFS_FTL=1
+        )
+        message("${COLOR_GREEN}Adding FATFS flash translation layer...${COLOR_RESET}")
+    endif()
     message("${COLOR_GREEN}Adding ${THIS_LIB}...${COLOR_RESET}")
 endif()
 unset(THIS_LIB)
@@ -450,6 +459,30 @@ if(${USE_${THIS_LIB}})
 endif()
 unset(THIS_LIB)
 
+#********************************
+# Gather asset image sources
+#********************************
+set(THIS_LIB ASSET_IMAGE)
+if(${USE_${THIS_LIB}})
+	set(${THIS_LIB}_FLAGS "-Os")
+
+	file(GLOB_RECURSE ${THIS_LIB}_SOURCES "${${THIS_LIB}_DIR}/src/*.c")
+
+    if(${${THIS_LIB}_FLAGS})
+       set_source_files_properties(${${THIS_LIB}_SOURCES} PROPERTIES COMPILE_FLAGS ${${THIS_LIB}_FLAGS})
+    endif()
+
+	set(${THIS_LIB}_INCLUDES
+	    "${${THIS_LIB}_DIR}/api"
+	)
+
+    add_compile_definitions(
+        USE_ASSET_IMAGE=1
+    )
+    message("${COLOR_GREEN}Adding ${THIS_LIB}...${COLOR_RESET}")
+endif()
+unset(THIS_LIB)
+
 #**********************
 # set user variables
 #**********************
@@ -459,6 +492,7 @@ set(SW_SERVICES_SOURCES
     ${JSON_PARSER_SOURCES}
     ${TINYUSB_SOURCES}
     ${DISPATCHER_SOURCES}
+    ${ASSET_IMAGE_SOURCES}
 )
 
 set(SW_SERVICES_INCLUDES
@@ -467,6 +501,7 @@ set(SW_SERVICES_INCLUDES
     ${JSON_PARSER_INCLUDES}
     ${TINYUSB_INCLUDES}
     ${DISPATCHER_INCLUDES}
+    ${ASSET_IMAGE_INCLUDES}
 )
 
 list(REMOVE_DUPLICATES SW_SERVICES_SOURCES)
@@ -62,6 +62,11 @@ void default_mbedtls_debug( void *ctx, int level,
 /**
  * Populate an mbedtls certificate, found at filepath
  *
+ * When USE_SWMEM is enabled and the file can be mapped with rtos_ff_map_file(),
+ * a DER certificate is used in place in the flash without being copied, so the
+ * file must not be modified or deleted while the certificate is in use. A PEM
+ * certificate is always base64 decoded into the heap.
+ *
  * \param[in/out] cert            Pointer to the cert to populate
  * \param[in]     filepath    	  Filepath that cert is located at
  *
@@ -73,6 +78,9 @@ int get_cert( mbedtls_x509_crt* cert, const char* filepath );
 /**
  * Populate an mbedtls key, found at filepath
  *
+ * The key is always copied into the heap, and a PEM key is base64 decoded
+ * there first.
+ *
  * \param[in/out] key             Pointer to the key to populate
  * \param[in]     filepath    	  Filepath that key is located at
  *
@@ -191,6 +191,18 @@ int tls_recv( void* ctx, unsigned char* buf, size_t len)
 
 extern int rtos_ff_get_file(const char* filename, FIL* outfile, unsigned int* len );
 
+#if USE_SWMEM
+/*
+ * mbedtls only parses PEM data that ends with a NUL terminator, which is not
+ * normally stored in the file. A mapped file is therefore only parsed in
+ * place when it is DER, which starts with a SEQUENCE tag, or when it
+ * includes the terminator.
+ */
+static int parsable_in_place( const unsigned char* data, unsigned int len )
+{
+	return ( len > 0 ) && ( ( data[ 0 ] == 0x30 ) || ( data[ len - 1 ] == 0x00 ) );
+}
+#endif
 
 int get_cert( mbedtls_x509_crt* cert, const char* filepath )
 {
@@ -215,6 +227,24 @@ int get_cert( mbedtls_x509_crt* cert, const char* filepath )
 			break;
 		}
 
+#if USE_SWMEM
+		/*
+		 * A DER certificate is used in place, so it is never copied into the
+		 * heap. mbedtls always base64 decodes PEM into the heap, so a mapped
+		 * PEM file only saves the copy of the file itself.
+		 */
+		if( rtos_ff_map_file( &prvfile, ( const void** ) &data ) == pdPASS &&
+			parsable_in_place( data, prvfile_len ) &&
+			( ( data[ 0 ] == 0x30 ) ?
+				mbedtls_x509_crt_parse_der_nocopy( cert, ( const unsigned char* ) data, prvfile_len ) :
+				mbedtls_x509_crt_parse( cert, ( const unsigned char* ) data, prvfile_len ) ) >= 0 )
+		{
+			retval = pdPASS;
+			f_close( &prvfile );
+			break;
+		}
+#endif
+
 		/* 0x00 must be at the end of data to parsed as a PEM certificate
 		 * by mbedtls, so malloc an extra byte
 		 * See mbedtls_x509_crt_parse_file */
@@ -282,6 +312,22 @@ int get_key( mbedtls_pk_context* key, const char* filepath )
 			break;
 		}
 
+#if USE_SWMEM
+		/*
+		 * DER and NUL terminated PEM files are parsed in place, saving the
+		 * copy of the file. mbedtls still copies the key itself into the
+		 * heap, and base64 decodes PEM there first.
+		 */
+		if( rtos_ff_map_file( &prvfile, ( const void** ) &data ) == pdPASS &&
+			parsable_in_place( data, prvfile_len ) &&
+			mbedtls_pk_parse_key( key, ( const unsigned char* ) data, prvfile_len, NULL, 0 ) == 0 )
+		{
+			retval = pdPASS;
+			f_close( &prvfile );
+			break;
+		}
+#endif
+
 		/* 0x00 must be at the end of data to parsed as a PEM certificate
 		 * by mbedtls, so malloc an extra byte.
 		 * See mbedtls_x509_crt_parse_file
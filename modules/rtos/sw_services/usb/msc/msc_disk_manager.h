@@ -103,4 +103,12 @@ int32_t qspi_flash_disk_read(disk_desc_t *disk_ctx, uint8_t *buffer, uint32_t lb
 int32_t qspi_flash_disk_write(disk_desc_t *disk_ctx, const uint8_t *buffer, uint32_t lba, uint32_t offset, uint32_t bufsize);
 int32_t qspi_flash_disk_scsi_command(disk_desc_t *disk_ctx, uint8_t lun, uint8_t *buffer, const uint8_t *scsi_cmd, uint16_t bufsize);
 
+/* Writes any data for the flash disk held in the sector cache to the
+ * flash. Applications that provide their own flash disk start_stop or
+ * scsi_command callbacks should call this when the disk is stopped or ejected
+ * and on SYNCHRONIZE CACHE. Applications that provide their own
+ * tud_msc_write10_complete_cb() must call it from there.
+ */
+void qspi_flash_disk_flush(disk_desc_t *disk_ctx);
+
 #endif  // MSC_DISK_MANAGER_H_
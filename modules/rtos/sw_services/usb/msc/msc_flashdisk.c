@@ -4,6 +4,9 @@
 #define DEBUG_UNIT MSC_FLASHDISK
 
 #include <stdio.h>
+#include <string.h>
+
+#include <xcore/assert.h>
 
 #include "rtos_osal.h"
 #include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
@@ -14,6 +17,83 @@
 #define QSPI_FLASH_SECTOR_SIZE 4096
 #endif
 
+/*
+ * Hosts write in blocks smaller than a flash sector. The blocks written to a
+ * sector by a single WRITE10 command are gathered in a single sector cache,
+ * so that the sector is erased and programmed once rather than once per
+ * block. The cached sector is written to the flash as soon as its last block
+ * has been written, and when a write goes to another sector, so a command
+ * that ends on a sector boundary is in the flash before its status is
+ * returned. Otherwise the partly written sector at its end is written once
+ * the command completes, before the next command is processed. Unlike a
+ * write-back cache, this never holds data past the end of the command that
+ * wrote it.
+ */
+
+/* Not in the TinyUSB SCSI command enumeration */
+#define FLASH_DISK_SCSI_CMD_SYNCHRONIZE_CACHE_10 0x35
+
+static struct {
+    disk_desc_t *disk; /* The disk that the cached sector belongs to, or NULL */
+    unsigned address;  /* The flash address of the cached sector */
+    bool dirty;
+    uint8_t *buf;
+    rtos_osal_mutex_t lock;
+} sector_cache;
+
+/* Must be called with sector_cache.lock held */
+static void sector_cache_write_back(void)
+{
+    if (sector_cache.dirty) {
+        rtos_qspi_flash_t *flash_ctx = (rtos_qspi_flash_t*)sector_cache.disk->args;
+
+        rtos_qspi_flash_lock(flash_ctx);
+        {
+            rtos_qspi_flash_erase(
+                    flash_ctx,
+                    sector_cache.address,
+                    (size_t)QSPI_FLASH_SECTOR_SIZE);
+            rtos_qspi_flash_write(
+                    flash_ctx,
+                    sector_cache.buf,
+                    sector_cache.address,
+                    (size_t)QSPI_FLASH_SECTOR_SIZE);
+        }
+        rtos_qspi_flash_unlock(flash_ctx);
+
+        sector_cache.dirty = false;
+    }
+}
+
+/*
+ * The cache is set up by the first write, which, like all the disk
+ * callbacks, is called from the USB task. The buffer is published last, as
+ * qspi_flash_disk_flush() may be called from other threads and uses the
+ * mutex once it sees the buffer.
+ */
+static void sector_cache_init(void)
+{
+    uint8_t *buf;
+
+    rtos_osal_mutex_create(&sector_cache.lock, "msc_flashdisk_cache", RTOS_OSAL_NOT_RECURSIVE);
+
+    buf = rtos_osal_malloc(sizeof(uint8_t) * QSPI_FLASH_SECTOR_SIZE);
+    xassert(buf != NULL);
+
+    sector_cache.buf = buf;
+}
+
+void qspi_flash_disk_flush(disk_desc_t *disk_ctx)
+{
+    if (sector_cache.buf != NULL) {
+        rtos_osal_mutex_get(&sector_cache.lock, RTOS_OSAL_WAIT_FOREVER);
+        if (sector_cache.disk == disk_ctx) {
+            sector_cache_write_back();
+        }
+        rtos_osal_mutex_put(&sector_cache.lock);
+    }
+}
+
 __attribute__((fptrgroup("disk_init_fptr_grp"))) __attribute__((weak))
 bool qspi_flash_disk_init(disk_desc_t *disk_ctx)
 {
@@ -32,6 +112,11 @@ __attribute__((fptrgroup("disk_start_stop_fptr_grp"))) __attribute__((weak))
 bool qspi_flash_disk_start_stop(disk_desc_t *disk_ctx, uint8_t power_condition, bool start, bool load_eject)
 {
     rtos_printf("flash_disk default start_stop callback\n");
+
+    if (!start) {
+        qspi_flash_disk_flush(disk_ctx);
+    }
+
     return true;
 }
 
@@ -39,13 +124,39 @@ __attribute__((fptrgroup("disk_read_fptr_grp"))) __attribute__((weak))
 int32_t qspi_flash_disk_read(disk_desc_t *disk_ctx, uint8_t *buffer, uint32_t lba, uint32_t offset, uint32_t bufsize)
 {
     rtos_qspi_flash_t *flash_ctx = (rtos_qspi_flash_t*)disk_ctx->args;
+    unsigned address = (unsigned)(disk_ctx->starting_addr + (lba * disk_ctx->block_size) + offset);
 
     rtos_printf("flash_disk default read callback\n");
-    rtos_qspi_flash_read(
-        flash_ctx,
-        (uint8_t*)buffer,
-        (unsigned)(disk_ctx->starting_addr + (lba * disk_ctx->block_size) + offset),
-        (size_t)bufsize);
+
+    if (sector_cache.buf == NULL) {
+        rtos_qspi_flash_read(
+            flash_ctx,
+            (uint8_t*)buffer,
+            address,
+            (size_t)bufsize);
+    } else {
+        /*
+         * The cached sector may be newer than the flash. The lock is held
+         * across the flash read so that the cache cannot be written back and
+         * refilled between the read and the patch.
+         */
+        rtos_osal_mutex_get(&sector_cache.lock, RTOS_OSAL_WAIT_FOREVER);
+        rtos_qspi_flash_read(
+            flash_ctx,
+            (uint8_t*)buffer,
+            address,
+            (size_t)bufsize);
+        if (sector_cache.disk == disk_ctx && sector_cache.dirty) {
+            unsigned start = TU_MAX(address, sector_cache.address);
+            unsigned end = TU_MIN(address + bufsize, sector_cache.address + QSPI_FLASH_SECTOR_SIZE);
+
+            if (start < end) {
+                memcpy(buffer + (start - address), sector_cache.buf + (start - sector_cache.address), end - start);
+            }
+        }
+        rtos_osal_mutex_put(&sector_cache.lock);
+    }
+
     return bufsize;
 }
 
@@ -53,39 +164,72 @@ __attribute__((fptrgroup("disk_write_fptr_grp"))) __attribute__((weak))
 int32_t qspi_flash_disk_write(disk_desc_t *disk_ctx, const uint8_t *buffer, uint32_t lba, uint32_t offset, uint32_t bufsize)
 {
     rtos_qspi_flash_t *flash_ctx = (rtos_qspi_flash_t*)disk_ctx->args;
+    unsigned address = (unsigned)(disk_ctx->starting_addr + (lba * disk_ctx->block_size) + offset);
+    uint32_t remaining = bufsize;
 
-    rtos_printf("flash_disk default write callback adr: 0x%x, size: %u lba: %u offset: %u\n", disk_ctx->starting_addr + (lba * disk_ctx->block_size), bufsize, lba, offset);
+    rtos_printf("flash_disk default write callback adr: 0x%x, size: %u lba: %u offset: %u\n", address, bufsize, lba, offset);
 
-    xassert(bufsize <= QSPI_FLASH_SECTOR_SIZE);
+    if (sector_cache.buf == NULL) {
+        sector_cache_init();
+    }
 
-    uint8_t *tmp_buf = rtos_osal_malloc( sizeof(uint8_t) * QSPI_FLASH_SECTOR_SIZE);
+    rtos_osal_mutex_get(&sector_cache.lock, RTOS_OSAL_WAIT_FOREVER);
 
-    rtos_qspi_flash_lock(flash_ctx);
-    {
-        rtos_qspi_flash_read(
-                flash_ctx,
-                tmp_buf,
-                (unsigned)(disk_ctx->starting_addr + (lba * disk_ctx->block_size)),
-                (size_t)QSPI_FLASH_SECTOR_SIZE);
-
-        memcpy(tmp_buf + offset, buffer, bufsize);
-
-        rtos_qspi_flash_erase(
-                flash_ctx,
-                (unsigned)(disk_ctx->starting_addr + (lba * disk_ctx->block_size)),
-                (size_t)QSPI_FLASH_SECTOR_SIZE);
-        rtos_qspi_flash_write(
-                flash_ctx,
-                (uint8_t *) tmp_buf,
-                (unsigned)(disk_ctx->starting_addr + (lba * disk_ctx->block_size)),
-                (size_t)QSPI_FLASH_SECTOR_SIZE);
-        rtos_qspi_flash_unlock(flash_ctx);
+    while (remaining > 0) {
+        unsigned sector_address = address & ~(QSPI_FLASH_SECTOR_SIZE - 1);
+        unsigned sector_offset = address - sector_address;
+        size_t len = TU_MIN(remaining, QSPI_FLASH_SECTOR_SIZE - sector_offset);
+
+        if (sector_cache.disk != disk_ctx || sector_cache.address != sector_address) {
+            sector_cache_write_back();
+
+            /* A write of the whole sector does not need its old contents */
+            if (len < QSPI_FLASH_SECTOR_SIZE) {
+                rtos_qspi_flash_read(
+                        flash_ctx,
+                        sector_cache.buf,
+                        sector_address,
+                        (size_t)QSPI_FLASH_SECTOR_SIZE);
+            }
+            sector_cache.disk = disk_ctx;
+            sector_cache.address = sector_address;
+        }
+
+        memcpy(sector_cache.buf + sector_offset, buffer, len);
+        sector_cache.dirty = true;
+
+        /* Nothing more of this command can go to a sector that it has completed */
+        if (sector_offset + len == QSPI_FLASH_SECTOR_SIZE) {
+            sector_cache_write_back();
+        }
+
+        buffer += len;
+        address += len;
+        remaining -= len;
     }
-    rtos_osal_free(tmp_buf);
+
+    rtos_osal_mutex_put(&sector_cache.lock);
 
     return bufsize;
 }
 
+/*
+ * Invoked by TinyUSB once a WRITE10 command has completed, before the next
+ * command is processed. Only the blocks of a partly written sector at the
+ * end of the command can still be in the cache here.
+ */
+__attribute__((weak))
+void tud_msc_write10_complete_cb(uint8_t lun)
+{
+    (void) lun;
+
+    if (sector_cache.buf != NULL) {
+        rtos_osal_mutex_get(&sector_cache.lock, RTOS_OSAL_WAIT_FOREVER);
+        sector_cache_write_back();
+        rtos_osal_mutex_put(&sector_cache.lock);
+    }
+}
+
 __attribute__((fptrgroup("disk_scsi_command_fptr_grp"))) __attribute__((weak))
 int32_t qspi_flash_disk_scsi_command(disk_desc_t *disk_ctx, uint8_t lun, uint8_t *buffer, const uint8_t *scsi_cmd, uint16_t bufsize)
 {
@@ -99,6 +243,11 @@ int32_t qspi_flash_disk_scsi_command(disk_desc_t *disk_ctx, uint8_t lun, uint8_t
             resplen = 0;
         break;
 
+        case FLASH_DISK_SCSI_CMD_SYNCHRONIZE_CACHE_10:
+            qspi_flash_disk_flush(disk_ctx);
+            resplen = 0;
+        break;
+
         default:
             // Set Sense = Invalid Command Operation
             tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
@@ -11,6 +11,8 @@
 #define INTERTILE_TEST_SYNC_PORT 11
 #define INTERTILE_TEST_SYNC_TASK_PRIORITY (configMAX_PRIORITIES-1)
 
+#define INTERTILE_TEST_PRIORITY_PORT 17
+
 #define I2C_MASTER_RPC_PORT 12
 #define I2C_MASTER_RPC_HOST_TASK_PRIORITY (configMAX_PRIORITIES/2)
 
@@ -88,7 +88,7 @@ void board_tile0_init(
         rtos_i2s_t *i2s_slave_ctx
     )
 {
-    rtos_intertile_init(intertile_ctx, tile1);
+    rtos_intertile_multi_link_init(intertile_ctx, tile1, 2);
     rtos_intertile_t *client_intertile_ctx[1] = {intertile_ctx};
 
     rtos_i2c_master_init(
@@ -218,7 +218,7 @@ void board_tile1_init(
 
     set_app_pll();
 
-    rtos_intertile_init(intertile_ctx, tile0);
+    rtos_intertile_multi_link_init(intertile_ctx, tile0, 2);
     rtos_intertile_t *client_intertile_ctx[1] = {intertile_ctx};
 
     rtos_gpio_init(
@@ -137,6 +137,7 @@ static void register_i2c_tests(i2c_test_ctx_t *test_ctx)
     register_rpc_master_write_multiple_test(test_ctx);
     register_rpc_master_read_test(test_ctx);
     register_rpc_master_read_multiple_test(test_ctx);
+    register_rpc_master_reg_batch_test(test_ctx);
 }
 
 static void i2c_init_tests(i2c_test_ctx_t *test_ctx, rtos_i2c_master_t *i2c_master_ctx, rtos_i2c_slave_t *i2c_slave_ctx)
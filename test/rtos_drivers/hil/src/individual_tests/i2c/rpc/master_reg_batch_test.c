@@ -0,0 +1,147 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+
+/* Library headers */
+#include "rtos/drivers/i2c/api/rtos_i2c_master.h"
+#include "rtos/drivers/i2c/api/rtos_i2c_slave.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/i2c/i2c_test.h"
+
+static const char* test_name = "rpc_master_reg_batch_test";
+
+#define local_printf( FMT, ... )    i2c_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define I2C_MASTER_TILE 1
+#define I2C_SLAVE_TILE  1
+
+typedef struct reg_test {
+    uint8_t reg;
+    uint8_t val;
+} reg_test_t;
+
+#if ON_TILE(I2C_MASTER_TILE) || ON_TILE(I2C_SLAVE_TILE)
+#define I2C_MASTER_REG_BATCH_TEST_ITER   4
+static reg_test_t test_vector[I2C_MASTER_REG_BATCH_TEST_ITER] =
+{
+    {0x00, 0xDE},
+    {0xFF, 0xAD},
+    {0xFA, 0xBE},
+    {0xB4, 0xEF},
+};
+#endif
+
+#if ON_TILE(I2C_SLAVE_TILE)
+static uint32_t test_slave_iters = 0;
+#endif
+
+I2C_MAIN_TEST_ATTR
+static int main_test(i2c_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(I2C_MASTER_TILE)
+    {
+        rtos_i2c_master_reg_op_t ops[I2C_MASTER_REG_BATCH_TEST_ITER];
+        i2c_regop_res_t reg_ret;
+        size_t num_ops_done;
+
+        for (int i=0; i<I2C_MASTER_REG_BATCH_TEST_ITER; i++)
+        {
+            ops[i].op = rtos_i2c_master_reg_op_write;
+            ops[i].device_addr = I2C_SLAVE_ADDR;
+            ops[i].reg_addr = test_vector[i].reg;
+            ops[i].data = test_vector[i].val;
+        }
+
+        local_printf("MASTER write batch of %d", I2C_MASTER_REG_BATCH_TEST_ITER);
+        reg_ret = rtos_i2c_master_reg_batch(ctx->i2c_master_ctx,
+                                            ops,
+                                            I2C_MASTER_REG_BATCH_TEST_ITER,
+                                            &num_ops_done);
+        if (reg_ret != I2C_REGOP_SUCCESS || num_ops_done != I2C_MASTER_REG_BATCH_TEST_ITER)
+        {
+            local_printf("MASTER failed after %u writes", num_ops_done);
+            return -1;
+        }
+    }
+    #endif
+
+    #if ON_TILE(I2C_SLAVE_TILE)
+    {
+        while(test_slave_iters < I2C_MASTER_REG_BATCH_TEST_ITER)
+        {
+            vTaskDelay(pdMS_TO_TICKS(1));
+        }
+
+        if (ctx->slave_success[ctx->cur_test] != 0)
+        {
+            local_printf("SLAVE failed");
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+#if ON_TILE(I2C_SLAVE_TILE)
+I2C_SLAVE_RX_ATTR
+static void slave_rx(rtos_i2c_slave_t *ctx, void *app_data, uint8_t *data, size_t len)
+{
+    i2c_test_ctx_t *test_ctx = (i2c_test_ctx_t*)ctx->app_data;
+
+    local_printf("SLAVE read iteration %d", test_slave_iters);
+    if (len != 2)
+    {
+        local_printf("SLAVE failed on iteration %d got len %d expected %d", test_slave_iters, len, 2);
+        test_ctx->slave_success[test_ctx->cur_test] = -1;
+    }
+    if (test_vector[test_slave_iters].reg != *data)
+    {
+        local_printf("SLAVE failed on iteration %d got reg 0x%x expected 0x%x", test_slave_iters, test_vector[test_slave_iters].reg, *data);
+        test_ctx->slave_success[test_ctx->cur_test] = -1;
+    }
+    if (test_vector[test_slave_iters].val != *++data)
+    {
+        local_printf("SLAVE failed on iteration %d got val 0x%x expected 0x%x", test_slave_iters, test_vector[test_slave_iters].val, *++data);
+        test_ctx->slave_success[test_ctx->cur_test] = -1;
+    }
+
+    test_slave_iters++;
+}
+#endif
+
+void register_rpc_master_reg_batch_test(i2c_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    #if ON_TILE(I2C_SLAVE_TILE)
+    test_ctx->slave_rx[this_test_num] = slave_rx;
+    #endif
+
+    #if ON_TILE(0)
+    test_ctx->slave_rx[this_test_num] = NULL;
+    #endif
+
+    test_ctx->slave_tx_start[this_test_num] = NULL;
+    test_ctx->slave_tx_done[this_test_num] = NULL;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -46,12 +46,17 @@ static void register_intertile_tests(intertile_test_ctx_t *test_ctx)
 {
     register_fixed_len_tx_test(test_ctx);
     register_var_len_tx_test(test_ctx);
+    register_rx_buf_test(test_ctx);
+    register_port_priority_test(test_ctx);
+    register_stream_test(test_ctx);
+    register_coalesce_test(test_ctx);
 }
 
-static void intertile_init_tests(intertile_test_ctx_t *test_ctx, rtos_intertile_t *intertile_ctx)
+static void intertile_init_tests(intertile_test_ctx_t *test_ctx, rtos_intertile_t *intertile_ctx, chanend_t c)
 {
     memset(test_ctx, 0, sizeof(intertile_test_ctx_t));
     test_ctx->intertile_ctx = intertile_ctx;
+    test_ctx->c = c;
 
     test_ctx->cur_test = 0;
     test_ctx->test_cnt = 0;
@@ -67,7 +72,7 @@ int intertile_device_tests(rtos_intertile_t *intertile_ctx, chanend_t c)
 
     sync(c);
     intertile_printf("Init test context");
-    intertile_init_tests(&test_ctx, intertile_ctx);
+    intertile_init_tests(&test_ctx, intertile_ctx, c);
     intertile_printf("Test context init");
 
     sync(c);
@@ -8,7 +8,7 @@
 
 #define intertile_printf( FMT, ... )       module_printf("INTERTILE", FMT, ##__VA_ARGS__)
 
-#define INTERTILE_MAX_TESTS   2
+#define INTERTILE_MAX_TESTS   6
 
 #define INTERTILE_MAIN_TEST_ATTR      __attribute__((fptrgroup("rtos_test_intertile_main_test_fptr_grp")))
 
@@ -20,6 +20,7 @@ struct intertile_test_ctx {
     char *name[INTERTILE_MAX_TESTS];
 
     rtos_intertile_t *intertile_ctx;
+    chanend_t c;
 
     INTERTILE_MAIN_TEST_ATTR int (*main_test[INTERTILE_MAX_TESTS])(intertile_test_ctx_t *ctx);
 };
@@ -31,5 +32,9 @@ int intertile_device_tests(rtos_intertile_t *intertile_ctx, chanend_t c);
 /* Local Tests */
 void register_fixed_len_tx_test(intertile_test_ctx_t *test_ctx);
 void register_var_len_tx_test(intertile_test_ctx_t *test_ctx);
+void register_rx_buf_test(intertile_test_ctx_t *test_ctx);
+void register_port_priority_test(intertile_test_ctx_t *test_ctx);
+void register_stream_test(intertile_test_ctx_t *test_ctx);
+void register_coalesce_test(intertile_test_ctx_t *test_ctx);
 
 #endif /* INTERTILE_TEST_H_ */
@@ -0,0 +1,241 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/intertile/api/rtos_intertile.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/intertile/intertile_test.h"
+
+static const char* test_name = "coalesce_test";
+
+#define local_printf( FMT, ... )    intertile_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define INTERTILE_TX_TILE 0
+#define INTERTILE_RX_TILE 1
+
+#define INTERTILE_BULK_PORT       INTERTILE_RPC_PORT
+#define INTERTILE_SMALL_PORT      INTERTILE_TEST_PRIORITY_PORT
+
+#define COALESCE_BULK_LEN         256
+#define COALESCE_MSG_LEN          8
+#define COALESCE_MSG_COUNT        4
+
+static uint8_t bulk_vector[COALESCE_BULK_LEN];
+
+static uint8_t msg_byte(int msg, int i)
+{
+    return (uint8_t)((msg << 4) | i);
+}
+
+#if ON_TILE(INTERTILE_TX_TILE)
+static void small_tx(intertile_test_ctx_t *ctx, int first, int count)
+{
+    uint8_t msg[COALESCE_MSG_LEN];
+
+    for (int i=first; i<first+count; i++)
+    {
+        for (int j=0; j<COALESCE_MSG_LEN; j++)
+        {
+            msg[j] = msg_byte(i, j);
+        }
+        rtos_intertile_tx(ctx->intertile_ctx, INTERTILE_SMALL_PORT, msg, sizeof(msg));
+    }
+}
+
+static int coalesced_check(intertile_test_ctx_t *ctx, unsigned expected)
+{
+    rtos_intertile_port_stats_t stats;
+
+    rtos_intertile_port_stats_get(ctx->intertile_ctx, INTERTILE_SMALL_PORT, &stats);
+    if (stats.tx_coalesced != expected)
+    {
+        local_printf("TX failed.  %u messages coalesced, expected %u", stats.tx_coalesced, expected);
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+#if ON_TILE(INTERTILE_RX_TILE)
+static int small_rx(intertile_test_ctx_t *ctx, int msg)
+{
+    uint8_t rx_buf[COALESCE_MSG_LEN];
+    int32_t bytes_rx;
+
+    bytes_rx = rtos_intertile_rx_buf(ctx->intertile_ctx, INTERTILE_SMALL_PORT, rx_buf, sizeof(rx_buf), RTOS_OSAL_WAIT_MS(100));
+    if (bytes_rx != COALESCE_MSG_LEN)
+    {
+        local_printf("RX failed on message %d.  Got %d expected %u", msg, bytes_rx, COALESCE_MSG_LEN);
+        return -1;
+    }
+
+    for (int j=0; j<COALESCE_MSG_LEN; j++)
+    {
+        if (rx_buf[j] != msg_byte(msg, j))
+        {
+            local_printf("RX failed on message %d at index %d.  Got 0x%x expected 0x%x", msg, j, rx_buf[j], msg_byte(msg, j));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int bulk_rx(intertile_test_ctx_t *ctx)
+{
+    uint8_t rx_buf[COALESCE_BULK_LEN];
+    int32_t bytes_rx;
+
+    bytes_rx = rtos_intertile_rx_buf(ctx->intertile_ctx, INTERTILE_BULK_PORT, rx_buf, sizeof(rx_buf), RTOS_OSAL_WAIT_MS(100));
+    if (bytes_rx != COALESCE_BULK_LEN)
+    {
+        local_printf("RX bulk failed.  Got %d expected %u", bytes_rx, COALESCE_BULK_LEN);
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+INTERTILE_MAIN_TEST_ATTR
+static int main_test(intertile_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    for (int i=0; i<COALESCE_BULK_LEN; i++)
+    {
+        bulk_vector[i] = (uint8_t)(0xFF & i);
+    }
+
+    #if ON_TILE(INTERTILE_TX_TILE)
+    {
+        static rtos_intertile_coalesce_t coalesce;
+        static uint8_t coalesce_buf[COALESCE_MSG_COUNT * (COALESCE_MSG_LEN + sizeof(uint32_t))];
+        rtos_intertile_port_stats_t stats;
+
+        rtos_intertile_port_coalesce_set(ctx->intertile_ctx, INTERTILE_SMALL_PORT, &coalesce, coalesce_buf, sizeof(coalesce_buf));
+        rtos_intertile_stats_clear(ctx->intertile_ctx);
+
+        /* Keep the link busy with the first half of the bulk message */
+        rtos_intertile_tx_len(ctx->intertile_ctx, INTERTILE_BULK_PORT, sizeof(bulk_vector));
+        rtos_intertile_tx_data(ctx->intertile_ctx, bulk_vector, sizeof(bulk_vector) / 2);
+
+        /* These must all wait in the coalesce buffer */
+        small_tx(ctx, 0, COALESCE_MSG_COUNT);
+
+        /* Releasing the link sends them as a single transfer */
+        rtos_intertile_tx_data(ctx->intertile_ctx, bulk_vector + sizeof(bulk_vector) / 2, sizeof(bulk_vector) / 2);
+
+        /* The receiver takes this while it is part way through the transfer */
+        rtos_intertile_tx(ctx->intertile_ctx, INTERTILE_BULK_PORT, bulk_vector, sizeof(bulk_vector));
+
+        rtos_intertile_port_stats_get(ctx->intertile_ctx, INTERTILE_SMALL_PORT, &stats);
+        if (stats.tx_messages != COALESCE_MSG_COUNT || stats.tx_coalesced != COALESCE_MSG_COUNT)
+        {
+            local_printf("TX failed.  Sent %u messages, %u coalesced, expected %u", stats.tx_messages, stats.tx_coalesced, COALESCE_MSG_COUNT);
+            return -1;
+        }
+
+        /* With a window, messages are held back even though the link is free */
+        rtos_intertile_port_coalesce_window_set(ctx->intertile_ctx, INTERTILE_SMALL_PORT, sizeof(coalesce_buf), RTOS_OSAL_WAIT_MS(10), RTOS_OSAL_HIGHEST_PRIORITY);
+
+        small_tx(ctx, 0, 2);
+        if (coalesced_check(ctx, COALESCE_MSG_COUNT) != 0)
+        {
+            return -1;
+        }
+
+        /* The window expiring sends them */
+        rtos_osal_delay(RTOS_OSAL_WAIT_MS(20));
+        if (coalesced_check(ctx, COALESCE_MSG_COUNT + 2) != 0)
+        {
+            return -1;
+        }
+
+        /* Filling the buffer up to the flush length sends them straight away */
+        small_tx(ctx, 0, COALESCE_MSG_COUNT);
+        if (coalesced_check(ctx, 2 * COALESCE_MSG_COUNT + 2) != 0)
+        {
+            return -1;
+        }
+
+        rtos_intertile_port_coalesce_set(ctx->intertile_ctx, INTERTILE_SMALL_PORT, NULL, NULL, 0);
+        local_printf("TX done");
+    }
+    #endif
+
+    #if ON_TILE(INTERTILE_RX_TILE)
+    {
+        if (bulk_rx(ctx) != 0)
+        {
+            return -1;
+        }
+
+        for (int i=0; i<COALESCE_MSG_COUNT; i++)
+        {
+            if (small_rx(ctx, i) != 0)
+            {
+                return -1;
+            }
+
+            /* The rest of the transfer must still be waiting to be received */
+            if (i < COALESCE_MSG_COUNT - 1 && !rtos_intertile_rx_pending(ctx->intertile_ctx, INTERTILE_SMALL_PORT))
+            {
+                local_printf("RX failed.  No messages pending after message %d", i);
+                return -1;
+            }
+
+            /* The link must not be held while they are */
+            if (i == 0 && bulk_rx(ctx) != 0)
+            {
+                return -1;
+            }
+        }
+
+        if (rtos_intertile_rx_pending(ctx->intertile_ctx, INTERTILE_SMALL_PORT))
+        {
+            local_printf("RX failed.  Messages still pending");
+            return -1;
+        }
+
+        for (int i=0; i<2; i++)
+        {
+            if (small_rx(ctx, i) != 0)
+            {
+                return -1;
+            }
+        }
+
+        for (int i=0; i<COALESCE_MSG_COUNT; i++)
+        {
+            if (small_rx(ctx, i) != 0)
+            {
+                return -1;
+            }
+        }
+        local_printf("RX passed");
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_coalesce_test(intertile_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
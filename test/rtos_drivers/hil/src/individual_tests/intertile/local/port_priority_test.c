@@ -0,0 +1,171 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/intertile/api/rtos_intertile.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/intertile/intertile_test.h"
+
+static const char* test_name = "port_priority_test";
+
+#define local_printf( FMT, ... )    intertile_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define INTERTILE_TX_TILE 0
+#define INTERTILE_RX_TILE 1
+
+#define INTERTILE_BULK_PORT       INTERTILE_RPC_PORT
+#define INTERTILE_CONTROL_PORT    INTERTILE_TEST_PRIORITY_PORT
+
+#define INTERTILE_BULK_LEN        4096
+static uint8_t bulk_vector[INTERTILE_BULK_LEN];
+static uint8_t control_vector[] = {0xDE, 0xAD, 0xBE, 0xEF};
+
+#if ON_TILE(INTERTILE_TX_TILE)
+typedef struct test_args {
+    intertile_test_ctx_t *ctx;
+    SemaphoreHandle_t done;
+} test_args_t;
+
+static void bulk_tx_thread(test_args_t *args)
+{
+    /* This does not complete until the receiver reads the bulk port */
+    rtos_intertile_tx(args->ctx->intertile_ctx,
+                      INTERTILE_BULK_PORT,
+                      bulk_vector,
+                      sizeof(bulk_vector));
+
+    xSemaphoreGive(args->done);
+
+    vTaskSuspend(NULL);
+    while(1) {;}
+}
+#endif
+
+#if ON_TILE(INTERTILE_RX_TILE)
+static int check_rx(uint8_t *rx_buf, int32_t bytes_rx, uint8_t *test_buf, size_t test_len)
+{
+    if (bytes_rx != (int32_t)test_len)
+    {
+        local_printf("RX failed.  Got %d expected %u", bytes_rx, test_len);
+        return -1;
+    }
+
+    for (size_t j=0; j<test_len; j++)
+    {
+        if (test_buf[j] != rx_buf[j])
+        {
+            local_printf("RX failed at index %u.  Got %u expected %u", j, rx_buf[j], test_buf[j]);
+            return -1;
+        }
+    }
+
+    local_printf("RX passed.  Got %d expected %u", bytes_rx, test_len);
+    return 0;
+}
+#endif
+
+INTERTILE_MAIN_TEST_ATTR
+static int main_test(intertile_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    for (int i=0; i<INTERTILE_BULK_LEN; i++)
+    {
+        bulk_vector[i] = (uint8_t)(0xFF & i);
+    }
+
+    #if ON_TILE(INTERTILE_TX_TILE)
+    {
+        TaskHandle_t bulk_handle;
+        test_args_t args;
+
+        args.ctx = ctx;
+        args.done = xSemaphoreCreateBinary();
+
+        rtos_intertile_port_priority_set(ctx->intertile_ctx, INTERTILE_CONTROL_PORT, 1);
+
+        local_printf("TX bulk %u", sizeof(bulk_vector));
+        xTaskCreate((TaskFunction_t)bulk_tx_thread,
+                    "bulk_tx",
+                    RTOS_THREAD_STACK_SIZE(bulk_tx_thread),
+                    &args,
+                    configMAX_PRIORITIES-1,
+                    &bulk_handle);
+
+        /* Give the bulk transfer time to occupy the first link */
+        vTaskDelay(pdMS_TO_TICKS(1));
+
+        local_printf("TX control %u", sizeof(control_vector));
+        rtos_intertile_tx(ctx->intertile_ctx,
+                          INTERTILE_CONTROL_PORT,
+                          control_vector,
+                          sizeof(control_vector));
+
+        xSemaphoreTake(args.done, portMAX_DELAY);
+        vTaskDelete(bulk_handle);
+        vSemaphoreDelete(args.done);
+
+        rtos_intertile_port_priority_set(ctx->intertile_ctx, INTERTILE_CONTROL_PORT, 0);
+        local_printf("TX done");
+    }
+    #endif
+
+    #if ON_TILE(INTERTILE_RX_TILE)
+    {
+        static uint8_t rx_buf[INTERTILE_BULK_LEN];
+        int32_t bytes_rx;
+
+        /*
+         * The control message must arrive while the bulk message is still
+         * waiting to be read on the other link.
+         */
+        bytes_rx = rtos_intertile_rx_buf(ctx->intertile_ctx,
+                                         INTERTILE_CONTROL_PORT,
+                                         rx_buf,
+                                         sizeof(rx_buf),
+                                         RTOS_OSAL_WAIT_MS(100));
+        if (check_rx(rx_buf, bytes_rx, control_vector, sizeof(control_vector)) != 0)
+        {
+            return -1;
+        }
+
+        bytes_rx = rtos_intertile_rx_buf(ctx->intertile_ctx,
+                                         INTERTILE_BULK_PORT,
+                                         rx_buf,
+                                         sizeof(rx_buf),
+                                         RTOS_OSAL_WAIT_MS(100));
+        if (check_rx(rx_buf, bytes_rx, bulk_vector, sizeof(bulk_vector)) != 0)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_port_priority_test(intertile_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
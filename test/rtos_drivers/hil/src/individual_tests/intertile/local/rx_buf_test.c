@@ -0,0 +1,185 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/intertile/api/rtos_intertile.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/intertile/intertile_test.h"
+
+static const char* test_name = "rx_buf_test";
+
+#define local_printf( FMT, ... )    intertile_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define INTERTILE_TX_TILE 0
+#define INTERTILE_RX_TILE 1
+
+typedef struct test_params {
+    size_t len;
+    uint8_t *data;
+} test_params_t;
+
+#define INTERTILE_TEST_ITERS      4
+#define INTERTILE_RX_BUF_SIZE     500
+#define INTERTILE_POOL_BLOCKS     2
+
+#define INTERTILE_TEST_VECTOR_2_LEN   1000
+static uint8_t test_vector_0[] = {0x00, 0xFF, 0xAA, 0x55};
+static uint8_t test_vector_1[] = {0xDE, 0xAD, 0xBE, 0xEF};
+static uint8_t test_vector_2[INTERTILE_TEST_VECTOR_2_LEN] = {0};
+
+static test_params_t intertile_tests[INTERTILE_TEST_ITERS] =
+{
+    {sizeof(test_vector_0), test_vector_0},
+    {sizeof(test_vector_1), test_vector_1},
+    {sizeof(test_vector_2), test_vector_2},
+    {0, test_vector_0},
+};
+
+#if ON_TILE(INTERTILE_RX_TILE)
+static int check_rx(uint8_t *rx_buf, int32_t bytes_rx, size_t buf_len, uint8_t *test_buf, size_t test_len)
+{
+    /* Messages longer than the buffer are truncated */
+    int32_t expected = test_len <= buf_len ? (int32_t)test_len : RTOS_INTERTILE_RX_TRUNCATED;
+
+    if (bytes_rx != expected)
+    {
+        local_printf("RX failed.  Got %d expected %d", bytes_rx, expected);
+        return -1;
+    }
+
+    for (size_t j=0; j<test_len && j<buf_len; j++)
+    {
+        if (test_buf[j] != rx_buf[j])
+        {
+            local_printf("RX failed at index %u.  Got %u expected %u", j, rx_buf[j], test_buf[j]);
+            return -1;
+        }
+    }
+
+    local_printf("RX passed.  Got %d expected %d", bytes_rx, expected);
+    return 0;
+}
+#endif
+
+INTERTILE_MAIN_TEST_ATTR
+static int main_test(intertile_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    for (int i=0; i<INTERTILE_TEST_VECTOR_2_LEN; i++)
+    {
+        test_vector_2[i] = (uint8_t)(0xFF & i);
+    }
+
+    #if ON_TILE(INTERTILE_RX_TILE)
+    static uint32_t pool_buf[INTERTILE_POOL_BLOCKS * INTERTILE_RX_BUF_SIZE / sizeof(uint32_t)];
+    rtos_intertile_pool_t pool;
+
+    rtos_intertile_pool_init(&pool, pool_buf, INTERTILE_RX_BUF_SIZE, INTERTILE_POOL_BLOCKS);
+
+    /* Nothing is sent to the priority port during this test */
+    {
+        static uint8_t rx_buf[INTERTILE_RX_BUF_SIZE];
+        uint8_t *pool_msg = NULL;
+
+        if (rtos_intertile_rx_buf(ctx->intertile_ctx, INTERTILE_TEST_PRIORITY_PORT, rx_buf, sizeof(rx_buf), RTOS_OSAL_WAIT_MS(1)) != RTOS_INTERTILE_RX_TIMEOUT ||
+            rtos_intertile_rx_pool(ctx->intertile_ctx, INTERTILE_TEST_PRIORITY_PORT, &pool, (void**)&pool_msg, RTOS_OSAL_WAIT_MS(1)) != RTOS_INTERTILE_RX_TIMEOUT ||
+            pool_msg != NULL)
+        {
+            local_printf("RX failed.  Timeout not reported");
+            rtos_intertile_pool_deinit(&pool);
+            return -1;
+        }
+    }
+    #endif
+
+    for (int i=0; i<INTERTILE_TEST_ITERS; i++)
+    {
+        size_t test_len = intertile_tests[i].len;
+        uint8_t *test_buf = intertile_tests[i].data;
+
+        local_printf("Test iteration %d", i);
+
+        #if ON_TILE(INTERTILE_TX_TILE)
+        {
+            local_printf("TX %u", test_len);
+            rtos_intertile_tx(ctx->intertile_ctx,
+                              INTERTILE_RPC_PORT,
+                              test_buf,
+                              test_len);
+            rtos_intertile_tx(ctx->intertile_ctx,
+                              INTERTILE_RPC_PORT,
+                              test_buf,
+                              test_len);
+            local_printf("TX done");
+        }
+        #endif
+
+        #if ON_TILE(INTERTILE_RX_TILE)
+        {
+            static uint8_t rx_buf[INTERTILE_RX_BUF_SIZE];
+            uint8_t *pool_msg = NULL;
+            int32_t bytes_rx;
+
+            bytes_rx = rtos_intertile_rx_buf(ctx->intertile_ctx,
+                                             INTERTILE_RPC_PORT,
+                                             rx_buf,
+                                             sizeof(rx_buf),
+                                             RTOS_OSAL_WAIT_MS(10));
+            if (check_rx(rx_buf, bytes_rx, sizeof(rx_buf), test_buf, test_len) != 0)
+            {
+                rtos_intertile_pool_deinit(&pool);
+                return -1;
+            }
+
+            bytes_rx = rtos_intertile_rx_pool(ctx->intertile_ctx,
+                                              INTERTILE_RPC_PORT,
+                                              &pool,
+                                              (void**)&pool_msg,
+                                              RTOS_OSAL_WAIT_MS(10));
+            if (pool_msg == NULL)
+            {
+                local_printf("RX returned NULL pool buffer");
+                rtos_intertile_pool_deinit(&pool);
+                return -1;
+            }
+
+            if (check_rx(pool_msg, bytes_rx, INTERTILE_RX_BUF_SIZE, test_buf, test_len) != 0)
+            {
+                rtos_intertile_pool_free(&pool, pool_msg);
+                rtos_intertile_pool_deinit(&pool);
+                return -1;
+            }
+            rtos_intertile_pool_free(&pool, pool_msg);
+        }
+        #endif
+    }
+
+    #if ON_TILE(INTERTILE_RX_TILE)
+    rtos_intertile_pool_deinit(&pool);
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_rx_buf_test(intertile_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -0,0 +1,125 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/intertile/api/rtos_intertile.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/intertile/intertile_test.h"
+
+static const char* test_name = "stream_test";
+
+#define local_printf( FMT, ... )    intertile_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define INTERTILE_TX_TILE 0
+#define INTERTILE_RX_TILE 1
+
+/* Longer than RTOS_INTERTILE_STREAM_ISR_WORDS, so each frame takes several interrupts */
+#define STREAM_FRAME_WORDS    (2 * RTOS_INTERTILE_STREAM_ISR_WORDS + 5)
+#define STREAM_RING_FRAMES    4
+#define STREAM_TEST_FRAMES    16
+
+static uint32_t frame_word(int frame, int word)
+{
+    return (frame << 16) | word;
+}
+
+INTERTILE_MAIN_TEST_ATTR
+static int main_test(intertile_test_ctx_t *ctx)
+{
+    static rtos_intertile_stream_t stream;
+
+    local_printf("Start");
+
+    #if ON_TILE(INTERTILE_TX_TILE)
+    {
+        uint32_t frame[STREAM_FRAME_WORDS];
+
+        rtos_intertile_stream_tx_init(&stream, ctx->c, sizeof(frame));
+        rtos_intertile_stream_start(&stream);
+
+        for (int i=0; i<STREAM_TEST_FRAMES; i++)
+        {
+            for (int j=0; j<STREAM_FRAME_WORDS; j++)
+            {
+                frame[j] = frame_word(i, j);
+            }
+
+            if (rtos_intertile_stream_tx(&stream, frame, RTOS_OSAL_WAIT_MS(100)) != sizeof(frame))
+            {
+                local_printf("TX failed on frame %d", i);
+                rtos_intertile_stream_deinit(&stream);
+                return -1;
+            }
+        }
+        local_printf("TX done");
+
+        rtos_intertile_stream_deinit(&stream);
+    }
+    #endif
+
+    #if ON_TILE(INTERTILE_RX_TILE)
+    {
+        static uint32_t ring[STREAM_RING_FRAMES * STREAM_FRAME_WORDS];
+
+        rtos_intertile_stream_rx_init(&stream, ctx->c, ring, STREAM_FRAME_WORDS * sizeof(uint32_t), STREAM_RING_FRAMES);
+        rtos_intertile_stream_start(&stream);
+
+        /* Let the transmitter fill the ring and run out of credits */
+        rtos_osal_delay(RTOS_OSAL_WAIT_MS(1));
+
+        for (int i=0; i<STREAM_TEST_FRAMES; i++)
+        {
+            uint32_t *frame;
+            size_t bytes_rx;
+
+            bytes_rx = rtos_intertile_stream_rx(&stream, (void**)&frame, RTOS_OSAL_WAIT_MS(100));
+            if (bytes_rx != STREAM_FRAME_WORDS * sizeof(uint32_t))
+            {
+                local_printf("RX failed on frame %d.  Got %u", i, bytes_rx);
+                rtos_intertile_stream_deinit(&stream);
+                return -1;
+            }
+
+            for (int j=0; j<STREAM_FRAME_WORDS; j++)
+            {
+                if (frame[j] != frame_word(i, j))
+                {
+                    local_printf("RX failed on frame %d at index %d.  Got 0x%x expected 0x%x", i, j, frame[j], frame_word(i, j));
+                    rtos_intertile_stream_rx_release(&stream);
+                    rtos_intertile_stream_deinit(&stream);
+                    return -1;
+                }
+            }
+
+            rtos_intertile_stream_rx_release(&stream);
+        }
+        local_printf("RX passed.  Got %d frames", STREAM_TEST_FRAMES);
+
+        rtos_intertile_stream_deinit(&stream);
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_stream_test(intertile_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -0,0 +1,235 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+
+/* Library headers */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/qspi_flash/qspi_flash_test.h"
+
+static const char* test_name = "async_test";
+
+#define local_printf( FMT, ... )    qspi_flash_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define QSPI_FLASH_TILE         0
+#define QSPI_FLASH_TEST_ADDR    0x50000
+
+/* The test data is read back this many bytes at a time from the callback */
+#define ASYNC_TEST_CHUNK_LEN    256
+#define ASYNC_TEST_CHUNKS       8
+#define ASYNC_TEST_LEN          (ASYNC_TEST_CHUNK_LEN * ASYNC_TEST_CHUNKS)
+
+#if ON_TILE(QSPI_FLASH_TILE)
+typedef struct {
+    uint8_t *buf;
+    int chunks_read;
+    rtos_osal_semaphore_t done;
+} chained_read_t;
+
+RTOS_QSPI_FLASH_OP_CALLBACK_ATTR
+static void chained_read_cb(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op,
+        void *arg)
+{
+    chained_read_t *read = arg;
+
+    read->chunks_read++;
+
+    if (read->chunks_read < ASYNC_TEST_CHUNKS) {
+        /* Reuse the op that just completed for the next chunk */
+        rtos_qspi_flash_read_async(ctx, op,
+                                   read->buf + read->chunks_read * ASYNC_TEST_CHUNK_LEN,
+                                   QSPI_FLASH_TEST_ADDR + read->chunks_read * ASYNC_TEST_CHUNK_LEN,
+                                   ASYNC_TEST_CHUNK_LEN,
+                                   chained_read_cb, read);
+    } else {
+        rtos_osal_semaphore_put(&read->done);
+    }
+}
+
+typedef struct {
+    rtos_qspi_flash_t *ctx;
+    volatile int stop;
+    rtos_osal_semaphore_t stopped;
+} competitor_t;
+
+/*
+ * Keeps the queue full, so that it takes each slot as soon as it is freed
+ * unless the slot is kept for the callback that is running.
+ */
+static void competing_thread(competitor_t *competitor)
+{
+    static uint8_t buf[RTOS_QSPI_FLASH_OP_QUEUE_LEN][ASYNC_TEST_CHUNK_LEN];
+    static rtos_qspi_flash_op_t op[RTOS_QSPI_FLASH_OP_QUEUE_LEN];
+
+    while (!competitor->stop)
+    {
+        for (int i=0; i<RTOS_QSPI_FLASH_OP_QUEUE_LEN; i++)
+        {
+            rtos_qspi_flash_read_async(competitor->ctx, &op[i], buf[i], QSPI_FLASH_TEST_ADDR, ASYNC_TEST_CHUNK_LEN, NULL, NULL);
+        }
+        for (int i=0; i<RTOS_QSPI_FLASH_OP_QUEUE_LEN; i++)
+        {
+            rtos_qspi_flash_op_wait(competitor->ctx, &op[i], RTOS_OSAL_WAIT_FOREVER);
+        }
+    }
+
+    rtos_osal_semaphore_put(&competitor->stopped);
+    vTaskDelete(NULL);
+}
+
+static int verify(const char *step, uint8_t *buf, size_t len)
+{
+    for (int i=0; i<len; i++)
+    {
+        if (buf[i] != (uint8_t)(0xFF & i))
+        {
+            local_printf("Failed after %s. buf[%d]: Expected 0x%x got 0x%x", step, i, (uint8_t)(0xFF & i), buf[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int async_ops(rtos_qspi_flash_t *ctx)
+{
+    static uint8_t test_buf[ASYNC_TEST_LEN];
+    static chained_read_t read;
+    static competitor_t competitor;
+    rtos_qspi_flash_op_t op;
+    rtos_osal_status_t status;
+
+    local_printf("Erase and write");
+    rtos_qspi_flash_erase_async(ctx, &op, QSPI_FLASH_TEST_ADDR, ASYNC_TEST_LEN, NULL, NULL);
+    rtos_qspi_flash_op_wait(ctx, &op, RTOS_OSAL_WAIT_FOREVER);
+
+    for (int i=0; i<ASYNC_TEST_LEN; i++)
+    {
+        test_buf[i] = (uint8_t)(0xFF & i);
+    }
+    rtos_qspi_flash_write_async(ctx, &op, test_buf, QSPI_FLASH_TEST_ADDR, ASYNC_TEST_LEN, NULL, NULL);
+    rtos_qspi_flash_op_wait(ctx, &op, RTOS_OSAL_WAIT_FOREVER);
+
+    local_printf("Read");
+    memset(test_buf, 0, sizeof(test_buf));
+    rtos_qspi_flash_read_async(ctx, &op, test_buf, QSPI_FLASH_TEST_ADDR, ASYNC_TEST_LEN, NULL, NULL);
+    rtos_qspi_flash_op_wait(ctx, &op, RTOS_OSAL_WAIT_FOREVER);
+    if (verify("read", test_buf, ASYNC_TEST_LEN) == -1)
+    {
+        return -1;
+    }
+
+    /*
+     * The reads resubmitted from the callback must not wait for the lock
+     * that this thread holds while it waits for them.
+     */
+    local_printf("Chained read with the lock held");
+    memset(test_buf, 0, sizeof(test_buf));
+    read.buf = test_buf;
+    read.chunks_read = 0;
+    rtos_osal_semaphore_create(&read.done, "async_test_done", 1, 0);
+
+    rtos_qspi_flash_lock(ctx);
+    rtos_qspi_flash_read_async(ctx, &op, test_buf, QSPI_FLASH_TEST_ADDR, ASYNC_TEST_CHUNK_LEN, chained_read_cb, &read);
+    status = rtos_osal_semaphore_get(&read.done, RTOS_OSAL_WAIT_MS(1000));
+    rtos_qspi_flash_unlock(ctx);
+    rtos_osal_semaphore_delete(&read.done);
+
+    if (status != RTOS_OSAL_SUCCESS)
+    {
+        local_printf("Failed. Only %d of %d chained reads completed", read.chunks_read, ASYNC_TEST_CHUNKS);
+        return -1;
+    }
+
+    if (verify("chained read", test_buf, ASYNC_TEST_LEN) == -1)
+    {
+        return -1;
+    }
+
+    /*
+     * The reads resubmitted from the callback must not wait for a queue
+     * slot that another thread takes first.
+     */
+    local_printf("Chained read with the queue full");
+    memset(test_buf, 0, sizeof(test_buf));
+    read.chunks_read = 0;
+    rtos_osal_semaphore_create(&read.done, "async_test_done", 1, 0);
+    competitor.ctx = ctx;
+    competitor.stop = 0;
+    rtos_osal_semaphore_create(&competitor.stopped, "async_test_stopped", 1, 0);
+
+    xTaskCreate((TaskFunction_t)competing_thread,
+                "competing_thread",
+                RTOS_THREAD_STACK_SIZE(competing_thread),
+                &competitor,
+                configMAX_PRIORITIES-1,
+                NULL);
+
+    rtos_qspi_flash_read_async(ctx, &op, test_buf, QSPI_FLASH_TEST_ADDR, ASYNC_TEST_CHUNK_LEN, chained_read_cb, &read);
+    status = rtos_osal_semaphore_get(&read.done, RTOS_OSAL_WAIT_MS(1000));
+
+    competitor.stop = 1;
+    if (rtos_osal_semaphore_get(&competitor.stopped, RTOS_OSAL_WAIT_MS(1000)) != RTOS_OSAL_SUCCESS)
+    {
+        local_printf("Failed. The competing thread did not stop");
+        return -1;
+    }
+    rtos_osal_semaphore_delete(&competitor.stopped);
+    rtos_osal_semaphore_delete(&read.done);
+
+    if (status != RTOS_OSAL_SUCCESS)
+    {
+        local_printf("Failed. Only %d of %d chained reads completed", read.chunks_read, ASYNC_TEST_CHUNKS);
+        return -1;
+    }
+
+    if (verify("chained read with the queue full", test_buf, ASYNC_TEST_LEN) == -1)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+#endif
+
+QSPI_FLASH_MAIN_TEST_ATTR
+static int main_test(qspi_flash_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(QSPI_FLASH_TILE)
+    {
+        if (async_ops(ctx->qspi_flash_ctx) == -1)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_async_test(qspi_flash_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -0,0 +1,126 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/qspi_flash/qspi_flash_test.h"
+
+static const char* test_name = "cache_test";
+
+#define local_printf( FMT, ... )    qspi_flash_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define QSPI_FLASH_TILE         0
+#define QSPI_FLASH_TEST_ADDR    0x40000
+
+/* Small enough to be served from the read cache */
+#define CACHE_TEST_READ_LEN     64
+
+#if ON_TILE(QSPI_FLASH_TILE)
+static int verify(const char *step, uint8_t *buf, size_t len, int seed)
+{
+    for (int i=0; i<len; i++)
+    {
+        uint8_t expected = seed < 0 ? 0xFF : (uint8_t)(seed + i);
+
+        if (buf[i] != expected)
+        {
+            local_printf("Failed after %s. buf[%d]: Expected 0x%x got 0x%x", step, i, expected, buf[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int cache_coherence(rtos_qspi_flash_t *ctx, unsigned addr)
+{
+    uint8_t buf[CACHE_TEST_READ_LEN];
+
+    /* Fill the cache with the erased sector */
+    rtos_qspi_flash_erase(ctx, addr, CACHE_TEST_READ_LEN);
+    rtos_qspi_flash_read(ctx, buf, addr, sizeof(buf));
+    if (verify("erase", buf, sizeof(buf), -1) == -1)
+    {
+        return -1;
+    }
+
+    /* The cached copy must not be returned once the flash has been written */
+    for (int i=0; i<sizeof(buf); i++)
+    {
+        buf[i] = (uint8_t)(0x5A + i);
+    }
+    rtos_qspi_flash_write(ctx, buf, addr, sizeof(buf));
+    memset(buf, 0, sizeof(buf));
+    rtos_qspi_flash_read(ctx, buf, addr, sizeof(buf));
+    if (verify("write", buf, sizeof(buf), 0x5A) == -1)
+    {
+        return -1;
+    }
+
+    /* A second read is a hit and must return the same data */
+    memset(buf, 0, sizeof(buf));
+    rtos_qspi_flash_read(ctx, buf, addr, sizeof(buf));
+    if (verify("cached read", buf, sizeof(buf), 0x5A) == -1)
+    {
+        return -1;
+    }
+
+    /* Nor once it has been erased again */
+    rtos_qspi_flash_erase(ctx, addr, sizeof(buf));
+    rtos_qspi_flash_read(ctx, buf, addr, sizeof(buf));
+    if (verify("second erase", buf, sizeof(buf), -1) == -1)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+#endif
+
+QSPI_FLASH_MAIN_TEST_ATTR
+static int main_test(qspi_flash_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(QSPI_FLASH_TILE)
+    {
+        size_t sector_size = rtos_qspi_flash_sector_size_get(ctx->qspi_flash_ctx);
+
+        /* At the start of a sector, and straddling the boundary between two */
+        if (cache_coherence(ctx->qspi_flash_ctx, QSPI_FLASH_TEST_ADDR) == -1)
+        {
+            return -1;
+        }
+
+        if (cache_coherence(ctx->qspi_flash_ctx, QSPI_FLASH_TEST_ADDR + sector_size - CACHE_TEST_READ_LEN / 2) == -1)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_cache_test(qspi_flash_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -0,0 +1,182 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+#if USE_FATFS
+#include "ff.h"
+#endif
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/qspi_flash/qspi_flash_test.h"
+
+static const char* test_name = "fatfs_dir_test";
+
+#define local_printf( FMT, ... )    qspi_flash_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define QSPI_FLASH_TILE         0
+
+#define FATFS_DIR_TEST_PATH     "/walk"
+
+/*
+ * Enough entries that the directory spans more than one sector, so that the
+ * walk reads the directory and FAT sectors through the disk cache many times.
+ */
+#define FATFS_DIR_TEST_FILES    160
+#define FATFS_DIR_TEST_PASSES   2
+
+#if ON_TILE(QSPI_FLASH_TILE) && USE_FATFS
+static int file_number(const char *name)
+{
+    int n;
+    char ext[4];
+
+    if (sscanf(name, "F%3d.%3s", &n, ext) != 2 || strcmp(ext, "TXT") != 0)
+    {
+        return -1;
+    }
+
+    return n;
+}
+
+static int fatfs_dir_walk(void)
+{
+    static uint8_t found[FATFS_DIR_TEST_FILES];
+    static DIR dir;
+    static FIL fil;
+    static FILINFO fno;
+    char path[32];
+    void *work;
+    FRESULT res;
+
+    /* Start from an empty volume so that the walk finds only the files made here */
+    local_printf("Format");
+    work = rtos_osal_malloc(FF_MAX_SS);
+    if (work == NULL)
+    {
+        local_printf("Malloc Failed");
+        return -1;
+    }
+    res = f_mkfs("", NULL, work, FF_MAX_SS);
+    rtos_osal_free(work);
+    if (res != FR_OK)
+    {
+        local_printf("Failed. f_mkfs returned %d", res);
+        return -1;
+    }
+
+    local_printf("Create %d files", FATFS_DIR_TEST_FILES);
+    res = f_mkdir(FATFS_DIR_TEST_PATH);
+    if (res != FR_OK)
+    {
+        local_printf("Failed. f_mkdir returned %d", res);
+        return -1;
+    }
+    for (int i=0; i<FATFS_DIR_TEST_FILES; i++)
+    {
+        snprintf(path, sizeof(path), FATFS_DIR_TEST_PATH "/F%03d.TXT", i);
+        res = f_open(&fil, path, FA_CREATE_NEW | FA_WRITE);
+        if (res == FR_OK)
+        {
+            res = f_close(&fil);
+        }
+        if (res != FR_OK)
+        {
+            local_printf("Failed. Creating %s returned %d", path, res);
+            return -1;
+        }
+    }
+
+    for (int pass=0; pass<FATFS_DIR_TEST_PASSES; pass++)
+    {
+        int count = 0;
+
+        local_printf("Walk pass %d", pass);
+        memset(found, 0, sizeof(found));
+
+        res = f_opendir(&dir, FATFS_DIR_TEST_PATH);
+        if (res != FR_OK)
+        {
+            local_printf("Failed. f_opendir returned %d", res);
+            return -1;
+        }
+
+        for (;;)
+        {
+            int n;
+
+            res = f_readdir(&dir, &fno);
+            if (res != FR_OK || fno.fname[0] == '\0')
+            {
+                break;
+            }
+
+            n = file_number(fno.fname);
+            if (n < 0 || n >= FATFS_DIR_TEST_FILES || found[n])
+            {
+                local_printf("Failed. Unexpected entry %s", fno.fname);
+                f_closedir(&dir);
+                return -1;
+            }
+            found[n] = 1;
+            count++;
+        }
+        f_closedir(&dir);
+
+        if (res != FR_OK)
+        {
+            local_printf("Failed. f_readdir returned %d", res);
+            return -1;
+        }
+        if (count != FATFS_DIR_TEST_FILES)
+        {
+            local_printf("Failed. Found %d of %d files", count, FATFS_DIR_TEST_FILES);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+QSPI_FLASH_MAIN_TEST_ATTR
+static int main_test(qspi_flash_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(QSPI_FLASH_TILE) && USE_FATFS
+    {
+        qspi_flash_test_fatfs_mount(ctx);
+
+        if (fatfs_dir_walk() == -1)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_fatfs_dir_test(qspi_flash_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
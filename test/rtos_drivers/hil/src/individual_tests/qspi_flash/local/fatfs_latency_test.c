@@ -0,0 +1,245 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+#include <xcore/hwtimer.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+#if USE_FATFS
+#include "ff.h"
+#endif
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/qspi_flash/qspi_flash_test.h"
+
+#ifndef LIBXCORE_HWTIMER_HAS_REFERENCE_TIME
+#error This test requires reference time
+#endif
+
+static const char* test_name = "fatfs_latency_test";
+
+#define local_printf( FMT, ... )    qspi_flash_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define QSPI_FLASH_TILE         0
+
+#define FATFS_LATENCY_TEST_LARGE    "/large.bin"
+#define FATFS_LATENCY_TEST_SMALL    "/small.bin"
+
+/* The large write is made of this many sectors, many times FF_FS_YIELD_SECTORS */
+#define FATFS_LATENCY_TEST_SECTORS  32
+#define FATFS_LATENCY_TEST_SMALL_LEN 512
+
+/*
+ * While the large write runs, a small read must wait for at most a few
+ * sectors of it rather than the whole thing. This leaves plenty of margin
+ * over the FF_FS_YIELD_SECTORS sectors it should wait for.
+ */
+#define FATFS_LATENCY_TEST_MAX_FRACTION 4
+
+#if ON_TILE(QSPI_FLASH_TILE) && USE_FATFS && FF_FS_REENTRANT && FF_FS_YIELD_SECTORS > 0
+typedef struct {
+    volatile int done;
+    FRESULT res;
+    uint32_t duration;
+    rtos_osal_semaphore_t stopped;
+} writer_t;
+
+static void writer_thread(writer_t *writer)
+{
+    static FIL fil;
+    uint8_t *buf;
+    UINT bw = 0;
+    uint32_t start;
+
+    buf = rtos_osal_malloc(FATFS_LATENCY_TEST_SECTORS * FF_MAX_SS);
+    if (buf == NULL)
+    {
+        writer->res = FR_NOT_ENOUGH_CORE;
+    }
+    else
+    {
+        memset(buf, 0xA5, FATFS_LATENCY_TEST_SECTORS * FF_MAX_SS);
+
+        writer->res = f_open(&fil, FATFS_LATENCY_TEST_LARGE, FA_CREATE_ALWAYS | FA_WRITE);
+        if (writer->res == FR_OK)
+        {
+            start = get_reference_time();
+            writer->res = f_write(&fil, buf, FATFS_LATENCY_TEST_SECTORS * FF_MAX_SS, &bw);
+            writer->duration = get_reference_time() - start;
+            f_close(&fil);
+        }
+        if (writer->res == FR_OK && bw != FATFS_LATENCY_TEST_SECTORS * FF_MAX_SS)
+        {
+            writer->res = FR_DENIED;
+        }
+        rtos_osal_free(buf);
+    }
+
+    writer->done = 1;
+    rtos_osal_semaphore_put(&writer->stopped);
+    vTaskDelete(NULL);
+}
+
+static int small_read(uint8_t *buf)
+{
+    static FIL fil;
+    UINT br = 0;
+    FRESULT res;
+
+    res = f_open(&fil, FATFS_LATENCY_TEST_SMALL, FA_READ);
+    if (res == FR_OK)
+    {
+        res = f_read(&fil, buf, FATFS_LATENCY_TEST_SMALL_LEN, &br);
+        f_close(&fil);
+    }
+
+    if (res != FR_OK || br != FATFS_LATENCY_TEST_SMALL_LEN)
+    {
+        local_printf("Failed. Small read returned %d with %u bytes", res, br);
+        return -1;
+    }
+
+    for (int i=0; i<FATFS_LATENCY_TEST_SMALL_LEN; i++)
+    {
+        if (buf[i] != (uint8_t)(0xFF & i))
+        {
+            local_printf("Failed. buf[%d]: Expected 0x%x got 0x%x", i, (uint8_t)(0xFF & i), buf[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int fatfs_latency(void)
+{
+    static uint8_t buf[FATFS_LATENCY_TEST_SMALL_LEN];
+    static writer_t writer;
+    static FIL fil;
+    uint32_t max_latency = 0;
+    int reads = 0;
+    UINT bw = 0;
+    FRESULT res;
+
+    local_printf("Write small file");
+    for (int i=0; i<FATFS_LATENCY_TEST_SMALL_LEN; i++)
+    {
+        buf[i] = (uint8_t)(0xFF & i);
+    }
+    res = f_open(&fil, FATFS_LATENCY_TEST_SMALL, FA_CREATE_ALWAYS | FA_WRITE);
+    if (res == FR_OK)
+    {
+        res = f_write(&fil, buf, FATFS_LATENCY_TEST_SMALL_LEN, &bw);
+        f_close(&fil);
+    }
+    if (res != FR_OK || bw != FATFS_LATENCY_TEST_SMALL_LEN)
+    {
+        local_printf("Failed. Small write returned %d with %u bytes", res, bw);
+        return -1;
+    }
+
+    /* The writer runs at this thread's priority, so only the yield lets the reads in */
+    local_printf("Read small file during large write");
+    writer.done = 0;
+    writer.res = FR_OK;
+    rtos_osal_semaphore_create(&writer.stopped, "fatfs_latency_test_stopped", 1, 0);
+
+    xTaskCreate((TaskFunction_t)writer_thread,
+                "writer_thread",
+                RTOS_THREAD_STACK_SIZE(writer_thread),
+                &writer,
+                uxTaskPriorityGet(NULL),
+                NULL);
+
+    while (!writer.done)
+    {
+        uint32_t start = get_reference_time();
+        uint32_t latency;
+
+        if (small_read(buf) == -1)
+        {
+            rtos_osal_semaphore_get(&writer.stopped, RTOS_OSAL_WAIT_FOREVER);
+            rtos_osal_semaphore_delete(&writer.stopped);
+            return -1;
+        }
+
+        latency = get_reference_time() - start;
+        if (!writer.done)
+        {
+            reads++;
+            if (latency > max_latency) max_latency = latency;
+        }
+        vTaskDelay(1);
+    }
+
+    rtos_osal_semaphore_get(&writer.stopped, RTOS_OSAL_WAIT_FOREVER);
+    rtos_osal_semaphore_delete(&writer.stopped);
+
+    local_printf("Large write took %u, %d small reads took up to %u", writer.duration, reads, max_latency);
+
+    if (writer.res != FR_OK)
+    {
+        local_printf("Failed. Large write returned %d", writer.res);
+        return -1;
+    }
+    if (reads == 0)
+    {
+        local_printf("Failed. No small reads completed during the large write");
+        return -1;
+    }
+    if (max_latency > writer.duration / FATFS_LATENCY_TEST_MAX_FRACTION)
+    {
+        local_printf("Failed. A small read waited for %u of the large write's %u", max_latency, writer.duration);
+        return -1;
+    }
+
+    f_unlink(FATFS_LATENCY_TEST_LARGE);
+    f_unlink(FATFS_LATENCY_TEST_SMALL);
+
+    return 0;
+}
+#endif
+
+QSPI_FLASH_MAIN_TEST_ATTR
+static int main_test(qspi_flash_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(QSPI_FLASH_TILE) && USE_FATFS && FF_FS_REENTRANT && FF_FS_YIELD_SECTORS > 0
+    {
+        qspi_flash_test_fatfs_mount(ctx);
+
+        if (fatfs_latency() == -1)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_fatfs_latency_test(qspi_flash_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -0,0 +1,164 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+#if USE_FATFS_FTL
+#include "diskio_ftl.h"
+#endif
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/qspi_flash/qspi_flash_test.h"
+
+static const char* test_name = "ftl_remount_test";
+
+#define local_printf( FMT, ... )    qspi_flash_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define QSPI_FLASH_TILE         0
+
+/* The translation layer is put over this many blocks at the end of the flash */
+#define FTL_TEST_BLOCKS         8
+#define FTL_TEST_BLOCK_SIZE     (DISKIO_FTL_BLOCK_SECTORS * DISKIO_FTL_SECTOR_SIZE)
+
+/* Each sector is written this many times, enough to need garbage collection */
+#define FTL_TEST_PASSES         3
+
+#if ON_TILE(QSPI_FLASH_TILE) && USE_FATFS_FTL
+static uint8_t sector_byte(unsigned sector, int pass, int i)
+{
+    return (uint8_t)(sector * 7 + pass + i);
+}
+
+static uint32_t erase_count_total(diskio_ftl_t *ftl)
+{
+    uint32_t total = 0;
+
+    for (unsigned i = 0; i < ftl->block_count; i++)
+    {
+        total += ftl->block[i].erase_count;
+    }
+
+    return total;
+}
+
+static int ftl_remount(rtos_qspi_flash_t *ctx)
+{
+    static diskio_ftl_t ftl;
+    unsigned start_address = rtos_qspi_flash_size_get(ctx) - FTL_TEST_BLOCKS * FTL_TEST_BLOCK_SIZE;
+    unsigned sector_count;
+    uint32_t erase_total;
+    uint8_t *test_buf;
+
+    test_buf = (uint8_t*)rtos_osal_malloc(DISKIO_FTL_SECTOR_SIZE);
+
+    if (test_buf == NULL)
+    {
+        local_printf("Malloc Failed");
+        return -1;
+    }
+
+    local_printf("Erase");
+    rtos_qspi_flash_erase(ctx, start_address, FTL_TEST_BLOCKS * FTL_TEST_BLOCK_SIZE);
+
+    local_printf("Mount");
+    diskio_ftl_init(&ftl, ctx, start_address);
+    sector_count = diskio_ftl_sector_count(&ftl);
+
+    local_printf("Write %u sectors %d times", sector_count, FTL_TEST_PASSES);
+    for (int pass=0; pass<FTL_TEST_PASSES; pass++)
+    {
+        for (unsigned sector=0; sector<sector_count; sector++)
+        {
+            for (int i=0; i<DISKIO_FTL_SECTOR_SIZE; i++)
+            {
+                test_buf[i] = sector_byte(sector, pass, i);
+            }
+            if (diskio_ftl_write(&ftl, test_buf, sector, 1) != 0)
+            {
+                local_printf("Failed. Write of sector %u failed", sector);
+                diskio_ftl_deinit(&ftl);
+                rtos_osal_free(test_buf);
+                return -1;
+            }
+        }
+    }
+
+    rtos_osal_mutex_get(&ftl.lock, RTOS_OSAL_WAIT_FOREVER);
+    erase_total = erase_count_total(&ftl);
+    rtos_osal_mutex_put(&ftl.lock);
+
+    local_printf("Remount");
+    diskio_ftl_deinit(&ftl);
+    diskio_ftl_init(&ftl, ctx, start_address);
+
+    /* Every erase must have been recorded, including those of the free blocks */
+    if (erase_count_total(&ftl) < erase_total)
+    {
+        local_printf("Failed. Erase count total was %u, now %u", erase_total, erase_count_total(&ftl));
+        diskio_ftl_deinit(&ftl);
+        rtos_osal_free(test_buf);
+        return -1;
+    }
+
+    local_printf("Verify");
+    for (unsigned sector=0; sector<sector_count; sector++)
+    {
+        memset(test_buf, 0, DISKIO_FTL_SECTOR_SIZE);
+        diskio_ftl_read(&ftl, test_buf, sector, 1);
+
+        for (int i=0; i<DISKIO_FTL_SECTOR_SIZE; i++)
+        {
+            if (test_buf[i] != sector_byte(sector, FTL_TEST_PASSES - 1, i))
+            {
+                local_printf("Failed. Sector %u [%d]: Expected 0x%x got 0x%x", sector, i, sector_byte(sector, FTL_TEST_PASSES - 1, i), test_buf[i]);
+                diskio_ftl_deinit(&ftl);
+                rtos_osal_free(test_buf);
+                return -1;
+            }
+        }
+    }
+
+    diskio_ftl_deinit(&ftl);
+    rtos_osal_free(test_buf);
+    return 0;
+}
+#endif
+
+QSPI_FLASH_MAIN_TEST_ATTR
+static int main_test(qspi_flash_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(QSPI_FLASH_TILE) && USE_FATFS_FTL
+    {
+        if (ftl_remount(ctx->qspi_flash_ctx) == -1)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_ftl_remount_test(qspi_flash_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -0,0 +1,168 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+#include <xcore/interrupt.h>
+#include <xcore/swmem_fill.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+#if USE_SWMEM
+#include "xcore_device_memory.h"
+#endif
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/qspi_flash/qspi_flash_test.h"
+
+static const char* test_name = "isr_read_test";
+
+#define local_printf( FMT, ... )    qspi_flash_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define QSPI_FLASH_TILE         0
+#define QSPI_FLASH_TEST_ADDR    0xA0000
+#define ISR_READ_TEST_LEN       256
+
+/* Erased while reads from interrupts are attempted */
+#define ISR_READ_TEST_ERASE_ADDR 0xA8000
+#define ISR_READ_TEST_ERASE_LEN  0x8000
+
+#if ON_TILE(QSPI_FLASH_TILE) && RTOS_QSPI_FLASH_ISR_READ
+static bool read_isr(rtos_qspi_flash_t *ctx, uint8_t *buf, unsigned address, size_t len)
+{
+    bool done;
+
+    interrupt_mask_all();
+    done = rtos_qspi_flash_read_isr(ctx, buf, address, len);
+    interrupt_unmask_all();
+
+    return done;
+}
+
+static int verify(const char *step, uint8_t *buf, size_t len)
+{
+    for (int i=0; i<len; i++)
+    {
+        if (buf[i] != (uint8_t)(0xA5 ^ i))
+        {
+            local_printf("Failed after %s. buf[%d]: Expected 0x%x got 0x%x", step, i, (uint8_t)(0xA5 ^ i), buf[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int isr_read(rtos_qspi_flash_t *ctx)
+{
+    static uint8_t test_buf[ISR_READ_TEST_LEN];
+    rtos_qspi_flash_op_t op;
+
+    for (int i=0; i<ISR_READ_TEST_LEN; i++)
+    {
+        test_buf[i] = (uint8_t)(0xA5 ^ i);
+    }
+
+    /* The data in the erase range ensures that the erase is not skipped */
+    rtos_qspi_flash_erase_async(ctx, &op, QSPI_FLASH_TEST_ADDR, 0x10000, NULL, NULL);
+    rtos_qspi_flash_op_wait(ctx, &op, RTOS_OSAL_WAIT_FOREVER);
+    rtos_qspi_flash_write_async(ctx, &op, test_buf, QSPI_FLASH_TEST_ADDR, ISR_READ_TEST_LEN, NULL, NULL);
+    rtos_qspi_flash_op_wait(ctx, &op, RTOS_OSAL_WAIT_FOREVER);
+    rtos_qspi_flash_write_async(ctx, &op, test_buf, ISR_READ_TEST_ERASE_ADDR, ISR_READ_TEST_LEN, NULL, NULL);
+    rtos_qspi_flash_op_wait(ctx, &op, RTOS_OSAL_WAIT_FOREVER);
+
+    local_printf("Read with interrupts masked");
+    memset(test_buf, 0, sizeof(test_buf));
+    if (!read_isr(ctx, test_buf, QSPI_FLASH_TEST_ADDR, ISR_READ_TEST_LEN))
+    {
+        local_printf("Failed. Read refused while the driver was idle");
+        return -1;
+    }
+    if (verify("read", test_buf, ISR_READ_TEST_LEN) == -1)
+    {
+        return -1;
+    }
+
+    if (read_isr(ctx, test_buf, rtos_qspi_flash_size_get(ctx) - 1, 2))
+    {
+        local_printf("Failed. Read past the end of the flash was not refused");
+        return -1;
+    }
+
+    /* Reads must be refused while the flash is erasing */
+    local_printf("Read during erase");
+    rtos_qspi_flash_erase_async(ctx, &op, ISR_READ_TEST_ERASE_ADDR, ISR_READ_TEST_ERASE_LEN, NULL, NULL);
+    rtos_osal_delay(RTOS_OSAL_WAIT_MS(1));
+    if (rtos_qspi_flash_op_wait(ctx, &op, RTOS_OSAL_NO_WAIT) != RTOS_OSAL_SUCCESS)
+    {
+        bool done = read_isr(ctx, test_buf, QSPI_FLASH_TEST_ADDR, ISR_READ_TEST_LEN);
+
+        rtos_qspi_flash_op_wait(ctx, &op, RTOS_OSAL_WAIT_FOREVER);
+        if (done)
+        {
+            local_printf("Failed. Read was not refused during the erase");
+            return -1;
+        }
+    }
+    else
+    {
+        local_printf("Erase completed too quickly, refusal not checked");
+    }
+
+#if USE_SWMEM
+    /* A line that was not read ahead is filled straight from the flash */
+    local_printf("SwMem fill from the flash");
+    swmem_flash_init(ctx);
+    memset(test_buf, 0, sizeof(test_buf));
+    interrupt_mask_all();
+    bool filled = swmem_flash_read_request_isr(QSPI_FLASH_TEST_ADDR, (uint32_t *)test_buf);
+    interrupt_unmask_all();
+    if (!filled)
+    {
+        local_printf("Failed. SwMem line was not filled from the flash");
+        return -1;
+    }
+    if (verify("SwMem fill", test_buf, SWMEM_FILL_SIZE_WORDS * sizeof(uint32_t)) == -1)
+    {
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+#endif
+
+QSPI_FLASH_MAIN_TEST_ATTR
+static int main_test(qspi_flash_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(QSPI_FLASH_TILE) && RTOS_QSPI_FLASH_ISR_READ
+    {
+        if (isr_read(ctx->qspi_flash_ctx) == -1)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_isr_read_test(qspi_flash_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -0,0 +1,140 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/qspi_flash/qspi_flash_test.h"
+
+static const char* test_name = "pre_erase_test";
+
+#define local_printf( FMT, ... )    qspi_flash_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define QSPI_FLASH_TILE         0
+#define QSPI_FLASH_TEST_ADDR    0x80000
+
+#define PRE_ERASE_TEST_SECTORS  4
+
+/* The sector that is written again after being trimmed */
+#define PRE_ERASE_TEST_REWRITE  1
+
+/* How long the background thread is given to erase the trimmed sectors */
+#define PRE_ERASE_TEST_WAIT_MS  1000
+
+#if ON_TILE(QSPI_FLASH_TILE) && RTOS_QSPI_FLASH_PRE_ERASE
+static void sector_fill(rtos_qspi_flash_t *ctx, uint8_t *buf, size_t sector_size, int sector)
+{
+    for (int i=0; i<sector_size; i++)
+    {
+        buf[i] = (uint8_t)(sector + i);
+    }
+    rtos_qspi_flash_erase(ctx, QSPI_FLASH_TEST_ADDR + sector * sector_size, sector_size);
+    rtos_qspi_flash_write(ctx, buf, QSPI_FLASH_TEST_ADDR + sector * sector_size, sector_size);
+}
+
+static int sector_check(rtos_qspi_flash_t *ctx, uint8_t *buf, size_t sector_size, int sector, bool erased)
+{
+    rtos_qspi_flash_read(ctx, buf, QSPI_FLASH_TEST_ADDR + sector * sector_size, sector_size);
+
+    for (int i=0; i<sector_size; i++)
+    {
+        uint8_t expected = erased ? 0xFF : (uint8_t)(sector + i);
+
+        if (buf[i] != expected)
+        {
+            local_printf("Failed. Sector %d [%d]: Expected 0x%x got 0x%x", sector, i, expected, buf[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int pre_erase(rtos_qspi_flash_t *ctx)
+{
+    size_t sector_size = rtos_qspi_flash_sector_size_get(ctx);
+    uint8_t *test_buf;
+    int ret = 0;
+
+    test_buf = (uint8_t*)rtos_osal_malloc(sector_size);
+
+    if (test_buf == NULL)
+    {
+        local_printf("Malloc Failed");
+        return -1;
+    }
+
+    local_printf("Trim %d sectors", PRE_ERASE_TEST_SECTORS);
+    for (int sector=0; sector<PRE_ERASE_TEST_SECTORS; sector++)
+    {
+        sector_fill(ctx, test_buf, sector_size, sector);
+    }
+    rtos_qspi_flash_trim(ctx, QSPI_FLASH_TEST_ADDR, PRE_ERASE_TEST_SECTORS * sector_size);
+    rtos_osal_delay(RTOS_OSAL_WAIT_MS(PRE_ERASE_TEST_WAIT_MS));
+
+    for (int sector=0; sector<PRE_ERASE_TEST_SECTORS && ret == 0; sector++)
+    {
+        ret = sector_check(ctx, test_buf, sector_size, sector, true);
+    }
+
+    /* A sector written after it is trimmed must not be erased after the write */
+    if (ret == 0)
+    {
+        local_printf("Write a trimmed sector");
+        for (int sector=0; sector<PRE_ERASE_TEST_SECTORS; sector++)
+        {
+            sector_fill(ctx, test_buf, sector_size, sector);
+        }
+        rtos_qspi_flash_trim(ctx, QSPI_FLASH_TEST_ADDR, PRE_ERASE_TEST_SECTORS * sector_size);
+        sector_fill(ctx, test_buf, sector_size, PRE_ERASE_TEST_REWRITE);
+        rtos_osal_delay(RTOS_OSAL_WAIT_MS(PRE_ERASE_TEST_WAIT_MS));
+
+        for (int sector=0; sector<PRE_ERASE_TEST_SECTORS && ret == 0; sector++)
+        {
+            ret = sector_check(ctx, test_buf, sector_size, sector, sector != PRE_ERASE_TEST_REWRITE);
+        }
+    }
+
+    rtos_osal_free(test_buf);
+    return ret;
+}
+#endif
+
+QSPI_FLASH_MAIN_TEST_ATTR
+static int main_test(qspi_flash_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(QSPI_FLASH_TILE) && RTOS_QSPI_FLASH_PRE_ERASE
+    {
+        if (pre_erase(ctx->qspi_flash_ctx) == -1)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_pre_erase_test(qspi_flash_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -0,0 +1,118 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/qspi_flash/qspi_flash_test.h"
+
+static const char* test_name = "read_chunk_test";
+
+#define local_printf( FMT, ... )    qspi_flash_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define QSPI_FLASH_TILE         0
+#define QSPI_FLASH_TEST_ADDR    0x70000
+
+/*
+ * Starts part way into a page and spans several read commands, ending part
+ * way through the last.
+ */
+#define READ_CHUNK_TEST_OFFSET  3
+#define READ_CHUNK_TEST_LEN     (3 * RTOS_QSPI_FLASH_READ_CHUNK_SIZE + RTOS_QSPI_FLASH_READ_CHUNK_SIZE / 2)
+
+#if ON_TILE(QSPI_FLASH_TILE)
+static int read_chunks(rtos_qspi_flash_t *ctx)
+{
+    unsigned addr = QSPI_FLASH_TEST_ADDR + READ_CHUNK_TEST_OFFSET;
+    uint8_t *test_buf;
+
+    test_buf = (uint8_t*)rtos_osal_malloc(READ_CHUNK_TEST_LEN);
+
+    if (test_buf == NULL)
+    {
+        local_printf("Malloc Failed");
+        return -1;
+    }
+
+    for (int i=0; i<READ_CHUNK_TEST_LEN; i++)
+    {
+        test_buf[i] = (uint8_t)(i + i / RTOS_QSPI_FLASH_READ_CHUNK_SIZE);
+    }
+
+    local_printf("Write %d bytes", READ_CHUNK_TEST_LEN);
+    rtos_qspi_flash_erase(ctx, addr, READ_CHUNK_TEST_LEN);
+    rtos_qspi_flash_write(ctx, test_buf, addr, READ_CHUNK_TEST_LEN);
+
+    local_printf("Read in chunks of %d bytes", RTOS_QSPI_FLASH_READ_CHUNK_SIZE);
+    memset(test_buf, 0, READ_CHUNK_TEST_LEN);
+    rtos_qspi_flash_read(ctx, test_buf, addr, READ_CHUNK_TEST_LEN);
+
+    for (int i=0; i<READ_CHUNK_TEST_LEN; i++)
+    {
+        if (test_buf[i] != (uint8_t)(i + i / RTOS_QSPI_FLASH_READ_CHUNK_SIZE))
+        {
+            local_printf("Failed. buf[%d]: Expected 0x%x got 0x%x", i, (uint8_t)(i + i / RTOS_QSPI_FLASH_READ_CHUNK_SIZE), test_buf[i]);
+            rtos_osal_free(test_buf);
+            return -1;
+        }
+    }
+
+    /* The part of a chunk beyond the end of the flash reads as erased */
+    local_printf("Read past the end of the flash");
+    memset(test_buf, 0, READ_CHUNK_TEST_LEN);
+    rtos_qspi_flash_read(ctx, test_buf, rtos_qspi_flash_size_get(ctx) - RTOS_QSPI_FLASH_READ_CHUNK_SIZE / 2, RTOS_QSPI_FLASH_READ_CHUNK_SIZE * 2);
+
+    for (int i=RTOS_QSPI_FLASH_READ_CHUNK_SIZE / 2; i<RTOS_QSPI_FLASH_READ_CHUNK_SIZE * 2; i++)
+    {
+        if (test_buf[i] != 0xFF)
+        {
+            local_printf("Failed. buf[%d]: Expected 0xff got 0x%x", i, test_buf[i]);
+            rtos_osal_free(test_buf);
+            return -1;
+        }
+    }
+
+    rtos_osal_free(test_buf);
+    return 0;
+}
+#endif
+
+QSPI_FLASH_MAIN_TEST_ATTR
+static int main_test(qspi_flash_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(QSPI_FLASH_TILE)
+    {
+        if (read_chunks(ctx->qspi_flash_ctx) == -1)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_read_chunk_test(qspi_flash_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -0,0 +1,130 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/qspi_flash/qspi_flash_test.h"
+
+static const char* test_name = "suspend_test";
+
+#define local_printf( FMT, ... )    qspi_flash_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define QSPI_FLASH_TILE         0
+
+/* The erase takes long enough for a read queued behind it to suspend it */
+#define SUSPEND_TEST_ERASE_ADDR 0x60000
+#define SUSPEND_TEST_ERASE_LEN  0x8000
+
+/* The read does not overlap the erase */
+#define SUSPEND_TEST_READ_ADDR  0x6F000
+#define SUSPEND_TEST_READ_LEN   256
+
+#if ON_TILE(QSPI_FLASH_TILE)
+static int erase_suspend(rtos_qspi_flash_t *ctx)
+{
+    static uint8_t test_buf[SUSPEND_TEST_READ_LEN];
+    rtos_qspi_flash_op_t erase_op;
+    rtos_qspi_flash_op_t read_op;
+    bool erase_done;
+
+    for (int i=0; i<SUSPEND_TEST_READ_LEN; i++)
+    {
+        test_buf[i] = (uint8_t)(0xFF & i);
+    }
+
+    /* Data in the erase range ensures that the erase is not skipped */
+    local_printf("Setup");
+    rtos_qspi_flash_erase_async(ctx, &erase_op, SUSPEND_TEST_ERASE_ADDR, 0x10000, NULL, NULL);
+    rtos_qspi_flash_op_wait(ctx, &erase_op, RTOS_OSAL_WAIT_FOREVER);
+    rtos_qspi_flash_write_async(ctx, &read_op, test_buf, SUSPEND_TEST_READ_ADDR, SUSPEND_TEST_READ_LEN, NULL, NULL);
+    rtos_qspi_flash_op_wait(ctx, &read_op, RTOS_OSAL_WAIT_FOREVER);
+    rtos_qspi_flash_write_async(ctx, &read_op, test_buf, SUSPEND_TEST_ERASE_ADDR, SUSPEND_TEST_READ_LEN, NULL, NULL);
+    rtos_qspi_flash_op_wait(ctx, &read_op, RTOS_OSAL_WAIT_FOREVER);
+
+    local_printf("Read during erase");
+    memset(test_buf, 0, sizeof(test_buf));
+    rtos_qspi_flash_erase_async(ctx, &erase_op, SUSPEND_TEST_ERASE_ADDR, SUSPEND_TEST_ERASE_LEN, NULL, NULL);
+    rtos_qspi_flash_read_async(ctx, &read_op, test_buf, SUSPEND_TEST_READ_ADDR, SUSPEND_TEST_READ_LEN, NULL, NULL);
+    rtos_qspi_flash_op_wait(ctx, &read_op, RTOS_OSAL_WAIT_FOREVER);
+
+    /* The erase must still be in progress, suspended for the read */
+    erase_done = rtos_qspi_flash_op_wait(ctx, &erase_op, 0) == RTOS_OSAL_SUCCESS;
+    if (!erase_done)
+    {
+        rtos_qspi_flash_op_wait(ctx, &erase_op, RTOS_OSAL_WAIT_FOREVER);
+    }
+
+    for (int i=0; i<SUSPEND_TEST_READ_LEN; i++)
+    {
+        if (test_buf[i] != (uint8_t)(0xFF & i))
+        {
+            local_printf("Failed. Read during erase buf[%d]: Expected 0x%x got 0x%x", i, (uint8_t)(0xFF & i), test_buf[i]);
+            return -1;
+        }
+    }
+
+    if (ctx->ctx.suspend_supported && erase_done)
+    {
+        local_printf("Failed. The read waited for the erase to complete");
+        return -1;
+    }
+    else if (!ctx->ctx.suspend_supported)
+    {
+        local_printf("Suspend not supported by the flash, read order not checked");
+    }
+
+    /* The resumed erase must have completed */
+    rtos_qspi_flash_read(ctx, test_buf, SUSPEND_TEST_ERASE_ADDR, SUSPEND_TEST_READ_LEN);
+    for (int i=0; i<SUSPEND_TEST_READ_LEN; i++)
+    {
+        if (test_buf[i] != 0xFF)
+        {
+            local_printf("Failed. Erased buf[%d]: Expected 0xff got 0x%x", i, test_buf[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+QSPI_FLASH_MAIN_TEST_ATTR
+static int main_test(qspi_flash_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(QSPI_FLASH_TILE)
+    {
+        if (erase_suspend(ctx->qspi_flash_ctx) == -1)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_suspend_test(qspi_flash_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
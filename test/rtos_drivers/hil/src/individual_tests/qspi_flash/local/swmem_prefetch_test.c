@@ -0,0 +1,161 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+#include <xcore/interrupt.h>
+#include <xcore/swmem_fill.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+#if USE_SWMEM
+#include "xcore_device_memory.h"
+#endif
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/qspi_flash/qspi_flash_test.h"
+
+static const char* test_name = "swmem_prefetch_test";
+
+#define local_printf( FMT, ... )    qspi_flash_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define QSPI_FLASH_TILE         0
+#define QSPI_FLASH_TEST_ADDR    0x90000
+
+#define SWMEM_TEST_LINE_BYTES   (SWMEM_FILL_SIZE_WORDS * sizeof(uint32_t))
+
+#if ON_TILE(QSPI_FLASH_TILE) && USE_SWMEM && SWMEM_PREFETCH_LINES > 0
+
+/* Two lines to start the read ahead, the lines read ahead, and one after */
+#define SWMEM_TEST_LINES        (2 + SWMEM_PREFETCH_LINES + 1)
+
+static uint8_t line_byte(int line, int i)
+{
+    return (uint8_t)(line * 3 + i);
+}
+
+static int verify(int line, uint32_t *buf)
+{
+    uint8_t *bytes = (uint8_t *)buf;
+
+    for (int i=0; i<SWMEM_TEST_LINE_BYTES; i++)
+    {
+        if (bytes[i] != line_byte(line, i))
+        {
+            local_printf("Failed. Line %d [%d]: Expected 0x%x got 0x%x", line, i, line_byte(line, i), bytes[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Fills a line the way that the SwMem fill interrupt does */
+static bool fill_isr(int line, uint32_t *buf)
+{
+    bool filled;
+
+    interrupt_mask_all();
+    filled = swmem_flash_read_request_isr(QSPI_FLASH_TEST_ADDR + line * SWMEM_TEST_LINE_BYTES, buf);
+    interrupt_unmask_all();
+
+    return filled;
+}
+
+static int swmem_prefetch(rtos_qspi_flash_t *ctx)
+{
+    static uint8_t test_buf[SWMEM_TEST_LINES * SWMEM_TEST_LINE_BYTES];
+    uint32_t line_buf[SWMEM_FILL_SIZE_WORDS];
+    int line;
+
+    for (line=0; line<SWMEM_TEST_LINES; line++)
+    {
+        for (int i=0; i<SWMEM_TEST_LINE_BYTES; i++)
+        {
+            test_buf[line * SWMEM_TEST_LINE_BYTES + i] = line_byte(line, i);
+        }
+    }
+    rtos_qspi_flash_erase(ctx, QSPI_FLASH_TEST_ADDR, sizeof(test_buf));
+    rtos_qspi_flash_write(ctx, test_buf, QSPI_FLASH_TEST_ADDR, sizeof(test_buf));
+
+    swmem_flash_init(ctx);
+
+    /* Two sequential fills start reading ahead */
+    local_printf("Sequential fills");
+    for (line=0; line<2; line++)
+    {
+        swmem_flash_read_request(QSPI_FLASH_TEST_ADDR + line * SWMEM_TEST_LINE_BYTES, line_buf);
+        if (verify(line, line_buf) == -1)
+        {
+            return -1;
+        }
+    }
+
+    /* Give the read ahead time to complete */
+    rtos_osal_delay(RTOS_OSAL_WAIT_MS(10));
+
+    local_printf("Fill %d lines from the read ahead", SWMEM_PREFETCH_LINES);
+    for (; line<2 + SWMEM_PREFETCH_LINES; line++)
+    {
+        memset(line_buf, 0, sizeof(line_buf));
+        if (!fill_isr(line, line_buf))
+        {
+            local_printf("Failed. Line %d was not read ahead", line);
+            return -1;
+        }
+        if (verify(line, line_buf) == -1)
+        {
+            return -1;
+        }
+    }
+
+    /* The next sequential line is left to the task, which reads ahead again */
+    if (fill_isr(line, line_buf))
+    {
+        local_printf("Failed. Line %d was filled beyond the read ahead", line);
+        return -1;
+    }
+    swmem_flash_read_request(QSPI_FLASH_TEST_ADDR + line * SWMEM_TEST_LINE_BYTES, line_buf);
+    if (verify(line, line_buf) == -1)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+#endif
+
+QSPI_FLASH_MAIN_TEST_ATTR
+static int main_test(qspi_flash_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(QSPI_FLASH_TILE) && USE_SWMEM && SWMEM_PREFETCH_LINES > 0
+    {
+        if (swmem_prefetch(ctx->qspi_flash_ctx) == -1)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_swmem_prefetch_test(qspi_flash_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
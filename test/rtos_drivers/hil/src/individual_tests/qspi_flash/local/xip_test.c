@@ -0,0 +1,172 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/qspi_flash/qspi_flash_test.h"
+
+static const char* test_name = "xip_test";
+
+#define local_printf( FMT, ... )    qspi_flash_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define QSPI_FLASH_TILE         0
+
+/* Only read during the test */
+#define XIP_TEST_READ_ADDR      0xC0000
+/* Programmed and erased between the reads */
+#define XIP_TEST_WRITE_ADDR     0xD0000
+
+#define XIP_TEST_LEN            4096
+#define XIP_TEST_READ_LEN       256
+#define XIP_TEST_READS          4
+#define XIP_TEST_ROUNDS         4
+
+#if ON_TILE(QSPI_FLASH_TILE)
+static uint8_t read_byte(int i)
+{
+    return (uint8_t)(0xFF & (i * 3 + 1));
+}
+
+static uint8_t write_byte(int round, int i)
+{
+    return (uint8_t)(0xFF & (i + round * 17));
+}
+
+static int xip_interleave(rtos_qspi_flash_t *ctx)
+{
+    static uint8_t write_buf[XIP_TEST_LEN];
+    static uint8_t written_buf[XIP_TEST_LEN];
+    static uint8_t erased_buf[XIP_TEST_LEN];
+    static uint8_t read_buf[XIP_TEST_READS][XIP_TEST_READ_LEN];
+    static rtos_qspi_flash_op_t read_op[XIP_TEST_READS];
+    static rtos_qspi_flash_op_t write_op, written_op, erase_op, erased_op;
+
+    local_printf("Erase and write");
+    rtos_qspi_flash_erase(ctx, XIP_TEST_READ_ADDR, XIP_TEST_LEN);
+    rtos_qspi_flash_erase(ctx, XIP_TEST_WRITE_ADDR, XIP_TEST_LEN);
+    for (int i=0; i<XIP_TEST_LEN; i++)
+    {
+        write_buf[i] = read_byte(i);
+    }
+    rtos_qspi_flash_write(ctx, write_buf, XIP_TEST_READ_ADDR, XIP_TEST_LEN);
+
+    /*
+     * All of the operations of a round are queued at once, so that the
+     * driver does not go idle between them. The reads leave the flash in
+     * XIP mode, and the program and erase that follow them must take it out
+     * again. The reads of the written area must see each change in turn.
+     */
+    for (int round=0; round<XIP_TEST_ROUNDS; round++)
+    {
+        local_printf("Interleaved round %d", round);
+
+        for (int i=0; i<XIP_TEST_LEN; i++)
+        {
+            write_buf[i] = write_byte(round, i);
+        }
+        memset(read_buf, 0, sizeof(read_buf));
+        memset(written_buf, 0, sizeof(written_buf));
+        memset(erased_buf, 0, sizeof(erased_buf));
+
+        rtos_qspi_flash_read_async(ctx, &read_op[0], read_buf[0], XIP_TEST_READ_ADDR + 0 * XIP_TEST_READ_LEN, XIP_TEST_READ_LEN, NULL, NULL);
+        rtos_qspi_flash_read_async(ctx, &read_op[1], read_buf[1], XIP_TEST_READ_ADDR + 1 * XIP_TEST_READ_LEN, XIP_TEST_READ_LEN, NULL, NULL);
+        rtos_qspi_flash_write_async(ctx, &write_op, write_buf, XIP_TEST_WRITE_ADDR, XIP_TEST_LEN, NULL, NULL);
+        rtos_qspi_flash_read_async(ctx, &written_op, written_buf, XIP_TEST_WRITE_ADDR, XIP_TEST_LEN, NULL, NULL);
+        rtos_qspi_flash_read_async(ctx, &read_op[2], read_buf[2], XIP_TEST_READ_ADDR + 2 * XIP_TEST_READ_LEN, XIP_TEST_READ_LEN, NULL, NULL);
+        rtos_qspi_flash_erase_async(ctx, &erase_op, XIP_TEST_WRITE_ADDR, XIP_TEST_LEN, NULL, NULL);
+        rtos_qspi_flash_read_async(ctx, &erased_op, erased_buf, XIP_TEST_WRITE_ADDR, XIP_TEST_LEN, NULL, NULL);
+        rtos_qspi_flash_read_async(ctx, &read_op[3], read_buf[3], XIP_TEST_READ_ADDR + 3 * XIP_TEST_READ_LEN, XIP_TEST_READ_LEN, NULL, NULL);
+
+        rtos_qspi_flash_op_wait(ctx, &read_op[0], RTOS_OSAL_WAIT_FOREVER);
+        rtos_qspi_flash_op_wait(ctx, &read_op[1], RTOS_OSAL_WAIT_FOREVER);
+        rtos_qspi_flash_op_wait(ctx, &write_op, RTOS_OSAL_WAIT_FOREVER);
+        rtos_qspi_flash_op_wait(ctx, &written_op, RTOS_OSAL_WAIT_FOREVER);
+        rtos_qspi_flash_op_wait(ctx, &read_op[2], RTOS_OSAL_WAIT_FOREVER);
+        rtos_qspi_flash_op_wait(ctx, &erase_op, RTOS_OSAL_WAIT_FOREVER);
+        rtos_qspi_flash_op_wait(ctx, &erased_op, RTOS_OSAL_WAIT_FOREVER);
+        rtos_qspi_flash_op_wait(ctx, &read_op[3], RTOS_OSAL_WAIT_FOREVER);
+
+        for (int r=0; r<XIP_TEST_READS; r++)
+        {
+            for (int i=0; i<XIP_TEST_READ_LEN; i++)
+            {
+                if (read_buf[r][i] != read_byte(r * XIP_TEST_READ_LEN + i))
+                {
+                    local_printf("Failed. Read %d [%d]: Expected 0x%x got 0x%x", r, i, read_byte(r * XIP_TEST_READ_LEN + i), read_buf[r][i]);
+                    return -1;
+                }
+            }
+        }
+
+        for (int i=0; i<XIP_TEST_LEN; i++)
+        {
+            if (written_buf[i] != write_byte(round, i))
+            {
+                local_printf("Failed. Written [%d]: Expected 0x%x got 0x%x", i, write_byte(round, i), written_buf[i]);
+                return -1;
+            }
+            if (erased_buf[i] != 0xFF)
+            {
+                local_printf("Failed. Erased [%d]: Expected 0xff got 0x%x", i, erased_buf[i]);
+                return -1;
+            }
+        }
+    }
+
+    /* The flash must accept commands again once the driver is idle */
+    local_printf("Read after idle");
+    memset(written_buf, 0, sizeof(written_buf));
+    rtos_qspi_flash_read(ctx, written_buf, XIP_TEST_READ_ADDR, XIP_TEST_LEN);
+    for (int i=0; i<XIP_TEST_LEN; i++)
+    {
+        if (written_buf[i] != read_byte(i))
+        {
+            local_printf("Failed after idle. buf[%d]: Expected 0x%x got 0x%x", i, read_byte(i), written_buf[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+QSPI_FLASH_MAIN_TEST_ATTR
+static int main_test(qspi_flash_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(QSPI_FLASH_TILE)
+    {
+        if (xip_interleave(ctx->qspi_flash_ctx) == -1)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_xip_test(qspi_flash_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
@@ -11,6 +11,9 @@
 
 /* Library headers */
 #include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+#if USE_FATFS
+#include "fs_support.h"
+#endif
 
 /* App headers */
 #include "app_conf.h"
@@ -38,6 +41,19 @@ static int run_qspi_flash_tests(qspi_flash_test_ctx_t *test_ctx, chanend_t c)
     return retval;
 }
 
+#if USE_FATFS
+void qspi_flash_test_fatfs_mount(qspi_flash_test_ctx_t *ctx)
+{
+    static int mounted;
+
+    if (!mounted)
+    {
+        rtos_fatfs_init(ctx->qspi_flash_ctx);
+        mounted = 1;
+    }
+}
+#endif
+
 static void start_qspi_flash_devices(qspi_flash_test_ctx_t *test_ctx)
 {
     qspi_flash_printf("rpc configure");
@@ -57,8 +73,32 @@ static void register_qspi_flash_tests(qspi_flash_test_ctx_t *test_ctx)
 
     register_read_write_read_test(test_ctx);
 
+    register_ftl_remount_test(test_ctx);
+
+    register_fatfs_dir_test(test_ctx);
+
+    register_fatfs_latency_test(test_ctx);
+
+    register_cache_test(test_ctx);
+
+    register_async_test(test_ctx);
+
+    register_suspend_test(test_ctx);
+
+    register_read_chunk_test(test_ctx);
+
+    register_pre_erase_test(test_ctx);
+
+    register_swmem_prefetch_test(test_ctx);
+
+    register_isr_read_test(test_ctx);
+
+    register_xip_test(test_ctx);
+
     register_rpc_read_write_read_test(test_ctx);
 
+    register_rpc_async_test(test_ctx);
+
     register_multiple_user_test(test_ctx);
 }
 
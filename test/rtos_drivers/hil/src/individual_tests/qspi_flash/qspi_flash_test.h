@@ -8,7 +8,7 @@
 
 #define qspi_flash_printf( FMT, ... )       module_printf("QSPI_FLASH", FMT, ##__VA_ARGS__)
 
-#define QSPI_FLASH_MAX_TESTS   4
+#define QSPI_FLASH_MAX_TESTS   16
 
 #define QSPI_FLASH_MAIN_TEST_ATTR      __attribute__((fptrgroup("rtos_test_qspi_flash_main_test_fptr_grp")))
 
@@ -28,14 +28,31 @@ typedef int (*qspi_flash_main_test_t)(qspi_flash_test_ctx_t *ctx);
 
 int qspi_flash_device_tests(rtos_qspi_flash_t *qspi_flash_ctx, chanend_t c);
 
+#if USE_FATFS
+/* Mounts the FatFs volume on this tile's flash the first time it is called */
+void qspi_flash_test_fatfs_mount(qspi_flash_test_ctx_t *ctx);
+#endif
+
 /* Independant Tests */
 void register_check_params_test(qspi_flash_test_ctx_t *test_ctx);
 void register_multiple_user_test(qspi_flash_test_ctx_t *test_ctx);
 
 /* Local Tests */
 void register_read_write_read_test(qspi_flash_test_ctx_t *test_ctx);
+void register_ftl_remount_test(qspi_flash_test_ctx_t *test_ctx);
+void register_fatfs_dir_test(qspi_flash_test_ctx_t *test_ctx);
+void register_fatfs_latency_test(qspi_flash_test_ctx_t *test_ctx);
+void register_cache_test(qspi_flash_test_ctx_t *test_ctx);
+void register_async_test(qspi_flash_test_ctx_t *test_ctx);
+void register_suspend_test(qspi_flash_test_ctx_t *test_ctx);
+void register_read_chunk_test(qspi_flash_test_ctx_t *test_ctx);
+void register_pre_erase_test(qspi_flash_test_ctx_t *test_ctx);
+void register_swmem_prefetch_test(qspi_flash_test_ctx_t *test_ctx);
+void register_isr_read_test(qspi_flash_test_ctx_t *test_ctx);
+void register_xip_test(qspi_flash_test_ctx_t *test_ctx);
 
 /* RPC Tests */
 void register_rpc_read_write_read_test(qspi_flash_test_ctx_t *test_ctx);
+void register_rpc_async_test(qspi_flash_test_ctx_t *test_ctx);
 
 #endif /* QSPI_FLASH_TEST_H_ */
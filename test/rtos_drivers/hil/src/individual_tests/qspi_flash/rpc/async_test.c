@@ -0,0 +1,181 @@
+// Copyright 2021 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/* System headers */
+#include <platform.h>
+#include <xs1.h>
+#include <string.h>
+
+/* Library headers */
+#include "rtos/osal/api/rtos_osal.h"
+#include "rtos/drivers/qspi_flash/api/rtos_qspi_flash.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "individual_tests/qspi_flash/qspi_flash_test.h"
+
+static const char* test_name = "rpc_async_test";
+
+#define local_printf( FMT, ... )    qspi_flash_printf("%s|" FMT, test_name, ##__VA_ARGS__)
+
+#define QSPI_FLASH_TILE         1
+#define QSPI_FLASH_TEST_ADDR    0xB0000
+
+/* The number of operations kept outstanding on the RPC client at once */
+#define ASYNC_TEST_OPS          4
+#define ASYNC_TEST_CHUNK_LEN    256
+#define ASYNC_TEST_CHUNKS       16
+#define ASYNC_TEST_LEN          (ASYNC_TEST_CHUNK_LEN * ASYNC_TEST_CHUNKS)
+
+#if ON_TILE(QSPI_FLASH_TILE)
+typedef struct {
+    uint8_t *buf;
+    int next_chunk;
+    int chunks_read;
+    rtos_osal_semaphore_t done;
+} chained_read_t;
+
+RTOS_QSPI_FLASH_OP_CALLBACK_ATTR
+static void chained_read_cb(
+        rtos_qspi_flash_t *ctx,
+        rtos_qspi_flash_op_t *op,
+        void *arg)
+{
+    chained_read_t *read = arg;
+
+    read->chunks_read++;
+
+    if (read->next_chunk < ASYNC_TEST_CHUNKS) {
+        /* Reuse the op that just completed for the next chunk not yet requested */
+        int chunk = read->next_chunk++;
+
+        rtos_qspi_flash_read_async(ctx, op,
+                                   read->buf + chunk * ASYNC_TEST_CHUNK_LEN,
+                                   QSPI_FLASH_TEST_ADDR + chunk * ASYNC_TEST_CHUNK_LEN,
+                                   ASYNC_TEST_CHUNK_LEN,
+                                   chained_read_cb, read);
+    } else if (read->chunks_read == ASYNC_TEST_CHUNKS) {
+        rtos_osal_semaphore_put(&read->done);
+    }
+}
+
+static int verify(const char *step, uint8_t *buf, size_t len)
+{
+    for (int i=0; i<len; i++)
+    {
+        if (buf[i] != (uint8_t)(0xFF & (i + 3)))
+        {
+            local_printf("Failed after %s. buf[%d]: Expected 0x%x got 0x%x", step, i, (uint8_t)(0xFF & (i + 3)), buf[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int async_ops(rtos_qspi_flash_t *ctx)
+{
+    static uint8_t test_buf[ASYNC_TEST_LEN];
+    static chained_read_t read;
+    static rtos_qspi_flash_op_t op[ASYNC_TEST_OPS];
+    rtos_osal_status_t status;
+
+    local_printf("Erase and write");
+    rtos_qspi_flash_erase(ctx, QSPI_FLASH_TEST_ADDR, ASYNC_TEST_LEN);
+    for (int i=0; i<ASYNC_TEST_LEN; i++)
+    {
+        test_buf[i] = (uint8_t)(0xFF & (i + 3));
+    }
+    rtos_qspi_flash_write(ctx, test_buf, QSPI_FLASH_TEST_ADDR, ASYNC_TEST_LEN);
+
+    /* All of the reads are sent before any of them is waited for */
+    local_printf("Overlapped reads");
+    memset(test_buf, 0, sizeof(test_buf));
+    for (int i=0; i<ASYNC_TEST_OPS; i++)
+    {
+        rtos_qspi_flash_read_async(ctx, &op[i],
+                                   test_buf + i * (ASYNC_TEST_LEN / ASYNC_TEST_OPS),
+                                   QSPI_FLASH_TEST_ADDR + i * (ASYNC_TEST_LEN / ASYNC_TEST_OPS),
+                                   ASYNC_TEST_LEN / ASYNC_TEST_OPS,
+                                   NULL, NULL);
+    }
+    for (int i=0; i<ASYNC_TEST_OPS; i++)
+    {
+        if (rtos_qspi_flash_op_wait(ctx, &op[i], RTOS_OSAL_WAIT_MS(1000)) != RTOS_OSAL_SUCCESS)
+        {
+            local_printf("Failed. Read %d did not complete", i);
+            return -1;
+        }
+    }
+    if (verify("overlapped reads", test_buf, ASYNC_TEST_LEN) == -1)
+    {
+        return -1;
+    }
+
+    /*
+     * Each op is resubmitted from its callback, so that ASYNC_TEST_OPS reads
+     * stay outstanding until every chunk has been read.
+     */
+    local_printf("Chained reads");
+    memset(test_buf, 0, sizeof(test_buf));
+    read.buf = test_buf;
+    read.next_chunk = ASYNC_TEST_OPS;
+    read.chunks_read = 0;
+    rtos_osal_semaphore_create(&read.done, "rpc_async_test_done", 1, 0);
+
+    for (int i=0; i<ASYNC_TEST_OPS; i++)
+    {
+        rtos_qspi_flash_read_async(ctx, &op[i],
+                                   test_buf + i * ASYNC_TEST_CHUNK_LEN,
+                                   QSPI_FLASH_TEST_ADDR + i * ASYNC_TEST_CHUNK_LEN,
+                                   ASYNC_TEST_CHUNK_LEN,
+                                   chained_read_cb, &read);
+    }
+    status = rtos_osal_semaphore_get(&read.done, RTOS_OSAL_WAIT_MS(1000));
+    rtos_osal_semaphore_delete(&read.done);
+
+    if (status != RTOS_OSAL_SUCCESS)
+    {
+        local_printf("Failed. Only %d of %d chained reads completed", read.chunks_read, ASYNC_TEST_CHUNKS);
+        return -1;
+    }
+
+    if (verify("chained reads", test_buf, ASYNC_TEST_LEN) == -1)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+#endif
+
+QSPI_FLASH_MAIN_TEST_ATTR
+static int main_test(qspi_flash_test_ctx_t *ctx)
+{
+    local_printf("Start");
+
+    #if ON_TILE(QSPI_FLASH_TILE)
+    {
+        if (async_ops(ctx->qspi_flash_ctx) == -1)
+        {
+            return -1;
+        }
+    }
+    #endif
+
+    local_printf("Done");
+    return 0;
+}
+
+void register_rpc_async_test(qspi_flash_test_ctx_t *test_ctx)
+{
+    uint32_t this_test_num = test_ctx->test_cnt;
+
+    local_printf("Register to test num %d", this_test_num);
+
+    test_ctx->name[this_test_num] = (char*)test_name;
+    test_ctx->main_test[this_test_num] = main_test;
+
+    test_ctx->test_cnt++;
+}
+
+#undef local_printf
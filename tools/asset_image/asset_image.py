@@ -0,0 +1,206 @@
+#!/usr/bin/env python
+# Copyright 2021 XMOS LIMITED.
+# This Software is subject to the terms of the XMOS Public Licence: Version 1.
+"""
+Builds a packed read only asset image for the asset_image sw_service.
+See README.md for the image format.
+
+The index is a minimal perfect hash built with the compress, hash and
+displace (CHD) method. Each name hashes to a bucket, holding about
+BUCKET_SIZE names, that has its own displacement value. The displacement
+rehashes the names in the bucket to free slots, of which there are a power
+of two at least as many as the assets. The index then grows linearly with
+the number of assets. The device keeps the displacements in RAM while the
+image is mounted, and finds any asset by reading one index entry.
+"""
+from __future__ import print_function
+
+import argparse
+import struct
+import sys
+from pathlib import Path
+
+MAGIC = 0x4D494158  # "XAIM"
+VERSION = 2
+HEADER_FORMAT = "<8I"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+DISPLACEMENT_SIZE = 4
+ENTRY_SIZE = 64
+NAME_MAX = ENTRY_SIZE - 8 - 1
+BUCKET_SIZE = 4
+DISPLACEMENT_TRIES = 1 << 16
+SEED_TRIES = 16
+
+FNV_OFFSET_BASIS = 2166136261
+FNV_PRIME = 16777619
+
+
+def name_hash(name, seed):
+    """32-bit FNV-1a, with the offset basis XORed with seed, followed by the
+    MurmurHash3 finalizer so that the low bits depend on every byte."""
+    h = FNV_OFFSET_BASIS ^ seed
+    for b in name:
+        h ^= b
+        h = (h * FNV_PRIME) & 0xFFFFFFFF
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & 0xFFFFFFFF
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & 0xFFFFFFFF
+    h ^= h >> 16
+    return h
+
+
+def bucket_of(name, seed, bucket_count):
+    return name_hash(name, seed) & (bucket_count - 1)
+
+
+def slot_of(name, seed, displacement, slot_count):
+    return name_hash(name, (seed + 1 + displacement) & 0xFFFFFFFF) & (slot_count - 1)
+
+
+def find_displacements(names, seed, bucket_count, slot_count):
+    """Returns a list of the displacement of each bucket and a dict of name
+    to slot, or None if some bucket cannot be placed with this seed.
+
+    The buckets holding the most names are placed first, while most slots
+    are still free."""
+    buckets = [[] for _ in range(bucket_count)]
+    for name in names:
+        buckets[bucket_of(name, seed, bucket_count)].append(name)
+
+    displacements = [0] * bucket_count
+    slots = {}
+    used = set()
+    for bucket in sorted(range(bucket_count), key=lambda b: len(buckets[b]), reverse=True):
+        bucket_names = buckets[bucket]
+        if not bucket_names:
+            break
+        for displacement in range(DISPLACEMENT_TRIES):
+            bucket_slots = set(slot_of(name, seed, displacement, slot_count) for name in bucket_names)
+            if len(bucket_slots) == len(bucket_names) and used.isdisjoint(bucket_slots):
+                break
+        else:
+            return None
+        displacements[bucket] = displacement
+        for name in bucket_names:
+            slots[name] = slot_of(name, seed, displacement, slot_count)
+        used.update(slots[name] for name in bucket_names)
+
+    return displacements, slots
+
+
+def build_index(names):
+    """Returns the seed, the number of slots and the displacements, and a
+    dict of name to slot. If no seed places every bucket the number of
+    slots is doubled."""
+    bucket_count = 1
+    while bucket_count * BUCKET_SIZE < len(names):
+        bucket_count *= 2
+
+    slot_count = 1
+    while slot_count < len(names):
+        slot_count *= 2
+
+    while True:
+        for seed in range(SEED_TRIES):
+            index = find_displacements(names, seed, bucket_count, slot_count)
+            if index is not None:
+                displacements, slots = index
+                return seed, slot_count, displacements, slots
+        slot_count *= 2
+
+
+def gather_assets(inputs):
+    """Returns a dict of asset name to file path. Files are named by their
+    path relative to the directory given on the command line, or by their
+    file name if given directly."""
+    assets = {}
+    for input_path in inputs:
+        path = Path(input_path)
+        if path.is_dir():
+            files = [(f.relative_to(path).as_posix(), f) for f in sorted(path.rglob("*")) if f.is_file()]
+        elif path.is_file():
+            files = [(path.name, path)]
+        else:
+            raise ValueError("{}: no such file or directory".format(input_path))
+
+        for name, f in files:
+            if len(name.encode("utf-8")) > NAME_MAX:
+                raise ValueError("{}: name is longer than {} bytes".format(name, NAME_MAX))
+            if name in assets:
+                raise ValueError("{}: more than one asset has this name".format(name))
+            assets[name] = f
+    return assets
+
+
+def align_up(value, alignment):
+    return (value + alignment - 1) // alignment * alignment
+
+
+def build_image(assets, alignment):
+    names = [name.encode("utf-8") for name in assets]
+
+    seed, slot_count, displacements, slots = build_index(names)
+    bucket_count = len(displacements)
+
+    index = [None] * slot_count
+    data = bytearray()
+    data_start = align_up(HEADER_SIZE + bucket_count * DISPLACEMENT_SIZE + slot_count * ENTRY_SIZE, alignment)
+
+    for name, path in assets.items():
+        blob = path.read_bytes()
+        data.extend(bytes(align_up(len(data), alignment) - len(data)))
+        offset = data_start + len(data)
+        data.extend(blob)
+        index[slots[name.encode("utf-8")]] = (offset, len(blob), name.encode("utf-8"))
+
+    image_size = data_start + len(data)
+
+    image = bytearray(
+        struct.pack(HEADER_FORMAT, MAGIC, VERSION, seed, slot_count, len(names), alignment, image_size, bucket_count)
+    )
+    image.extend(struct.pack("<{}I".format(bucket_count), *displacements))
+    for entry in index:
+        if entry is None:
+            image.extend(bytes(ENTRY_SIZE))
+        else:
+            offset, size, name = entry
+            image.extend(struct.pack("<II", offset, size))
+            image.extend(name.ljust(ENTRY_SIZE - 8, b"\0"))
+    image.extend(bytes(data_start - len(image)))
+    image.extend(data)
+
+    return image, slot_count
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build a read only asset image to place in flash")
+    parser.add_argument("output", help="Output image file")
+    parser.add_argument("inputs", nargs="+", help="Files and directories to add to the image")
+    parser.add_argument(
+        "--align",
+        type=int,
+        default=4,
+        help="Alignment in bytes of each asset's data from the start of the image. Must be a power of two. Default is 4",
+    )
+    args = parser.parse_args()
+
+    if args.align <= 0 or (args.align & (args.align - 1)) != 0:
+        print("--align must be a power of two", file=sys.stderr)
+        return 1
+
+    try:
+        assets = gather_assets(args.inputs)
+    except ValueError as e:
+        print(e, file=sys.stderr)
+        return 1
+
+    image, slot_count = build_image(assets, args.align)
+    Path(args.output).write_bytes(image)
+
+    print("{}: {} assets, {} index slots, {} bytes".format(args.output, len(assets), slot_count, len(image)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,109 @@
+# Copyright 2021 XMOS LIMITED.
+# This Software is subject to the terms of the XMOS Public Licence: Version 1.
+import struct
+from pathlib import Path
+
+import pytest
+
+import asset_image
+
+EXAMPLE_DIR = Path(__file__).parent / "example"
+
+
+def mount(image):
+    """Reads the header and displacement table the same way as
+    asset_image_mount() on the device."""
+    header = struct.unpack_from(asset_image.HEADER_FORMAT, image)
+    magic, version, seed, slot_count, asset_count, alignment, size, bucket_count = header
+    assert magic == asset_image.MAGIC
+    assert version == asset_image.VERSION
+    assert size == len(image)
+    assert bucket_count <= slot_count
+
+    displacements = struct.unpack_from("<{}I".format(bucket_count), image, asset_image.HEADER_SIZE)
+    return seed, slot_count, alignment, displacements
+
+
+def find(image, name):
+    """Looks up an asset the same way as asset_image_find() on the device,
+    reading only its index entry from the image once it is mounted.
+    Returns the asset's data, or None if it is not in the image."""
+    seed, slot_count, alignment, displacements = mount(image)
+    bucket_count = len(displacements)
+
+    name = name.encode("utf-8")
+    bucket = asset_image.bucket_of(name, seed, bucket_count)
+    slot = asset_image.slot_of(name, seed, displacements[bucket], slot_count)
+
+    entry_address = (
+        asset_image.HEADER_SIZE + bucket_count * asset_image.DISPLACEMENT_SIZE + slot * asset_image.ENTRY_SIZE
+    )
+    offset, length = struct.unpack_from("<II", image, entry_address)
+    entry_name = bytes(image[entry_address + 8 : entry_address + asset_image.ENTRY_SIZE]).rstrip(b"\0")
+    if entry_name != name:
+        return None
+
+    assert offset % alignment == 0
+    return bytes(image[offset : offset + length])
+
+
+def index_size(image):
+    _, _, _, slot_count, _, _, _, bucket_count = struct.unpack_from(asset_image.HEADER_FORMAT, image)
+    return bucket_count * asset_image.DISPLACEMENT_SIZE + slot_count * asset_image.ENTRY_SIZE
+
+
+def write_assets(path, count):
+    for i in range(count):
+        asset = path / "models" / "asset_{}.bin".format(i)
+        asset.parent.mkdir(parents=True, exist_ok=True)
+        asset.write_bytes(bytes([i & 0xFF]) * (i % 7))
+
+
+def test_example():
+    image, _ = asset_image.build_image(asset_image.gather_assets([str(EXAMPLE_DIR)]), 4)
+
+    assert find(image, "hello.txt") == (EXAMPLE_DIR / "hello.txt").read_bytes()
+    assert find(image, "prompts/welcome.txt") == (EXAMPLE_DIR / "prompts" / "welcome.txt").read_bytes()
+    assert find(image, "welcome.txt") is None
+
+
+def test_empty():
+    image, _ = asset_image.build_image({}, 4)
+
+    assert find(image, "hello.txt") is None
+
+
+@pytest.mark.parametrize("count", [1, 5, 64, 1000])
+@pytest.mark.parametrize("alignment", [4, 64])
+def test_find_every_asset(tmp_path, count, alignment):
+    write_assets(tmp_path, count)
+    image, _ = asset_image.build_image(asset_image.gather_assets([str(tmp_path)]), alignment)
+
+    for i in range(count):
+        assert find(image, "models/asset_{}.bin".format(i)) == bytes([i & 0xFF]) * (i % 7)
+    assert find(image, "models/asset_{}.bin".format(count)) is None
+
+
+def test_index_grows_linearly(tmp_path):
+    sizes = []
+    for count in [250, 500, 1000]:
+        path = tmp_path / str(count)
+        write_assets(path, count)
+        image, _ = asset_image.build_image(asset_image.gather_assets([str(path)]), 4)
+        sizes.append(index_size(image))
+
+        # At most two slots per asset, and a displacement per bucket
+        assert index_size(image) <= count * 2 * (asset_image.ENTRY_SIZE + asset_image.DISPLACEMENT_SIZE)
+
+    assert sizes[2] <= 2 * sizes[1] <= 4 * sizes[0]
+
+
+def test_name_too_long(tmp_path):
+    (tmp_path / ("a" * (asset_image.NAME_MAX + 1))).write_bytes(b"")
+
+    with pytest.raises(ValueError):
+        asset_image.gather_assets([str(tmp_path)])
+
+
+if __name__ == "__main__":
+    pytest.main()
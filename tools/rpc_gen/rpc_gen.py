@@ -0,0 +1,423 @@
+#!/usr/bin/env python
+# Copyright 2021 XMOS LIMITED.
+# This Software is subject to the terms of the XMOS Public Licence: Version 1.
+"""
+Generates the RPC client stubs and host dispatcher for an RTOS driver from
+a compact interface description. See README.md for the description format.
+
+The generated code uses a fixed message layout for each function. Scalar
+parameters and the return value are packed into C structs, so their offsets
+are computed by the compiler and no parameter descriptors are sent, parsed
+or walked at runtime. Buffers follow the fixed part of the message, each
+padded to the alignment of its elements.
+"""
+from __future__ import print_function
+
+import argparse
+import re
+import sys
+from pathlib import Path
+
+DIRECTIONS = ("in", "out", "inout")
+
+
+class IdlError(Exception):
+    def __init__(self, path, line_num, msg):
+        super().__init__("{}:{}: {}".format(path, line_num, msg))
+
+
+class Param:
+    def __init__(self, direction, decl, count):
+        self.direction = direction
+        self.decl = decl
+        self.count = count
+        self.name = self._name_get(decl)
+
+    @staticmethod
+    def _name_get(decl):
+        # The name of a pointer-to-array parameter is inside the parentheses,
+        # e.g. int32_t (*sample_buf)[4]. Otherwise it is the last identifier.
+        m = re.search(r"\(\s*\*\s*([A-Za-z_]\w*)\s*\)", decl)
+        if m:
+            return m.group(1)
+        m = re.search(r"([A-Za-z_]\w*)\s*$", decl)
+        if m:
+            return m.group(1)
+        return None
+
+    @property
+    def is_buffer(self):
+        return self.count is not None
+
+    @property
+    def is_input(self):
+        return self.direction in ("in", "inout")
+
+    @property
+    def is_output(self):
+        return self.direction in ("out", "inout")
+
+    @property
+    def length(self):
+        return "{}_len".format(self.name)
+
+    def length_decl(self):
+        return "const size_t {} = sizeof({}[0]) * ({});".format(
+            self.length, self.name, self.count
+        )
+
+
+class Function:
+    def __init__(self, name, host_function, return_type):
+        self.name = name
+        self.host_function = host_function
+        self.return_type = return_type
+        self.params = []
+
+    @property
+    def returns_value(self):
+        return self.return_type != "void"
+
+    def scalars(self):
+        return [p for p in self.params if not p.is_buffer]
+
+    def buffers(self, direction_test):
+        return [p for p in self.params if p.is_buffer and direction_test(p)]
+
+
+class Interface:
+    def __init__(self):
+        self.prefix = None
+        self.context = None
+        self.include = []
+        self.lock = None
+        self.functions = []
+
+
+def parse_idl(path):
+    interface = Interface()
+    function = None
+
+    with open(path) as f:
+        lines = f.readlines()
+
+    for line_num, line in enumerate(lines, 1):
+        line = line.split("#", 1)[0].strip()
+        if not line:
+            continue
+
+        keyword, _, rest = line.partition(" ")
+        rest = rest.strip()
+
+        if keyword == "interface":
+            interface.prefix = rest
+        elif keyword == "context":
+            interface.context = rest
+        elif keyword == "include":
+            interface.include.append(rest)
+        elif keyword == "lock":
+            interface.lock = rest
+        elif keyword == "function":
+            fields = rest.split(None, 2)
+            if len(fields) != 3:
+                raise IdlError(
+                    path, line_num, "expected: function <name> <host function> <return type>"
+                )
+            function = Function(*fields)
+            interface.functions.append(function)
+        elif keyword in DIRECTIONS:
+            if function is None:
+                raise IdlError(path, line_num, "parameter outside of a function")
+            decl, sep, count = rest.partition(":")
+            param = Param(keyword, decl.strip(), count.strip() if sep else None)
+            if param.name is None:
+                raise IdlError(path, line_num, "cannot find the parameter name")
+            if not param.is_buffer and keyword != "in":
+                raise IdlError(
+                    path, line_num, "only buffers may be outputs, give a count after ':'"
+                )
+            function.params.append(param)
+        else:
+            raise IdlError(path, line_num, "unknown keyword '{}'".format(keyword))
+
+    if interface.prefix is None or interface.context is None:
+        raise IdlError(path, len(lines), "interface and context must both be given")
+
+    return interface
+
+
+class Writer:
+    def __init__(self):
+        self.lines = []
+        self.indent = 0
+
+    def __call__(self, text=""):
+        for line in text.split("\n"):
+            self.lines.append(("    " * self.indent + line) if line else "")
+
+    def text(self):
+        return "\n".join(self.lines) + "\n"
+
+
+def req_type(interface, function):
+    return "{}_{}_req_t".format(interface.prefix, function.name)
+
+
+def resp_type(interface, function):
+    return "{}_{}_resp_t".format(interface.prefix, function.name)
+
+
+def pad_name(interface):
+    return "{}_rpc_pad".format(interface.prefix)
+
+
+def write_offsets(w, function, fixed_size):
+    """
+    Declares <buffer>_ofs, the offset of each input buffer from the start of
+    the request message. Each buffer is padded to the alignment of its
+    elements, so that the host can use it in place. Returns the expression
+    for the length of the whole request message.
+    """
+    end = fixed_size
+    for p in function.buffers(lambda p: p.is_input):
+        w(
+            "const size_t {0}_ofs = RPC_GEN_ALIGN({1}, __alignof__({0}[0]));".format(
+                p.name, end
+            )
+        )
+        end = "{}_ofs + {}".format(p.name, p.length)
+    return end
+
+
+def write_layouts(w, interface, function):
+    w("/*")
+    w(" * Fixed parts of the {}() request and response messages.".format(function.host_function))
+    w(" */")
+    w("typedef struct {")
+    w("    rpc_fixed_request_hdr_t hdr;")
+    w("    {} *ctx;".format(interface.context))
+    for p in function.scalars():
+        w("    {};".format(p.decl))
+    w("}} {};".format(req_type(interface, function)))
+    w()
+    w("typedef struct {")
+    w("    int fcode;")
+    if function.returns_value:
+        w("    {} ret;".format(function.return_type))
+    w("}} {};".format(resp_type(interface, function)))
+    w()
+
+
+def write_client_stub(w, interface, function):
+    prefix = interface.prefix
+    in_buffers = function.buffers(lambda p: p.is_input)
+    out_buffers = function.buffers(lambda p: p.is_output)
+
+    w('__attribute__((fptrgroup("{}_fptr_grp")))'.format(function.host_function))
+    w("static {} {}_remote_{}(".format(function.return_type, prefix, function.name))
+    args = ["{} *ctx".format(interface.context)] + [p.decl for p in function.params]
+    w(",\n".join("        " + a for a in args) + ")")
+    w("{")
+    w.indent += 1
+    w("rtos_intertile_address_t *host_address = &ctx->rpc_config->host_address;")
+    w("rtos_intertile_t *intertile_ctx = host_address->intertile_ctx;")
+    for p in function.buffers(lambda p: True):
+        w(p.length_decl())
+    w("{} req;".format(req_type(interface, function)))
+    req_length = write_offsets(w, function, "sizeof(req)")
+    w("{} resp;".format(resp_type(interface, function)))
+    w("size_t msg_length;")
+    w()
+    w("xassert(host_address->port >= 0);")
+    w()
+    w("req.hdr.fcode = fcode_{};".format(function.name))
+    w("req.hdr.param_count = 0;")
+    w("req.ctx = ctx->rpc_config->host_ctx_ptr;")
+    for p in function.scalars():
+        w("req.{0} = {0};".format(p.name))
+    w()
+    if interface.lock:
+        w("rtos_osal_mutex_get(&ctx->{}, RTOS_OSAL_WAIT_FOREVER);".format(interface.lock))
+        w()
+    w("rtos_intertile_tx_len(intertile_ctx, host_address->port, {});".format(req_length))
+    w("rtos_intertile_tx_data(intertile_ctx, &req, sizeof(req));")
+    end = "sizeof(req)"
+    for p in in_buffers:
+        w("if ({}_ofs > {}) {{".format(p.name, end))
+        w("    rtos_intertile_tx_data(intertile_ctx, {}, {}_ofs - ({}));".format(pad_name(interface), p.name, end))
+        w("}")
+        end = "{}_ofs + {}".format(p.name, p.length)
+        w("if ({} > 0) {{".format(p.length))
+        w("    rtos_intertile_tx_data(intertile_ctx, {}, {});".format(p.name, p.length))
+        w("}")
+    w()
+    w("msg_length = rtos_intertile_rx_len(intertile_ctx, host_address->port, RTOS_OSAL_WAIT_FOREVER);")
+    length = " + ".join(["sizeof(resp)"] + [p.length for p in out_buffers])
+    w("xassert(msg_length == {});".format(length))
+    w("rtos_intertile_rx_data(intertile_ctx, &resp, sizeof(resp));")
+    for p in out_buffers:
+        w("if ({} > 0) {{".format(p.length))
+        w("    rtos_intertile_rx_data(intertile_ctx, {}, {});".format(p.name, p.length))
+        w("}")
+    w()
+    if interface.lock:
+        w("rtos_osal_mutex_put(&ctx->{});".format(interface.lock))
+        w()
+    w("xassert(resp.fcode == fcode_{});".format(function.name))
+    if function.returns_value:
+        w()
+        w("return resp.ret;")
+    w.indent -= 1
+    w("}")
+    w()
+
+
+def write_host_function(w, interface, function):
+    prefix = interface.prefix
+    in_buffers = function.buffers(lambda p: p.is_input)
+    out_buffers = function.buffers(lambda p: p.is_output)
+    out_only = function.buffers(lambda p: p.is_output and not p.is_input)
+
+    w(
+        "static void {}_{}_rpc_host(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)".format(
+            prefix, function.name
+        )
+    )
+    w("{")
+    w.indent += 1
+    w("{} *req = rpc_msg->msg_buf;".format(req_type(interface, function)))
+    w("{} *ctx = req->ctx;".format(interface.context))
+    for p in function.scalars():
+        w("{} = req->{};".format(p.decl, p.name))
+    for p in function.buffers(lambda p: True):
+        w("{};".format(p.decl))
+    # The length of the last input buffer is only needed if it is also output
+    last_in = in_buffers[-1] if in_buffers else None
+    for p in function.buffers(lambda p: p.is_output or p is not last_in):
+        w(p.length_decl())
+    write_offsets(w, function, "sizeof(*req)")
+    w("{} resp;".format(resp_type(interface, function)))
+    w()
+    if in_buffers:
+        w("/* Input buffers are used in place in the request message */")
+        for p in in_buffers:
+            w("{0} = (void *) ((uint8_t *) req + {0}_ofs);".format(p.name))
+        w()
+    if out_only:
+        w("/* Output only buffers are allocated here, as the caller would have */")
+        for p in out_only:
+            w("{} = rtos_osal_malloc({});".format(p.name, p.length))
+        w()
+    call_args = ", ".join(["ctx"] + [p.name for p in function.params])
+    if function.returns_value:
+        w("resp.ret = {}({});".format(function.host_function, call_args))
+    else:
+        w("{}({});".format(function.host_function, call_args))
+    w("resp.fcode = req->hdr.fcode;")
+    w()
+    w("/* send RPC response message to client */")
+    length = " + ".join(["sizeof(resp)"] + [p.length for p in out_buffers])
+    w("rtos_intertile_tx_len(client_address->intertile_ctx, client_address->port, {});".format(length))
+    w("rtos_intertile_tx_data(client_address->intertile_ctx, &resp, sizeof(resp));")
+    for p in out_buffers:
+        w("if ({} > 0) {{".format(p.length))
+        w("    rtos_intertile_tx_data(client_address->intertile_ctx, {}, {});".format(p.name, p.length))
+        w("}")
+    for p in out_only:
+        w("rtos_osal_free({});".format(p.name))
+    w.indent -= 1
+    w("}")
+    w()
+
+
+def write_dispatch(w, interface):
+    prefix = interface.prefix
+    w("RPC_HOST_DISPATCH_ATTR")
+    w("static void {}_rpc_dispatch(rtos_intertile_address_t *client_address, rpc_msg_t *rpc_msg)".format(prefix))
+    w("{")
+    w("    switch (rpc_msg->fcode) {")
+    for function in interface.functions:
+        w("    case fcode_{}:".format(function.name))
+        w("        {}_{}_rpc_host(client_address, rpc_msg);".format(prefix, function.name))
+        w("        break;")
+    w("    default:")
+    w("        xassert(0);")
+    w("    }")
+    w("}")
+
+
+def generate(interface, idl_name, output_name):
+    guard = re.sub(r"\W", "_", output_name).upper() + "_"
+    w = Writer()
+
+    w("// Copyright 2021 XMOS LIMITED.")
+    w("// This Software is subject to the terms of the XMOS Public Licence: Version 1.")
+    w()
+    w("/*")
+    w(" * Generated by tools/rpc_gen/rpc_gen.py from {}. Do not edit.".format(idl_name))
+    w(" *")
+    w(" * This is included by the driver's RPC source file, and provides the static")
+    w(" * client stub {}_remote_<function>() for each function, and the host".format(interface.prefix))
+    w(" * dispatch function {}_rpc_dispatch().".format(interface.prefix))
+    w(" */")
+    w()
+    w("#ifndef {}".format(guard))
+    w("#define {}".format(guard))
+    w()
+    w('#include "rtos/drivers/rpc/api/rtos_rpc.h"')
+    for include in interface.include:
+        w("#include {}".format(include))
+    w()
+    if any(function.buffers(lambda p: p.is_input) for function in interface.functions):
+        w("#ifndef RPC_GEN_ALIGN")
+        w("#define RPC_GEN_ALIGN(x, a) (((x) + (a) - 1) & ~((size_t) (a) - 1))")
+        w("#endif")
+        w()
+        w("/* Sent before each input buffer to align it, no alignment exceeds 8 on xcore */")
+        w("static uint8_t {}[8];".format(pad_name(interface)))
+        w()
+    w("enum {")
+    for function in interface.functions:
+        w("    fcode_{},".format(function.name))
+    w("};")
+    w()
+    for function in interface.functions:
+        write_layouts(w, interface, function)
+    for function in interface.functions:
+        write_client_stub(w, interface, function)
+    for function in interface.functions:
+        write_host_function(w, interface, function)
+    write_dispatch(w, interface)
+    w()
+    w("#endif /* {} */".format(guard))
+
+    return w.text()
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Generate RTOS driver RPC stubs from an interface description"
+    )
+    parser.add_argument("idl", help="Interface description file")
+    parser.add_argument(
+        "-o",
+        "--output",
+        help="Output header file. Defaults to the description file name with _gen.h in place of .idl",
+    )
+    args = parser.parse_args()
+
+    idl_path = Path(args.idl)
+    output = Path(args.output) if args.output else idl_path.with_name(idl_path.stem + "_gen.h")
+
+    try:
+        interface = parse_idl(idl_path)
+    except IdlError as e:
+        print(e, file=sys.stderr)
+        return 1
+
+    output.write_text(generate(interface, idl_path.name, output.name))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())